@@ -41,6 +41,7 @@ typedef struct _Options
     const char* provDir;
     MI_Boolean help;
     MI_Uint32   idletimeout;
+    int         ringfd;
 }
 Options;
 
@@ -57,6 +58,8 @@ OPTIONS:\n\
     --version           Print version information.\n\
     --providerdir       Find providers in this directory.\n\
     --loglevel LEVEL    Set the log level (0-5).\n\
+    --ringfd FD         Exchange message pages through the shared-memory\n\
+                        rings created by the server on this descriptor.\n\
 \n");
 
 PRINTF_FORMAT(1, 2)
@@ -236,6 +239,7 @@ static void GetCommandLineOptions(int* argc, const char* argv[])
         "--providerdir:",
         "--idletimeout:",
         "--loglevel:",
+        "--ringfd:",
         NULL,
     };
 
@@ -277,6 +281,19 @@ static void GetCommandLineOptions(int* argc, const char* argv[])
 
             s_opts.idletimeout = x;
         }
+        else if (strcmp(state.opt, "--ringfd") == 0)
+        {
+            char* end;
+            long x = Strtol(state.arg, &end, 10);
+
+            if (*end != '\0' || x < 0)
+            {
+                err(ZT("bad option argument for --ringfd: %s"),
+                    scs(state.arg));
+            }
+
+            s_opts.ringfd = (int)x;
+        }
         else if (strcmp(state.opt, "--loglevel") == 0)
         {
             if (Log_SetLevelFromString(state.arg) != 0)
@@ -334,6 +351,7 @@ int agent_main(int argc, const char* argv[])
     arg0 = argv[0];
 
     memset(&s_data, 0, sizeof(s_data));
+    s_opts.ringfd = -1;
 
     /* Enable core dump */
     _EnableCoreDump();
@@ -390,12 +408,25 @@ int agent_main(int argc, const char* argv[])
 
     /* Create new protocol object */
     {
+        ProtocolRings* rings = NULL;
+
+        /* server sends pages through the rings once it passed them */
+        if (s_opts.ringfd != -1)
+        {
+            r = ProtocolRings_Attach(&rings, s_opts.ringfd);
+            close(s_opts.ringfd);
+
+            if (r != MI_RESULT_OK)
+                err(ZT("ProtocolRings_Attach() failed: %d"), (int)r);
+        }
+
         r = ProtocolSocketAndBase_New_Agent(
             &s_data.protocol,
             &s_data.selector,
             fd,
             MuxIn_Open,
-            &s_data.mux);
+            &s_data.mux,
+            rings);
 
         if (r != MI_RESULT_OK)
             err(ZT("ProtocolSocketAndBase_New_Agent() failed"));
@@ -407,6 +438,9 @@ int agent_main(int argc, const char* argv[])
 
         if (r != MI_RESULT_OK)
             err(ZT("ProvMgr_Init() failed"));
+
+        /* the server splits the instance batches */
+        s_data.provmgr.instanceBatchSize = PROVMGR_INSTANCEBATCH_SIZE;
     }
 
     /* idle timeout */
@@ -1859,7 +1859,7 @@ struct _Timer
 #endif
 
 #if defined(CONFIG_POSIX)
-    Handler handler;
+    SelectorTimer selectorTimer;
     Selector* selector;
 #endif
     /* End OS-Specific data */
@@ -450,6 +450,17 @@ MI_Boolean Batch_FixPointer(
     const Header_BatchInfoItem* ptrAdjustmentInfo,
     size_t ptrAdjustmentInfoCount,
     void** ptrInOut)
+{
+    return Batch_FixRange(
+        self, ptrAdjustmentInfo, ptrAdjustmentInfoCount, ptrInOut, 0);
+}
+
+MI_Boolean Batch_FixRange(
+    Batch* self,
+    const Header_BatchInfoItem* ptrAdjustmentInfo,
+    size_t ptrAdjustmentInfoCount,
+    void** ptrInOut,
+    size_t size)
 {
     /* see if pointer matches old blocks */
     size_t index;
@@ -470,6 +481,11 @@ MI_Boolean Batch_FixPointer(
         if ( old_ptr >= old_page &&
             old_ptr < (old_page + ptrAdjustmentInfo[index].pageSize) )
         {
+            /* the whole range has to be in the same page */
+            if (size > ptrAdjustmentInfo[index].pageSize -
+                (size_t)(old_ptr - old_page))
+                return MI_FALSE;
+
             *ptrInOut = ((char*)(p + 1)) + (old_ptr - old_page);
             return MI_TRUE;
         }
@@ -205,6 +205,15 @@ MI_Boolean Batch_FixPointer(
     size_t ptrAdjustmentInfoCount,
     void** ptrInOut);
 
+/* Same as Batch_FixPointer, but fails unless all 'size' bytes starting
+   at the pointer are within the page it points into */
+MI_Boolean Batch_FixRange(
+    Batch* batch,
+    const Header_BatchInfoItem* ptrAdjustmentInfo,
+    size_t ptrAdjustmentInfoCount,
+    void** ptrInOut,
+    size_t size);
+
 /* Add this block to list of individual blocks */
 MI_INLINE void Batch_AttachPage(
     Batch* self,
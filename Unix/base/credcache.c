@@ -10,6 +10,7 @@
 #include "credcache.h"
 #include "log.h"
 #include <pal/sleep.h>
+#include <pal/lock.h>
 
 #if defined (CONFIG_POSIX)
 # include <openssl/evp.h>
@@ -47,6 +48,8 @@ static int s_init;
 static int s_initAttempted;
 static const EVP_MD* s_md;
 static MI_Uint64    s_expirationTime_us = CRED_CACHE_TIME_TO_KEEP_USEC;
+/* requests may be authenticated on several I/O threads */
+static Lock s_lock = LOCK_INITIALIZER;
 
 static int _Init()
 {
@@ -176,28 +179,39 @@ void CredCache_PutUser(const char* user, const char* password)
     int pos;
     int userLen;
 
+    Lock_Acquire(&s_lock);
+
     if (!s_init && 0 != _Init())
     {
+        Lock_Release(&s_lock);
         return;
     }
 
     /* Check if user name is too long for cache */
     userLen = strlen(user);
     if (userLen >= CRED_USER_NAME_MAX_LEN)
+    {
+        Lock_Release(&s_lock);
         return;
+    }
 
     /* find position for user */
     pos = _FindUserEmptyOldest(user);
 
     /* timestamp */
     if (PAL_TRUE != PAL_Time(&s_cache[pos].timestamp))
+    {
+        Lock_Release(&s_lock);
         return;
+    }
 
     /* user name */
     strcpy(s_cache[pos].user, user);
 
     /* hash */
     _Hash(user, userLen, password, strlen(password), s_cache[pos].hash);
+
+    Lock_Release(&s_lock);
 }
 
 /* 
@@ -212,21 +226,24 @@ int CredCache_CheckUser(const char* user, const char* password)
     int pos;
     unsigned char hash[CRED_HASH_MAX_LEN];
     MI_Uint64 now;
+    int result = -1;
+
+    Lock_Acquire(&s_lock);
 
     /* 'no' if not initialized */
     if (!s_init)
-        return -1;
+        goto Done;
 
     /* Does user exisit in cache */
     if (-1 == (pos = _Find(user)))
-        return -1;
+        goto Done;
 
     /* Is it expired? */
     if (PAL_TRUE != PAL_Time(&now))
-        return -1;
+        goto Done;
 
     if (s_cache[pos].timestamp + s_expirationTime_us < now)
-        return -1;
+        goto Done;
 
     /* Hash matches? */
     memset(hash, 0, sizeof(hash));
@@ -235,10 +252,14 @@ int CredCache_CheckUser(const char* user, const char* password)
     assert(pos < MI_COUNT(s_cache));
 
     if (0 != memcmp(hash, s_cache[pos].hash, sizeof(hash)))
-        return -1;
+        goto Done;
 
     /* Credentials are valid */
-    return 0;
+    result = 0;
+
+Done:
+    Lock_Release(&s_lock);
+    return result;
 }
 
 /* Unit-test support - updating expiration timeout */
@@ -253,7 +274,9 @@ void CredCache_SetExpirationTimeout(MI_Uint64 expirationTimeUS)
 /* Unit-test support mostly - clear all cached items */
 void CredCache_Clean()
 {
+    Lock_Acquire(&s_lock);
     memset(s_cache, 0, sizeof(s_cache));
+    Lock_Release(&s_lock);
 }
 
 /*
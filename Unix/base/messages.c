@@ -31,7 +31,8 @@ typedef enum _MessageFieldType
     MFT_POINTER_OPT,        /* Pointer that has to be converted (may be null) */
     MFT_POINTER_SET_NULL,   /* Pointer that has to be nullified instead of converting */
     MFT_INSTANCE,           /* instance */
-    MFT_INSTANCE_OPT        /* instance  (maybe NULL) */
+    MFT_INSTANCE_OPT,       /* instance  (maybe NULL) */
+    MFT_INSTANCE_BATCH      /* PostInstanceBatchItem array (count at offPackedSize) */
 }
 MessageFieldType;
 
@@ -54,6 +55,8 @@ static const MessageField baseMessageFields[] =
     {MFT_POINTER_SET_NULL,offsetof(Message, prev),0,0},
     {MFT_POINTER_SET_NULL,offsetof(Message, dtor),0,0},
     {MFT_POINTER_SET_NULL,offsetof(Message, dtorData),0,0},
+    {MFT_POINTER_SET_NULL,offsetof(Message, payloadOwner),0,0},
+    {MFT_POINTER_SET_NULL,offsetof(Message, payloadPtr),0,0},
     {MFT_END_OF_LIST, 0, 0, 0}
 };
 
@@ -205,6 +208,12 @@ static const MessageField postIndicationMessageFields[] =
     {MFT_END_OF_LIST, 0, 0, 0}
 };
 
+static const MessageField postInstanceBatchMessageFields[] =
+{
+    {MFT_INSTANCE_BATCH,offsetof(PostInstanceBatchMsg, items),0,offsetof(PostInstanceBatchMsg, count)},
+    {MFT_END_OF_LIST, 0, 0, 0}
+};
+
 /* Entries in this array corresponds to MessageTag values */
 typedef struct _MessageDeclaration
 {
@@ -251,6 +260,7 @@ static const MessageDeclaration allMessages[] = {
     {invokeMessageFields,               sizeof(InvokeReq),              MI_TRUE}, /* ShellConnectReqTag */
 #endif
     {pullMessageFields,                 sizeof(PullReq),                MI_TRUE},
+    {postInstanceBatchMessageFields,    sizeof(PostInstanceBatchMsg),   MI_FALSE},
 };
 
 /*
@@ -357,6 +367,11 @@ void __Message_Release(
             (*self->dtor)(self, self->dtorData);
         }
 
+        if (self->payloadOwner)
+        {
+            __Message_Release(self->payloadOwner, cs);
+        }
+
         Batch_Destroy(self->batch);
     }
     else
@@ -380,6 +395,20 @@ void __Message_Release(
 #endif /* defined(CONFIG_ENABLE_DEBUG) */
 }
 
+void Message_SetPayload(
+    Message* self,
+    Message* owner,
+    void* ptr,
+    MI_Uint32 size)
+{
+    DEBUG_ASSERT(NULL == self->payloadOwner);
+
+    Message_AddRef(owner);
+    self->payloadOwner = owner;
+    self->payloadPtr = ptr;
+    self->payloadSize = size;
+}
+
 static MI_Boolean _UnpackInstance(
     Batch* batch,
     void* ptr,
@@ -477,6 +506,49 @@ static MI_Result _RestoreMessage(
 
             break;
 
+        case MFT_INSTANCE_BATCH:
+            {
+                PostInstanceBatchMsg* batchMsg = (PostInstanceBatchMsg*)msg;
+                MI_Uint32 i;
+
+                if (!*ptr || batchMsg->count > batchMsg->capacity)
+                {
+                    trace_RestoreMsgFailed_PtrPackedMissing();
+                    return MI_RESULT_INVALID_PARAMETER;
+                }
+
+                /* the items used and every packed instance (read in place
+                   later) have to be within the pages received */
+                if (!Batch_FixRange(
+                    batch,
+                    ptrAdjustmentInfo,
+                    ptrAdjustmentInfoCount,
+                    ptr,
+                    (size_t)batchMsg->count * sizeof(PostInstanceBatchItem)))
+                {
+                    trace_RestoreMsgFailed_PointersForMstPointer();
+                    return MI_RESULT_INVALID_PARAMETER;
+                }
+
+                /* instances stay packed; they are only passed on */
+                for (i = 0; i < batchMsg->count; i++)
+                {
+                    if (!batchMsg->items[i].packedInstancePtr ||
+                        !Batch_FixRange(
+                            batch,
+                            ptrAdjustmentInfo,
+                            ptrAdjustmentInfoCount,
+                            &batchMsg->items[i].packedInstancePtr,
+                            batchMsg->items[i].packedInstanceSize))
+                    {
+                        trace_RestoreMsgFailed_PointersForMstInstance();
+                        return MI_RESULT_INVALID_PARAMETER;
+                    }
+                }
+            }
+
+            break;
+
         default:
             break;
         }
@@ -636,6 +708,8 @@ MI_Result __MessageFromBatch(
     /* fix base part of message */
     msg->batch = batch;
     msg->refCounter = 1;
+    /* a payload sent along is a page of the batch now */
+    msg->payloadSize = 0;
 
     if (MI_RESULT_OK != _RestoreMessage(
         msg,
@@ -741,6 +815,25 @@ MI_Result MessagePackCloneForBinarySending(
     return MI_RESULT_OK;
 }
 
+PostInstanceMsg* PostInstanceBatchMsg_NewItemMsg(
+    PostInstanceBatchMsg* self,
+    MI_Uint32 index)
+{
+    const PostInstanceBatchItem* item = &self->items[index];
+    PostInstanceMsg* msg = PostInstanceMsg_New(self->base.operationId);
+
+    if (!msg)
+        return NULL;
+
+    msg->base.flags = self->base.flags;
+    msg->packedInstancePtr = item->packedInstancePtr;
+    msg->packedInstanceSize = item->packedInstanceSize;
+    Message_SetPayload(&msg->base, &self->base,
+        item->packedInstancePtr, item->packedInstanceSize);
+
+    return msg;
+}
+
 /*
 **==============================================================================
 **
@@ -789,6 +882,7 @@ const PAL_Char* _MsgNames[] = {
     PAL_T("ShellCommandReq(invoke)"),
 #endif
     PAL_T("PullReq"),
+    PAL_T("PostInstanceBatchMsg"),
 };
 
 const PAL_Char* MessageName(MI_Uint32 tag)
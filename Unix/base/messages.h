@@ -74,7 +74,8 @@ typedef enum _MessageTag
     ShellDisconnectReqTag = 31 | MessageTagIsRequest, /* Basically a InvokeInstanceReqTag */
     ShellCommandReqTag = 32 | MessageTagIsRequest, /* Basically a InvokeInstanceReqTag */
 #endif
-    PullRequestTag = 33 | MessageTagIsRequest
+    PullRequestTag = 33 | MessageTagIsRequest,
+    PostInstanceBatchMsgTag = 34
 }
 MessageTag;
 
@@ -118,7 +119,11 @@ typedef enum _MessageFlag
     WSMAN_MethodInParameter =           0x8000,
 
     WSMAN_IsShellRequest =              0x10000,
-    WSMAN_IsShellResponse =             0x20000
+    WSMAN_IsShellResponse =             0x20000,
+
+    /* Binary-specific encoding options: the client unpacks compact
+       instances (set by the protocol from the revision of the client) */
+    BinaryProtocol_CompactInstanceFlag = 0x40000
 }
 MessageFlag;
 
@@ -190,6 +195,14 @@ struct _Message
 
     /* Data passed as 2nd argument of 'dtor' */
     void* dtorData;
+
+    /* Opaque payload [opt]: bytes the message points to that live in the
+        batch of 'payloadOwner' (referenced until this message is destroyed)
+        instead of its own batch; they are passed on without being copied
+        and the binary protocol sends them as one more page */
+    struct _Message* payloadOwner;
+    void* payloadPtr;
+    MI_Uint32 payloadSize;
 };
 
 Message* __Message_New(
@@ -213,6 +226,14 @@ void __Message_AddRef(
     Message* self,
     CallSite cs);
 
+/* Makes 'size' bytes at 'ptr' in the batch of 'owner' the opaque payload of
+   the message (see Message.payloadOwner); adds a reference to 'owner' */
+void Message_SetPayload(
+    Message* self,
+    Message* owner,
+    void* ptr,
+    MI_Uint32 size);
+
 /*
     Verifies if message is final reposne to the initial request
 */
@@ -785,6 +806,85 @@ MI_INLINE void __PostIndicationMsg_Release(
 
 void PostIndicationMsg_Print(const PostIndicationMsg* msg, FILE* os);
 
+/*
+**==============================================================================
+**
+** PostInstanceBatchMsg
+**
+**     Several packed instances of one operation in a single message; sent
+**     by the agent instead of a PostInstanceMsg per instance and split back
+**     into PostInstanceMsg by the server. Instances are packed the same way
+**     as PostInstanceMsg.packedInstancePtr (flags of the message tell how).
+**
+**==============================================================================
+*/
+
+typedef struct _PostInstanceBatchItem
+{
+    void*           packedInstancePtr;
+    MI_Uint32       packedInstanceSize;
+}
+PostInstanceBatchItem;
+
+typedef struct _PostInstanceBatchMsg
+{
+    Message                 base;
+    /* array of 'capacity' items, the first 'count' are used */
+    PostInstanceBatchItem*  items;
+    MI_Uint32               count;
+    MI_Uint32               capacity;
+    /* total of packedInstanceSize of all items */
+    MI_Uint32               packedSize;
+}
+PostInstanceBatchMsg;
+
+#define PostInstanceBatchMsg_New(operationId, capacity) \
+    __PostInstanceBatchMsg_New(operationId, capacity, CALLSITE)
+
+MI_INLINE PostInstanceBatchMsg* __PostInstanceBatchMsg_New(
+    MI_Uint64 operationId,
+    MI_Uint32 capacity,
+    CallSite cs)
+{
+    PostInstanceBatchMsg* self = (PostInstanceBatchMsg*)__Message_New(
+        PostInstanceBatchMsgTag, sizeof(PostInstanceBatchMsg), operationId, 0,
+        cs);
+
+    if (self)
+    {
+        self->items = (PostInstanceBatchItem*)Batch_GetClear(self->base.batch,
+            capacity * sizeof(PostInstanceBatchItem));
+
+        if (!self->items)
+        {
+            __Message_Release(&self->base, cs);
+            return NULL;
+        }
+
+        self->capacity = capacity;
+    }
+
+    return self;
+}
+
+#define PostInstanceBatchMsg_Release(self) \
+    __PostInstanceBatchMsg_Release(self, CALLSITE)
+
+MI_INLINE void __PostInstanceBatchMsg_Release(
+    PostInstanceBatchMsg* self,
+    CallSite cs)
+{
+    __Message_Release(&self->base, cs);
+}
+
+/* Creates a PostInstanceMsg for the item at 'index'; the packed instance
+   stays in this message (it becomes the payload of the new message) */
+PostInstanceMsg* PostInstanceBatchMsg_NewItemMsg(
+    PostInstanceBatchMsg* self,
+    MI_Uint32 index);
+
+void PostInstanceBatchMsg_Print(const PostInstanceBatchMsg* msg, FILE* os);
+
 /*
 **==============================================================================
 **
@@ -1327,13 +1427,26 @@ MI_INLINE void __HttpRequestMsg_Release(
 #define HttpRequestMsg_New(page, headers) \
     __HttpRequestMsg_New(page, headers, CALLSITE)
 
+/* Frees request content: one page, or the list of pages a large XML body
+   is received in (each holds a zero-terminated piece of the document) */
+MI_INLINE void HttpRequestMsg_FreePages(
+    _In_opt_ Page* page)
+{
+    while (page)
+    {
+        Page* next = page->u.s.next;
+
+        PAL_Free(page);
+        page = next;
+    }
+}
+
 MI_INLINE void __HttpRequestMsg_dtor(Message* message, void* callbackData)
 {
     HttpRequestMsg* msg;
     DEBUG_ASSERT(message->tag == HttpRequestMsgTag);
     msg = (HttpRequestMsg*)message;
-    if (msg->page)
-        PAL_Free(msg->page);
+    HttpRequestMsg_FreePages(msg->page);
 }
 
 MI_INLINE HttpRequestMsg* __HttpRequestMsg_New(
@@ -1363,12 +1476,78 @@ MI_INLINE HttpRequestMsg* __HttpRequestMsg_New(
     return msg;
 }
 
+/*
+    Gathered response content: the pieces of content are not copied into
+    pages, but sent from where they are. Every page of such a list holds
+    an HttpContentRef in place of data; u.s.size is the size of the data
+    referred to. The owner of the data is released once the page is sent
+    (or dropped).
+*/
+typedef struct _HttpContentRef
+{
+    const void* data;
+    void (*release)(void* owner);
+    void* owner;
+}
+HttpContentRef;
+
+MI_INLINE Page* HttpContentRef_New(
+    _In_reads_bytes_(size) const void* data,
+    size_t size,
+    void (*release)(void* owner),
+    _In_opt_ void* owner)
+{
+    Page* page = (Page*)PAL_Malloc(sizeof(Page) + sizeof(HttpContentRef));
+    HttpContentRef* ref;
+
+    if (!page)
+        return NULL;
+
+    memset(page, 0, sizeof(Page));
+    page->u.s.size = (unsigned int)size;
+
+    ref = (HttpContentRef*)(page + 1);
+    ref->data = data;
+    ref->release = release;
+    ref->owner = owner;
+
+    return page;
+}
+
+MI_INLINE const char* HttpContentRef_Data(
+    _In_ const Page* page)
+{
+    return (const char*)((const HttpContentRef*)(page + 1))->data;
+}
+
+/* Frees a list of HttpContentRef pages */
+MI_INLINE void HttpContentRef_FreeList(
+    _In_opt_ Page* page)
+{
+    while (page)
+    {
+        Page* next = page->u.s.next;
+        HttpContentRef* ref = (HttpContentRef*)(page + 1);
+
+        if (ref->release)
+            ref->release(ref->owner);
+
+        PAL_Free(page);
+        page = next;
+    }
+}
+
 typedef struct _HttpResponseMsg
 {
     Message base;
 
+    /* content; a list of pages (linked by u.s.next) is sent chunked,
+       unless it is gathered content */
     Page * page;
     int httpErrorCode;
+
+    /* page is a list of HttpContentRef pages, sent as one body */
+    MI_Boolean gather;
 }
 HttpResponseMsg;
 
@@ -1380,8 +1559,19 @@ MI_INLINE void __HttpResponseMsg_dtor(Message* message, void* callbackData)
     HttpResponseMsg* msg;
     DEBUG_ASSERT( message->tag == HttpResponseMsgTag );
     msg = (HttpResponseMsg*)message;
-    if (msg->page)
+
+    if (msg->gather)
+    {
+        HttpContentRef_FreeList(msg->page);
+        msg->page = NULL;
+    }
+
+    while (msg->page)
+    {
+        Page* next = msg->page->u.s.next;
         PAL_Free(msg->page);
+        msg->page = next;
+    }
 }
 
 MI_INLINE HttpResponseMsg* __HttpResponseMsg_New(
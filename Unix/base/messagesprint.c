@@ -315,6 +315,13 @@ void MessagePrint(const Message* msg, FILE* os)
             }
             break;
 
+        case PostInstanceBatchMsgTag:
+            {
+                const PostInstanceBatchMsg* m = (const PostInstanceBatchMsg*)msg;
+                PostInstanceBatchMsg_Print(m, os);
+            }
+            break;
+
         default:
             Ftprintf(os, ZT("unknown message tag %d\n"), msg->tag);
             break;
@@ -472,6 +479,20 @@ void PostInstanceMsg_Print(const PostInstanceMsg* msg, FILE* os)
     _Message_Print(msg, os, "PostInstanceMsg", fields);
 }
 
+void PostInstanceBatchMsg_Print(const PostInstanceBatchMsg* msg, FILE* os)
+{
+    typedef PostInstanceBatchMsg Self;
+    static const Field fields[] =
+    {
+        {"tag", FT_UINT32, offsetof(Self, base.tag)},
+        {"operationId", FT_UINT64, offsetof(Self, base.operationId)},
+        {"count", FT_UINT32, offsetof(Self, count)},
+        {"packedSize", FT_UINT32, offsetof(Self, packedSize)},
+        {NULL, 0, 0},
+    };
+    _Message_Print(msg, os, "PostInstanceBatchMsg", fields);
+}
+
 void PostSchemaMsg_Print(const PostSchemaMsg* msg, FILE* os)
 {
     typedef PostSchemaMsg Self;
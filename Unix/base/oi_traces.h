@@ -290,7 +290,7 @@ OI_EVENT("Timer_Start:Selector not specified or initialized (%p)")
 void trace_Timer_Selector_Missing(void* selector);
 OI_EVENT("Timer: Unable to access current time")
 void trace_Timer_Cannot_AccessCurrentTime();
-OI_EVENT("Timer_Start: Unable to add handler to selector (%p")
+OI_EVENT("Timer_Start: Unable to add timer to selector (%p)")
 void trace_Timer_Cannot_AddHandlerToSelector(void* selector);
 OI_EVENT("Timer_Close: Double close of timer (%p)")
 void trace_Timer_Double_Close(void* timer);
@@ -792,6 +792,12 @@ void trace_NtlmEnvIgnored(const char * ntlm_user_file);
 OI_EVENT("SSL Compression was disabled in the OMI configuration, but the version of SSL used by OMI does not support it.")
 void trace_Http_SslCompressionNotPresent();
 
+OI_EVENT("cannot create shared-memory rings of %u bytes for agent; using the socket alone")
+void trace_AgentRings_CreateFailed(unsigned int size);
+
+OI_EVENT("RequestItem %p: cannot allocate instance %u of a batch from agent; instance dropped")
+void trace_RequestItem_InstanceBatchSplitFailed(void * requestItem, unsigned int index);
+
 
 
 /******************************** INFORMATIONAL ***********************************/
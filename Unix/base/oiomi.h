@@ -711,7 +711,7 @@ FILE_EVENT0(20110, trace_Timer_Cannot_AccessCurrentTime_Impl, LOG_ERR, PAL_T("Ti
 #else
 #define trace_Timer_Cannot_AddHandlerToSelector(a0) trace_Timer_Cannot_AddHandlerToSelector_Impl(0, 0, a0)
 #endif
-FILE_EVENT1(20111, trace_Timer_Cannot_AddHandlerToSelector_Impl, LOG_ERR, PAL_T("Timer_Start: Unable to add handler to selector (%p"), void*)
+FILE_EVENT1(20111, trace_Timer_Cannot_AddHandlerToSelector_Impl, LOG_ERR, PAL_T("Timer_Start: Unable to add timer to selector (%p)"), void*)
 #if defined(CONFIG_ENABLE_DEBUG)
 #define trace_Timer_Double_Close(a0) trace_Timer_Double_Close_Impl(__FILE__, __LINE__, a0)
 #else
@@ -2129,6 +2129,18 @@ FILE_EVENT1(30210, trace_NtlmEnvIgnored_Impl, LOG_WARNING, PAL_T("NTLM_USER_FILE
 #endif
 FILE_EVENT0(30211, trace_Http_SslCompressionNotPresent_Impl, LOG_WARNING, PAL_T("SSL Compression was disabled in the OMI configuration, but the version of SSL used by OMI does not support it."))
 #if defined(CONFIG_ENABLE_DEBUG)
+#define trace_AgentRings_CreateFailed(a0) trace_AgentRings_CreateFailed_Impl(__FILE__, __LINE__, a0)
+#else
+#define trace_AgentRings_CreateFailed(a0) trace_AgentRings_CreateFailed_Impl(0, 0, a0)
+#endif
+FILE_EVENT1(30212, trace_AgentRings_CreateFailed_Impl, LOG_WARNING, PAL_T("cannot create shared-memory rings of %u bytes for agent; using the socket alone"), unsigned int)
+#if defined(CONFIG_ENABLE_DEBUG)
+#define trace_RequestItem_InstanceBatchSplitFailed(a0, a1) trace_RequestItem_InstanceBatchSplitFailed_Impl(__FILE__, __LINE__, a0, a1)
+#else
+#define trace_RequestItem_InstanceBatchSplitFailed(a0, a1) trace_RequestItem_InstanceBatchSplitFailed_Impl(0, 0, a0, a1)
+#endif
+FILE_EVENT2(30213, trace_RequestItem_InstanceBatchSplitFailed_Impl, LOG_WARNING, PAL_T("RequestItem %p: cannot allocate instance %u of a batch from agent; instance dropped"), void *, unsigned int)
+#if defined(CONFIG_ENABLE_DEBUG)
 #define trace_Agent_DisconnectedFromServer() trace_Agent_DisconnectedFromServer_Impl(__FILE__, __LINE__)
 #else
 #define trace_Agent_DisconnectedFromServer() trace_Agent_DisconnectedFromServer_Impl(0, 0)
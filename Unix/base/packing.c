@@ -9,11 +9,16 @@
 
 #include "packing.h"
 #include "naming.h"
+#include "field.h"
+#include "types.h"
 #include <pal/format.h>
 
 /** Magic number for MI_Instance objects (binary buffer pack/unpack) */
 #define INSTANCE_MAGIC ((MI_Uint32)0x462b9957)
 
+/** Magic number for MI_Instance objects in the compact encoding */
+#define INSTANCE_COMPACT_MAGIC ((MI_Uint32)0x462b9958)
+
 /* The magic number that occurs at the end of an instance serialization */
 static const MI_Uint32 _END_MAGIC = 0x76f474e3;
 
@@ -374,6 +379,1043 @@ static MI_Result _UnpackField(
     MI_RETURN(MI_RESULT_OK);
 }
 
+/*
+**==============================================================================
+**
+** Compact encoding:
+**
+**     instance := INSTANCE_COMPACT_MAGIC(u32) body
+**     body     := schema nameSpace(str) exists(bitmap) value*
+**     schema   := varint; 0 is followed by a new schema that gets the next
+**                 index: flags, className(str), count and count times
+**                 property flags, name(str) and type(u8); n refers to the
+**                 schema with index n - 1
+**     str      := varint; 0 is NULL, 2 * index + 1 refers to a string of
+**                 the table, 2 * (length + 1) is followed by the characters
+**                 (null terminated) and adds the string to the table
+**
+**     Only properties in the exists bitmap have a value. Integers are
+**     varints (signed ones zigzag-encoded), reals and 8-bit values go as
+**     they are in host byte order, arrays are a varint count followed by
+**     the elements, embedded instances are bodies.
+**
+**     The schema and string tables span one packed instance (with all its
+**     embedded instances) rather than the connection: packed instances are
+**     forwarded by the server as they are received from agents.
+**
+**==============================================================================
+*/
+
+/* Entries of the tables kept on stack before any allocation is made */
+#define COMPACT_INLINE_STRINGS 32
+#define COMPACT_INLINE_SCHEMAS 4
+#define COMPACT_INLINE_PROPERTIES 64
+
+typedef struct _CompactString
+{
+    const ZChar* str;
+    MI_Uint32 len;
+    MI_Uint32 hash;
+}
+CompactString;
+
+typedef struct _CompactSchema
+{
+    const MI_ClassDecl* cd;
+    MI_Boolean keysOnly;
+    MI_Uint32 count;
+}
+CompactSchema;
+
+typedef struct _CompactPacker
+{
+    Buf* buf;
+
+    /* Strings written so far (their index is their position) */
+    CompactString* strings;
+    MI_Uint32 stringsSize;
+    MI_Uint32 stringsCapacity;
+
+    /* Open-addressed table finding strings by hash: position + 1, zero
+       if free; twice the capacity of strings, so it is never full */
+    MI_Uint32* lookup;
+    MI_Uint32 lookupCapacity;
+
+    /* Schemas written so far (filtered top-level schema is not shared) */
+    CompactSchema* schemas;
+    MI_Uint32 schemasSize;
+    MI_Uint32 schemasCapacity;
+
+    CompactString inlineStrings[COMPACT_INLINE_STRINGS];
+    CompactSchema inlineSchemas[COMPACT_INLINE_SCHEMAS];
+    MI_Uint32 inlineLookup[2 * COMPACT_INLINE_STRINGS];
+}
+CompactPacker;
+
+typedef struct _CompactProperty
+{
+    MI_Uint32 flags;
+    const ZChar* name;
+    MI_Type type;
+}
+CompactProperty;
+
+typedef struct _CompactClass
+{
+    MI_Uint32 flags;
+    const ZChar* name;
+
+    /* Properties of the schema in CompactUnpacker.properties */
+    MI_Uint32 first;
+    MI_Uint32 count;
+}
+CompactClass;
+
+typedef struct _CompactUnpacker
+{
+    Buf* buf;
+    Batch* batch;
+    MI_Boolean copy;
+
+    const ZChar** strings;
+    MI_Uint32 stringsSize;
+    MI_Uint32 stringsCapacity;
+
+    CompactClass* classes;
+    MI_Uint32 classesSize;
+    MI_Uint32 classesCapacity;
+
+    CompactProperty* properties;
+    MI_Uint32 propertiesSize;
+    MI_Uint32 propertiesCapacity;
+
+    const ZChar* inlineStrings[COMPACT_INLINE_STRINGS];
+    CompactClass inlineClasses[COMPACT_INLINE_SCHEMAS];
+    CompactProperty inlineProperties[COMPACT_INLINE_PROPERTIES];
+}
+CompactUnpacker;
+
+/* Doubles the capacity of a table that starts in 'inlineData' */
+static MI_Boolean _GrowTable(
+    void** data,
+    MI_Uint32* capacity,
+    size_t elementSize,
+    void* inlineData)
+{
+    MI_Uint32 newCapacity = *capacity * 2;
+    void* p;
+
+    if (*data == inlineData)
+    {
+        p = PAL_Malloc(newCapacity * elementSize);
+
+        if (p)
+            memcpy(p, *data, *capacity * elementSize);
+    }
+    else
+    {
+        p = PAL_Realloc(*data, newCapacity * elementSize);
+    }
+
+    if (!p)
+        return MI_FALSE;
+
+    *data = p;
+    *capacity = newCapacity;
+    return MI_TRUE;
+}
+
+static MI_Result _PackVarint(Buf* buf, MI_Uint64 x)
+{
+    MI_Uint8 bytes[10];
+    MI_Uint32 n = 0;
+
+    while (x >= 0x80)
+    {
+        bytes[n++] = (MI_Uint8)(x | 0x80);
+        x >>= 7;
+    }
+
+    bytes[n++] = (MI_Uint8)x;
+    return Buf_App(buf, bytes, n);
+}
+
+static MI_Result _UnpackVarint(Buf* buf, MI_Uint64* x)
+{
+    const MI_Uint8* p = (const MI_Uint8*)buf->data + buf->offset;
+    const MI_Uint8* end = (const MI_Uint8*)buf->data + buf->size;
+    MI_Uint64 value = 0;
+    unsigned int shift = 0;
+
+    for (;;)
+    {
+        if (p == end || shift > 63)
+            return MI_RESULT_FAILED;
+
+        value |= (MI_Uint64)(*p & 0x7F) << shift;
+
+        if (!(*p++ & 0x80))
+            break;
+
+        shift += 7;
+    }
+
+    buf->offset = (MI_Uint32)(p - (const MI_Uint8*)buf->data);
+    *x = value;
+    return MI_RESULT_OK;
+}
+
+MI_INLINE MI_Uint64 _ZigZag(MI_Sint64 x)
+{
+    return ((MI_Uint64)x << 1) ^ (MI_Uint64)(x >> 63);
+}
+
+MI_INLINE MI_Sint64 _UnZigZag(MI_Uint64 x)
+{
+    return (MI_Sint64)(x >> 1) ^ -(MI_Sint64)(x & 1);
+}
+
+/* Characters of strings are aligned so that they can be borrowed */
+static MI_Result _PadChars(Buf* buf)
+{
+    if (sizeof(ZChar) == 2)
+        return Buf_Pad16(buf);
+    if (sizeof(ZChar) == 4)
+        return Buf_Pad32(buf);
+    return MI_RESULT_OK;
+}
+
+static MI_Result _AlignChars(Buf* buf)
+{
+    if (sizeof(ZChar) == 2)
+        return Buf_Align16(buf);
+    if (sizeof(ZChar) == 4)
+        return Buf_Align32(buf);
+    return MI_RESULT_OK;
+}
+
+/* Sizes the string lookup table for the capacity of the string table and
+   adds the strings written so far to it */
+static MI_Boolean _GrowStringLookup(
+    CompactPacker* self)
+{
+    MI_Uint32 capacity = 2 * self->stringsCapacity;
+    MI_Uint32* lookup = (MI_Uint32*)PAL_Calloc(capacity, sizeof(MI_Uint32));
+    MI_Uint32 i;
+
+    if (!lookup)
+        return MI_FALSE;
+
+    for (i = 0; i < self->stringsSize; i++)
+    {
+        MI_Uint32 slot = self->strings[i].hash & (capacity - 1);
+
+        while (lookup[slot])
+            slot = (slot + 1) & (capacity - 1);
+
+        lookup[slot] = i + 1;
+    }
+
+    if (self->lookup != self->inlineLookup)
+        PAL_Free(self->lookup);
+
+    self->lookup = lookup;
+    self->lookupCapacity = capacity;
+    return MI_TRUE;
+}
+
+static MI_Result _PackCompactStr(
+    CompactPacker* self,
+    const ZChar* str,
+    MI_Uint32 len)
+{
+    MI_Uint32 hash = 2166136261U;
+    MI_Uint32 slot;
+    MI_Uint32 i;
+    CompactString* entry;
+
+    if (!str)
+        return _PackVarint(self->buf, 0);
+
+    for (i = 0; i < len; i++)
+        hash = (hash ^ (MI_Uint32)str[i]) * 16777619U;
+
+    for (slot = hash & (self->lookupCapacity - 1); self->lookup[slot];
+        slot = (slot + 1) & (self->lookupCapacity - 1))
+    {
+        i = self->lookup[slot] - 1;
+        entry = &self->strings[i];
+
+        if (entry->hash == hash && entry->len == len &&
+            memcmp(entry->str, str, len * sizeof(ZChar)) == 0)
+        {
+            return _PackVarint(self->buf, 2 * (MI_Uint64)i + 1);
+        }
+    }
+
+    if (self->stringsSize == self->stringsCapacity)
+    {
+        if (!_GrowTable((void**)&self->strings, &self->stringsCapacity,
+                sizeof(CompactString), self->inlineStrings) ||
+            !_GrowStringLookup(self))
+        {
+            MI_RETURN(MI_RESULT_SERVER_LIMITS_EXCEEDED);
+        }
+
+        slot = hash & (self->lookupCapacity - 1);
+
+        while (self->lookup[slot])
+            slot = (slot + 1) & (self->lookupCapacity - 1);
+    }
+
+    self->lookup[slot] = self->stringsSize + 1;
+    entry = &self->strings[self->stringsSize++];
+    entry->str = str;
+    entry->len = len;
+    entry->hash = hash;
+
+    MI_RETURN_ERR(_PackVarint(self->buf, 2 * ((MI_Uint64)len + 1)));
+    MI_RETURN_ERR(_PadChars(self->buf));
+    MI_RETURN(Buf_App(self->buf, str, (len + 1) * sizeof(ZChar)));
+}
+
+static MI_Result _UnpackCompactStr(
+    CompactUnpacker* self,
+    const ZChar** str)
+{
+    Buf* buf = self->buf;
+    MI_Uint64 x;
+    MI_Uint64 len;
+    const ZChar* data;
+
+    MI_RETURN_ERR(_UnpackVarint(buf, &x));
+
+    if (x == 0)
+    {
+        *str = NULL;
+        MI_RETURN(MI_RESULT_OK);
+    }
+
+    if (x & 1)
+    {
+        if ((x >> 1) >= self->stringsSize)
+            MI_RETURN(MI_RESULT_FAILED);
+
+        *str = self->strings[x >> 1];
+        MI_RETURN(MI_RESULT_OK);
+    }
+
+    len = (x >> 1) - 1;
+    MI_RETURN_ERR(_AlignChars(buf));
+
+    if (len >= (buf->size - buf->offset) / sizeof(ZChar))
+        MI_RETURN(MI_RESULT_FAILED);
+
+    data = (const ZChar*)((char*)buf->data + buf->offset);
+
+    if (data[len] != 0)
+        MI_RETURN(MI_RESULT_FAILED);
+
+    buf->offset += (MI_Uint32)((len + 1) * sizeof(ZChar));
+
+    if (self->stringsSize == self->stringsCapacity &&
+        !_GrowTable((void**)&self->strings, &self->stringsCapacity,
+            sizeof(const ZChar*), (void*)self->inlineStrings))
+    {
+        MI_RETURN(MI_RESULT_SERVER_LIMITS_EXCEEDED);
+    }
+
+    self->strings[self->stringsSize++] = data;
+    *str = data;
+    MI_RETURN(MI_RESULT_OK);
+}
+
+static MI_Result _PackCompactBody(
+    CompactPacker* self,
+    const MI_Instance* instance,
+    MI_Boolean keysOnly,
+    MI_Boolean (*filterProperty)(const ZChar* name, void* data),
+    void* filterPropertyData);
+
+static MI_Result _PackCompactDatetime(
+    Buf* buf,
+    const MI_Datetime* x)
+{
+    MI_RETURN_ERR(Buf_PackU8(buf, x->isTimestamp ? 1 : 0));
+
+    if (x->isTimestamp)
+    {
+        MI_RETURN_ERR(_PackVarint(buf, x->u.timestamp.year));
+        MI_RETURN_ERR(_PackVarint(buf, x->u.timestamp.month));
+        MI_RETURN_ERR(_PackVarint(buf, x->u.timestamp.day));
+        MI_RETURN_ERR(_PackVarint(buf, x->u.timestamp.hour));
+        MI_RETURN_ERR(_PackVarint(buf, x->u.timestamp.minute));
+        MI_RETURN_ERR(_PackVarint(buf, x->u.timestamp.second));
+        MI_RETURN_ERR(_PackVarint(buf, x->u.timestamp.microseconds));
+        MI_RETURN(_PackVarint(buf, _ZigZag(x->u.timestamp.utc)));
+    }
+
+    MI_RETURN_ERR(_PackVarint(buf, x->u.interval.days));
+    MI_RETURN_ERR(_PackVarint(buf, x->u.interval.hours));
+    MI_RETURN_ERR(_PackVarint(buf, x->u.interval.minutes));
+    MI_RETURN_ERR(_PackVarint(buf, x->u.interval.seconds));
+    MI_RETURN(_PackVarint(buf, x->u.interval.microseconds));
+}
+
+static MI_Result _UnpackCompactDatetime(
+    Buf* buf,
+    MI_Datetime* x)
+{
+    MI_Uint8 isTimestamp;
+    MI_Uint64 v[8];
+    MI_Uint32 i;
+
+    MI_RETURN_ERR(Buf_UnpackU8(buf, &isTimestamp));
+
+    for (i = 0; i < (isTimestamp ? 8U : 5U); i++)
+        MI_RETURN_ERR(_UnpackVarint(buf, &v[i]));
+
+    memset(x, 0, sizeof(MI_Datetime));
+    x->isTimestamp = isTimestamp ? 1 : 0;
+
+    if (isTimestamp)
+    {
+        x->u.timestamp.year = (MI_Uint32)v[0];
+        x->u.timestamp.month = (MI_Uint32)v[1];
+        x->u.timestamp.day = (MI_Uint32)v[2];
+        x->u.timestamp.hour = (MI_Uint32)v[3];
+        x->u.timestamp.minute = (MI_Uint32)v[4];
+        x->u.timestamp.second = (MI_Uint32)v[5];
+        x->u.timestamp.microseconds = (MI_Uint32)v[6];
+        x->u.timestamp.utc = (MI_Sint32)_UnZigZag(v[7]);
+    }
+    else
+    {
+        x->u.interval.days = (MI_Uint32)v[0];
+        x->u.interval.hours = (MI_Uint32)v[1];
+        x->u.interval.minutes = (MI_Uint32)v[2];
+        x->u.interval.seconds = (MI_Uint32)v[3];
+        x->u.interval.microseconds = (MI_Uint32)v[4];
+    }
+
+    MI_RETURN(MI_RESULT_OK);
+}
+
+/* Packs a value of scalar 'type' stored at 'p' */
+static MI_Result _PackCompactScalar(
+    CompactPacker* self,
+    const void* p,
+    MI_Type type)
+{
+    Buf* buf = self->buf;
+
+    switch (type)
+    {
+        case MI_BOOLEAN:
+        case MI_UINT8:
+        case MI_SINT8:
+            MI_RETURN(Buf_App(buf, p, sizeof(MI_Uint8)));
+        case MI_UINT16:
+        case MI_CHAR16:
+            MI_RETURN(_PackVarint(buf, *(const MI_Uint16*)p));
+        case MI_SINT16:
+            MI_RETURN(_PackVarint(buf, _ZigZag(*(const MI_Sint16*)p)));
+        case MI_UINT32:
+            MI_RETURN(_PackVarint(buf, *(const MI_Uint32*)p));
+        case MI_SINT32:
+            MI_RETURN(_PackVarint(buf, _ZigZag(*(const MI_Sint32*)p)));
+        case MI_UINT64:
+            MI_RETURN(_PackVarint(buf, *(const MI_Uint64*)p));
+        case MI_SINT64:
+            MI_RETURN(_PackVarint(buf, _ZigZag(*(const MI_Sint64*)p)));
+        case MI_REAL32:
+            MI_RETURN(Buf_App(buf, p, sizeof(MI_Real32)));
+        case MI_REAL64:
+            MI_RETURN(Buf_App(buf, p, sizeof(MI_Real64)));
+        case MI_DATETIME:
+            MI_RETURN(_PackCompactDatetime(buf, (const MI_Datetime*)p));
+        case MI_STRING:
+        {
+            const ZChar* str = *(const ZChar* const*)p;
+            MI_RETURN(_PackCompactStr(
+                self, str, str ? (MI_Uint32)Tcslen(str) : 0));
+        }
+        case MI_INSTANCE:
+        case MI_REFERENCE:
+        {
+            const MI_Instance* instance = *(const MI_Instance* const*)p;
+
+            if (!instance)
+                MI_RETURN(MI_RESULT_FAILED);
+
+            MI_RETURN(_PackCompactBody(
+                self, instance, type == MI_REFERENCE, NULL, NULL));
+        }
+        default:
+            MI_RETURN(MI_RESULT_FAILED);
+    }
+}
+
+static MI_Result _UnpackCompactBody(
+    CompactUnpacker* self,
+    MI_Instance** instanceOut);
+
+/* Unpacks a value of scalar 'type' into 'p' */
+static MI_Result _UnpackCompactScalar(
+    CompactUnpacker* self,
+    void* p,
+    MI_Type type)
+{
+    Buf* buf = self->buf;
+    MI_Uint64 x;
+
+    switch (type)
+    {
+        case MI_BOOLEAN:
+        case MI_UINT8:
+        case MI_SINT8:
+            MI_RETURN(Buf_UnpackU8(buf, (MI_Uint8*)p));
+        case MI_UINT16:
+        case MI_CHAR16:
+            MI_RETURN_ERR(_UnpackVarint(buf, &x));
+            *(MI_Uint16*)p = (MI_Uint16)x;
+            break;
+        case MI_SINT16:
+            MI_RETURN_ERR(_UnpackVarint(buf, &x));
+            *(MI_Sint16*)p = (MI_Sint16)_UnZigZag(x);
+            break;
+        case MI_UINT32:
+            MI_RETURN_ERR(_UnpackVarint(buf, &x));
+            *(MI_Uint32*)p = (MI_Uint32)x;
+            break;
+        case MI_SINT32:
+            MI_RETURN_ERR(_UnpackVarint(buf, &x));
+            *(MI_Sint32*)p = (MI_Sint32)_UnZigZag(x);
+            break;
+        case MI_UINT64:
+            MI_RETURN(_UnpackVarint(buf, (MI_Uint64*)p));
+        case MI_SINT64:
+            MI_RETURN_ERR(_UnpackVarint(buf, &x));
+            *(MI_Sint64*)p = _UnZigZag(x);
+            break;
+        case MI_REAL32:
+        case MI_REAL64:
+        {
+            MI_Uint32 size = type == MI_REAL32 ?
+                sizeof(MI_Real32) : sizeof(MI_Real64);
+
+            if (buf->size - buf->offset < size)
+                MI_RETURN(MI_RESULT_FAILED);
+
+            memcpy(p, (char*)buf->data + buf->offset, size);
+            buf->offset += size;
+            break;
+        }
+        case MI_DATETIME:
+            MI_RETURN(_UnpackCompactDatetime(buf, (MI_Datetime*)p));
+        case MI_STRING:
+            MI_RETURN(_UnpackCompactStr(self, (const ZChar**)p));
+        case MI_INSTANCE:
+        case MI_REFERENCE:
+            MI_RETURN(_UnpackCompactBody(self, (MI_Instance**)p));
+        default:
+            MI_RETURN(MI_RESULT_FAILED);
+    }
+
+    MI_RETURN(MI_RESULT_OK);
+}
+
+/* Whether elements of 'type' are copied as they are */
+MI_INLINE MI_Boolean _IsCompactRaw(MI_Type type)
+{
+    return type == MI_BOOLEAN || type == MI_UINT8 || type == MI_SINT8 ||
+        type == MI_REAL32 || type == MI_REAL64;
+}
+
+static MI_Result _PackCompactValue(
+    CompactPacker* self,
+    const MI_Value* value,
+    MI_Type type)
+{
+    /* all array types share the layout of MI_Uint8A */
+    const MI_Uint8A* array = &value->uint8a;
+    MI_Type scalar = Type_ScalarOf(type);
+    size_t size = Type_SizeOf(scalar);
+    MI_Uint32 i;
+
+    if (!(type & MI_ARRAY_BIT))
+        MI_RETURN(_PackCompactScalar(self, value, type));
+
+    if (!array->data && array->size)
+        MI_RETURN(MI_RESULT_FAILED);
+
+    MI_RETURN_ERR(_PackVarint(self->buf, array->size));
+
+    if (_IsCompactRaw(scalar))
+    {
+        MI_RETURN(Buf_App(self->buf, array->data,
+            (MI_Uint32)(array->size * size)));
+    }
+
+    for (i = 0; i < array->size; i++)
+    {
+        MI_RETURN_ERR(_PackCompactScalar(
+            self, (const char*)array->data + i * size, scalar));
+    }
+
+    MI_RETURN(MI_RESULT_OK);
+}
+
+/* Unpacks a value; arrays that have to be freed once the value is added
+   to the instance are returned in '*temp' */
+static MI_Result _UnpackCompactValue(
+    CompactUnpacker* self,
+    MI_Value* value,
+    MI_Type type,
+    void** temp)
+{
+    Buf* buf = self->buf;
+    MI_Uint8A* array = &value->uint8a;
+    MI_Type scalar = Type_ScalarOf(type);
+    size_t size = Type_SizeOf(scalar);
+    MI_Uint64 count;
+    MI_Uint32 i;
+
+    memset(value, 0, sizeof(MI_Value));
+
+    if (!(type & MI_ARRAY_BIT))
+        MI_RETURN(_UnpackCompactScalar(self, value, type));
+
+    MI_RETURN_ERR(_UnpackVarint(buf, &count));
+
+    /* every element takes at least one byte */
+    if (count > buf->size - buf->offset)
+        MI_RETURN(MI_RESULT_FAILED);
+
+    if (!count)
+        MI_RETURN(MI_RESULT_OK);
+
+    if (self->batch)
+    {
+        array->data = (MI_Uint8*)Batch_Get(self->batch, (size_t)count * size);
+    }
+    else
+    {
+        array->data = (MI_Uint8*)PAL_Malloc((size_t)count * size);
+        *temp = array->data;
+    }
+
+    if (!array->data)
+        MI_RETURN(MI_RESULT_SERVER_LIMITS_EXCEEDED);
+
+    array->size = (MI_Uint32)count;
+
+    if (_IsCompactRaw(scalar))
+    {
+        if ((size_t)count * size > buf->size - buf->offset)
+            MI_RETURN(MI_RESULT_FAILED);
+
+        memcpy(array->data, (char*)buf->data + buf->offset,
+            (size_t)count * size);
+        buf->offset += (MI_Uint32)(count * size);
+        MI_RETURN(MI_RESULT_OK);
+    }
+
+    for (i = 0; i < array->size; i++)
+    {
+        MI_RETURN_ERR(_UnpackCompactScalar(
+            self, (char*)array->data + i * size, scalar));
+    }
+
+    MI_RETURN(MI_RESULT_OK);
+}
+
+MI_INLINE MI_Boolean _PacksProperty(
+    const MI_PropertyDecl* pd,
+    MI_Boolean keysOnly,
+    MI_Boolean (*filterProperty)(const ZChar* name, void* data),
+    void* filterPropertyData)
+{
+    /* Skip non-key properties (for references) */
+    if (keysOnly && (pd->flags & MI_FLAG_KEY) == 0)
+        return MI_FALSE;
+
+    /* Skip filtered properties */
+    if (filterProperty && (*filterProperty)(pd->name, filterPropertyData))
+        return MI_FALSE;
+
+    return MI_TRUE;
+}
+
+static MI_Result _PackCompactSchema(
+    CompactPacker* self,
+    const MI_ClassDecl* cd,
+    MI_Boolean keysOnly,
+    MI_Boolean (*filterProperty)(const ZChar* name, void* data),
+    void* filterPropertyData,
+    MI_Uint32* countOut)
+{
+    Buf* buf = self->buf;
+    MI_Uint32 count = 0;
+    MI_Uint32 i;
+
+    if (!filterProperty)
+    {
+        for (i = 0; i < self->schemasSize; i++)
+        {
+            CompactSchema* schema = &self->schemas[i];
+
+            if (schema->cd == cd && schema->keysOnly == keysOnly)
+            {
+                *countOut = schema->count;
+                MI_RETURN(_PackVarint(buf, (MI_Uint64)i + 1));
+            }
+        }
+    }
+
+    for (i = 0; i < cd->numProperties; i++)
+    {
+        if (_PacksProperty(cd->properties[i], keysOnly,
+            filterProperty, filterPropertyData))
+        {
+            count++;
+        }
+    }
+
+    MI_RETURN_ERR(_PackVarint(buf, 0));
+    MI_RETURN_ERR(_PackVarint(buf, cd->flags));
+    MI_RETURN_ERR(_PackCompactStr(self, cd->name, NameLen(cd->name, cd->code)));
+    MI_RETURN_ERR(_PackVarint(buf, count));
+
+    for (i = 0; i < cd->numProperties; i++)
+    {
+        const MI_PropertyDecl* pd = cd->properties[i];
+        const ZChar* pName = pd->name;
+        MI_Uint8 type = (MI_Uint8)pd->type;
+
+        if (!_PacksProperty(pd, keysOnly, filterProperty, filterPropertyData))
+            continue;
+
+        MI_RETURN_ERR(_PackVarint(buf, pd->flags));
+
+        if ((pd->flags & MI_FLAG_PARAMETER) && (pd->flags & MI_FLAG_OUT))
+        {
+            if (pName && pName[0] == ZT('M') && Tcscmp(pName, ZT("MIReturn"))== 0)
+                pName = ZT("ReturnValue");
+        }
+
+        MI_RETURN_ERR(_PackCompactStr(self, pName,
+            pName == pd->name ? NameLen(pName, pd->code) :
+                (MI_Uint32)Tcslen(pName)));
+        MI_RETURN_ERR(Buf_App(buf, &type, sizeof(type)));
+    }
+
+    /* the filtered schema of the top-level instance is never reused, yet
+       it takes an index as the reader cannot tell it apart */
+    if (self->schemasSize == self->schemasCapacity &&
+        !_GrowTable((void**)&self->schemas, &self->schemasCapacity,
+            sizeof(CompactSchema), self->inlineSchemas))
+    {
+        MI_RETURN(MI_RESULT_SERVER_LIMITS_EXCEEDED);
+    }
+
+    self->schemas[self->schemasSize].cd = filterProperty ? NULL : cd;
+    self->schemas[self->schemasSize].keysOnly = keysOnly;
+    self->schemas[self->schemasSize].count = count;
+    self->schemasSize++;
+
+    *countOut = count;
+    MI_RETURN(MI_RESULT_OK);
+}
+
+static MI_Result _UnpackCompactSchema(
+    CompactUnpacker* self,
+    CompactClass* classOut)
+{
+    Buf* buf = self->buf;
+    CompactClass cls;
+    MI_Uint64 x;
+    MI_Uint32 i;
+
+    MI_RETURN_ERR(_UnpackVarint(buf, &x));
+    cls.flags = (MI_Uint32)x;
+    MI_RETURN_ERR(_UnpackCompactStr(self, &cls.name));
+    MI_RETURN_ERR(_UnpackVarint(buf, &x));
+
+    /* every property takes at least three bytes */
+    if (!cls.name || x > (buf->size - buf->offset) / 3)
+        MI_RETURN(MI_RESULT_FAILED);
+
+    cls.first = self->propertiesSize;
+    cls.count = (MI_Uint32)x;
+
+    for (i = 0; i < cls.count; i++)
+    {
+        CompactProperty* property;
+        MI_Uint8 type;
+
+        while (self->propertiesSize == self->propertiesCapacity)
+        {
+            if (!_GrowTable((void**)&self->properties,
+                &self->propertiesCapacity, sizeof(CompactProperty),
+                self->inlineProperties))
+            {
+                MI_RETURN(MI_RESULT_SERVER_LIMITS_EXCEEDED);
+            }
+        }
+
+        property = &self->properties[self->propertiesSize++];
+
+        MI_RETURN_ERR(_UnpackVarint(buf, &x));
+        property->flags = (MI_Uint32)x;
+        MI_RETURN_ERR(_UnpackCompactStr(self, &property->name));
+        MI_RETURN_ERR(Buf_UnpackU8(buf, &type));
+
+        if (!property->name || type > MI_INSTANCEA)
+            MI_RETURN(MI_RESULT_FAILED);
+
+        property->type = (MI_Type)type;
+    }
+
+    if (self->classesSize == self->classesCapacity &&
+        !_GrowTable((void**)&self->classes, &self->classesCapacity,
+            sizeof(CompactClass), self->inlineClasses))
+    {
+        MI_RETURN(MI_RESULT_SERVER_LIMITS_EXCEEDED);
+    }
+
+    self->classes[self->classesSize++] = cls;
+    *classOut = cls;
+    MI_RETURN(MI_RESULT_OK);
+}
+
+static MI_Result _PackCompactBody(
+    CompactPacker* self,
+    const MI_Instance* instance,
+    MI_Boolean keysOnly,
+    MI_Boolean (*filterProperty)(const ZChar* name, void* data),
+    void* filterPropertyData)
+{
+    Instance* inst = Instance_GetSelf(instance);
+    const MI_ClassDecl* cd = inst->classDecl;
+    Buf* buf = self->buf;
+    MI_Uint32 count;
+    MI_Uint32 offset;
+    MI_Uint32 bytes;
+    MI_Uint32 i;
+    MI_Uint32 n;
+
+    MI_RETURN_ERR(_PackCompactSchema(self, cd, keysOnly,
+        filterProperty, filterPropertyData, &count));
+
+    MI_RETURN_ERR(_PackCompactStr(self, inst->nameSpace,
+        inst->nameSpace ? (MI_Uint32)Tcslen(inst->nameSpace) : 0));
+
+    /* exists bitmap */
+    offset = buf->size;
+    bytes = (count + 7) / 8;
+    MI_RETURN_ERR(Buf_Reserve(buf, offset + bytes));
+    memset((char*)buf->data + offset, 0, bytes);
+    buf->size += bytes;
+
+    for (i = 0, n = 0; i < cd->numProperties; i++)
+    {
+        const MI_PropertyDecl* pd = cd->properties[i];
+
+        if (!_PacksProperty(pd, keysOnly, filterProperty, filterPropertyData))
+            continue;
+
+        if (Field_GetExists(
+            (const Field*)((char*)inst + pd->offset), (MI_Type)pd->type))
+        {
+            ((MI_Uint8*)buf->data)[offset + n / 8] |= (MI_Uint8)(1 << (n % 8));
+        }
+
+        n++;
+    }
+
+    for (i = 0; i < cd->numProperties; i++)
+    {
+        const MI_PropertyDecl* pd = cd->properties[i];
+        const Field* field = (const Field*)((char*)inst + pd->offset);
+
+        if (!_PacksProperty(pd, keysOnly, filterProperty, filterPropertyData))
+            continue;
+
+        if (Field_GetExists(field, (MI_Type)pd->type))
+        {
+            MI_RETURN_ERR(_PackCompactValue(
+                self, (const MI_Value*)field, (MI_Type)pd->type));
+        }
+    }
+
+    MI_RETURN(MI_RESULT_OK);
+}
+
+static MI_Result _UnpackCompactBody(
+    CompactUnpacker* self,
+    MI_Instance** instanceOut)
+{
+    Buf* buf = self->buf;
+    CompactClass cls;
+    const ZChar* nameSpace;
+    const MI_Uint8* exists;
+    MI_Instance* instance;
+    MI_Uint64 x;
+    MI_Uint32 i;
+
+    *instanceOut = NULL;
+
+    MI_RETURN_ERR(_UnpackVarint(buf, &x));
+
+    if (x == 0)
+    {
+        MI_RETURN_ERR(_UnpackCompactSchema(self, &cls));
+    }
+    else
+    {
+        if (x > self->classesSize)
+            MI_RETURN(MI_RESULT_FAILED);
+
+        cls = self->classes[x - 1];
+    }
+
+    MI_RETURN_ERR(_UnpackCompactStr(self, &nameSpace));
+
+    if ((cls.count + 7) / 8 > buf->size - buf->offset)
+        MI_RETURN(MI_RESULT_FAILED);
+
+    exists = (const MI_Uint8*)buf->data + buf->offset;
+    buf->offset += (cls.count + 7) / 8;
+
+    MI_RETURN_ERR(Instance_NewDynamic(&instance, cls.name, cls.flags,
+        self->batch));
+
+    MI_RETURN_ERR(MI_Instance_SetNameSpace(instance, nameSpace));
+
+    for (i = 0; i < cls.count; i++)
+    {
+        /* properties may move while embedded instances are unpacked */
+        CompactProperty property = self->properties[cls.first + i];
+        MI_Uint32 flags = property.flags;
+        MI_Value value;
+        void* temp = NULL;
+        MI_Result r;
+
+        if (exists[i / 8] & (1 << (i % 8)))
+        {
+            r = _UnpackCompactValue(self, &value, property.type, &temp);
+
+            if (r == MI_RESULT_OK)
+            {
+                if (!self->copy && !temp)
+                    flags |= MI_FLAG_BORROW;
+
+                r = MI_Instance_AddElement(instance, property.name, &value,
+                    property.type, flags);
+            }
+        }
+        else
+        {
+            if (!self->copy)
+                flags |= MI_FLAG_BORROW;
+
+            r = MI_Instance_AddElement(instance, property.name, NULL,
+                property.type, flags);
+        }
+
+        if (temp)
+            PAL_Free(temp);
+
+        if (r != MI_RESULT_OK)
+            MI_RETURN(r);
+    }
+
+    *instanceOut = instance;
+    MI_RETURN(MI_RESULT_OK);
+}
+
+MI_Result Instance_PackCompact(
+    const MI_Instance* self,
+    MI_Boolean (*filterProperty)(const ZChar* name, void* data),
+    void* filterPropertyData,
+    Buf* buf)
+{
+    CompactPacker packer;
+    MI_Result r;
+
+    /* Check for null arguments */
+    if (!self || !buf)
+        MI_RETURN(MI_RESULT_INVALID_PARAMETER);
+
+    packer.buf = buf;
+    packer.strings = packer.inlineStrings;
+    packer.stringsSize = 0;
+    packer.stringsCapacity = COMPACT_INLINE_STRINGS;
+    packer.lookup = packer.inlineLookup;
+    packer.lookupCapacity = MI_COUNT(packer.inlineLookup);
+    memset(packer.inlineLookup, 0, sizeof(packer.inlineLookup));
+    packer.schemas = packer.inlineSchemas;
+    packer.schemasSize = 0;
+    packer.schemasCapacity = COMPACT_INLINE_SCHEMAS;
+
+    r = Buf_PackU32(buf, INSTANCE_COMPACT_MAGIC);
+
+    if (r == MI_RESULT_OK)
+    {
+        r = _PackCompactBody(&packer, self, MI_FALSE,
+            filterProperty, filterPropertyData);
+    }
+
+    if (packer.strings != packer.inlineStrings)
+        PAL_Free(packer.strings);
+
+    if (packer.lookup != packer.inlineLookup)
+        PAL_Free(packer.lookup);
+
+    if (packer.schemas != packer.inlineSchemas)
+        PAL_Free(packer.schemas);
+
+    MI_RETURN(r);
+}
+
+/* Unpacks the body that follows INSTANCE_COMPACT_MAGIC */
+static MI_Result _UnpackCompact(
+    MI_Instance** selfOut,
+    Buf* buf,
+    Batch* batch,
+    MI_Boolean copy)
+{
+    CompactUnpacker unpacker;
+    MI_Result r;
+
+    unpacker.buf = buf;
+    unpacker.batch = batch;
+    unpacker.copy = copy;
+    unpacker.strings = unpacker.inlineStrings;
+    unpacker.stringsSize = 0;
+    unpacker.stringsCapacity = COMPACT_INLINE_STRINGS;
+    unpacker.classes = unpacker.inlineClasses;
+    unpacker.classesSize = 0;
+    unpacker.classesCapacity = COMPACT_INLINE_SCHEMAS;
+    unpacker.properties = unpacker.inlineProperties;
+    unpacker.propertiesSize = 0;
+    unpacker.propertiesCapacity = COMPACT_INLINE_PROPERTIES;
+
+    r = _UnpackCompactBody(&unpacker, selfOut);
+
+    if (unpacker.strings != unpacker.inlineStrings)
+        PAL_Free((void*)unpacker.strings);
+
+    if (unpacker.classes != unpacker.inlineClasses)
+        PAL_Free(unpacker.classes);
+
+    if (unpacker.properties != unpacker.inlineProperties)
+        PAL_Free(unpacker.properties);
+
+    MI_RETURN(r);
+}
+
 MI_Result Instance_Pack(
     const MI_Instance* self_,
     MI_Boolean keysOnly,
@@ -507,6 +1549,9 @@ MI_Result Instance_Unpack(
     /* Unpack magic number */
     MI_RETURN_ERR(Buf_UnpackU32(buf, &magic));
 
+    if (INSTANCE_COMPACT_MAGIC == magic)
+        MI_RETURN(_UnpackCompact(selfOut, buf, batch, copy));
+
     if (INSTANCE_MAGIC != magic)
         MI_RETURN(MI_RESULT_FAILED);
 
@@ -587,8 +1632,9 @@ MI_Result Instance_Unpack(
     MI_RETURN(MI_RESULT_OK);
 }
 
-MI_Result InstanceToBatch(
+static MI_Result _InstanceToBatch(
     const MI_Instance* instance,
+    MI_Boolean compact,
     MI_Boolean (*filterProperty)(const ZChar* name, void* data),
     void* filterPropertyData,
     Batch* batch,
@@ -599,13 +1645,21 @@ MI_Result InstanceToBatch(
     MI_Result r;
     Page* page;
 
-    r = Buf_Init(&buf, 16*1024);
+    r = Buf_Init(&buf, compact ? 1024 : 16*1024);
 
     if (MI_RESULT_OK != r)
         return r;
 
-    r = Instance_Pack(
-        instance, MI_FALSE, filterProperty, filterPropertyData, &buf);
+    if (compact)
+    {
+        r = Instance_PackCompact(
+            instance, filterProperty, filterPropertyData, &buf);
+    }
+    else
+    {
+        r = Instance_Pack(
+            instance, MI_FALSE, filterProperty, filterPropertyData, &buf);
+    }
 
     if (MI_RESULT_OK != r)
     {
@@ -622,3 +1676,27 @@ MI_Result InstanceToBatch(
     *sizeOut = (MI_Uint32)page->u.s.size;
     return MI_RESULT_OK;
 }
+
+MI_Result InstanceToBatch(
+    const MI_Instance* instance,
+    MI_Boolean (*filterProperty)(const ZChar* name, void* data),
+    void* filterPropertyData,
+    Batch* batch,
+    void** ptrOut,
+    MI_Uint32* sizeOut)
+{
+    return _InstanceToBatch(instance, MI_FALSE, filterProperty,
+        filterPropertyData, batch, ptrOut, sizeOut);
+}
+
+MI_Result InstanceToBatchCompact(
+    const MI_Instance* instance,
+    MI_Boolean (*filterProperty)(const ZChar* name, void* data),
+    void* filterPropertyData,
+    Batch* batch,
+    void** ptrOut,
+    MI_Uint32* sizeOut)
+{
+    return _InstanceToBatch(instance, MI_TRUE, filterProperty,
+        filterPropertyData, batch, ptrOut, sizeOut);
+}
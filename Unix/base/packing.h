@@ -38,12 +38,39 @@ MI_Result Instance_Pack(
     void* filterPropertyData,
     Buf* buf);
 
+/*
+**==============================================================================
+**
+** Instance_PackCompact()
+**
+**     Serializes an instance into a buffer like Instance_Pack() but in the
+**     compact encoding: integers are varints, class and property names are
+**     sent once per packed instance (not once per embedded instance) and
+**     repeated strings refer to their first occurrence. Only peers with
+**     PROTOCOL_REVISION_COMPACT_INSTANCES or later can unpack it.
+**
+** Parameters:
+**     self - the instance to be serialized.
+**     buf - the buffer to put instance into.
+**
+** Returns:
+**     MI_RESULT_OK on success.
+**
+**==============================================================================
+*/
+MI_Result Instance_PackCompact(
+    const MI_Instance* self,
+    MI_Boolean (*filterProperty)(const ZChar* name, void* data),
+    void* filterPropertyData,
+    Buf* buf);
+
 /*
 **==============================================================================
 **
 ** Instance_Unpack()
 **
-**     Unpacks an instance from a buffer.
+**     Unpacks an instance from a buffer (packed by Instance_Pack() or
+**     Instance_PackCompact()).
 **
 ** Parameters:
 **     self - shall point to a newly allocated instance.
@@ -88,6 +115,15 @@ MI_Result InstanceToBatch(
     void** ptrOut,
     MI_Uint32* sizeOut);
 
+/* Same as InstanceToBatch() but uses Instance_PackCompact() */
+MI_Result InstanceToBatchCompact(
+    const MI_Instance* instance,
+    MI_Boolean (*filterProperty)(const ZChar* name, void* data),
+    void* filterPropertyData,
+    Batch* batch,
+    void** ptrOut,
+    MI_Uint32* sizeOut);
+
 END_EXTERNC
 
 #endif /* _base_packing_h */
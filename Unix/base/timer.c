@@ -185,27 +185,16 @@ void Timer_SetSelector(
     timerSelector = selector;
 }
 
-MI_Boolean _HandlerTimerCallback(
+void _SelectorTimerCallback(
     Selector* sel,
-    Handler* handler,
+    SelectorTimer* selectorTimer,
     MI_Uint32 mask, 
     MI_Uint64 currentTimeUsec)
 {
-    if (mask & SELECTOR_TIMEOUT)
+    if (mask & SELECTOR_TIMEOUT || mask & SELECTOR_REMOVE || mask & SELECTOR_DESTROY)
     {
-        /* Returns MI_FALSE to signal it is OK to remove the Handler.
-         * actual handling will occur once the Selector calls this func
-         * again with SELECTOR_REMOVE.  This is expected to happen 
-         * immediately. */
-        return MI_FALSE;
-    }
-    else if (mask & SELECTOR_REMOVE || mask & SELECTOR_DESTROY)
-    {
-        _Strand_ScheduleTimer( (Strand*)handler->data );
-    }
-    else if (mask & SELECTOR_ADD)
-    {
-        trace_Timer_Selector_Added();
+        /* Timer has already been taken off the Selector's timer heap */
+        _Strand_ScheduleTimer( (Strand*)selectorTimer->data );
     }
     else
     {
@@ -213,8 +202,6 @@ MI_Boolean _HandlerTimerCallback(
         trace_Timer_Unexpected_Selector_Mask( mask );
         DEBUG_ASSERT(MI_FALSE);
     }
-
-    return MI_TRUE;
 }
 
 /* State checks have already been performed.  This function just needs to
@@ -238,7 +225,7 @@ TimerResult Timer_Start(
         return TimerResult_InvalidArgument;
     }
 
-    if (MI_RESULT_OK == Selector_ContainsHandler(timer->selector, &timer->handler))
+    if (timer->selectorTimer.scheduled)
     {
         trace_Timer_CannotStartTimer_AlreadyRunning( timer );
         return TimerResult_InvalidArgument;
@@ -252,17 +239,19 @@ TimerResult Timer_Start(
 
     timer->reason = TimerReason_Expired;
 
-    timer->handler.fireTimeoutAt = currentTimeUsec + timer->timeoutInUsec;
-    timer->handler.sock = INVALID_SOCK;
-    timer->handler.data = strand;
-    timer->handler.callback = _HandlerTimerCallback;
+    timer->selectorTimer.data = strand;
+    timer->selectorTimer.callback = _SelectorTimerCallback;
 
-    if (MI_RESULT_OK != Selector_AddHandler( timer->selector, &timer->handler ))
+    if (MI_RESULT_OK != Selector_StartTimer( 
+        timer->selector, 
+        &timer->selectorTimer, 
+        currentTimeUsec + timer->timeoutInUsec ))
     {
         trace_Timer_Cannot_AddHandlerToSelector( timer->selector );
         return TimerResult_Failed;
     }
 
+    trace_Timer_Selector_Added();
     trace_Timer_Started_POSIX( timer->timeoutInUsec );
     return TimerResult_Success;
 }
@@ -276,9 +265,9 @@ void Timer_Fire(
     DEBUG_ASSERT( timer );
     DEBUG_ASSERT( strand );
 
-    /* Handler is zero'd during Timer_Start and Timer_Close.  A NULL callback
+    /* SelectorTimer is zero'd during Timer_Close.  A NULL callback
      * means that this timer is not active. */
-    if (NULL != timer->handler.callback) // TODO: Selector_ContainsHandler is a more thorough check, but less efficient
+    if (NULL != timer->selectorTimer.callback)
     {
         PAL_Uint64 currentTimeUsec = 0;
 
@@ -289,7 +278,7 @@ void Timer_Fire(
             trace_Timer_Cannot_AccessCurrentTime();
         }
 
-        if ( TimerReason_Canceled == reason || timer->handler.fireTimeoutAt > currentTimeUsec )
+        if ( TimerReason_Canceled == reason || timer->selectorTimer.fireTimeoutAt > currentTimeUsec )
         {
             /* Due to how Selector works, Selector will not check for timeouts 
              * during long running operations.  In those instances, the time
@@ -299,11 +288,12 @@ void Timer_Fire(
              * as a manuallly triggered timeout. */
             timer->reason = reason;
         }
-        timer->handler.fireTimeoutAt = currentTimeUsec;
 
         trace_Timer_ManualTrigger( timer, strand );
-        
-        Selector_Wakeup( timer->selector, MI_TRUE );
+
+        /* NOT_FOUND means the timer already expired and its callback is
+         * on its way; nothing else to do then. */
+        Selector_UpdateTimer( timer->selector, &timer->selectorTimer, currentTimeUsec );
     }
  }
 
@@ -313,17 +303,17 @@ void Timer_Close(
 {
     DEBUG_ASSERT( timer );
 
-    if (NULL == timer->handler.callback)
+    if (NULL == timer->selectorTimer.callback)
     {
         trace_Timer_Double_Close( timer );
     }
     else
     {
-        /* Handler is not present in the Selector's list since this will only 
-         * trigger, if SELECTOR_REMOVE has gone through _HandlerTimerCallback,
+        /* SelectorTimer is not present in the Selector's heap since this will
+         * only trigger after the Selector has called _SelectorTimerCallback,
          * so it is OK to zero out.
          */
-        memset( &timer->handler, 0, sizeof(Handler) );
+        memset( &timer->selectorTimer, 0, sizeof(SelectorTimer) );
         timer->reason = TimerReason_Expired;
 
         trace_Timer_Close( timer );
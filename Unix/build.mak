@@ -125,6 +125,7 @@ TESTDIRS += tests/wql
 TESTDIRS += tests/strhash
 TESTDIRS += tests/xml
 TESTDIRS += tests/xmlserializer
+TESTDIRS += tests/bench
 TESTDIRS += samples/Providers/tests/PersonProvider
 TESTDIRS += tests/miapi
 TESTDIRS += tests/oi
@@ -166,6 +167,9 @@ tests:
 
 dsctests:
 	( LD_LIBRARY_PATH=$(LIBDIR); export LD_LIBRARY_PATH; DYLD_LIBRARY_PATH=$(LIBDIR); export DYLD_LIBRARY_PATH; $(BINDIR)/nits -file:$(TMPDIR)/nitsdscargs.txt )
+
+bench:
+	$(MAKE) -s -C tests/bench bench
 endif
 
 ##==============================================================================
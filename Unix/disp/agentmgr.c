@@ -76,6 +76,9 @@ typedef struct _RequestItem
     Message* request;           // Request received from the left
     MI_Uint64 originalOperationId;
     MI_Uint64 key;  // OperationId of the outogoing request; for now RequestItem address (as it was before)
+
+    PostInstanceBatchMsg* instanceBatch;    // Batch from the agent being posted instance by instance
+    MI_Uint32 instanceBatchNext;            // Index of the next instance to post from instanceBatch
 }
 RequestItem;
 
@@ -122,8 +125,9 @@ STRAND_DEBUGNAME2( AgentElem, CloseAgentItem, EntryAck )
 STRAND_DEBUGNAME1( IdleRequestItem, ReadyToFinish )
 
 #define REQUESTITEM_STRANDAUX_PREPARETOFINISHONERROR 0
+#define REQUESTITEM_STRANDAUX_POSTNEXTINSTANCE       1
 
-STRAND_DEBUGNAME1( RequestItem, PrepareToFinishOnError )
+STRAND_DEBUGNAME2( RequestItem, PrepareToFinishOnError, PostNextInstance )
 
 
 /*
@@ -357,6 +361,39 @@ static void _SendErrorResponseAndClose(
     Strand_Close(&requestItem->strand.strand);
 }
 
+/*
+    Posts the next instance of instanceBatch to the left; once all of them
+    have been posted releases the batch and returns MI_FALSE
+*/
+static MI_Boolean _RequestItem_PostNextInstance(
+    _In_ RequestItem* self)
+{
+    PostInstanceBatchMsg* batchMsg = self->instanceBatch;
+
+    if (!batchMsg)
+        return MI_FALSE;
+
+    while (self->instanceBatchNext < batchMsg->count)
+    {
+        PostInstanceMsg* msg = PostInstanceBatchMsg_NewItemMsg(batchMsg, self->instanceBatchNext);
+
+        if (msg)
+        {
+            self->instanceBatchNext++;
+            Strand_Post(&self->strand.strand, &msg->base);
+            PostInstanceMsg_Release(msg);
+            return MI_TRUE;
+        }
+
+        trace_RequestItem_InstanceBatchSplitFailed(self, self->instanceBatchNext);
+        self->instanceBatchNext++;
+    }
+
+    self->instanceBatch = NULL;
+    PostInstanceBatchMsg_Release(batchMsg);
+    return MI_FALSE;
+}
+
 // not used much yet (no secondary "semantic" messages at the time)
 // currently used for unsubscribe message
 void _RequestItem_Post( _In_ Strand* self_, _In_ Message* msg)
@@ -391,6 +428,15 @@ void _RequestItem_Ack( _In_ Strand* self_)
     DEBUG_ASSERT( NULL != self_ );
     trace_RequestItemAck( &self_->info.interaction, self_->info.interaction.other );
 
+    // the agent gets the Ack once all instances of a batch are acked;
+    // the next one cannot be posted while still inside Ack
+    if (self->finishOnErrorState == RequestItemFinishState_None &&
+        NULL != self->instanceBatch)
+    {
+        StrandEntry_ScheduleAux( &self->strand, REQUESTITEM_STRANDAUX_POSTNEXTINSTANCE );
+        return;
+    }
+
     if (self->finishOnErrorState != RequestItemFinishState_ProcessedFinishOnError)
     {
         StrandEntry_ScheduleAuxParent( &self->strand, AGENTELEM_STRANDAUX_ENTRYACK );
@@ -464,6 +510,12 @@ void _RequestItem_Finish( _In_ Strand* self_)
         self->request = NULL;
     }
 
+    if( NULL != self->instanceBatch )
+    {
+        PostInstanceBatchMsg_Release(self->instanceBatch);
+        self->instanceBatch = NULL;
+    }
+
     StrandEntry_Delete( &self->strand );
 }
 
@@ -487,6 +539,28 @@ void _RequestItem_PrepareToFinishOnError( _In_ Strand* self_)
     self->finishOnErrorState = RequestItemFinishState_PendingFinishOnError;
 }
 
+// REQUESTITEM_STRANDAUX_POSTNEXTINSTANCE
+void _RequestItem_PostNextInstanceAux( _In_ Strand* self_)
+{
+    RequestItem* self = (RequestItem*)StrandEntry_FromStrand(self_);
+
+    // the connection is being closed (PrepareToFinishOnError run in between)
+    if (self->finishOnErrorState != RequestItemFinishState_None)
+    {
+        if (NULL != self->instanceBatch)
+        {
+            PostInstanceBatchMsg_Release(self->instanceBatch);
+            self->instanceBatch = NULL;
+        }
+        return;
+    }
+
+    if (!_RequestItem_PostNextInstance(self))
+    {
+        StrandEntry_ScheduleAuxParent( &self->strand, AGENTELEM_STRANDAUX_ENTRYACK );
+    }
+}
+
 /*
     Object that implements a single operation/request going to an agent thru
     a binary protocol connection. Uses that one-to-many interface to multiplex multiple
@@ -531,7 +605,10 @@ void _RequestItem_PrepareToFinishOnError( _In_ Strand* self_)
        the left interaction (typically dispatcher) unless the connection has already being
        closed for some reason. It restores the original operationId that is replaced in
        the connection to the agent and it also checks if the message is a final message,
-       in which case closes the interaction.
+       in which case closes the interaction. A PostInstanceBatchMsg is posted as
+       one PostInstanceMsg per instance instead, the next one from
+       _RequestItem_PostNextInstanceAux scheduled on each Ack, and the Ack is
+       passed to the parent only after the last one.
     - _RequestItem_ParentAck checks if the corresponding Post was PassThru
        and in that case sends the Ack passThru. It also checks if there was a pending
        cancel to be send (see Cancel above) and send its now that is possible.
@@ -545,7 +622,7 @@ static StrandFT _RequestItem_FT = {
     _RequestItem_Finish,
     NULL,
     _RequestItem_PrepareToFinishOnError,
-    NULL,
+    _RequestItem_PostNextInstanceAux,
     NULL,
     NULL,
     NULL };
@@ -662,6 +739,21 @@ void _RequestItem_ParentPost( _In_ StrandEntry* self, _In_ Message* msg)
         requestItem->request->operationId = requestItem->originalOperationId;
         msg->operationId = requestItem->originalOperationId;
 
+        if( PostInstanceBatchMsgTag == msg->tag )
+        {
+            // split into PostInstanceMsg; the next one is posted on each Ack
+            DEBUG_ASSERT( NULL == requestItem->instanceBatch );
+            Message_AddRef( msg );
+            requestItem->instanceBatch = (PostInstanceBatchMsg*)msg;
+            requestItem->instanceBatchNext = 0;
+
+            if( !_RequestItem_PostNextInstance( requestItem ) )
+            {
+                StrandEntry_ScheduleAuxParent( &requestItem->strand, AGENTELEM_STRANDAUX_ENTRYACK );
+            }
+            return;
+        }
+
         Strand_Post( &requestItem->strand.strand, msg );
 
         /* remove item if result received */
@@ -786,6 +878,7 @@ static AgentElem* _FindShellAgent(
 static pid_t _SpawnAgentProcess(
     Sock s,
     int logfd,
+    int ringfd,
     uid_t uid,
     gid_t gid,
     const char* provDir,
@@ -797,6 +890,9 @@ static pid_t _SpawnAgentProcess(
     char param_sock[32];
     char param_logfd[32];
     char param_idletimeout[32];
+    char param_ringfd[32];
+    const char* argv[16];
+    int argc = 0;
     const char* agentProgram = OMI_GetPath(ID_AGENTPROGRAM);
     char realAgentProgram[PATH_MAX];
     const char* destDir = OMI_GetPath(ID_DESTDIR);
@@ -842,29 +938,42 @@ static pid_t _SpawnAgentProcess(
     /* ATTN: close first 3 also! Left for debugging only */
     for (fd = 3; fd < fdLimit; ++fd)
     {
-        if (fd != s && fd != logfd)
+        if (fd != s && fd != logfd && fd != ringfd)
             close(fd);
     }
 
+    /* shared memory is opened close-on-exec */
+    if (ringfd != -1 && fcntl(ringfd, F_SETFD, 0) != 0)
+        _exit(1);
+
     /* prepare parameter:
         socket fd to attach */
     Snprintf(param_sock, sizeof(param_sock), "%d", (int)s);
     Snprintf(param_logfd, sizeof(param_logfd), "%d", (int)logfd);
     Snprintf(param_idletimeout, sizeof(param_idletimeout), "%d", (int)idletimeout);
+    Snprintf(param_ringfd, sizeof(param_ringfd), "%d", ringfd);
+
+    argv[argc++] = realAgentProgram;
+    argv[argc++] = param_sock;
+    argv[argc++] = param_logfd;
+    argv[argc++] = "--destdir";
+    argv[argc++] = realDestDir;
+    argv[argc++] = "--providerdir";
+    argv[argc++] = realProvDir;
+    //argv[argc++] = "--idletimeout";
+    //argv[argc++] = param_idletimeout;
+    argv[argc++] = "--loglevel";
+    argv[argc++] = Log_GetLevelString(Log_GetLevel());
+
+    if (ringfd != -1)
+    {
+        argv[argc++] = "--ringfd";
+        argv[argc++] = param_ringfd;
+    }
 
-    execl(realAgentProgram,
-        realAgentProgram,
-        param_sock,
-        param_logfd,
-        "--destdir",
-        realDestDir,
-        "--providerdir",
-        realProvDir,
-        //"--idletimeout",
-        //param_idletimeout,
-        "--loglevel",
-        Log_GetLevelString(Log_GetLevel()),
-        NULL);
+    argv[argc] = NULL;
+
+    execv(realAgentProgram, (char* const*)argv);
 
     trace_AgentLaunch_Failed(scs(realAgentProgram), errno);
     _exit(1);
@@ -968,6 +1077,8 @@ static AgentElem* _CreateAgent(
     AgentElem* agent = 0;
     Sock s[2];
     int logfd = -1;
+    int ringfd = -1;
+    ProtocolRings* rings = NULL;
     InteractionOpenParams interactionParams;
 
     /* create communication pipe */
@@ -1003,6 +1114,13 @@ static AgentElem* _CreateAgent(
         }
     }
 
+    /* rings are an optimization; the socket alone is used without them */
+    if (self->ringSize &&
+        MI_RESULT_OK != ProtocolRings_Create(&rings, self->ringSize, &ringfd))
+    {
+        trace_AgentRings_CreateFailed((unsigned int)self->ringSize);
+    }
+
     agent = (AgentElem*)StrandMany_New(
                             STRAND_DEBUG( AgentElem )
                             &_AgentElem_FT,
@@ -1026,6 +1144,7 @@ static AgentElem* _CreateAgent(
         _SpawnAgentProcess(
             s[0],
             logfd,
+            ringfd,
             uid,
             gid,
             self->provDir,
@@ -1038,6 +1157,12 @@ static AgentElem* _CreateAgent(
     close(logfd);
     logfd = -1;
 
+    if (-1 != ringfd)
+    {
+        close(ringfd);
+        ringfd = -1;
+    }
+
     //printf("Press any key to continue\n");
     //getchar();
 
@@ -1052,8 +1177,13 @@ static AgentElem* _CreateAgent(
         &agent->protocol,
         self->selector,
         s[1],
-        &interactionParams ) )
-            goto failed;
+        &interactionParams,
+        rings ) )
+    {
+        /* rings are deleted by the protocol */
+        rings = NULL;
+        goto failed;
+    }
 
     s[1] = INVALID_SOCK;
 
@@ -1075,6 +1205,12 @@ failed:
     if (-1 != logfd)
         close(logfd);
 
+    if (-1 != ringfd)
+        close(ringfd);
+
+    if (rings)
+        ProtocolRings_Delete(rings);
+
     if (agent)
     {
         _AgentElem_InitiateClose(agent);
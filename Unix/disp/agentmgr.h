@@ -60,6 +60,10 @@ typedef struct _AgentMgr
     // To protect access to list on headAgents/tailAgents
     ReadWriteLock   lock;
 
+    /* Size of the shared-memory rings for message pages between server and
+       each agent (see protocol/ring.h); 0 to use the socket alone */
+    size_t          ringSize;
+
 #if defined(CONFIG_ENABLE_PREEXEC)
     PreExec preexec;
 #endif /* defined(CONFIG_ENABLE_PREEXEC) */
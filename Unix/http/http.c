@@ -60,6 +60,20 @@ typedef void SSL_CTX;
 
 #define FORCE_TRACING 0
 
+/* content up to this size is sent in the same ssl record as the header
+   (maximum plaintext size of a TLS record) */
+#define HTTP_SSL_COALESCE_SIZE (16 * 1024)
+
+/* maximum number of pieces of gathered content given to one writev */
+#define HTTP_GATHER_IOV_MAX 64
+
+/* maximum number of chunks given to one writev (header, data, end each) */
+#define HTTP_CHUNK_WRITE_MAX (HTTP_GATHER_IOV_MAX / 3)
+
+/* gathered pieces are compressed together into chunks of about this much
+   content */
+#define HTTP_COMPRESS_BATCH_SIZE (64 * 1024)
+
 //------------------------------------------------------------------------------
 
 #define HTTPSOCKET_STRANDAUX_NEWREQUEST 0
@@ -203,6 +217,13 @@ static MI_Boolean _getHeaderField(
             }
             break;
         }
+        case (_HashCode('a','g',15)): /*Accept-Encoding*/
+        {
+            if (Strcasecmp(name,"Accept-Encoding") == 0)
+                handler->acceptEncoding = HttpCompress_ParseAcceptEncoding(value);
+
+            break;
+        }
         case (_HashCode('a','n',13)): /*Authorization*/
         {
             if (Strcasecmp(name,"Authorization") == 0)
@@ -467,6 +488,328 @@ INLINE MI_Result _Sock_Write(
     return r;
 }
 
+INLINE MI_Result _Sock_WriteV(
+    Http_SR_SocketData* handler,
+    const IOVec* iov,
+    size_t iovcnt,
+    size_t* sizeWritten)
+{
+    MI_Result r;
+    size_t left;
+    size_t i;
+
+    if (handler->ssl)
+    {
+        /* no gather-write for ssl: piece by piece, up to the first short 
+           write; a retried piece is given with the same pointer again */
+        r = MI_RESULT_OK;
+        *sizeWritten = 0;
+
+        for (i = 0; i < iovcnt; i++)
+        {
+            size_t sent = 0;
+
+            if (!iov[i].len)
+                continue;
+
+            r = _Sock_Write(handler, iov[i].ptr, iov[i].len, &sent);
+            *sizeWritten += sent;
+
+            if (r != MI_RESULT_OK || sent < iov[i].len)
+                break;
+        }
+
+        if (r == MI_RESULT_WOULD_BLOCK && *sizeWritten)
+            r = MI_RESULT_OK;
+
+        return r;
+    }
+
+    r = Sock_WriteV(handler->handler.sock, iov, iovcnt, sizeWritten);
+
+    if (FORCE_TRACING || (r == MI_RESULT_OK && handler->enableTracing))
+    {
+        left = *sizeWritten;
+
+        for (i = 0; i < iovcnt && left; i++)
+        {
+            size_t size = iov[i].len < left ? iov[i].len : left;
+
+            _WriteTraceFile(ID_HTTPSENDTRACEFILE, iov[i].ptr, size);
+            left -= size;
+        }
+    }
+
+    return r;
+}
+
+/*
+**==============================================================================
+**
+** Receive buffer pool
+**
+**==============================================================================
+*/
+
+static HttpBufferPool* _HttpBufferPool_New()
+{
+    HttpBufferPool* self = (HttpBufferPool*)PAL_Calloc(1, sizeof(HttpBufferPool));
+
+    if (!self)
+        return NULL;
+
+    SList_Init(&self->freeList);
+    SList_Init(&self->slabs);
+    self->refs = 1;
+    return self;
+}
+
+static void _HttpBufferPool_AddRef(
+    _In_ HttpBufferPool* self)
+{
+    Atomic_Inc(&self->refs);
+}
+
+static void _HttpBufferPool_Release(
+    _In_ HttpBufferPool* self)
+{
+    SListEntry* slab;
+
+    if (Atomic_Dec(&self->refs) != 0)
+        return;
+
+    slab = SList_FlushAtomic(&self->slabs);
+
+    while (slab)
+    {
+        SListEntry* next = SList_Next(slab);
+        SList_Free(slab);
+        slab = next;
+    }
+
+    PAL_Free(self);
+}
+
+/* Returns a buffer of MAX_HEADER_SIZE bytes; NULL if no memory */
+static char* _HttpBufferPool_Get(
+    _In_ HttpBufferPool* self)
+{
+    SListEntry* entry = SList_PopAtomic(&self->freeList);
+    char* slab;
+    size_t i;
+
+    if (entry)
+        return (char*)entry;
+
+    slab = (char*)SList_Alloc(
+        HTTP_BUFFER_SLAB_HEADER_SIZE + HTTP_BUFFERS_PER_SLAB * MAX_HEADER_SIZE);
+
+    if (!slab)
+        return NULL;
+
+    SList_PushAtomic(&self->slabs, (SListEntry*)slab);
+
+    for (i = 1; i < HTTP_BUFFERS_PER_SLAB; i++)
+    {
+        SList_PushAtomic(&self->freeList, (SListEntry*)
+            (slab + HTTP_BUFFER_SLAB_HEADER_SIZE + i * MAX_HEADER_SIZE));
+    }
+
+    return slab + HTTP_BUFFER_SLAB_HEADER_SIZE;
+}
+
+static void _HttpBufferPool_Put(
+    _In_ HttpBufferPool* self,
+    _In_ char* buffer)
+{
+    SList_PushAtomic(&self->freeList, (SListEntry*)buffer);
+}
+
+/*
+    A large XML body is received in pages of about HTTP_CONTENT_PAGE_SIZE
+    instead of one allocation of its Content-Length. The content is fed to
+    an XML reader as it arrives; a full page is cut right after the last
+    tag the reader returned and the rest moves on to the next page, so
+    WS-Man can parse the list of pages as the pieces of one document (see
+    XML_SetTextPieces). With no tag to cut at, or once the reader failed,
+    the page grows instead.
+*/
+static MI_Boolean _ReceiveInPages(
+    const HttpHeaders* headers)
+{
+#if defined(CONFIG_ENABLE_WCHAR)
+    /* WS-Man converts the content as a whole */
+    MI_UNUSED(headers);
+    return MI_FALSE;
+#else
+    if (headers->contentLength <= HTTP_CONTENT_PAGE_SIZE ||
+        !headers->contentType)
+        return MI_FALSE;
+
+    if (Strcasecmp(headers->contentType, "application/soap+xml") != 0 &&
+        Strcasecmp(headers->contentType, "text/xml") != 0)
+        return MI_FALSE;
+
+    return !headers->charset || Strcasecmp(headers->charset, "utf-8") == 0;
+#endif
+}
+
+static Page* _NewContentPage(
+    size_t capacity)
+{
+    /* Allocate zero-terminated buffer */
+    Page* page = (Page*)PAL_Malloc(sizeof(Page) + capacity + 1);
+
+    if (page)
+        memset(page, 0, sizeof(Page));
+
+    return page;
+}
+
+static void _DropContentReader(
+    Http_SR_SocketData* handler)
+{
+    if (handler->recvReader)
+    {
+        XML_Reader_Destroy(handler->recvReader);
+        PAL_Free(handler->recvReader);
+        handler->recvReader = NULL;
+    }
+}
+
+static MI_Boolean _StartContentPages(
+    Http_SR_SocketData* handler)
+{
+    handler->recvReader = (XML_Reader*)PAL_Malloc(sizeof(XML_Reader));
+
+    if (!handler->recvReader)
+        return MI_FALSE;
+
+    XML_Reader_Init(handler->recvReader);
+
+    handler->recvPage = _NewContentPage(HTTP_CONTENT_PAGE_SIZE);
+
+    if (!handler->recvPage)
+        return MI_FALSE;
+
+    handler->recvPages = NULL;
+    handler->recvPagesTail = &handler->recvPages;
+    handler->recvPageCapacity = HTTP_CONTENT_PAGE_SIZE;
+    handler->recvPageOffset = 0;
+    handler->recvCut = 0;
+    return MI_TRUE;
+}
+
+/* Moves recvCut past the tags in the newly received data */
+static void _FindContentCut(
+    Http_SR_SocketData* handler,
+    const char* data,
+    size_t size)
+{
+    XML_Reader* reader = handler->recvReader;
+    XML_ReaderElem elem;
+    int last = handler->receivedSize == handler->recvHeaders.contentLength;
+    int r;
+
+    if (XML_Reader_Feed(reader, data, size, last) == 0)
+    {
+        while ((r = XML_Reader_Next(reader, &elem)) == 0)
+        {
+            if (elem.type == XML_START || elem.type == XML_END)
+                handler->recvCut = XML_Reader_Offset(reader);
+        }
+
+        if (r != -1)
+            return;
+    }
+
+    /* not cut any further; WS-Man reports what is wrong with it */
+    _DropContentReader(handler);
+}
+
+static MI_Boolean _NextContentPage(
+    Http_SR_SocketData* handler)
+{
+    Page* page = handler->recvPage;
+    size_t left = handler->recvHeaders.contentLength - handler->receivedSize;
+    size_t more = left < HTTP_CONTENT_PAGE_SIZE ? left : HTTP_CONTENT_PAGE_SIZE;
+    size_t capacity;
+    size_t cut;
+    size_t tail;
+    Page* next;
+
+    if (!handler->recvReader || handler->recvCut <= handler->recvPageOffset)
+    {
+        /* nowhere to cut: double this page (or make room for the rest of
+           the content if it will not be cut at all) */
+        capacity = handler->recvPageCapacity;
+        capacity += handler->recvReader && capacity < left ? capacity : left;
+
+        page = (Page*)PAL_Realloc(page, sizeof(Page) + capacity + 1);
+
+        if (!page)
+            return MI_FALSE;
+
+        handler->recvPage = page;
+        handler->recvPageCapacity = capacity;
+        return MI_TRUE;
+    }
+
+    cut = handler->recvCut - handler->recvPageOffset;
+    tail = page->u.s.size - cut;
+    capacity = tail + more;
+
+    next = _NewContentPage(capacity);
+
+    if (!next)
+        return MI_FALSE;
+
+    memcpy(next + 1, (char*)(page + 1) + cut, tail);
+    next->u.s.size = (unsigned int)tail;
+
+    page->u.s.size = (unsigned int)cut;
+    ((char*)(page + 1))[cut] = '\0';
+    *handler->recvPagesTail = page;
+    handler->recvPagesTail = &page->u.s.next;
+
+    handler->recvPage = next;
+    handler->recvPageCapacity = capacity;
+    handler->recvPageOffset += cut;
+    return MI_TRUE;
+}
+
+/* Takes 'size' bytes received at the end of recvPage */
+static MI_Boolean _ContentPageReceived(
+    Http_SR_SocketData* handler,
+    size_t size)
+{
+    Page* page = handler->recvPage;
+    const char* data = (const char*)(page + 1) + page->u.s.size;
+
+    page->u.s.size += (unsigned int)size;
+
+    if (handler->recvReader)
+        _FindContentCut(handler, data, size);
+
+    if (handler->receivedSize == handler->recvHeaders.contentLength)
+    {
+        /* hand the whole list over as recvPage */
+        ((char*)(page + 1))[page->u.s.size] = '\0';
+        *handler->recvPagesTail = page;
+        handler->recvPage = handler->recvPages;
+        handler->recvPages = NULL;
+        handler->recvPagesTail = NULL;
+        handler->recvPageCapacity = 0;
+        _DropContentReader(handler);
+        return MI_TRUE;
+    }
+
+    if (page->u.s.size == handler->recvPageCapacity)
+        return _NextContentPage(handler);
+
+    return MI_TRUE;
+}
+
 static Http_CallbackResult _ReadHeader(
     Http_SR_SocketData* handler)
 {
@@ -481,8 +824,19 @@ static Http_CallbackResult _ReadHeader(
     if (handler->recvingState == RECV_STATE_CONTENT)
         return PRT_CONTINUE;
 
+    if (!handler->recvBuffer)
+    {
+        handler->recvBuffer = _HttpBufferPool_Get(handler->bufferPool);
+
+        if (!handler->recvBuffer)
+        {
+            trace_SocketClose_recvBuffer_AllocFailed();
+            return PRT_RETURN_FALSE;
+        }
+    }
+
     buf = handler->recvBuffer + handler->receivedSize;
-    buf_size = handler->recvBufferSize - handler->receivedSize;
+    buf_size = MAX_HEADER_SIZE - handler->receivedSize;
     received = 0;
 
     r = _Sock_Read(handler, buf, buf_size, &received);
@@ -512,32 +866,20 @@ static Http_CallbackResult _ReadHeader(
 
     if (!fullHeaderReceived )
     {
-        if ( handler->receivedSize <  handler->recvBufferSize )
+        if ( handler->receivedSize < MAX_HEADER_SIZE )
             return PRT_RETURN_TRUE; /* continue reading */
 
-        if ( handler->recvBufferSize < MAX_HEADER_SIZE )
-        {
-            buf = PAL_Realloc(handler->recvBuffer, handler->recvBufferSize * 2);
-
-            if (!buf)
-                return PRT_RETURN_FALSE;
-
-            handler->recvBufferSize *= 2;
-            handler->recvBuffer = buf;
-            return _ReadHeader(handler);
-        }
-        else
-        {
-            /* http header is too big - drop connection */
-            trace_HttpHeaderIsTooBig();
-            return PRT_RETURN_FALSE;
-        }
+        /* http header is too big - drop connection */
+        trace_HttpHeaderIsTooBig();
+        return PRT_RETURN_FALSE;
     }
 
     /* consume data */
     currentLine = buf;
     data = buf + index + 1; /* pointer to data in case we got some */
 
+    handler->acceptEncoding = HTTP_CONTENT_ENCODING_IDENTITY;
+
     if (!_getHeaderField(handler, &currentLine, ' '))
         return PRT_RETURN_FALSE;
 
@@ -549,6 +891,30 @@ static Http_CallbackResult _ReadHeader(
 
     }
 
+    handler->receivedSize -= index + 1;
+
+    /* Verify that we have not more than 'content-length' bytes in buffer left
+        If we hvae more, assuming http client is invalid and drop connection */
+    if (handler->receivedSize > handler->recvHeaders.contentLength)
+    {
+        trace_HttpPayloadIsBiggerThanContentLength();
+        return PRT_RETURN_FALSE;
+    }
+
+    if (_ReceiveInPages(&handler->recvHeaders))
+    {
+        if (!_StartContentPages(handler))
+            return PRT_RETURN_FALSE;
+
+        memcpy( handler->recvPage + 1, data, handler->receivedSize );
+
+        if (!_ContentPageReceived(handler, handler->receivedSize))
+            return PRT_RETURN_FALSE;
+
+        handler->recvingState = RECV_STATE_CONTENT;
+        return PRT_CONTINUE;
+    }
+
     size_t allocSize = 0;
     if (SizeTAdd(sizeof(Page), handler->recvHeaders.contentLength, &allocSize) == S_OK &&
         SizeTAdd(allocSize, 1, &allocSize) == S_OK)
@@ -570,16 +936,6 @@ static Http_CallbackResult _ReadHeader(
     handler->recvPage->u.s.size = (unsigned int)handler->recvHeaders.contentLength;
     handler->recvPage->u.s.next = 0;
 
-    handler->receivedSize -= index + 1;
-
-    /* Verify that we have not more than 'content-length' bytes in buffer left
-        If we hvae more, assuming http client is invalid and drop connection */
-    if (handler->receivedSize > handler->recvHeaders.contentLength)
-    {
-        trace_HttpPayloadIsBiggerThanContentLength();
-        return PRT_RETURN_FALSE;
-    }
-
     memcpy( handler->recvPage + 1, data, handler->receivedSize );
     handler->recvingState = RECV_STATE_CONTENT;
 
@@ -602,6 +958,16 @@ static Http_CallbackResult _ReadData(
     buf_size = handler->recvHeaders.contentLength - handler->receivedSize;
     received = 0;
 
+    if (handler->recvPageCapacity)
+    {
+        size_t room = handler->recvPageCapacity - handler->recvPage->u.s.size;
+
+        buf = ((char*)(handler->recvPage + 1)) + handler->recvPage->u.s.size;
+
+        if (buf_size > room)
+            buf_size = room;
+    }
+
     if (buf_size)
     {
         r = _Sock_Read(handler, buf, buf_size, &received);
@@ -613,6 +979,10 @@ static Http_CallbackResult _ReadData(
             return PRT_RETURN_FALSE;
 
         handler->receivedSize += received;
+
+        if (handler->recvPageCapacity && received &&
+            !_ContentPageReceived(handler, received))
+            return PRT_RETURN_FALSE;
     }
 
     /* did we get all data? */
@@ -692,7 +1062,7 @@ static Http_CallbackResult _ReadData(
 
         if (handler->recvPage)
         {
-            PAL_Free(handler->recvPage);
+            HttpRequestMsg_FreePages(handler->recvPage);
             handler->recvPage = NULL; /* clearing this out so that caller does not double-free it */
         }
 
@@ -707,6 +1077,9 @@ static Http_CallbackResult _ReadData(
     Strand_ScheduleAux( &handler->strand, HTTPSOCKET_STRANDAUX_NEWREQUEST );
 
 Done:
+    /* headers are copied to the request by now */
+    _HttpBufferPool_Put(handler->bufferPool, handler->recvBuffer);
+    handler->recvBuffer = NULL;
     handler->recvPage = 0;
     handler->receivedSize = 0;
     memset(&handler->recvHeaders, 0, sizeof(handler->recvHeaders));
@@ -781,6 +1154,71 @@ static const char* _HttpErrorCodeDescription(
     return STATUS_UNKNOWN_ERROR;
 }
 
+/*
+ * Response content may be a list of pages (linked through u.s.next)
+ */
+static void _FreePages(
+    Page* page)
+{
+    while (page)
+    {
+        Page* next = page->u.s.next;
+
+        PAL_Free(page);
+        page = next;
+    }
+}
+
+static size_t _PagesSize(
+    const Page* page)
+{
+    size_t size = 0;
+
+    for (; page; page = page->u.s.next)
+        size += page->u.s.size;
+
+    return size;
+}
+
+/*
+ * Replaces a list of pages (of HttpContentRef pages if 'gather' is set)
+ * by a single page with the same content
+ */
+static MI_Boolean _JoinPages(
+    Page** pages,
+    MI_Boolean gather)
+{
+    Page* page;
+    Page* joined;
+    size_t size = _PagesSize(*pages);
+    char* data;
+
+    joined = (Page*)PAL_Malloc(sizeof(Page) + size + 1);
+
+    if (!joined)
+        return MI_FALSE;
+
+    memset(joined, 0, sizeof(Page));
+    joined->u.s.size = size;
+    data = (char*)(joined + 1);
+
+    for (page = *pages; page; page = page->u.s.next)
+    {
+        memcpy(data, gather ? HttpContentRef_Data(page) : (const char*)(page + 1),
+            page->u.s.size);
+        data += page->u.s.size;
+    }
+    *data = 0;
+
+    if (gather)
+        HttpContentRef_FreeList(*pages);
+    else
+        _FreePages(*pages);
+
+    *pages = joined;
+    return MI_TRUE;
+}
+
 /*
  * Common clean up function that reverts the changes made when preparing
  * the strand for a write.
@@ -790,7 +1228,10 @@ static void _ResetWriteState(
 {
     if (socketData->sendPage)
     {
-        PAL_Free(socketData->sendPage);
+        if (socketData->sendGather)
+            HttpContentRef_FreeList(socketData->sendPage);
+        else
+            _FreePages(socketData->sendPage);
         socketData->sendPage = 0;
     }
 
@@ -800,6 +1241,17 @@ static void _ResetWriteState(
         socketData->sendHeader = 0;
     }
 
+    if (socketData->sendCompressor)
+    {
+        HttpCompressStream_Delete(socketData->sendCompressor);
+        socketData->sendCompressor = NULL;
+    }
+
+    socketData->sendHeaderHasContent = MI_FALSE;
+    socketData->sendChunked = MI_FALSE;
+    socketData->sendGather = MI_FALSE;
+    socketData->sendEncoding = HTTP_CONTENT_ENCODING_IDENTITY;
+    socketData->sendCompressed = 0;
     socketData->httpErrorCode = 0;
     socketData->authFailed     = FALSE;
     socketData->sentSize = 0;
@@ -822,6 +1274,12 @@ static const char HTTP_PROTOCOL_HEADER[]   = "HTTP/1.1 ";
 static const char CONTENT_LENGTH_HEADER[]     = "Content-Length: ";
 #define CONTENT_LENGTH_HEADER_LEN  (MI_COUNT(CONTENT_LENGTH_HEADER)-1)
 
+static const char TRANSFER_ENCODING_CHUNKED_HEADER[] = "Transfer-Encoding: chunked";
+#define TRANSFER_ENCODING_CHUNKED_HEADER_LEN  (MI_COUNT(TRANSFER_ENCODING_CHUNKED_HEADER)-1)
+
+static const char CONTENT_ENCODING_HEADER[] = "Content-Encoding: ";
+#define CONTENT_ENCODING_HEADER_LEN  (MI_COUNT(CONTENT_ENCODING_HEADER)-1)
+
 static const char CONNECTION_HEADER[] = "Connection: ";
 #define CONNECTION_HEADER_LEN  (MI_COUNT(CONNECTION_HEADER)-1)
 
@@ -846,8 +1304,26 @@ _BuildHeader( Http_SR_SocketData* handler, int contentLen,
     char content_len_buff[16] ;
     char *pcontent_len = int64_to_a(content_len_buff, sizeof(content_len_buff), contentLen, &content_len_strlen);
 
-    int needed_size = HTTP_PROTOCOL_HEADER_LEN  + errorcode_strlen + 1 + errcode_desc_len + 2 + // HTTP/1.1 0 200 Success\r\n
-                      CONTENT_LENGTH_HEADER_LEN + content_len_strlen + 2;                       // Content-Length: 214
+    const char *pcontent_encoding = NULL;
+    int  content_encoding_len = 0;
+
+    int needed_size = HTTP_PROTOCOL_HEADER_LEN  + errorcode_strlen + 1 + errcode_desc_len + 2; // HTTP/1.1 0 200 Success\r\n
+
+    if (handler->sendEncoding != HTTP_CONTENT_ENCODING_IDENTITY)
+    {
+        pcontent_encoding = HttpCompress_EncodingName(handler->sendEncoding);
+        content_encoding_len = (int)Strlen(pcontent_encoding);
+        needed_size += CONTENT_ENCODING_HEADER_LEN + content_encoding_len + 2;  // Content-Encoding: gzip
+    }
+
+    if (contentLen < 0)
+    {
+        needed_size += TRANSFER_ENCODING_CHUNKED_HEADER_LEN + 2;            // Transfer-Encoding: chunked
+    }
+    else
+    {
+        needed_size += CONTENT_LENGTH_HEADER_LEN + content_len_strlen + 2;  // Content-Length: 214
+    }
 
     if (connectionAction)
     {
@@ -884,17 +1360,40 @@ _BuildHeader( Http_SR_SocketData* handler, int contentLen,
     memcpy(bufp, "\r\n", 2);
     bufp += 2;
  
-    // Content-Length: 2035\r\n
+    if (contentLen < 0)
+    {
+        // Transfer-Encoding: chunked\r\n
+
+        memcpy(bufp, TRANSFER_ENCODING_CHUNKED_HEADER, TRANSFER_ENCODING_CHUNKED_HEADER_LEN);
+        bufp += TRANSFER_ENCODING_CHUNKED_HEADER_LEN;
+    }
+    else
+    {
+        // Content-Length: 2035\r\n
 
-    memcpy(bufp, CONTENT_LENGTH_HEADER, CONTENT_LENGTH_HEADER_LEN);
-    bufp += CONTENT_LENGTH_HEADER_LEN;
+        memcpy(bufp, CONTENT_LENGTH_HEADER, CONTENT_LENGTH_HEADER_LEN);
+        bufp += CONTENT_LENGTH_HEADER_LEN;
 
-    memcpy(bufp, pcontent_len, content_len_strlen);
-    bufp += content_len_strlen;
+        memcpy(bufp, pcontent_len, content_len_strlen);
+        bufp += content_len_strlen;
+    }
 
     memcpy(bufp, "\r\n", 2);
     bufp += 2;
 
+    if (pcontent_encoding)
+    {
+        // Content-Encoding: gzip\r\n
+        memcpy(bufp, CONTENT_ENCODING_HEADER, CONTENT_ENCODING_HEADER_LEN);
+        bufp += CONTENT_ENCODING_HEADER_LEN;
+
+        memcpy(bufp, pcontent_encoding, content_encoding_len);
+        bufp += content_encoding_len;
+
+        memcpy(bufp, "\r\n", 2);
+        bufp += 2;
+    }
+
     if (connectionAction)
     {
         // Connection: Keep-Alive\r\n
@@ -944,6 +1443,177 @@ _BuildHeader( Http_SR_SocketData* handler, int contentLen,
 }
 
 
+/* Data of a page of the content being sent */
+static const char* _SendPageData(
+    Http_SR_SocketData* handler,
+    const Page* page)
+{
+    return handler->sendGather ? HttpContentRef_Data(page) : (const char*)(page + 1);
+}
+
+/* Releases the first page of the content once it is sent */
+static void _DropSendPage(
+    Http_SR_SocketData* handler)
+{
+    Page* page = handler->sendPage;
+
+    handler->sendPage = page->u.s.next;
+
+    if (handler->sendCompressed)
+        handler->sendCompressed--;
+
+    if (handler->sendGather)
+    {
+        page->u.s.next = NULL;
+        HttpContentRef_FreeList(page);
+    }
+    else
+        PAL_Free(page);
+}
+
+static void _FreeCompressedPiece(
+    void* page)
+{
+    PAL_Free(page);
+}
+
+/* Compresses the next page of the content that is not compressed yet, if
+   the content is compressed; the last page finishes the compressed stream.
+   Gathered pieces are compressed together, up to HTTP_COMPRESS_BATCH_SIZE
+   of them, into one chunk */
+static MI_Boolean _CompressChunk(
+    Http_SR_SocketData* handler)
+{
+    Page** link = &handler->sendPage;
+    Page* page;
+    size_t i;
+
+    if (!handler->sendCompressor)
+        return MI_TRUE;
+
+    for (i = 0; i < handler->sendCompressed && *link; i++)
+        link = &(*link)->u.s.next;
+
+    if (!(page = *link))
+        return MI_TRUE;
+
+    if (handler->sendGather)
+    {
+        /* the pieces are compressed from where they are; the reference of
+           the first one then refers to (and owns) the compressed data, the
+           others are released */
+        HttpContentRef* ref = (HttpContentRef*)(page + 1);
+        IOVec pieces[HTTP_GATHER_IOV_MAX];
+        size_t count = 0;
+        size_t size = 0;
+        Page* next = page;
+        Page* out;
+
+        while (next && count < MI_COUNT(pieces) && size < HTTP_COMPRESS_BATCH_SIZE)
+        {
+            pieces[count].ptr = (void*)HttpContentRef_Data(next);
+            pieces[count].len = next->u.s.size;
+            size += next->u.s.size;
+            count++;
+            next = next->u.s.next;
+        }
+
+        if (!HttpCompressStream_DataV(handler->sendCompressor, pieces, count,
+            next == NULL, &out))
+        {
+            return MI_FALSE;
+        }
+
+        if (count > 1)
+        {
+            Page* rest = page->u.s.next;
+
+            for (i = 2, page = rest; i < count; i++)
+                page = page->u.s.next;
+
+            page->u.s.next = NULL;
+            HttpContentRef_FreeList(rest);
+            page = *link;
+            page->u.s.next = next;
+        }
+
+        if (ref->release)
+            ref->release(ref->owner);
+
+        ref->data = out + 1;
+        ref->release = _FreeCompressedPiece;
+        ref->owner = out;
+        page->u.s.size = out->u.s.size;
+    }
+    else if (!HttpCompressStream_Page(handler->sendCompressor, link,
+        page->u.s.next == NULL))
+    {
+        return MI_FALSE;
+    }
+
+    handler->sendCompressed++;
+    return MI_TRUE;
+}
+
+/* Whether content of the given size (whole, unless chunked) is to be 
+   compressed */
+static MI_Boolean _ShouldCompress(
+    Http_SR_SocketData* handler,
+    size_t size)
+{
+    Http* self = (Http*)handler->handler.data;
+
+    if (handler->acceptEncoding == HTTP_CONTENT_ENCODING_IDENTITY ||
+        self->options.compressionLevel == 0)
+        return MI_FALSE;
+
+    if (!handler->sendChunked && size < self->options.compressionThreshold)
+        return MI_FALSE;
+
+#if ENCRYPT_DECRYPT
+    /* encrypted content has its own content type */
+    if (!handler->ssl && handler->encryptedTransaction)
+        return MI_FALSE;
+#endif
+
+    return MI_TRUE;
+}
+
+/* Compresses the content with the coding accepted by the client, unless
+   compression is disabled or the content is too small to be worth it. 
+   Chunked content is compressed page by page as it is sent. Content that 
+   cannot be compressed goes out as it is; MI_FALSE only if the first chunk
+   fails after the stream is set up */
+static MI_Boolean _StartCompression(
+    Http_SR_SocketData* handler)
+{
+    Http* self = (Http*)handler->handler.data;
+    HttpCompressStream* stream;
+
+    if (!handler->sendPage ||
+        !_ShouldCompress(handler, handler->sendPage->u.s.size))
+        return MI_TRUE;
+
+    stream = HttpCompressStream_New(handler->acceptEncoding, MI_TRUE,
+        (int)self->options.compressionLevel);
+
+    if (!stream)
+        return MI_TRUE;
+
+    if (handler->sendChunked)
+    {
+        handler->sendCompressor = stream;
+        handler->sendEncoding = handler->acceptEncoding;
+        return _CompressChunk(handler);
+    }
+
+    if (HttpCompressStream_Page(stream, &handler->sendPage, MI_TRUE))
+        handler->sendEncoding = handler->acceptEncoding;
+
+    HttpCompressStream_Delete(stream);
+    return MI_TRUE;
+}
+
 static Http_CallbackResult _WriteHeader( Http_SR_SocketData* handler)
 {
 
@@ -974,11 +1644,59 @@ static Http_CallbackResult _WriteHeader( Http_SR_SocketData* handler)
         static const char MULTIPART_ENCRYPTED_KERBEROS[] = "multipart/encrypted;"
                        "protocol=\"application/HTTP-Kerberos-session-encrypted\";" "boundary=\"Encrypted Boundary\"\r\n";
 
-        char *content_type    = (char*)CONTENT_TYPE_APPLICATION_SOAP;
-        int  content_type_len = CONTENT_TYPE_APPLICATION_SOAP_LEN;
-        int  content_len      = 0;
+        char *content_type    = (char*)CONTENT_TYPE_APPLICATION_SOAP;
+        int  content_type_len = CONTENT_TYPE_APPLICATION_SOAP_LEN;
+        int  content_len      = 0;
+
+        if (handler->sendGather)
+        {
+            /* gathered content goes out from where it is, piece by piece:
+               as one body, or chunked if it is compressed; encryption
+               needs it as a whole */
+    #if ENCRYPT_DECRYPT
+            if (!handler->ssl && handler->encryptedTransaction)
+            {
+                if (!_JoinPages(&handler->sendPage, MI_TRUE))
+                    return PRT_RETURN_FALSE;
+
+                handler->sendGather = MI_FALSE;
+            }
+            else
+    #endif
+            if (_ShouldCompress(handler, _PagesSize(handler->sendPage)))
+            {
+                handler->sendChunked = MI_TRUE;
+            }
+        }
+        else if (handler->sendPage && handler->sendPage->u.s.next)
+        {
+            /* a list of pages goes out as it is, one chunk per page; 
+               encryption needs the content as a whole */
+    #if ENCRYPT_DECRYPT
+            if (!handler->ssl && handler->encryptedTransaction)
+            {
+                if (!_JoinPages(&handler->sendPage, MI_FALSE))
+                    return PRT_RETURN_FALSE;
+            }
+            else
+    #endif
+            {
+                handler->sendChunked = MI_TRUE;
+            }
+        }
+
+        if (!_StartCompression(handler))
+            return PRT_RETURN_FALSE;
     
-        if (handler->sendPage)
+        if (handler->sendChunked)
+        {
+            content_len = -1;
+        }
+        else if (handler->sendGather)
+        {
+            content_len = (int)_PagesSize(handler->sendPage);
+        }
+        else if (handler->sendPage)
         {
             content_len = handler->sendPage->u.s.size;
         }
@@ -1047,14 +1765,70 @@ static Http_CallbackResult _WriteHeader( Http_SR_SocketData* handler)
         handler->sendHeader = _BuildHeader(handler, content_len, 
                                           CONNECTION_KEEPALIVE_LEN, CONNECTION_KEEPALIVE,
                                           content_type_len, content_type);
+
+        /* ssl encrypts every SSL_write into its own record(s): give it 
+           header and small content as one buffer, so they go out as one
+           record */
+        if (handler->ssl && handler->sendPage && !handler->sendChunked &&
+            !handler->sendGather &&
+            handler->sendPage->u.s.size <= HTTP_SSL_COALESCE_SIZE)
+        {
+            size_t header_len = handler->sendHeader->u.s.size;
+            Page* page = (Page*)PAL_Realloc(handler->sendHeader, 
+                sizeof(Page) + header_len + handler->sendPage->u.s.size);
+
+            /* if it fails, they are sent one by one */
+            if (page)
+            {
+                memcpy((char*)(page+1) + header_len, handler->sendPage+1, handler->sendPage->u.s.size);
+                page->u.s.size += handler->sendPage->u.s.size;
+                handler->sendHeader = page;
+                handler->sendHeaderHasContent = MI_TRUE;
+            }
+        }
     }
 
     sent = 0;
 
     char *bufp = (char*)(handler->sendHeader+1);
+    size_t header_left;
     bufp += handler->sentSize;
+    header_left = handler->sendHeader->u.s.size - handler->sentSize;
+
+    if (!handler->ssl && handler->sendPage && !handler->sendChunked)
+    {
+        /* header and content in one call; whatever part of content 
+           does not go out now is sent by _WriteData */
+        IOVec iov[1 + HTTP_GATHER_IOV_MAX];
+        size_t iovcnt = 1;
+
+        iov[0].ptr = bufp;
+        iov[0].len = header_left;
+
+        if (handler->sendGather)
+        {
+            Page* page;
+
+            for (page = handler->sendPage; page && iovcnt < MI_COUNT(iov); page = page->u.s.next)
+            {
+                iov[iovcnt].ptr = (void*)HttpContentRef_Data(page);
+                iov[iovcnt].len = page->u.s.size;
+                iovcnt++;
+            }
+        }
+        else
+        {
+            iov[1].ptr = handler->sendPage + 1;
+            iov[1].len = handler->sendPage->u.s.size;
+            iovcnt = 2;
+        }
 
-    r = _Sock_Write(handler, bufp, handler->sendHeader->u.s.size - handler->sentSize, &sent);
+        r = _Sock_WriteV(handler, iov, iovcnt, &sent);
+    }
+    else
+    {
+        r = _Sock_Write(handler, bufp, header_left, &sent);
+    }
 
     if ( r == MI_RESULT_OK && 0 == sent )
     {
@@ -1071,15 +1845,19 @@ static Http_CallbackResult _WriteHeader( Http_SR_SocketData* handler)
         return PRT_RETURN_TRUE;
     }
 
-    handler->sentSize += sent;
-    if (handler->sentSize < handler->sendHeader->u.s.size)
+    if (sent < header_left)
     {
         // We didn't send all of the header, so keep sending
+        handler->sentSize += sent;
         return PRT_RETURN_TRUE;
     }
 
-    // We sent the entire header successfully and can move on to the content
-    handler->sentSize = 0;
+    // We sent the entire header successfully and can move on to the content;
+    // some or all of the content may have been sent with it
+    if (handler->sendHeaderHasContent)
+        handler->sentSize = handler->sendPage->u.s.size;
+    else
+        handler->sentSize = sent - header_left;
 
     PAL_Free(handler->sendHeader);
     handler->sendHeader = NULL;
@@ -1089,6 +1867,177 @@ static Http_CallbackResult _WriteHeader( Http_SR_SocketData* handler)
 }
 
 
+/* Sends the page list as chunked content: "<size>\r\n<page>\r\n" per page,
+   terminated by "0\r\n\r\n", several chunks per call. Pages are 
+   compressed as they are about to be sent and released as soon as they
+   are sent. sentSize is the part of the first chunk that is out already */
+static Http_CallbackResult _WriteChunkedData(
+    Http_SR_SocketData* handler)
+{
+    static const char CHUNK_END[] = "\r\n0\r\n\r\n";
+
+    /* ssl writes piece by piece and a retried piece must be given from
+       the same place again: one chunk per call, with its header kept in
+       the handler */
+    size_t maxChunks = handler->ssl ? 1 : HTTP_CHUNK_WRITE_MAX;
+
+    while (handler->sendPage)
+    {
+        char headers[HTTP_CHUNK_WRITE_MAX][16];
+        size_t chunkSizes[HTTP_CHUNK_WRITE_MAX];
+        IOVec iov[HTTP_CHUNK_WRITE_MAX * 3];
+        size_t iovcnt = 0;
+        size_t chunks = 0;
+        size_t skip = handler->sentSize;
+        size_t left = 0;
+        size_t sent = 0;
+        Page** link = &handler->sendPage;
+        size_t i;
+        MI_Result r;
+
+        while (*link && chunks < maxChunks)
+        {
+            char* header = chunks ? headers[chunks] : handler->sendChunkHeader;
+            IOVec pieces[3];
+            Page* page;
+
+            if (handler->sendCompressor && chunks == handler->sendCompressed &&
+                !_CompressChunk(handler))
+            {
+                return PRT_RETURN_FALSE;
+            }
+
+            page = *link;
+            pieces[0].ptr = header;
+            pieces[0].len = 0;
+            pieces[1].ptr = (void*)_SendPageData(handler, page);
+            pieces[1].len = page->u.s.size;
+            pieces[2].ptr = (void*)CHUNK_END;
+            pieces[2].len = 0;
+
+            if (page->u.s.size)
+            {
+                pieces[0].len = (size_t)Snprintf(header, sizeof(headers[0]),
+                    "%x\r\n", (unsigned int)page->u.s.size);
+
+                /* the last page carries the terminating zero-size chunk */
+                pieces[2].len = page->u.s.next ? 2 : MI_COUNT(CHUNK_END) - 1;
+            }
+            else if (!page->u.s.next)
+            {
+                pieces[2].ptr = (void*)(CHUNK_END + 2);
+                pieces[2].len = MI_COUNT(CHUNK_END) - 3;
+            }
+            /* else an empty chunk would end the content: nothing is sent */
+
+            chunkSizes[chunks] = pieces[0].len + pieces[1].len + pieces[2].len;
+
+            /* skip what went out by the previous call */
+            for (i = 0; i < MI_COUNT(pieces); i++)
+            {
+                if (skip >= pieces[i].len)
+                {
+                    skip -= pieces[i].len;
+                    continue;
+                }
+
+                iov[iovcnt].ptr = (char*)pieces[i].ptr + skip;
+                iov[iovcnt].len = pieces[i].len - skip;
+                left += iov[iovcnt].len;
+                iovcnt++;
+                skip = 0;
+            }
+
+            link = &page->u.s.next;
+            chunks++;
+        }
+
+        if (left)
+        {
+            r = _Sock_WriteV(handler, iov, iovcnt, &sent);
+
+            if ( r == MI_RESULT_OK && 0 == sent )
+                return PRT_RETURN_FALSE; /* conection closed */
+
+            if ( r != MI_RESULT_OK && r != MI_RESULT_WOULD_BLOCK )
+                return PRT_RETURN_FALSE;
+        }
+
+        handler->sentSize += sent;
+
+        for (i = 0; i < chunks && handler->sentSize >= chunkSizes[i]; i++)
+        {
+            handler->sentSize -= chunkSizes[i];
+            _DropSendPage(handler);
+        }
+
+        if (sent < left)
+            return PRT_RETURN_TRUE;
+    }
+
+    _ResetWriteState( handler );
+
+    return PRT_CONTINUE;
+}
+
+/* Sends gathered content, several pieces per call; pieces are released
+   as soon as they are sent. sentSize is the part of the first one that
+   is out already */
+static Http_CallbackResult _WriteGatheredData(
+    Http_SR_SocketData* handler)
+{
+    for (;;)
+    {
+        IOVec iov[HTTP_GATHER_IOV_MAX];
+        size_t iovcnt = 0;
+        size_t skip;
+        size_t left = 0;
+        size_t sent = 0;
+        Page* page;
+        MI_Result r;
+
+        while (handler->sendPage && handler->sentSize >= handler->sendPage->u.s.size)
+        {
+            page = handler->sendPage;
+            handler->sentSize -= page->u.s.size;
+            handler->sendPage = page->u.s.next;
+            page->u.s.next = NULL;
+            HttpContentRef_FreeList(page);
+        }
+
+        if (!handler->sendPage)
+            break;
+
+        skip = handler->sentSize;
+
+        for (page = handler->sendPage; page && iovcnt < MI_COUNT(iov); page = page->u.s.next)
+        {
+            iov[iovcnt].ptr = (char*)HttpContentRef_Data(page) + skip;
+            iov[iovcnt].len = page->u.s.size - skip;
+            left += iov[iovcnt].len;
+            iovcnt++;
+            skip = 0;
+        }
+
+        r = _Sock_WriteV(handler, iov, iovcnt, &sent);
+
+        if ( r == MI_RESULT_OK && 0 == sent )
+            return PRT_RETURN_FALSE; /* conection closed */
+
+        if ( r != MI_RESULT_OK && r != MI_RESULT_WOULD_BLOCK )
+            return PRT_RETURN_FALSE;
+
+        handler->sentSize += sent;
+
+        if (sent < left)
+            return PRT_RETURN_TRUE;
+    }
+
+    _ResetWriteState( handler );
+
+    return PRT_CONTINUE;
+}
+
 static Http_CallbackResult _WriteData(
     Http_SR_SocketData* handler)
 {
@@ -1100,8 +2049,14 @@ static Http_CallbackResult _WriteData(
     if (handler->sendingState != RECV_STATE_CONTENT)
         return PRT_RETURN_FALSE;
 
-    if (!handler->sendPage)
-    {   /* no content*/
+    if (handler->sendChunked)
+        return _WriteChunkedData(handler);
+
+    if (handler->sendGather)
+        return _WriteGatheredData(handler);
+
+    if (!handler->sendPage || handler->sentSize == handler->sendPage->u.s.size)
+    {   /* no content or it was sent along with the header */
         _ResetWriteState( handler );
         return PRT_CONTINUE;
     }
@@ -1229,12 +2184,23 @@ static MI_Boolean _RequestCallback(
         }
 
         if (handler->recvPage)
-            PAL_Free(handler->recvPage);
+            HttpRequestMsg_FreePages(handler->recvPage);
+
+        if (handler->recvPages)
+            HttpRequestMsg_FreePages(handler->recvPages);
+
+        _DropContentReader(handler);
 
         if (handler->sendPage)
-            PAL_Free(handler->sendPage);
+            _FreePages(handler->sendPage);
+
+        if (handler->sendCompressor)
+            HttpCompressStream_Delete(handler->sendCompressor);
 
-        PAL_Free(handler->recvBuffer);
+        if (handler->recvBuffer)
+            _HttpBufferPool_Put(handler->bufferPool, handler->recvBuffer);
+
+        _HttpBufferPool_Release(handler->bufferPool);
         // handler deleted on its own strand
 
         // notify next stack layer
@@ -1260,7 +2226,7 @@ static void _SendIN_IO_thread_HttpSocket(void* self_, Message* message)
     /* validate handler */
 
     if (MI_RESULT_OK != Selector_ContainsHandler(
-            sendSock->http->selector, &sendSock->handler ) )
+            sendSock->selector, &sendSock->handler ) )
     {
         trace_SendIN_IO_thread_HttpSocket_InvalidHandler(sendSock);
 
@@ -1274,9 +2240,11 @@ static void _SendIN_IO_thread_HttpSocket(void* self_, Message* message)
 
     sendSock->handler.mask |= SELECTOR_WRITE;
     sendSock->handler.mask &= ~SELECTOR_READ;
+    Selector_UpdateHandler(sendSock->selector, &sendSock->handler, MI_FALSE);
 
     // Now we take ownership of the page
     sendSock->sendPage = response->page;
+    sendSock->sendGather = response->gather && response->page;
     response->page = NULL;
     sendSock->httpErrorCode = response->httpErrorCode;
 
@@ -1318,7 +2286,7 @@ void _HttpSocket_Post( _In_ Strand* self_, _In_ Message* msg)
     Atomic_Inc((ptrdiff_t*) &self->refcount);
 
     if( MI_RESULT_OK != Selector_CallInIOThread(
-        self->http->selector, _SendIN_IO_thread_HttpSocket, self, msg ) )
+        self->selector, _SendIN_IO_thread_HttpSocket, self, msg ) )
     {
         // We also need to release the page (if any)
         HttpResponseMsg * response = (HttpResponseMsg *)msg;
@@ -1438,7 +2406,6 @@ static MI_Boolean _ListenerCallback(
     Addr addr;
     Http_SR_SocketData* h;
 
-    MI_UNUSED(sel);
     MI_UNUSED(mask);
     MI_UNUSED(currentTimeUsec);
 
@@ -1478,6 +2445,7 @@ static MI_Boolean _ListenerCallback(
         /* Primary refount -- secondary one is for posting to protocol thread safely */
         h->refcount = 1;
         h->http = self;
+        h->selector = sel;   /* connection stays on listener's thread */
         h->pAuthContext  = NULL;
         h->pVerifierCred = NULL;
         h->isAuthorised = FALSE;
@@ -1486,16 +2454,6 @@ static MI_Boolean _ListenerCallback(
         h->pSendAuthHeader = NULL;
         h->sendAuthHeaderLen = 0;
 
-        h->recvBufferSize = INITIAL_BUFFER_SIZE;
-        h->recvBuffer = (char*)PAL_Calloc(1, h->recvBufferSize);
-        if (!h->recvBuffer)
-        {
-            Strand_Delete(&h->strand);
-            trace_SocketClose_recvBuffer_AllocFailed();
-            Sock_Close(s);
-            return MI_TRUE;
-        }
-
         h->handler.sock = s;
         h->handler.mask = SELECTOR_READ | SELECTOR_EXCEPTION;
         h->handler.callback = _RequestCallback;
@@ -1526,12 +2484,16 @@ static MI_Boolean _ListenerCallback(
             }
         }
 
+        h->bufferPool = self->bufferPool;
+        _HttpBufferPool_AddRef(h->bufferPool);
+
         /* Watch for read events on the incoming connection */
-        r = Selector_AddHandler(self->selector, &h->handler);
+        r = Selector_AddHandler(sel, &h->handler);
 
         if (r != MI_RESULT_OK)
         {
             trace_SelectorAddHandler_Failed();
+            _HttpBufferPool_Release(h->bufferPool);
             if (handler->secure)
                 SSL_free(h->ssl);
             Strand_Delete(&h->strand);
@@ -1583,6 +2545,14 @@ static MI_Result _New_Http(
             return MI_RESULT_FAILED;
     }
 
+    self->bufferPool = _HttpBufferPool_New();
+
+    if (!self->bufferPool)
+    {
+        PAL_Free(self);
+        return MI_RESULT_FAILED;
+    }
+
     if (selector)
     {   /* attach the exisiting selector */
         self->selector = selector;
@@ -1596,6 +2566,7 @@ static MI_Result _New_Http(
         /* Initialize the selector */
         if (Selector_Init(&self->internalSelector) != MI_RESULT_OK)
         {
+            _HttpBufferPool_Release(self->bufferPool);
             PAL_Free(self);
             return MI_RESULT_FAILED;
         }
@@ -1727,12 +2698,55 @@ static MI_Result _CreateSSLContext(Http* self, const char* sslCipherSuite, SSL_O
     self->sslContext = sslContext;
     return MI_RESULT_OK;
 }
+
+#if OPENSSL_VERSION_NUMBER < 0x10100000L
+/* OpenSSL before 1.1 is only thread-safe once locking callbacks are set */
+static pthread_mutex_t* _sslLocks;
+
+static void _SSLLockingCallback(int mode, int n, const char* file, int line)
+{
+    MI_UNUSED(file);
+    MI_UNUSED(line);
+
+    if (mode & CRYPTO_LOCK)
+        pthread_mutex_lock(&_sslLocks[n]);
+    else
+        pthread_mutex_unlock(&_sslLocks[n]);
+}
+
+static unsigned long _SSLThreadIdCallback(void)
+{
+    return (unsigned long)pthread_self();
+}
+
+/* Locks live as long as the process; installed only once */
+static void _InitSSLLocking()
+{
+    int i;
+
+    if (CRYPTO_get_locking_callback())
+        return;
+
+    _sslLocks = (pthread_mutex_t*)PAL_Malloc(CRYPTO_num_locks() * sizeof(pthread_mutex_t));
+
+    if (!_sslLocks)
+        return;
+
+    for (i = 0; i < CRYPTO_num_locks(); i++)
+        pthread_mutex_init(&_sslLocks[i], NULL);
+
+    CRYPTO_set_id_callback(_SSLThreadIdCallback);
+    CRYPTO_set_locking_callback(_SSLLockingCallback);
+}
+#endif /* OPENSSL_VERSION_NUMBER < 0x10100000L */
 #endif
 
 static MI_Result _CreateAddListenerSocket(
     Http* self,
+    Selector* selector,
     unsigned short port,
-    MI_Boolean  secure
+    MI_Boolean  secure,
+    MI_Boolean  shared
     )
 {
     Addr addr;
@@ -1742,7 +2756,11 @@ static MI_Result _CreateAddListenerSocket(
     /* Create listener socket */
     {
         Addr_InitAny(&addr, port);
-        r = Sock_CreateListener(&listener, &addr);
+
+        if (shared)
+            r = Sock_CreateSharedListener(&listener, &addr);
+        else
+            r = Sock_CreateListener(&listener, &addr);
 
         if (r != MI_RESULT_OK)
         {
@@ -1776,7 +2794,7 @@ static MI_Result _CreateAddListenerSocket(
         h->base.data = self;
         h->secure = secure;
 
-        r = Selector_AddHandler(self->selector, &h->base);
+        r = Selector_AddHandler(selector, &h->base);
 
         if (r != MI_RESULT_OK)
         {
@@ -1790,6 +2808,133 @@ static MI_Result _CreateAddListenerSocket(
     return MI_RESULT_OK;
 }
 
+/* Creates listener(s) for the port: one on the main selector, or one per
+   I/O thread all sharing the port, so the kernel balances connections */
+static MI_Result _CreateAddListeners(
+    Http* self,
+    unsigned short port,
+    MI_Boolean  secure
+    )
+{
+    MI_Uint32 i;
+    MI_Result r;
+
+    if (0 == self->ioThreadsCount)
+        return _CreateAddListenerSocket(self, self->selector, port, secure, MI_FALSE);
+
+    for (i = 0; i < self->ioThreadsCount; i++)
+    {
+        r = _CreateAddListenerSocket(
+            self,
+            &self->ioThreads[i].selector,
+            port,
+            secure,
+            self->ioThreadsCount > 1);
+
+        if (r != MI_RESULT_OK)
+            return r;
+    }
+
+    return MI_RESULT_OK;
+}
+
+static PAL_Uint32 THREAD_API _IOThreadProc(void* param)
+{
+    HttpIOThread* ioThread = (HttpIOThread*)param;
+    const MI_Uint64 ONE_SECOND_USEC = 1000 * 1000;
+
+    /* Selector_StopRunning may be called before Selector_Run starts,
+       so stop flag is re-checked between bounded runs */
+    while (!Atomic_Read(&ioThread->http->ioThreadsStopping))
+    {
+        Selector_Run(&ioThread->selector, ONE_SECOND_USEC, MI_FALSE);
+    }
+
+    return 0;
+}
+
+static MI_Result _InitIOThreads(
+    Http* self,
+    MI_Uint32 count)
+{
+    MI_Uint32 i;
+
+    self->ioThreads = (HttpIOThread*)PAL_Calloc(count, sizeof(HttpIOThread));
+
+    if (!self->ioThreads)
+        return MI_RESULT_FAILED;
+
+    self->ioThreadsCount = count;
+
+    for (i = 0; i < count; i++)
+    {
+        HttpIOThread* ioThread = &self->ioThreads[i];
+
+        if (Selector_Init(&ioThread->selector) != MI_RESULT_OK)
+            return MI_RESULT_FAILED;
+
+        ioThread->selectorInitialized = MI_TRUE;
+        ioThread->http = self;
+
+        /* thread keeps running even if all its sockets are gone */
+        Selector_SetAllowEmptyFlag(&ioThread->selector, MI_TRUE);
+    }
+
+    return MI_RESULT_OK;
+}
+
+static MI_Result _StartIOThreads(
+    Http* self)
+{
+    MI_Uint32 i;
+
+    for (i = 0; i < self->ioThreadsCount; i++)
+    {
+        HttpIOThread* ioThread = &self->ioThreads[i];
+
+        if (Thread_CreateJoinable(&ioThread->thread, _IOThreadProc, NULL, ioThread) != 0)
+            return MI_RESULT_FAILED;
+
+        ioThread->threadStarted = MI_TRUE;
+    }
+
+    return MI_RESULT_OK;
+}
+
+static void _DeleteIOThreads(
+    Http* self)
+{
+    MI_Uint32 i;
+
+    Atomic_Swap(&self->ioThreadsStopping, 1);
+
+    for (i = 0; i < self->ioThreadsCount; i++)
+    {
+        HttpIOThread* ioThread = &self->ioThreads[i];
+
+        if (ioThread->threadStarted)
+        {
+            PAL_Uint32 ret;
+
+            Selector_StopRunning(&ioThread->selector);
+            Thread_Join(&ioThread->thread, &ret);
+            Thread_Destroy(&ioThread->thread);
+        }
+    }
+
+    /* Note: selector-destroy closes all listeners and connections;
+       their threads are gone so it is safe to do from here */
+    for (i = 0; i < self->ioThreadsCount; i++)
+    {
+        if (self->ioThreads[i].selectorInitialized)
+            Selector_Destroy(&self->ioThreads[i].selector);
+    }
+
+    PAL_Free(self->ioThreads);
+    self->ioThreads = NULL;
+    self->ioThreadsCount = 0;
+}
+
 MI_Result Http_New_Server(
     _Out_       Http**              selfOut,
     _In_        Selector*           selector,               /* optional, maybe NULL*/
@@ -1812,10 +2957,33 @@ MI_Result Http_New_Server(
 
     self = *selfOut;
 
+    // options
+    if( NULL == options )
+    {
+        HttpOptions tmpOptions = DEFAULT_HTTP_OPTIONS;
+        self->options = tmpOptions;
+    }
+    else
+    {
+        self->options = *options;
+    }
+
+    /* Selectors for dedicated I/O threads (threads start once listening) */
+    if (self->options.ioThreads)
+    {
+        r = _InitIOThreads(self, self->options.ioThreads);
+
+        if (r != MI_RESULT_OK)
+        {
+            Http_Delete(self);
+            return r;
+        }
+    }
+
     /* Create http listener socket */
     if (http_port)
     {
-        r = _CreateAddListenerSocket(self, http_port, MI_FALSE);
+        r = _CreateAddListeners(self, http_port, MI_FALSE);
 
         if (r != MI_RESULT_OK)
         {
@@ -1840,8 +3008,14 @@ MI_Result Http_New_Server(
             return r;
         }
 
+#if OPENSSL_VERSION_NUMBER < 0x10100000L
+        /* connections are served from several threads */
+        if (self->ioThreadsCount)
+            _InitSSLLocking();
+#endif
+
         /* create a socket */
-        r = _CreateAddListenerSocket(self, https_port, MI_TRUE);
+        r = _CreateAddListeners(self, https_port, MI_TRUE);
 
         if (r != MI_RESULT_OK)
         {
@@ -1853,15 +3027,15 @@ MI_Result Http_New_Server(
     MI_UNUSED(https_port);
 #endif
 
-    // options
-    if( NULL == options )
-    {
-        HttpOptions tmpOptions = DEFAULT_HTTP_OPTIONS;
-        self->options = tmpOptions;
-    }
-    else
+    if (self->ioThreadsCount)
     {
-        self->options = *options;
+        r = _StartIOThreads(self);
+
+        if (r != MI_RESULT_OK)
+        {
+            Http_Delete(self);
+            return r;
+        }
     }
 
     return MI_RESULT_OK;
@@ -1878,6 +3052,9 @@ MI_Result Http_Delete(
     if (self->magic != _MAGIC)
         return MI_RESULT_INVALID_PARAMETER;
 
+    if (self->ioThreads)
+        _DeleteIOThreads(self);
+
     if (self->internalSelectorUsed)
     {
         /* Release selector;
@@ -1891,6 +3068,9 @@ MI_Result Http_Delete(
     if (self->sslContext)
         SSL_CTX_free(self->sslContext);
 
+    /* connections still open keep the pool until they are closed */
+    _HttpBufferPool_Release(self->bufferPool);
+
     /* Clear magic number */
     self->magic = 0xDDDDDDDD;
 
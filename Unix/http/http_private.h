@@ -10,6 +10,11 @@
 #ifndef _omi_http_http_private_h
 #define _omi_http_http_private_h
 
+#include <pal/thread.h>
+#include <pal/slist.h>
+#include "httpcompress.h"
+#include <xml/xmlreader.h>
+
 /*
 **==============================================================================
 **
@@ -54,9 +59,44 @@ typedef void SSL_CTX;
 
 static const MI_Uint32 _MAGIC = 0xE0BB5FD3;
 static const MI_Uint32 MAX_HEADER_SIZE     = 4 * 1024;
-static const MI_Uint32 INITIAL_BUFFER_SIZE = 4 * 1024;
 static const size_t HTTP_MAX_CONTENT = 1024 * 1024;
 
+/* larger XML content is received in pages of about this size */
+static const size_t HTTP_CONTENT_PAGE_SIZE = 64 * 1024;
+
+/* receive buffers are carved from slabs of this many */
+#define HTTP_BUFFERS_PER_SLAB 16
+
+/* slab header size; keeps buffers aligned as list entries need */
+#define HTTP_BUFFER_SLAB_HEADER_SIZE 64
+
+/*
+    Header receive buffers (MAX_HEADER_SIZE each) shared by the connections
+    of a server. A connection takes one when a request starts to come in
+    and gives it back once the request is received, so idle keep-alive
+    connections hold none. Slabs are released with the last reference: the
+    server holds one and so does each connection, as connections may be
+    closed after the server is deleted.
+*/
+typedef struct _HttpBufferPool
+{
+    SListHead freeList;         /* free buffers */
+    SListHead slabs;            /* memory the buffers are carved from */
+    volatile ptrdiff_t refs;
+}
+HttpBufferPool;
+
+typedef struct _HttpIOThread {
+    /* selector owning this thread's listeners and connections */
+    Selector selector;
+    MI_Boolean selectorInitialized;
+
+    Thread thread;
+    MI_Boolean threadStarted;
+
+    Http *http;
+} HttpIOThread;
+
 struct _Http {
     MI_Uint32 magic;
     Selector internalSelector;
@@ -67,6 +107,15 @@ struct _Http {
     /* options: timeouts etc */
     HttpOptions options;
     MI_Boolean internalSelectorUsed;
+
+    /* dedicated I/O threads (options.ioThreads of them); when present,
+       listeners and connections live on their selectors only */
+    HttpIOThread *ioThreads;
+    MI_Uint32 ioThreadsCount;
+    volatile ptrdiff_t ioThreadsStopping;
+
+    /* receive buffers of connections */
+    HttpBufferPool *bufferPool;
 };
 
 typedef struct _Http_Listener_SocketData {
@@ -88,6 +137,9 @@ typedef struct _Http_SR_SocketData {
 
     Http *http;
 
+    /* selector (and so I/O thread) that owns this connection */
+    Selector *selector;
+
     /* ssl part */
     SSL *ssl;
     MI_Boolean reverseOperations;   /*reverse read/write Events/Handlers */
@@ -98,17 +150,31 @@ typedef struct _Http_SR_SocketData {
     MI_Boolean requestIsBeingProcessed;
 
     /* receiving data */
-    char *recvBuffer;
-    size_t recvBufferSize;
+    char *recvBuffer;           /* from bufferPool, while a request is received */
+    HttpBufferPool *bufferPool;
     size_t receivedSize;
     Http_RecvState recvingState;
     HttpHeaders recvHeaders;
     Page *recvPage;
+    Page *recvPages;            /* full content pages before recvPage */
+    Page **recvPagesTail;
+    size_t recvPageCapacity;    /* non-zero while content is received in pages */
+    size_t recvPageOffset;      /* content offset of recvPage */
+    size_t recvCut;             /* content offset recvPage can be cut at */
+    XML_Reader *recvReader;     /* finds recvCut; NULL once it failed */
     HttpRequestMsg *request;    // request msg with the request page
 
     /* sending part */
     Page *sendPage;
     Page *sendHeader;
+    MI_Boolean sendHeaderHasContent;    /* sendHeader also carries sendPage content */
+    MI_Boolean sendChunked;             /* sendPage is a list, sent one chunk per page */
+    MI_Boolean sendGather;              /* sendPage is a list of HttpContentRef pages */
+    char sendChunkHeader[16];           /* "<size>\r\n" of the first chunk being sent */
+    HttpContentEncoding acceptEncoding; /* coding accepted by the client (Accept-Encoding) */
+    HttpContentEncoding sendEncoding;   /* coding applied to sendPage content */
+    HttpCompressStream* sendCompressor; /* compresses chunks as they are sent */
+    size_t sendCompressed;              /* sendPage pages compressed already */
     size_t sentSize;
     Http_RecvState sendingState;
 
@@ -880,7 +880,7 @@ static void _SendAuthResponse(Http_SR_SocketData * sendSock, const char *pRespon
 
     if (sendSock->recvPage)
     {
-        PAL_Free(sendSock->recvPage);
+        HttpRequestMsg_FreePages(sendSock->recvPage);
         sendSock->sendPage = 0;
     }
     // Force it into read state so we can get the next header
@@ -246,6 +246,15 @@ static MI_Boolean _getHeaderField(
         handler->contentEnd = -1;
         handler->contentTotalLength = -1;
     }
+    else if (nameHashCode == _HashCode('c','g',16) && /*Content-Encoding*/
+        Strcasecmp(name, "Content-Encoding") == 0)
+    {
+        if (!HttpCompress_ParseContentEncoding(value, &handler->recvEncoding))
+        {
+            LOGE2((ZT("_getHeaderField - Unsupported Content-Encoding: %s"), value));
+            return MI_FALSE;
+        }
+    }
     else if (nameHashCode == _HashCode('c','e',13) && /*Content-Range*/
         Strcasecmp(name, "Content-Range") == 0)
     {
@@ -626,6 +635,8 @@ static Http_CallbackResult _ReadHeader(
     currentLine = buf;
     data = buf + index + 1; /* pointer to data in case we got some */
 
+    handler->recvEncoding = HTTP_CONTENT_ENCODING_IDENTITY;
+
     if (!_getRequestLine(handler, &currentLine))
     {
         LOGE2((ZT("_ReadHeader - Cannot find request line in HTTP header")));
@@ -646,6 +657,18 @@ static Http_CallbackResult _ReadHeader(
     {
         handler->receivedSize -= index + 1;
 
+        /* compressed chunks are decompressed one by one as they come */
+        if (handler->recvEncoding != HTTP_CONTENT_ENCODING_IDENTITY)
+        {
+            if (handler->recvDecompressor)
+                HttpCompressStream_Delete(handler->recvDecompressor);
+
+            handler->recvDecompressor = HttpCompressStream_New(handler->recvEncoding, MI_FALSE, 0);
+
+            if (!handler->recvDecompressor)
+                return PRT_RETURN_FALSE;
+        }
+
         /* Invoke user's callback with header information */
         {
             HttpClient* self = (HttpClient*)handler->base.data;
@@ -857,6 +880,24 @@ static Http_CallbackResult _ReadData(
         }
 #endif
     }
+
+    if (handler->recvEncoding != HTTP_CONTENT_ENCODING_IDENTITY && !handler->headVerb)
+    {
+        HttpCompressStream* stream = HttpCompressStream_New(handler->recvEncoding, MI_FALSE, 0);
+        MI_Boolean ok = stream && HttpCompressStream_Page(stream, &handler->recvPage, MI_TRUE);
+
+        if (stream)
+            HttpCompressStream_Delete(stream);
+
+        if (!ok)
+        {
+            LOGE2((ZT("_ReadData - Cannot decompress %s content"), HttpCompress_EncodingName(handler->recvEncoding)));
+            return PRT_RETURN_FALSE;
+        }
+
+        handler->contentLength = handler->recvPage->u.s.size;
+    }
+
     if (handler->isAuthorized) 
     {
         /* Invoke user's callback with header information */
@@ -906,6 +947,23 @@ static Http_CallbackResult _ReadData(
     return PRT_CONTINUE;
 }
 
+/* Replaces the received chunk by its decompressed data, if the content 
+   is compressed */
+static MI_Boolean _DecompressChunk(
+    HttpClient_SR_SocketData* handler)
+{
+    if (!handler->recvDecompressor)
+        return MI_TRUE;
+
+    if (!HttpCompressStream_Page(handler->recvDecompressor, &handler->recvPage, MI_FALSE))
+    {
+        LOGE2((ZT("_DecompressChunk - Cannot decompress %s content"), HttpCompress_EncodingName(handler->recvEncoding)));
+        return MI_FALSE;
+    }
+
+    return MI_TRUE;
+}
+
 static Http_CallbackResult _ReadChunkHeader(
     HttpClient_SR_SocketData* handler)
 {
@@ -995,6 +1053,18 @@ static Http_CallbackResult _ReadChunkHeader(
     {
         /* last chunk received */
 
+        if (handler->recvDecompressor)
+        {
+            MI_Boolean ended = HttpCompressStream_Ended(handler->recvDecompressor);
+
+            HttpCompressStream_Delete(handler->recvDecompressor);
+            handler->recvDecompressor = NULL;
+
+            /* content is cut short */
+            if (!ended)
+                return PRT_RETURN_FALSE;
+        }
+
         /* Invoke user's callback with header information */
         {
             HttpClient* self = (HttpClient*)handler->base.data;
@@ -1053,6 +1123,9 @@ static Http_CallbackResult _ReadChunkHeader(
         /* copy page size to page */
         memcpy(handler->recvPage + 1, data, chunkSize+2);
 
+        if (!_DecompressChunk(handler))
+            return PRT_RETURN_FALSE;
+
         /* notify user */
         {
             HttpClient* self = (HttpClient*)handler->base.data;
@@ -1120,6 +1193,9 @@ static Http_CallbackResult _ReadChunkData(
     if (handler->receivedSize != (size_t)(handler->recvPage->u.s.size + 2 /* CR-LF */))
         return PRT_RETURN_TRUE;
 
+    if (!_DecompressChunk(handler))
+        return PRT_RETURN_FALSE;
+
     /* Invoke user's callback with header information */
     {
         HttpClient* self = (HttpClient*)handler->base.data;
@@ -1323,7 +1399,7 @@ Http_CallbackResult _WriteClientData(
     return PRT_CONTINUE;
 }
 
-static MI_Boolean _RequestCallbackRead(
+static MI_Boolean _RequestCallbackReadStep(
     HttpClient_SR_SocketData* handler)
 {
     switch (_ReadHeader(handler))
@@ -1365,6 +1441,22 @@ static MI_Boolean _RequestCallbackRead(
     return MI_TRUE;
 }
 
+static MI_Boolean _RequestCallbackRead(
+    HttpClient_SR_SocketData* handler)
+{
+    /* ssl reads whole records from the socket: data of a record beyond what
+       was asked for (such as the end of chunked content) is kept decrypted 
+       by ssl, where the selector does not see it */
+    do
+    {
+        if (!_RequestCallbackReadStep(handler))
+            return MI_FALSE;
+    }
+    while (handler->ssl && SSL_pending(handler->ssl) > 0);
+
+    return MI_TRUE;
+}
+
 static MI_Boolean _RequestCallbackWrite(
     HttpClient_SR_SocketData* handler)
 {
@@ -1516,6 +1608,18 @@ static MI_Boolean _RequestCallback(
                 self->connector->password = NULL;
             }
 
+            if (self->connector->hostname)
+            {
+                PAL_Free(self->connector->hostname);
+                self->connector->hostname = NULL;
+            }
+
+            if (self->connector->hostHeader)
+            {
+                PAL_Free(self->connector->hostHeader);
+                self->connector->hostHeader = NULL;
+            }
+
             self->connector = NULL;
         }
 
@@ -1527,6 +1631,9 @@ static MI_Boolean _RequestCallback(
         if (handler->recvPage)
             PAL_Free(handler->recvPage);
 
+        if (handler->recvDecompressor)
+            HttpCompressStream_Delete(handler->recvDecompressor);
+
         if (handler->sendPage)
             PAL_Free(handler->sendPage);
 
@@ -1936,7 +2043,16 @@ Page* _CreateHttpHeader(
     static const char CONNECTION_KEEPALIVE[] = "Keep-Alive";
     static const char CONNECTION_KEEPALIVE_LEN = MI_COUNT(CONNECTION_KEEPALIVE)-1;
 
+    static const char ACCEPT_ENCODING_HEADER[] = HTTP_ACCEPT_ENCODING_HEADER;
+    static const char ACCEPT_ENCODING_HEADER_LEN = MI_COUNT(ACCEPT_ENCODING_HEADER)-1;
+
+    /* responses may come compressed if we can decompress them */
+    MI_Boolean acceptEncoding = HttpCompress_IsSupported();
+
     pageSize += Strlen(hostHeader) + 2;
+
+    if (acceptEncoding)
+        pageSize += ACCEPT_ENCODING_HEADER_LEN + 2;
     if (extraHeaders)
     {
         int i;
@@ -2023,6 +2139,16 @@ Page* _CreateHttpHeader(
     memcpy(p, "\r\n", 2);
     p += 2;
 
+    if (acceptEncoding)
+    {
+        // Accept-Encoding: gzip, deflate\r\n
+        memcpy(p, ACCEPT_ENCODING_HEADER, ACCEPT_ENCODING_HEADER_LEN);
+        p += ACCEPT_ENCODING_HEADER_LEN;
+
+        memcpy(p, "\r\n", 2);
+        p += 2;
+    }
+
     pageSize -= (p-((char*)(page+1)));
 
     if (contentType)
@@ -3086,6 +3212,7 @@ MI_Result HttpClient_StartRequestV2(
     self->connector->sentSize = 0;
     self->connector->sendingState = RECV_STATE_HEADER;
     self->connector->base.mask |= SELECTOR_WRITE;
+    Selector_UpdateHandler(self->selector, &self->connector->base, MI_FALSE);
 
     _RequestCallbackWrite(self->connector);
 
@@ -3129,6 +3256,7 @@ MI_Result HttpClient_SetTimeout(
     /* create header page */
     self->connector->timeoutUsec = timeoutUsec;
     self->connector->base.fireTimeoutAt = currentTimeUsec + self->connector->timeoutUsec;
+    Selector_UpdateHandler(self->selector, &self->connector->base, MI_FALSE);
 
     return MI_RESULT_OK;
 }
@@ -3143,7 +3271,7 @@ MI_Result HttpClient_WakeUpSelector(HttpClient *self, MI_Uint64 whenTime)
     if (self->connector)
     {
         self->connector->base.fireTimeoutAt = whenTime;
-        Selector_Wakeup(self->selector, MI_TRUE );
+        Selector_UpdateHandler(self->selector, &self->connector->base, MI_TRUE );
     }
     return MI_RESULT_OK;
 }
@@ -10,6 +10,8 @@
 #ifndef _omi_http_httpclient_private_h
 #define _omi_http_httpclient_private_h
 
+#include "httpcompress.h"
+
 /*
 **==============================================================================
 **
@@ -55,6 +57,8 @@ typedef struct _HttpClient_SR_SocketData {
     MI_Sint64 contentEnd;
     MI_Sint64 contentTotalLength;
     Page *recvPage;
+    HttpContentEncoding recvEncoding;       /* Content-Encoding of the response */
+    HttpCompressStream* recvDecompressor;   /* decompresses chunks as they come */
 
     /* flag for a response from a HEAD request */
     MI_Boolean headVerb;
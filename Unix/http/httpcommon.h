@@ -123,6 +123,18 @@ typedef struct _HttpOptions
 
     /* Enable tracing of HTTP input and output */
     MI_Boolean enableTracing;
+
+    /* Number of dedicated I/O threads serving connections (each with its own
+    selector and listener sockets); 0 serves everything on the server's
+    selector */
+    MI_Uint32 ioThreads;
+
+    /* gzip/deflate compression level (1-9) of response content for clients
+    that accept it; 0 disables compression */
+    MI_Uint32 compressionLevel;
+
+    /* Content smaller than this is not compressed */
+    MI_Uint32 compressionThreshold;
 }
 HttpOptions;
 
@@ -143,8 +155,13 @@ SSL_Options;
 
 //------------------------------------------------------------------------------------------------------------------
 
+/* fast compression: most of the gain on xml for little cpu */
+#define HTTP_DEFAULT_COMPRESSION_LEVEL 1
+#define HTTP_DEFAULT_COMPRESSION_THRESHOLD 1024
+
 /* 60 sec timeout */
-#define DEFAULT_HTTP_OPTIONS  { (60 * 1000000), MI_FALSE }
+#define DEFAULT_HTTP_OPTIONS  { (60 * 1000000), MI_FALSE, 0, \
+    HTTP_DEFAULT_COMPRESSION_LEVEL, HTTP_DEFAULT_COMPRESSION_THRESHOLD }
 
 MI_Result Http_New_Server(
     _Out_       Http**              selfOut,
@@ -0,0 +1,489 @@
+/*
+**==============================================================================
+**
+** Copyright (c) Microsoft Corporation. All rights reserved. See file LICENSE
+** for license information.
+**
+**==============================================================================
+*/
+
+#include <string.h>
+#include <pal/strings.h>
+#include "httpcompress.h"
+
+#if defined(CONFIG_HAVE_ZLIB)
+# include <zlib.h>
+#endif
+
+/* page data is limited by the 31-bit size field */
+#define HTTPCOMPRESS_MAX_PAGE_SIZE 0x7FFFFFFF
+
+/*
+**==============================================================================
+**
+** Coding names
+**
+**==============================================================================
+*/
+
+static MI_Boolean _IsToken(
+    const char* s,
+    size_t len,
+    const char* token)
+{
+    return Strlen(token) == len && Strncasecmp(s, token, len) == 0;
+}
+
+static MI_Boolean _IsSpace(char c)
+{
+    return c == ' ' || c == '\t';
+}
+
+/* Gets next element of a comma-separated list of codings with optional
+   parameters ("gzip;q=0.5"); refused is set for a q value of 0 */
+static MI_Boolean _NextCoding(
+    _Inout_ const char** list,
+    _Out_   const char** name,
+    _Out_   size_t* nameLen,
+    _Out_   MI_Boolean* refused)
+{
+    const char* p = *list;
+    const char* end;
+
+    while (_IsSpace(*p) || *p == ',')
+        p++;
+
+    if (!*p)
+        return MI_FALSE;
+
+    *name = p;
+
+    while (*p && *p != ',' && *p != ';' && !_IsSpace(*p))
+        p++;
+
+    *nameLen = p - *name;
+    *refused = MI_FALSE;
+
+    /* parameters */
+    end = p;
+    while (*end && *end != ',')
+        end++;
+
+    while (p < end)
+    {
+        if ((*p == 'q' || *p == 'Q') && p + 1 < end && p[1] == '=')
+        {
+            const char* q = p + 2;
+
+            /* zero: "0", "0.", "0.0", ... */
+            if (*q == '0')
+            {
+                q++;
+                if (q < end && *q == '.')
+                {
+                    q++;
+                    while (q < end && *q == '0')
+                        q++;
+                }
+                while (q < end && _IsSpace(*q))
+                    q++;
+
+                *refused = (q == end || *q == ';');
+            }
+            break;
+        }
+        p++;
+    }
+
+    *list = end;
+    return MI_TRUE;
+}
+
+HttpContentEncoding HttpCompress_ParseAcceptEncoding(
+    _In_z_      const char*             value)
+{
+    const char* p = value;
+    const char* name;
+    size_t len;
+    MI_Boolean refused;
+    MI_Boolean gzip = MI_FALSE;
+    MI_Boolean deflate = MI_FALSE;
+
+    if (!HttpCompress_IsSupported() || !value)
+        return HTTP_CONTENT_ENCODING_IDENTITY;
+
+    while (_NextCoding(&p, &name, &len, &refused))
+    {
+        if (refused)
+            continue;
+
+        if (_IsToken(name, len, "gzip") || _IsToken(name, len, "x-gzip") ||
+            _IsToken(name, len, "*"))
+        {
+            gzip = MI_TRUE;
+        }
+        else if (_IsToken(name, len, "deflate"))
+        {
+            deflate = MI_TRUE;
+        }
+    }
+
+    if (gzip)
+        return HTTP_CONTENT_ENCODING_GZIP;
+
+    if (deflate)
+        return HTTP_CONTENT_ENCODING_DEFLATE;
+
+    return HTTP_CONTENT_ENCODING_IDENTITY;
+}
+
+MI_Boolean HttpCompress_ParseContentEncoding(
+    _In_z_      const char*             value,
+    _Out_       HttpContentEncoding*    encoding)
+{
+    const char* p = value;
+    const char* name;
+    size_t len;
+    MI_Boolean refused;
+
+    *encoding = HTTP_CONTENT_ENCODING_IDENTITY;
+
+    if (!_NextCoding(&p, &name, &len, &refused))
+        return MI_TRUE;
+
+    /* more than one coding applied is not supported */
+    if (_NextCoding(&p, &name, &len, &refused))
+        return MI_FALSE;
+
+    if (_IsToken(name, len, "identity"))
+        return MI_TRUE;
+
+    if (!HttpCompress_IsSupported())
+        return MI_FALSE;
+
+    if (_IsToken(name, len, "gzip") || _IsToken(name, len, "x-gzip"))
+    {
+        *encoding = HTTP_CONTENT_ENCODING_GZIP;
+        return MI_TRUE;
+    }
+
+    if (_IsToken(name, len, "deflate"))
+    {
+        *encoding = HTTP_CONTENT_ENCODING_DEFLATE;
+        return MI_TRUE;
+    }
+
+    return MI_FALSE;
+}
+
+const char* HttpCompress_EncodingName(
+                HttpContentEncoding     encoding)
+{
+    switch (encoding)
+    {
+    case HTTP_CONTENT_ENCODING_GZIP:
+        return "gzip";
+    case HTTP_CONTENT_ENCODING_DEFLATE:
+        return "deflate";
+    default:
+        return "identity";
+    }
+}
+
+/*
+**==============================================================================
+**
+** Streams
+**
+**==============================================================================
+*/
+
+#if defined(CONFIG_HAVE_ZLIB)
+
+struct _HttpCompressStream
+{
+    z_stream z;
+    MI_Boolean compress;
+    MI_Boolean ended;
+};
+
+MI_Boolean HttpCompress_IsSupported()
+{
+    return MI_TRUE;
+}
+
+HttpCompressStream* HttpCompressStream_New(
+                HttpContentEncoding     encoding,
+                MI_Boolean              compress,
+                int                     level)
+{
+    HttpCompressStream* self;
+    int r;
+
+    if (encoding != HTTP_CONTENT_ENCODING_GZIP &&
+        encoding != HTTP_CONTENT_ENCODING_DEFLATE)
+        return NULL;
+
+    self = (HttpCompressStream*)PAL_Calloc(1, sizeof(HttpCompressStream));
+
+    if (!self)
+        return NULL;
+
+    self->compress = compress;
+
+    if (compress)
+    {
+        /* window bits + 16: gzip wrapper; otherwise zlib wrapper, which is
+           what 'deflate' stands for in http */
+        r = deflateInit2(&self->z,
+            level < 1 ? 1 : (level > 9 ? 9 : level),
+            Z_DEFLATED,
+            encoding == HTTP_CONTENT_ENCODING_GZIP ? MAX_WBITS + 16 : MAX_WBITS,
+            8,
+            Z_DEFAULT_STRATEGY);
+    }
+    else
+    {
+        /* window bits + 32: either wrapper is detected */
+        r = inflateInit2(&self->z, MAX_WBITS + 32);
+    }
+
+    if (r != Z_OK)
+    {
+        PAL_Free(self);
+        return NULL;
+    }
+
+    return self;
+}
+
+void HttpCompressStream_Delete(
+    _In_        HttpCompressStream*     self)
+{
+    if (self->compress)
+        deflateEnd(&self->z);
+    else
+        inflateEnd(&self->z);
+
+    PAL_Free(self);
+}
+
+MI_Boolean HttpCompressStream_DataV(
+    _In_        HttpCompressStream*     self,
+    _In_reads_(count) const IOVec*      data,
+                size_t                  count,
+                MI_Boolean              last,
+    _Out_       Page**                  page)
+{
+    Page* out;
+    size_t capacity;
+    size_t size = 0;
+    size_t i;
+    int r;
+
+    for (i = 0; i < count; i++)
+        size += data[i].len;
+
+    if (self->compress)
+        capacity = deflateBound(&self->z, (uLong)size) + 16;
+    else
+        capacity = size * 4 + 256;
+
+    if (capacity > HTTPCOMPRESS_MAX_PAGE_SIZE)
+        capacity = HTTPCOMPRESS_MAX_PAGE_SIZE;
+
+    out = (Page*)PAL_Malloc(sizeof(Page) + capacity + 1);
+
+    if (!out)
+        return MI_FALSE;
+
+    self->z.next_out = (Bytef*)(out + 1);
+    self->z.avail_out = (uInt)capacity;
+
+    i = 0;
+    do
+    {
+        /* pieces before the last one are taken without a flush */
+        int flush = i + 1 < count ? Z_NO_FLUSH : last ? Z_FINISH : Z_SYNC_FLUSH;
+
+        self->z.next_in = count ? (Bytef*)data[i].ptr : NULL;
+        self->z.avail_in = count ? (uInt)data[i].len : 0;
+
+        for (;;)
+        {
+            if (self->compress)
+            {
+                r = deflate(&self->z, flush);
+            }
+            else if (self->ended)
+            {
+                /* data after the end of the stream is ignored */
+                r = Z_STREAM_END;
+            }
+            else
+            {
+                r = inflate(&self->z, Z_NO_FLUSH);
+            }
+
+            if (r == Z_STREAM_END)
+            {
+                self->ended = MI_TRUE;
+                break;
+            }
+
+            if (r != Z_OK && r != Z_BUF_ERROR)
+                goto failed;
+
+            /* all input is processed (and flushed) once there is output 
+               space left; finishing a stream ends with Z_STREAM_END */
+            if (self->z.avail_out && !(self->compress && flush == Z_FINISH))
+                break;
+
+            if (!self->z.avail_out)
+            {
+                size_t used = capacity;
+                Page* bigger;
+
+                if (capacity == HTTPCOMPRESS_MAX_PAGE_SIZE)
+                    goto failed;
+
+                capacity = capacity > HTTPCOMPRESS_MAX_PAGE_SIZE / 2 ?
+                    HTTPCOMPRESS_MAX_PAGE_SIZE : capacity * 2;
+                bigger = (Page*)PAL_Realloc(out, sizeof(Page) + capacity + 1);
+
+                if (!bigger)
+                    goto failed;
+
+                out = bigger;
+                self->z.next_out = (Bytef*)(out + 1) + used;
+                self->z.avail_out = (uInt)(capacity - used);
+            }
+        }
+    }
+    while (++i < count);
+
+    if (last && !self->ended)
+        goto failed;
+
+    memset(out, 0, sizeof(Page));
+    out->u.s.size = (unsigned int)(capacity - self->z.avail_out);
+    ((char*)(out + 1))[out->u.s.size] = 0;
+
+    *page = out;
+    return MI_TRUE;
+
+failed:
+    PAL_Free(out);
+    return MI_FALSE;
+}
+
+MI_Boolean HttpCompressStream_Data(
+    _In_        HttpCompressStream*     self,
+    _In_reads_bytes_(size) const void*  data,
+                size_t                  size,
+                MI_Boolean              last,
+    _Out_       Page**                  page)
+{
+    IOVec piece;
+
+    piece.ptr = (void*)data;
+    piece.len = size;
+    return HttpCompressStream_DataV(self, &piece, 1, last, page);
+}
+
+MI_Boolean HttpCompressStream_Page(
+    _In_        HttpCompressStream*     self,
+    _Inout_     Page**                  page,
+                MI_Boolean              last)
+{
+    Page* in = *page;
+    Page* out;
+
+    if (!HttpCompressStream_Data(self, in + 1, in->u.s.size, last, &out))
+        return MI_FALSE;
+
+    out->u.s.next = in->u.s.next;
+    PAL_Free(in);
+    *page = out;
+    return MI_TRUE;
+}
+
+MI_Boolean HttpCompressStream_Ended(
+    _In_        HttpCompressStream*     self)
+{
+    return self->ended;
+}
+
+#else /* defined(CONFIG_HAVE_ZLIB) */
+
+MI_Boolean HttpCompress_IsSupported()
+{
+    return MI_FALSE;
+}
+
+HttpCompressStream* HttpCompressStream_New(
+                HttpContentEncoding     encoding,
+                MI_Boolean              compress,
+                int                     level)
+{
+    MI_UNUSED(encoding);
+    MI_UNUSED(compress);
+    MI_UNUSED(level);
+    return NULL;
+}
+
+void HttpCompressStream_Delete(
+    _In_        HttpCompressStream*     self)
+{
+    MI_UNUSED(self);
+}
+
+MI_Boolean HttpCompressStream_Data(
+    _In_        HttpCompressStream*     self,
+    _In_reads_bytes_(size) const void*  data,
+                size_t                  size,
+                MI_Boolean              last,
+    _Out_       Page**                  page)
+{
+    MI_UNUSED(self);
+    MI_UNUSED(data);
+    MI_UNUSED(size);
+    MI_UNUSED(last);
+    *page = NULL;
+    return MI_FALSE;
+}
+
+MI_Boolean HttpCompressStream_DataV(
+    _In_        HttpCompressStream*     self,
+    _In_reads_(count) const IOVec*      data,
+                size_t                  count,
+                MI_Boolean              last,
+    _Out_       Page**                  page)
+{
+    MI_UNUSED(self);
+    MI_UNUSED(data);
+    MI_UNUSED(count);
+    MI_UNUSED(last);
+    *page = NULL;
+    return MI_FALSE;
+}
+
+MI_Boolean HttpCompressStream_Page(
+    _In_        HttpCompressStream*     self,
+    _Inout_     Page**                  page,
+                MI_Boolean              last)
+{
+    MI_UNUSED(self);
+    MI_UNUSED(page);
+    MI_UNUSED(last);
+    return MI_FALSE;
+}
+
+MI_Boolean HttpCompressStream_Ended(
+    _In_        HttpCompressStream*     self)
+{
+    MI_UNUSED(self);
+    return MI_FALSE;
+}
+
+#endif /* defined(CONFIG_HAVE_ZLIB) */
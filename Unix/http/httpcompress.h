@@ -0,0 +1,109 @@
+/*
+**==============================================================================
+**
+** Copyright (c) Microsoft Corporation. All rights reserved. See file LICENSE
+** for license information.
+**
+**==============================================================================
+*/
+
+#ifndef _omi_http_httpcompress_h
+#define _omi_http_httpcompress_h
+
+#include "config.h"
+#include <common.h>
+#include <base/batch.h>
+#include <sock/sock.h>
+
+BEGIN_EXTERNC
+
+/* Content codings of http content (Content-Encoding/Accept-Encoding) */
+typedef enum _HttpContentEncoding
+{
+    HTTP_CONTENT_ENCODING_IDENTITY = 0,
+    HTTP_CONTENT_ENCODING_GZIP,
+    HTTP_CONTENT_ENCODING_DEFLATE
+}
+HttpContentEncoding;
+
+/* Accept-Encoding value sent by the client side */
+#define HTTP_ACCEPT_ENCODING_HEADER "Accept-Encoding: gzip, deflate"
+
+/* Whether any coding besides identity is available (built with zlib) */
+MI_Boolean HttpCompress_IsSupported();
+
+/* Returns the coding to use for a response, given the Accept-Encoding
+   value of the request: gzip, then deflate, if not refused by q=0;
+   identity if none of them is acceptable */
+HttpContentEncoding HttpCompress_ParseAcceptEncoding(
+    _In_z_      const char*             value);
+
+/* Parses a Content-Encoding value; MI_FALSE if the coding is not supported */
+MI_Boolean HttpCompress_ParseContentEncoding(
+    _In_z_      const char*             value,
+    _Out_       HttpContentEncoding*    encoding);
+
+/* Name of the coding as used in http headers */
+const char* HttpCompress_EncodingName(
+                HttpContentEncoding     encoding);
+
+/*
+    Compressing or decompressing stream; content is given page by page
+    (pages as used for http content: size in u.s.size, data follows the
+    page header).
+*/
+typedef struct _HttpCompressStream HttpCompressStream;
+
+/* level (1-9) is used for compression only; returns NULL if the coding
+   is not supported or no memory */
+HttpCompressStream* HttpCompressStream_New(
+                HttpContentEncoding     encoding,
+                MI_Boolean              compress,
+                int                     level);
+
+void HttpCompressStream_Delete(
+    _In_        HttpCompressStream*     self);
+
+/*
+    Replaces *page by a page with its compressed (decompressed) content;
+    u.s.next is preserved and the data is followed by a zero byte (not
+    counted in size). 'last' is set for the last page of the content:
+    compression finishes the stream; decompression fails if the stream
+    does not end with this page.
+
+    Compressed pages, except the last one, end at a flush point, so a
+    receiver can decompress all data of the pages it got so far.
+
+    On failure *page is left as it was.
+*/
+MI_Boolean HttpCompressStream_Page(
+    _In_        HttpCompressStream*     self,
+    _Inout_     Page**                  page,
+                MI_Boolean              last);
+
+/* Same for content that is not in a page (e.g. gathered content): *page
+   is set to a new page with the result */
+MI_Boolean HttpCompressStream_Data(
+    _In_        HttpCompressStream*     self,
+    _In_reads_bytes_(size) const void*  data,
+                size_t                  size,
+                MI_Boolean              last,
+    _Out_       Page**                  page);
+
+/* Same for content given in several pieces: they are compressed 
+   (decompressed) together into one page, flushed after the last piece
+   only */
+MI_Boolean HttpCompressStream_DataV(
+    _In_        HttpCompressStream*     self,
+    _In_reads_(count) const IOVec*      data,
+                size_t                  count,
+                MI_Boolean              last,
+    _Out_       Page**                  page);
+
+/* Whether decompression has reached the end of the compressed stream */
+MI_Boolean HttpCompressStream_Ended(
+    _In_        HttpCompressStream*     self);
+
+END_EXTERNC
+
+#endif /* _omi_http_httpcompress_h */
@@ -81,6 +81,14 @@ else
   OPENSSL_LIBOPT:=-L$(OPENSSLLIBDIR)
 endif
 
+##==============================================================================
+##
+## zlib (HTTP content compression; empty if not configured)
+##
+##==============================================================================
+
+ZLIB_LIBS=$(ZLIBLIBS)
+
 ##==============================================================================
 ##
 ## OBJDIRPATH -- resolve directory where objects will go.
@@ -161,23 +169,27 @@ endif
 CSHLIBFLAGS=$(shell $(BUILDTOOL) cshlibflags $(__CSHLIBOPTS))
 CSHLIBFLAGS+=$(shell $(BUILDTOOL) syslibs)
 CSHLIBFLAGS+=$(OPENSSL_LIBS)
+CSHLIBFLAGS+=$(ZLIB_LIBS)
 CSHLIBFLAGS+=$(EXPORTFLAGS)
 CSHLIBFLAGS+=$(LIBPATHFLAGS)
 
 CXXSHLIBFLAGS=$(shell $(BUILDTOOL) cxxshlibflags)
 CXXSHLIBFLAGS+=$(shell $(BUILDTOOL) syslibs)
 CXXSHLIBFLAGS+=$(OPENSSL_LIBS)
+CXXSHLIBFLAGS+=$(ZLIB_LIBS)
 CXXSHLIBFLAGS+=$(EXPORTFLAGS)
 CXXSHLIBFLAGS+=$(LIBPATHFLAGS)
 
 CPROGFLAGS=$(shell $(BUILDTOOL) cprogflags)
 CPROGFLAGS+=$(shell $(BUILDTOOL) syslibs)
 CPROGFLAGS+=$(OPENSSL_LIBS)
+CPROGFLAGS+=$(ZLIB_LIBS)
 CPROGFLAGS+=$(LIBPATHFLAGS)
 
 CXXPROGFLAGS=$(shell $(BUILDTOOL) cxxprogflags)
 CXXPROGFLAGS+=$(shell $(BUILDTOOL) syslibs)
 CXXPROGFLAGS+=$(OPENSSL_LIBS)
+CXXPROGFLAGS+=$(ZLIB_LIBS)
 CXXPROGFLAGS+=$(LIBPATHFLAGS)
 
 __DEPS=$(wildcard $(addprefix $(LIBDIR)/lib,$(addsuffix .*,$(LIBRARIES))))
@@ -71,6 +71,18 @@ PAL_INLINE int Shmem_Close(
 #endif
 }
 
+/* Removes the name of the shared memory; it stays mapped and open */
+PAL_INLINE int Shmem_Unlink(
+    _Inout_ Shmem* self)
+{
+#if defined(_MSC_VER)
+    PAL_UNUSED(self);
+    return 0;
+#else
+    return shm_unlink(self->shmname) == 0 ? 0 : -1;
+#endif
+}
+
 void* Shmem_Map(
     _Inout_ Shmem* self,
     _In_ ShmemAccess access,
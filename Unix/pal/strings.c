@@ -552,6 +552,62 @@ int ConvertWideCharToUtf8Windows(
 
 #else
 
+/* ASCII runs are checked and narrowed 8 and 16 characters at a time */
+#if defined(__GNUC__) && defined(__SSE2__) && (__WCHAR_MAX__ == 0x7fffffff)
+# include <emmintrin.h>
+# define STRINGS_UTF32_SSE2
+#endif
+
+/* Returns the number of leading ASCII characters of utf32 */
+static size_t _AsciiRunLength(
+            const Utf32Char* utf32,
+            size_t utf32Size)
+{
+    size_t pos = 0;
+
+#if defined(STRINGS_UTF32_SSE2)
+    const __m128i high = _mm_set1_epi32(~0x7F);
+    const __m128i zero = _mm_setzero_si128();
+
+    for (; pos + 8 <= utf32Size; pos += 8)
+    {
+        __m128i v = _mm_or_si128(
+            _mm_loadu_si128((const __m128i*)(utf32 + pos)),
+            _mm_loadu_si128((const __m128i*)(utf32 + pos + 4)));
+
+        if (_mm_movemask_epi8(_mm_cmpeq_epi32(_mm_and_si128(v, high), zero)) != 0xFFFF)
+            break;
+    }
+#endif
+
+    while (pos < utf32Size && (PAL_Uint32)utf32[pos] < 0x0080)
+        pos++;
+
+    return pos;
+}
+
+/* Copies ASCII characters of utf32 to utf8 */
+static void _NarrowAscii(
+            Utf8Char* utf8,
+            const Utf32Char* utf32,
+            size_t count)
+{
+    size_t pos = 0;
+
+#if defined(STRINGS_UTF32_SSE2)
+    for (; pos + 16 <= count; pos += 16)
+    {
+        const __m128i* src = (const __m128i*)(utf32 + pos);
+        __m128i lo = _mm_packs_epi32(_mm_loadu_si128(src), _mm_loadu_si128(src + 1));
+        __m128i hi = _mm_packs_epi32(_mm_loadu_si128(src + 2), _mm_loadu_si128(src + 3));
+
+        _mm_storeu_si128((__m128i*)(utf8 + pos), _mm_packus_epi16(lo, hi));
+    }
+#endif
+
+    for (; pos < count; pos++)
+        utf8[pos] = (Utf8Char)utf32[pos];
+}
 
 int ConvertWideCharToUtf8NonWindows(
             const Utf32Char* utf32,
@@ -560,10 +616,10 @@ int ConvertWideCharToUtf8NonWindows(
             Utf8Char* utf8,
             int utf8Size)
 {       
-    Utf32Char c;
+    PAL_Uint32 c;
     Utf8Char* p = utf8;    
     const Utf8Char INVALID_CHAR = '?';
-    const Utf32Char CODE_POINT_MAXIMUM_VALUE = 0x10FFFF;
+    const PAL_Uint32 CODE_POINT_MAXIMUM_VALUE = 0x10FFFF;
     // turn off the ASCII-only code for the first pass
     size_t firstNonAsciiChar = utf8 == NULL ? 0 : (firstNonAscii ? *firstNonAscii : 0);
     size_t pos = 0;
@@ -571,9 +627,10 @@ int ConvertWideCharToUtf8NonWindows(
     PAL_UNUSED(utf8Size);
     
     // do the ASCII-only conversion for the beginning characters on the second pass
-    for (pos = 0; pos < firstNonAsciiChar; pos++)
+    if (firstNonAsciiChar)
     {
-        *p++ = (Utf8Char)*(utf32 + pos);
+        _NarrowAscii(p, utf32, firstNonAsciiChar);
+        p += firstNonAsciiChar;
     }
 
     // If this is the first pass or firstNonAsciiChar < utf32Size, handle the
@@ -584,12 +641,15 @@ int ConvertWideCharToUtf8NonWindows(
         *firstNonAscii = utf32Size;
     for (pos = firstNonAsciiChar; pos < utf32Size; pos++)
     {
-        c = *(utf32 + pos);
+        c = (PAL_Uint32)*(utf32 + pos);
         if (c < 0x0080)
-        {                               // an ASCII character
+        {                               // a run of ASCII characters
+            size_t run = _AsciiRunLength(utf32 + pos, utf32Size - pos);
+
             if (utf8 != NULL)
-                *p = (Utf8Char)c;
-            p++;
+                _NarrowAscii(p, utf32 + pos, run);
+            p += run;
+            pos += run - 1;
         }
         else
         {
@@ -608,7 +668,7 @@ int ConvertWideCharToUtf8NonWindows(
                 }
                 p += 2;
             }
-            else if (c <= 0x00010000)
+            else if (c < 0x00010000)
             {                           // a 3-byte character
                 if (utf8 != NULL)
                 {
@@ -656,4 +716,119 @@ int ConvertWideCharToMultiByte(
     return ConvertWideCharToUtf8NonWindows(utf32, utf32Size, firstNonAscii, utf8, utf8Size);
 #endif
 }
+
+/*----------------------------------------------------------------------------*/
+/**
+Convert a UTF-8 string to a wide-character string in one pass
+
+A character never takes fewer bytes in UTF-8 than characters in the result,
+so a buffer of utf8Size characters is always big enough. Invalid or
+truncated sequences are converted to '?' byte by byte.
+
+\param [in]     utf8      the UTF-8 string
+\param [in]     utf8Size  the number of bytes in the string
+\param [out]    utf32     the result; room for utf8Size characters
+\returns        the number of characters written
+*/
+size_t ConvertMultiByteToWideChar(
+            const Utf8Char* utf8,
+            size_t utf8Size,
+            Utf32Char* utf32)
+{
+#if defined(_MSC_VER)
+    return (size_t)MultiByteToWideChar(CP_UTF8, 0, utf8, (int)utf8Size, utf32, (int)utf8Size);
+#else
+    const unsigned char* s = (const unsigned char*)utf8;
+    const unsigned char* end = s + utf8Size;
+    Utf32Char* p = utf32;
+    const Utf32Char INVALID_CHAR = '?';
+
+    while (s != end)
+    {
+        PAL_Uint32 c = *s;
+        size_t n;
+        size_t i;
+
+        if (c < 0x80)
+        {
+#if defined(STRINGS_UTF32_SSE2)
+            /* widen runs of 16 ASCII characters at once */
+            while (end - s >= 16)
+            {
+                __m128i v = _mm_loadu_si128((const __m128i*)s);
+                __m128i zero = _mm_setzero_si128();
+                __m128i lo, hi;
+
+                if (_mm_movemask_epi8(v))
+                    break;
+
+                lo = _mm_unpacklo_epi8(v, zero);
+                hi = _mm_unpackhi_epi8(v, zero);
+                _mm_storeu_si128((__m128i*)p, _mm_unpacklo_epi16(lo, zero));
+                _mm_storeu_si128((__m128i*)(p + 4), _mm_unpackhi_epi16(lo, zero));
+                _mm_storeu_si128((__m128i*)(p + 8), _mm_unpacklo_epi16(hi, zero));
+                _mm_storeu_si128((__m128i*)(p + 12), _mm_unpackhi_epi16(hi, zero));
+                s += 16;
+                p += 16;
+            }
+
+            if (s == end)
+                break;
+
+            c = *s;
+
+            if (c < 0x80)
+#endif
+            {
+                *p++ = (Utf32Char)c;
+                s++;
+                continue;
+            }
+        }
+
+        if (c >= 0xC2 && c <= 0xDF)
+        {
+            n = 1;
+            c &= 0x1F;
+        }
+        else if (c >= 0xE0 && c <= 0xEF)
+        {
+            n = 2;
+            c &= 0x0F;
+        }
+        else if (c >= 0xF0 && c <= 0xF4)
+        {
+            n = 3;
+            c &= 0x07;
+        }
+        else
+        {
+            n = 0;
+        }
+
+        for (i = 1; n && i <= n; i++)
+        {
+            if (s + i == end || (s[i] & 0xC0) != 0x80)
+                n = 0;
+            else
+                c = (c << 6) | (s[i] & 0x3F);
+        }
+
+        /* overlong forms, surrogates and values above the maximum */
+        if (n == 0 ||
+            (n == 2 && (c < 0x800 || (c >= 0xD800 && c <= 0xDFFF))) ||
+            (n == 3 && (c < 0x10000 || c > 0x10FFFF)))
+        {
+            *p++ = INVALID_CHAR;
+            s++;
+            continue;
+        }
+
+        *p++ = (Utf32Char)c;
+        s += n + 1;
+    }
+
+    return (size_t)(p - utf32);
+#endif
+}
 #endif
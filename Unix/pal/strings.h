@@ -956,6 +956,11 @@ int ConvertWideCharToMultiByte(
             size_t* firstNonAscii,
             Utf8Char* utf8,
             int utf8Size);
+
+size_t ConvertMultiByteToWideChar(
+            const Utf8Char* utf8,
+            size_t utf8Size,
+            Utf32Char* utf32);
 #endif
 
 PAL_INLINE char *
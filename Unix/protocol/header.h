@@ -30,10 +30,25 @@ BEGIN_EXTERNC
 
 #define PROTOCOL_MAGIC 0xB1A87E2F
 
-#define PROTOCOL_VERSION CONFIG_VERSION_MASK
+/* Revision of the protocol in the top byte of the version; a peer may only
+   use features of the revision its peer announces in its headers */
+#define PROTOCOL_REVISION 1
+
+/* Instances of responses to binary requests may be packed by
+   Instance_PackCompact() */
+#define PROTOCOL_REVISION_COMPACT_INSTANCES 1
+
+#define PROTOCOL_VERSION \
+    (((MI_Uint32)PROTOCOL_REVISION << 24) | CONFIG_VERSION_MASK)
+
+#define PROTOCOL_VERSION_REVISION(version) ((MI_Uint32)(version) >> 24)
 
 #define PROTOCOL_HEADER_MAX_PAGES 64
 
+/* Pages of the message follow in the shared-memory ring of the connection
+   rather than on the socket (see protocol/ring.h) */
+#define PROTOCOL_FLAG_RING_PAGES 0x1
+
 typedef struct _HeaderBase
 {
     /* Magic number (can be used to detect endianess of request) */
@@ -53,6 +68,10 @@ typedef struct _HeaderBase
 
     /* A correlation identifier borne by matching request and response */
     MI_Uint64 operationId;
+
+    /* PROTOCOL_FLAG_* */
+    MI_Uint32 flags;
+    MI_Uint32 reserved;
 }
 HeaderBase;
 
@@ -13,6 +13,7 @@
 #include <sock/sock.h>
 #include <sock/selector.h>
 #include <base/buf.h>
+#include <base/list.h>
 #include <base/log.h>
 #include <base/result.h>
 #include <base/user.h>
@@ -187,8 +188,58 @@ MI_Result _AddProtocolSocket_Handler(
     return r;
 }
 
+/* Memory held by the batch of a received message */
+static size_t _MessageSize(
+    Message* msg)
+{
+    size_t size = 0;
+    Page* page;
+
+    for (page = msg->batch->pages; page; page = page->u.s.next)
+        size += page->u.s.size;
+
+    return size;
+}
+
+/* Whether reading may resume once nothing is being written */
+static MI_Boolean _ProtocolSocket_CanRead(
+    ProtocolSocket* self)
+{
+    if (self->windowMessages)
+        return !self->windowFull;
+
+    return !self->strand.info.thisAckPending;
+}
+
+/* Releases the messages read ahead once nothing can be posted any more */
+static void _ProtocolSocket_DropWindow(
+    ProtocolSocket* self)
+{
+    Message* msg;
+
+    Lock_Acquire(&self->windowLock);
+    msg = self->windowHead;
+    self->windowHead = NULL;
+    self->windowTail = NULL;
+    self->windowCount = 0;
+    self->windowSize = 0;
+    self->windowPosting = MI_FALSE;
+    self->windowCloseDeferred = MI_FALSE;
+    Lock_Release(&self->windowLock);
+
+    while (msg)
+    {
+        Message* next = msg->next;
+
+        Message_Release(msg);
+        msg = next;
+    }
+}
+
 static void _ProtocolSocket_Cleanup(ProtocolSocket* handler)
 {
+    MI_Boolean deferClose;
+
     if(handler->closeOtherScheduled)
         return;
 
@@ -219,7 +270,14 @@ static void _ProtocolSocket_Cleanup(ProtocolSocket* handler)
     /* Mark handler as closed */
     handler->base.sock = INVALID_SOCK;
 
-    Strand_ScheduleClose( &handler->strand );
+    /* messages already read ahead still go up before the close */
+    Lock_Acquire(&handler->windowLock);
+    deferClose = handler->windowPosting;
+    handler->windowCloseDeferred = deferClose;
+    Lock_Release(&handler->windowLock);
+
+    if (!deferClose)
+        Strand_ScheduleClose( &handler->strand );
 }
 
 /*
@@ -237,7 +295,7 @@ void _ProtocolSocket_CheckAbort( _In_ ProtocolSocket* self )
         // provoke a timeout to close/delete the socket
         PAL_Time(&currentTimeUsec);
         self->base.fireTimeoutAt = currentTimeUsec;
-        Selector_Wakeup( protocolBase->selector, MI_TRUE );
+        Selector_UpdateHandler( protocolBase->selector, &self->base, MI_TRUE );
     }
 }
 
@@ -288,6 +346,66 @@ void _ProtocolSocket_Cancel( _In_ Strand* self_)
     _ProtocolSocket_CheckAbort( self );
 }
 
+/* An Ack is a credit: the next message read ahead is posted and reading
+   resumes once half of the window is free again */
+static void _ProtocolSocket_AckWindow(
+    ProtocolSocket* self)
+{
+    ProtocolBase* protocolBase = (ProtocolBase*)self->base.data;
+    Message* next;
+    MI_Boolean close = MI_FALSE;
+    MI_Boolean wakeup = MI_FALSE;
+
+    Lock_Acquire(&self->windowLock);
+
+    next = self->windowHead;
+
+    if (next)
+    {
+        List_Remove(
+            (ListElem**)&self->windowHead,
+            (ListElem**)&self->windowTail,
+            (ListElem*)next);
+        self->windowCount--;
+        self->windowSize -= _MessageSize(next);
+    }
+    else
+    {
+        self->windowPosting = MI_FALSE;
+        close = self->windowCloseDeferred;
+        self->windowCloseDeferred = MI_FALSE;
+    }
+
+    if (self->windowFull &&
+        self->windowCount <= self->windowMessages / 2 &&
+        self->windowSize <= self->windowBytes / 2)
+    {
+        self->windowFull = MI_FALSE;
+
+        if (!(self->base.mask & SELECTOR_WRITE))
+        {
+            self->base.mask |= SELECTOR_READ;
+            wakeup = MI_TRUE;
+        }
+    }
+
+    Lock_Release(&self->windowLock);
+
+    if (next)
+    {
+        // the reference taken when it was queued goes along
+        self->strand.info.otherMsg = next;
+        Strand_ScheduleAux( &self->strand, PROTOCOLSOCKET_STRANDAUX_POSTMSG );
+    }
+    else if (close)
+    {
+        Strand_ScheduleClose( &self->strand );
+    }
+
+    if (wakeup)
+        Selector_UpdateHandler( protocolBase->selector, &self->base, MI_FALSE );
+}
+
 void _ProtocolSocket_Ack( _In_ Strand* self_)
 {
     ProtocolSocket* self = FromOffset( ProtocolSocket, strand, self_ );
@@ -295,9 +413,16 @@ void _ProtocolSocket_Ack( _In_ Strand* self_)
     DEBUG_ASSERT( NULL != self_ );
 
     trace_ProtocolSocket_Ack( &self_->info.interaction, self_->info.interaction.other );
+
+    if (self->windowMessages)
+    {
+        _ProtocolSocket_AckWindow(self);
+        return;
+    }
+
     if (!(self->base.mask & SELECTOR_WRITE))
         self->base.mask |= SELECTOR_READ;
-    Selector_Wakeup( protocolBase->selector, MI_FALSE );
+    Selector_UpdateHandler( protocolBase->selector, &self->base, MI_FALSE );
 }
 
 void _ProtocolSocket_Close( _In_ Strand* self_)
@@ -323,6 +448,8 @@ void _ProtocolSocket_Finish( _In_ Strand* self_)
 
     trace_ProtocolSocket_Finish( self );
 
+    _ProtocolSocket_DropWindow( self );
+
     if( protocolBase->type == PRT_TYPE_LISTENER )
     {
         _ProtocolSocket_Delete( self );
@@ -362,6 +489,11 @@ void _ProtocolSocket_Aux_PostMsg( _In_ Strand* self_)
         // and the provider is in-proc and takes over the thread
         Strand_PostAndLeaveStrand( &self->strand, msg );
     }
+    else
+    {
+        // no Ack is coming to post the messages read ahead
+        _ProtocolSocket_DropWindow( self );
+    }
 
     // now we can remove the reference added before Strand_ScheduleAux( PROTOCOLSOCKET_STRANDAUX_POSTMSG )
     Message_Release( msg );
@@ -404,6 +536,11 @@ void _ProtocolSocket_Aux_ConnectEvent( _In_ Strand* self_)
        if not it triggers a timeout that will close it
     - Ack reactivates keep reading by setting SELECTOR_READ (if no
        write is in progress)
+    - With a receive window (server side of agent connections) reading goes
+       on while a received message waits for its Ack; further messages are
+       queued and each Ack posts the next one. Reading stops when the window
+       is full and resumes once half of it has been acked. A close of the
+       socket waits until the queued messages have been posted.
     - Shutdown:
        The ProtocolSocketServer objects are shutdown/deleted thru the normal
        Strand logic (once the interaction is closed).
@@ -815,6 +952,8 @@ static MI_Boolean _ProcessAuthMessage(
 static void _PrepareMessageForSending(
     ProtocolSocket *handler)
 {
+    ProtocolBase* protocolBase = (ProtocolBase*)handler->base.data;
+
     DEBUG_ASSERT(handler->message != NULL);
 
     /* reset sending attributes */
@@ -828,15 +967,56 @@ static void _PrepareMessageForSending(
     handler->send_buffer.base.originalMessagePointer = handler->message;
 
     /* ATTN! */
-    DEBUG_ASSERT (handler->send_buffer.base.pageCount <= PROTOCOL_HEADER_MAX_PAGES);
+    DEBUG_ASSERT (handler->send_buffer.base.pageCount +
+        (handler->message->payloadPtr ? 1 : 0) <= PROTOCOL_HEADER_MAX_PAGES);
 
     /* get page info */
 
     Batch_GetPageInfo(
         handler->message->batch, handler->send_buffer.batchInfo);
 
+    /* opaque payload goes as is as one more page; the receiver fixes
+       pointers into it as into any other page */
+    if (handler->message->payloadPtr)
+    {
+        Header_BatchInfoItem* item =
+            &handler->send_buffer.batchInfo[handler->send_buffer.base.pageCount++];
+
+        item->pagePointer = handler->message->payloadPtr;
+        item->pageSize = handler->message->payloadSize;
+    }
+
+    /* pages go through the ring if they fit; only the header is sent */
+    if (handler->rings && handler->send_buffer.base.pageCount)
+    {
+        IOVec pages[PROTOCOL_HEADER_MAX_PAGES];
+        MI_Uint32 index;
+        MI_Result r;
+
+        for (index = 0; index < handler->send_buffer.base.pageCount; index++)
+        {
+            pages[index].ptr = handler->send_buffer.batchInfo[index].pagePointer;
+            pages[index].len = handler->send_buffer.batchInfo[index].pageSize;
+        }
+
+        r = ProtocolRings_Write(handler->rings, pages, index);
+
+        if (MI_RESULT_OK == r)
+        {
+            handler->send_buffer.base.flags |= PROTOCOL_FLAG_RING_PAGES;
+        }
+        else if (MI_RESULT_WOULD_BLOCK != r)
+        {
+            /* the peer broke the ring; the message still goes over the
+               socket, but the connection is closed */
+            trace_Socket_Sending_Error(handler, r);
+            _ProtocolSocket_CheckAbort(handler);
+        }
+    }
+
     /* mark handler as 'want-write' */
     handler->base.mask |= SELECTOR_WRITE;
+    Selector_UpdateHandler(protocolBase->selector, &handler->base, MI_FALSE);
 
 }
 
@@ -857,7 +1037,7 @@ static MI_Boolean _RequestCallbackWrite(
         if ( !handler->message )
         { /* nothing to send */
             handler->base.mask &= ~SELECTOR_WRITE;
-            if (!handler->strand.info.thisAckPending)
+            if (_ProtocolSocket_CanRead(handler))
                 handler->base.mask |= SELECTOR_READ;
             trace_SocketSendCompleted(handler);
             return MI_TRUE;
@@ -883,7 +1063,8 @@ static MI_Boolean _RequestCallbackWrite(
             if (!counter)
                 buffers[counter].len -= handler->sentCurrentBlockBytes;
 
-            if (index == handler->send_buffer.base.pageCount)
+            if (index == handler->send_buffer.base.pageCount ||
+                (handler->send_buffer.base.flags & PROTOCOL_FLAG_RING_PAGES))
             {
                 counter++;
                 break;
@@ -942,6 +1123,13 @@ static MI_Boolean _RequestCallbackWrite(
             break;
         }
 
+        /* header is all there is on the socket if pages went to the ring */
+        if (handler->sendingPageIndex == 1 &&
+            (handler->send_buffer.base.flags & PROTOCOL_FLAG_RING_PAGES))
+        {
+            handler->sendingPageIndex += (int)handler->send_buffer.base.pageCount;
+        }
+
         if (handler->sendingPageIndex - 1 == (int)handler->send_buffer.base.pageCount)
         {
             MI_Boolean internalMessage = Message_IsInternalMessage( handler->message );
@@ -960,6 +1148,57 @@ static MI_Boolean _RequestCallbackWrite(
     }
 }
 
+/*
+    Posts a received message up or, if the previous one has not been acked
+    yet, queues it in the receive window. Returns PRT_CONTINUE while the
+    window has room to keep reading.
+*/
+static Protocol_CallbackResult _ProtocolSocket_QueueReceived(
+    ProtocolSocket* handler,
+    Message* msg)
+{
+    Protocol_CallbackResult ret = PRT_CONTINUE;
+    MI_Boolean post;
+
+    Message_AddRef( msg );  // since the actual message use can be delayed
+
+    Lock_Acquire(&handler->windowLock);
+
+    post = !handler->windowPosting;
+
+    if (post)
+    {
+        handler->windowPosting = MI_TRUE;
+    }
+    else
+    {
+        List_Append(
+            (ListElem**)&handler->windowHead,
+            (ListElem**)&handler->windowTail,
+            (ListElem*)msg);
+        handler->windowCount++;
+        handler->windowSize += _MessageSize(msg);
+
+        if (handler->windowCount >= handler->windowMessages ||
+            handler->windowSize >= handler->windowBytes)
+        {
+            handler->windowFull = MI_TRUE;
+            handler->base.mask &= ~SELECTOR_READ;
+            ret = PRT_RETURN_TRUE;
+        }
+    }
+
+    Lock_Release(&handler->windowLock);
+
+    if (post)
+    {
+        handler->strand.info.otherMsg = msg;
+        Strand_ScheduleAux( &handler->strand, PROTOCOLSOCKET_STRANDAUX_POSTMSG );
+    }
+
+    return ret;
+}
+
 /*
     Processes incoming message, including:
         - decoding message from batch
@@ -979,6 +1218,7 @@ static Protocol_CallbackResult _ProcessReceivedMessage(
     Message* msg = 0;
     ProtocolBase* protocolBase = (ProtocolBase*)handler->base.data;
     Protocol_CallbackResult ret = PRT_RETURN_FALSE;
+    MI_Uint32 version = handler->recv_buffer.base.version;
 
     /* create a message from a batch */
     r = MessageFromBatch(
@@ -1002,6 +1242,32 @@ static Protocol_CallbackResult _ProcessReceivedMessage(
 
     if (MI_RESULT_OK == r)
     {
+        /* batches of instances only come from agents */
+        if (PostInstanceBatchMsgTag == msg->tag &&
+            PRT_TYPE_FROM_SOCKET != protocolBase->type)
+        {
+            trace_RestoreMessage_Failed(MI_RESULT_ACCESS_DENIED,
+                tcs(Result_ToString(MI_RESULT_ACCESS_DENIED)));
+            Message_Release(msg);
+            return PRT_RETURN_FALSE;
+        }
+
+        /* instances of responses to clients are packed compact only if the
+           client is of a revision that can unpack them */
+        if (PRT_TYPE_LISTENER == protocolBase->type && Message_IsRequest(msg))
+        {
+            if ((msg->flags & BinaryProtocolFlag) &&
+                PROTOCOL_VERSION_REVISION(version) >=
+                    PROTOCOL_REVISION_COMPACT_INSTANCES)
+            {
+                msg->flags |= BinaryProtocol_CompactInstanceFlag;
+            }
+            else
+            {
+                msg->flags &= ~BinaryProtocol_CompactInstanceFlag;
+            }
+        }
+
         trace_Socket_ReceivedMessage(
             msg,
             msg->tag,
@@ -1013,6 +1279,10 @@ static Protocol_CallbackResult _ProcessReceivedMessage(
             if( _ProcessAuthMessage(handler, msg) )
                 ret = PRT_CONTINUE;
         }
+        else if (handler->windowMessages)
+        {
+            ret = _ProtocolSocket_QueueReceived(handler, msg);
+        }
         else
         {
             //disable receiving anything else until this message is ack'ed
@@ -1113,6 +1383,27 @@ static Protocol_CallbackResult _ReadHeader(
             handler->receivingPageIndex++;
             handler->receivedCurrentBlockBytes = 0;
 
+            /* pages were put into the ring before the header was sent */
+            if (handler->recv_buffer.base.flags & PROTOCOL_FLAG_RING_PAGES)
+            {
+                IOVec pages[PROTOCOL_HEADER_MAX_PAGES];
+
+                for (index = 0; index < handler->recv_buffer.base.pageCount; index++)
+                {
+                    pages[index].ptr = Batch_GetPageByIndex(handler->receivingBatch, index);
+                    pages[index].len = handler->recv_buffer.batchInfo[index].pageSize;
+                }
+
+                if (!handler->rings ||
+                    !ProtocolRings_Read(handler->rings, pages, index))
+                {
+                    trace_Socket_Read_Error(handler, MI_RESULT_FAILED);
+                    return PRT_RETURN_FALSE;
+                }
+
+                handler->receivingPageIndex += (int)index;
+            }
+
             if ( (handler->receivingPageIndex - 1) == (int)handler->recv_buffer.base.pageCount )
             {   /* received the whole message - process it */
                 return _ProcessReceivedMessage(handler);
@@ -1621,6 +1912,7 @@ MI_Result _ProtocolSocket_New(
     Strand_Init( STRAND_PASSDEBUG(debug) &self->strand, &_ProtocolSocket_FT, STRAND_FLAG_ENTERSTRAND, params);
     self->refCount = 1; //ref associated with Strand. Released on Strand_Finish
     self->closeOtherScheduled = MI_FALSE;
+    Lock_Init(&self->windowLock);
 
     self->base.callback = _RequestCallback;
 
@@ -1771,6 +2063,8 @@ MI_Result ProtocolSocketAndBase_New_Connector(
         to skip unpacking instances from agent
     callback - function that protocol calls to inform about new connection
     callbackData -
+    rings - [opt] shared-memory rings for message pages; owned by the protocol
+        object (deleted even if the operation failed)
 
     Returns:
     'OK' if succefful, error otherwise
@@ -1782,7 +2076,8 @@ MI_Result _ProtocolSocketAndBase_New_From_Socket(
     _In_        Sock                    sock,
                 MI_Boolean              skipInstanceUnpack,
     _In_opt_    OpenCallback            callback,       // only used on Agent
-    _In_opt_    void*                   callbackData)   // used along with callback
+    _In_opt_    void*                   callbackData,   // used along with callback
+    _In_opt_    ProtocolRings*          rings)
 {
     ProtocolSocketAndBase* self;
     MI_Result r;
@@ -1792,7 +2087,13 @@ MI_Result _ProtocolSocketAndBase_New_From_Socket(
     r = _ProtocolSocketAndBase_New( STRAND_DEBUG(ProtocolFromSocket) &self, params, selector, callback, callbackData, PRT_TYPE_FROM_SOCKET );
 
     if( r != MI_RESULT_OK )
+    {
+        if (rings)
+            ProtocolRings_Delete(rings);
         return r;
+    }
+
+    self->protocolSocket.rings = rings;
 
     self->internalProtocolBase.skipInstanceUnpack = skipInstanceUnpack;
 
@@ -1811,6 +2112,10 @@ MI_Result _ProtocolSocketAndBase_New_From_Socket(
                 ignore socket operations under stress */
             //no more used - as flow control is implemented in protocol and wsman layers
             //h->base.mask |= SELECTOR_IGNORE_READ_OVERLOAD;
+
+            /* read results ahead of the acks of the server side */
+            h->windowMessages = PROTOCOLSOCKET_RECEIVEWINDOW_MESSAGES;
+            h->windowBytes = PROTOCOLSOCKET_RECEIVEWINDOW_BYTES;
         }
 
         h->isConnected = MI_TRUE;
@@ -1836,9 +2141,10 @@ MI_Result ProtocolSocketAndBase_New_AgentConnector(
     _Out_       ProtocolSocketAndBase** selfOut,
     _In_opt_    Selector*               selector,       // optional, maybe NULL
     _In_        Sock                    s,
-    _In_        InteractionOpenParams*  params )
+    _In_        InteractionOpenParams*  params,
+    _In_opt_    ProtocolRings*          rings )
 {
-    return _ProtocolSocketAndBase_New_From_Socket( selfOut, params, selector, s, MI_TRUE, NULL, NULL );
+    return _ProtocolSocketAndBase_New_From_Socket( selfOut, params, selector, s, MI_TRUE, NULL, NULL, rings );
 }
 
 MI_Result ProtocolSocketAndBase_New_Agent(
@@ -1846,9 +2152,10 @@ MI_Result ProtocolSocketAndBase_New_Agent(
     _In_opt_    Selector*               selector,       // optional, maybe NULL
     _In_        Sock                    s,
     _In_        OpenCallback            callback,
-    _In_        void*                   callbackData)   // used along with callback
+    _In_        void*                   callbackData,   // used along with callback
+    _In_opt_    ProtocolRings*          rings )
 {
-    return _ProtocolSocketAndBase_New_From_Socket( selfOut, NULL, selector, s, MI_FALSE, callback, callbackData );
+    return _ProtocolSocketAndBase_New_From_Socket( selfOut, NULL, selector, s, MI_FALSE, callback, callbackData, rings );
 }
 
 MI_Result _ProtocolBase_Finish(
@@ -1900,6 +2207,9 @@ MI_Result _ProtocolSocketAndBase_Delete(
     if( MI_RESULT_OK != r )
         return r;
 
+    if (self->protocolSocket.rings)
+        ProtocolRings_Delete(self->protocolSocket.rings);
+
     /* Free self pointer */
     PAL_Free(self);
 
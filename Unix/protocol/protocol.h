@@ -16,7 +16,9 @@
 #include <base/Strand.h>
 #include <sock/selector.h>
 #include <pal/thread.h>
+#include <pal/lock.h>
 #include <protocol/header.h>
+#include <protocol/ring.h>
 
 BEGIN_EXTERNC
 
@@ -24,6 +26,17 @@ BEGIN_EXTERNC
 #define PROTOCOLSOCKET_STRANDAUX_READYTOFINISH  1
 #define PROTOCOLSOCKET_STRANDAUX_CONNECTEVENT   2
 
+/*
+    Receive window of the server side of agent connections: while a received
+    message waits for its Ack, up to this many further messages (or bytes of
+    their batches) are read ahead and queued, so the agent keeps sending
+    instead of waiting for each one to make it through the server. Once the
+    window is full, reading resumes only after the acks have drained half of
+    it, so credits go back to the socket in bulk.
+*/
+#define PROTOCOLSOCKET_RECEIVEWINDOW_MESSAGES   64
+#define PROTOCOLSOCKET_RECEIVEWINDOW_BYTES      (1024 * 1024)
+
 typedef enum _Protocol_AuthState
 {
     /* authentication failed (intentionaly takes value '0')*/
@@ -95,6 +108,9 @@ typedef struct _ProtocolSocket
     Header              recv_buffer;
     Header              send_buffer;
 
+    /* shared-memory rings for message pages (server/agent connections) */
+    ProtocolRings*      rings;
+
     /* Auth state */
     Protocol_AuthState  authState;
     /* server side - auhtenticated user's ids */
@@ -107,6 +123,21 @@ typedef struct _ProtocolSocket
 
     volatile ptrdiff_t refCount; //used by socket listner for lifetimemanagement
     MI_Boolean          closeOtherScheduled;
+
+    /* receive window; zero means nothing is read until the last received
+       message is acked (see PROTOCOLSOCKET_RECEIVEWINDOW_MESSAGES) */
+    MI_Uint32           windowMessages;
+    size_t              windowBytes;
+
+    /* messages read ahead of the one posted up; protected by windowLock */
+    Lock                windowLock;
+    Message*            windowHead;
+    Message*            windowTail;
+    MI_Uint32           windowCount;
+    size_t              windowSize;
+    MI_Boolean          windowPosting;      /* posted up and not acked yet */
+    MI_Boolean          windowFull;         /* reading stopped until drained */
+    MI_Boolean          windowCloseDeferred;/* close once the queue is posted */
 }
 ProtocolSocket;
 
@@ -152,18 +183,25 @@ MI_Result ProtocolSocketAndBase_New_Connector(
     _In_        const char*             user,
     _In_        const char*             password );
 
+/*
+    Both sides of a server/agent connection may pass rings (see ring.h) to
+    move message pages through shared memory; the protocol object takes
+    ownership of them, even if it fails to be created.
+*/
 MI_Result ProtocolSocketAndBase_New_AgentConnector(
     _Out_       ProtocolSocketAndBase** selfOut,
     _In_opt_    Selector*               selector,       // optional, maybe NULL
     _In_        Sock                    s,
-    _In_        InteractionOpenParams*  params );
+    _In_        InteractionOpenParams*  params,
+    _In_opt_    ProtocolRings*          rings );
 
 MI_Result ProtocolSocketAndBase_New_Agent(
     _Out_       ProtocolSocketAndBase** selfOut,
     _In_opt_    Selector*               selector,       // optional, maybe NULL
     _In_        Sock                    s,
     _In_        OpenCallback            callback,
-    _In_        void*                   callbackData);  // used along with callback
+    _In_        void*                   callbackData,   // used along with callback
+    _In_opt_    ProtocolRings*          rings );
 
 MI_Result ProtocolBase_Delete(
     ProtocolBase* self);
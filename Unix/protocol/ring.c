@@ -0,0 +1,351 @@
+/*
+**==============================================================================
+**
+** Copyright (c) Microsoft Corporation. All rights reserved. See file LICENSE
+** for license information.
+**
+**==============================================================================
+*/
+
+#include <string.h>
+#include "ring.h"
+#include <pal/atomic.h>
+#include <pal/shmem.h>
+#include <pal/format.h>
+
+#if defined(CONFIG_POSIX) && defined(CONFIG_HAVE_ATOMIC_INTRINSICS)
+# define PROTOCOLRINGS_SUPPORTED
+# include <sys/types.h>
+# include <sys/stat.h>
+# include <sys/mman.h>
+# include <unistd.h>
+#endif
+
+#if defined(PROTOCOLRINGS_SUPPORTED)
+
+#define PROTOCOLRINGS_MAGIC 0x474E4952
+
+/* Counters written by different sides are kept on different cache lines */
+#define PROTOCOLRINGS_LINE 64
+
+/* Ring header in shared memory followed by 'size' bytes of data */
+typedef struct _ProtocolRingHeader
+{
+    MI_Uint32 magic;
+    MI_Uint32 size;
+    char pad0[PROTOCOLRINGS_LINE - 2 * sizeof(MI_Uint32)];
+
+    /* Bytes written so far (wraps around); only the producer writes it */
+    volatile ptrdiff_t head;
+    char pad1[PROTOCOLRINGS_LINE - sizeof(ptrdiff_t)];
+
+    /* Bytes read so far (wraps around); only the consumer writes it */
+    volatile ptrdiff_t tail;
+    char pad2[PROTOCOLRINGS_LINE - sizeof(ptrdiff_t)];
+}
+ProtocolRingHeader;
+
+struct _ProtocolRings
+{
+    void* mem;
+    size_t memSize;
+    size_t size;
+    ProtocolRingHeader* out;
+    ProtocolRingHeader* in;
+};
+
+static volatile ptrdiff_t s_counter;
+
+static size_t _MemSize(size_t size)
+{
+    return 2 * (sizeof(ProtocolRingHeader) + size);
+}
+
+static ProtocolRingHeader* _Ring(void* mem, size_t size, int index)
+{
+    return (ProtocolRingHeader*)((char*)mem +
+        index * (sizeof(ProtocolRingHeader) + size));
+}
+
+static MI_Result _Init(
+    ProtocolRings** selfOut,
+    void* mem,
+    size_t memSize,
+    size_t size,
+    MI_Boolean creator)
+{
+    ProtocolRings* self = (ProtocolRings*)PAL_Calloc(1, sizeof(ProtocolRings));
+
+    if (!self)
+        return MI_RESULT_SERVER_LIMITS_EXCEEDED;
+
+    self->mem = mem;
+    self->memSize = memSize;
+    self->size = size;
+    self->out = _Ring(mem, size, creator ? 0 : 1);
+    self->in = _Ring(mem, size, creator ? 1 : 0);
+
+    *selfOut = self;
+    return MI_RESULT_OK;
+}
+
+MI_Result ProtocolRings_Create(
+    _Out_   ProtocolRings** self,
+            size_t ringSize,
+    _Out_   int* fd)
+{
+    Shmem shmem;
+    PAL_Char name[64];
+    size_t size = PROTOCOLRINGS_MIN_SIZE;
+    size_t memSize;
+    void* mem;
+    MI_Result r;
+    int i;
+
+    *self = NULL;
+    *fd = -1;
+
+    if (ringSize > PROTOCOLRINGS_MAX_SIZE)
+        return MI_RESULT_INVALID_PARAMETER;
+
+    while (size < ringSize)
+        size *= 2;
+
+    memSize = _MemSize(size);
+
+    Stprintf(name, MI_COUNT(name), PAL_T("/omi-rings.%d.%d"),
+        (int)getpid(), (int)Atomic_Inc(&s_counter));
+
+    if (Shmem_Open(&shmem, name, SHMEM_ACCESS_READWRITE,
+        SHMEM_USER_ACCESS_DEFAULT, memSize) != 0)
+    {
+        return MI_RESULT_FAILED;
+    }
+
+    Shmem_Unlink(&shmem);
+
+    mem = Shmem_Map(&shmem, SHMEM_ACCESS_READWRITE, 0, memSize);
+
+    if (!mem)
+    {
+        close(shmem.shmid);
+        return MI_RESULT_FAILED;
+    }
+
+    for (i = 0; i < 2; i++)
+    {
+        ProtocolRingHeader* ring = _Ring(mem, size, i);
+
+        memset(ring, 0, sizeof(ProtocolRingHeader));
+        ring->magic = PROTOCOLRINGS_MAGIC;
+        ring->size = (MI_Uint32)size;
+    }
+
+    r = _Init(self, mem, memSize, size, MI_TRUE);
+
+    if (r != MI_RESULT_OK)
+    {
+        Shmem_Unmap(&shmem, mem, memSize);
+        close(shmem.shmid);
+        return r;
+    }
+
+    *fd = shmem.shmid;
+    return MI_RESULT_OK;
+}
+
+MI_Result ProtocolRings_Attach(
+    _Out_   ProtocolRings** self,
+            int fd)
+{
+    Shmem shmem;
+    struct stat st;
+    ProtocolRingHeader* ring;
+    size_t size;
+    size_t memSize;
+    void* mem;
+    MI_Result r;
+
+    *self = NULL;
+
+    if (fstat(fd, &st) != 0 ||
+        (size_t)st.st_size < _MemSize(PROTOCOLRINGS_MIN_SIZE) ||
+        (size_t)st.st_size > _MemSize(PROTOCOLRINGS_MAX_SIZE))
+    {
+        return MI_RESULT_INVALID_PARAMETER;
+    }
+
+    memSize = (size_t)st.st_size;
+
+    memset(&shmem, 0, sizeof(shmem));
+    shmem.shmid = fd;
+
+    mem = Shmem_Map(&shmem, SHMEM_ACCESS_READWRITE, 0, memSize);
+
+    if (!mem)
+        return MI_RESULT_FAILED;
+
+    /* both rings have to be of the size the memory was created for */
+    ring = _Ring(mem, 0, 0);
+    size = ring->size;
+
+    if (ring->magic != PROTOCOLRINGS_MAGIC ||
+        size < PROTOCOLRINGS_MIN_SIZE || (size & (size - 1)) != 0 ||
+        _MemSize(size) != memSize ||
+        _Ring(mem, size, 1)->magic != PROTOCOLRINGS_MAGIC ||
+        _Ring(mem, size, 1)->size != size)
+    {
+        Shmem_Unmap(&shmem, mem, memSize);
+        return MI_RESULT_INVALID_PARAMETER;
+    }
+
+    r = _Init(self, mem, memSize, size, MI_FALSE);
+
+    if (r != MI_RESULT_OK)
+        Shmem_Unmap(&shmem, mem, memSize);
+
+    return r;
+}
+
+void ProtocolRings_Delete(
+    _In_    ProtocolRings* self)
+{
+    munmap(self->mem, self->memSize);
+    PAL_Free(self);
+}
+
+static size_t _Total(
+    const IOVec* buffers,
+    size_t count)
+{
+    size_t total = 0;
+    size_t i;
+
+    for (i = 0; i < count; i++)
+        total += buffers[i].len;
+
+    return total;
+}
+
+MI_Result ProtocolRings_Write(
+    _Inout_ ProtocolRings* self,
+    _In_reads_(count) const IOVec* buffers,
+            size_t count)
+{
+    ProtocolRingHeader* ring = self->out;
+    char* data = (char*)(ring + 1);
+    size_t mask = self->size - 1;
+    size_t total = _Total(buffers, count);
+    size_t pos = (size_t)ring->head;
+    size_t used = pos - (size_t)Atomic_Read(&ring->tail);
+    size_t i;
+
+    /* the counters are in memory the peer can write to */
+    if (used > self->size)
+        return MI_RESULT_FAILED;
+
+    /* the consumer only moves 'tail' forward, so space can only grow */
+    if (total > self->size - used)
+        return MI_RESULT_WOULD_BLOCK;
+
+    for (i = 0; i < count; i++)
+    {
+        size_t n = buffers[i].len;
+        size_t at = pos & mask;
+        size_t first = self->size - at < n ? self->size - at : n;
+
+        memcpy(data + at, buffers[i].ptr, first);
+        memcpy(data, (const char*)buffers[i].ptr + first, n - first);
+        pos += n;
+    }
+
+    /* publish the data (full barrier) before the header is sent */
+    Atomic_Add(&ring->head, (ptrdiff_t)total);
+    return MI_RESULT_OK;
+}
+
+MI_Boolean ProtocolRings_Read(
+    _Inout_ ProtocolRings* self,
+    _In_reads_(count) const IOVec* buffers,
+            size_t count)
+{
+    ProtocolRingHeader* ring = self->in;
+    const char* data = (const char*)(ring + 1);
+    size_t mask = self->size - 1;
+    size_t total = _Total(buffers, count);
+    size_t pos = (size_t)ring->tail;
+    size_t avail = (size_t)Atomic_Read(&ring->head) - pos;
+    size_t i;
+
+    /* the counters are in memory the peer can write to; no more than the
+       ring holds can have been written */
+    if (total > self->size || avail > self->size || total > avail)
+        return MI_FALSE;
+
+    for (i = 0; i < count; i++)
+    {
+        size_t n = buffers[i].len;
+        size_t at = pos & mask;
+        size_t first = self->size - at < n ? self->size - at : n;
+
+        memcpy(buffers[i].ptr, data + at, first);
+        memcpy((char*)buffers[i].ptr + first, data, n - first);
+        pos += n;
+    }
+
+    /* release the space (full barrier) once the data is copied out */
+    Atomic_Add(&ring->tail, (ptrdiff_t)total);
+    return MI_TRUE;
+}
+
+#else /* defined(PROTOCOLRINGS_SUPPORTED) */
+
+MI_Result ProtocolRings_Create(
+    _Out_   ProtocolRings** self,
+            size_t ringSize,
+    _Out_   int* fd)
+{
+    MI_UNUSED(ringSize);
+    *self = NULL;
+    *fd = -1;
+    return MI_RESULT_NOT_SUPPORTED;
+}
+
+MI_Result ProtocolRings_Attach(
+    _Out_   ProtocolRings** self,
+            int fd)
+{
+    MI_UNUSED(fd);
+    *self = NULL;
+    return MI_RESULT_NOT_SUPPORTED;
+}
+
+void ProtocolRings_Delete(
+    _In_    ProtocolRings* self)
+{
+    MI_UNUSED(self);
+}
+
+MI_Result ProtocolRings_Write(
+    _Inout_ ProtocolRings* self,
+    _In_reads_(count) const IOVec* buffers,
+            size_t count)
+{
+    MI_UNUSED(self);
+    MI_UNUSED(buffers);
+    MI_UNUSED(count);
+    return MI_RESULT_WOULD_BLOCK;
+}
+
+MI_Boolean ProtocolRings_Read(
+    _Inout_ ProtocolRings* self,
+    _In_reads_(count) const IOVec* buffers,
+            size_t count)
+{
+    MI_UNUSED(self);
+    MI_UNUSED(buffers);
+    MI_UNUSED(count);
+    return MI_FALSE;
+}
+
+#endif /* defined(PROTOCOLRINGS_SUPPORTED) */
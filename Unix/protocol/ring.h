@@ -0,0 +1,90 @@
+/*
+**==============================================================================
+**
+** Copyright (c) Microsoft Corporation. All rights reserved. See file LICENSE
+** for license information.
+**
+**==============================================================================
+*/
+
+#ifndef _omi_protocol_ring_h
+#define _omi_protocol_ring_h
+
+#include "config.h"
+#include <common.h>
+#include <sock/sock.h>
+
+BEGIN_EXTERNC
+
+/*
+**==============================================================================
+**
+** ProtocolRings:
+**
+**     A pair of single-producer/single-consumer byte rings in shared memory,
+**     one for each direction of a server/agent connection. The creator (the
+**     server) writes to the first ring and reads from the second one; the
+**     side that attaches (the agent) does the opposite.
+**
+**     The rings only carry message pages. The sender copies all pages of a
+**     message into its ring (if they fit) before the message header goes
+**     out on the socket; the header has PROTOCOL_FLAG_RING_PAGES set, so
+**     the receiver takes the pages from the ring once it has the header.
+**     The socket thus stays the doorbell that orders messages and wakes up
+**     the receiver, and a full ring never blocks the sender: the message
+**     goes over the socket as usual.
+**
+**     The counters live in memory the peer can write to; both calls check
+**     them (and the lengths they are given) against the size of the ring
+**     before copying anything, so a broken peer cannot make them touch
+**     memory outside of it.
+**
+**     Requires atomic intrinsics that work across processes; on other
+**     configurations ProtocolRings_Create() fails and the caller keeps
+**     using the socket alone.
+**
+**==============================================================================
+*/
+
+/* Bounds of the ring size (bytes of data in each direction) */
+#define PROTOCOLRINGS_MIN_SIZE 4096
+#define PROTOCOLRINGS_MAX_SIZE (64 * 1024 * 1024)
+
+typedef struct _ProtocolRings ProtocolRings;
+
+/* Creates the shared memory for rings of at least 'ringSize' bytes (rounded
+   up to a power of two); '*fd' receives the descriptor the peer process
+   attaches to and is owned by the caller. The memory has no name left by
+   the time this returns. */
+MI_Result ProtocolRings_Create(
+    _Out_   ProtocolRings** self,
+            size_t ringSize,
+    _Out_   int* fd);
+
+/* Maps the rings created by the peer; 'fd' is not closed */
+MI_Result ProtocolRings_Attach(
+    _Out_   ProtocolRings** self,
+            int fd);
+
+void ProtocolRings_Delete(
+    _In_    ProtocolRings* self);
+
+/* Copies all buffers into the output ring. Returns MI_RESULT_WOULD_BLOCK
+   (and copies nothing) if they do not fit into the free space and
+   MI_RESULT_FAILED if the peer left the ring's counters inconsistent */
+MI_Result ProtocolRings_Write(
+    _Inout_ ProtocolRings* self,
+    _In_reads_(count) const IOVec* buffers,
+            size_t count);
+
+/* Fills all buffers from the input ring; returns MI_FALSE (and consumes
+   nothing) if the ring holds fewer bytes or its counters claim more than
+   the ring can hold */
+MI_Boolean ProtocolRings_Read(
+    _Inout_ ProtocolRings* self,
+    _In_reads_(count) const IOVec* buffers,
+            size_t count);
+
+END_EXTERNC
+
+#endif /* _omi_protocol_ring_h */
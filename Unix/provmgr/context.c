@@ -45,6 +45,10 @@ void _Context_Destroy(
         Provider_Release(self->provider);
     }
 
+    /* instances left after a cancel */
+    if (self->instanceBatch)
+        PostInstanceBatchMsg_Release(self->instanceBatch);
+
     memset(self, 0xFF, sizeof(Context));
 
     /* Context typically allocated from message's batch
@@ -57,36 +61,36 @@ void _Context_Destroy(
         Message_Release(loadRequest);
 }
 
+/* Provider manager is usually picked up from the providers library after it
+ * has been loaded. There are a few situations where the library is not
+ * actually loaded so we get it from the context directly. Code paths are
+ * such that we cannot just switch to the context version so we keep the old
+ * option as an initial try and if that fails fall back to the new location
+ */
+static ProvMgr* _GetProvMgr(
+    _In_ Context* self)
+{
+    if (self->provider && self->provider->lib && self->provider->lib->provmgr)
+        return self->provider->lib->provmgr;
+
+    return self->provmgr;
+}
+
 /*
- * Post a message to the component to the left
+ * Post a message to the component to the left; self->lock is held
  */
-_Use_decl_annotations_
-void Context_PostMessageLeft(
-    Context* self,
-    Message* msg)
+static void _PostMessageLeft(
+    _In_ Context* self,
+    _In_ Message* msg)
 {
     ptrdiff_t tryingToPostLeft;
 // Uncomment when no longer using Selector
 //#if !defined(CONFIG_OS_WINDOWS)
     ThreadID threadId = Thread_ID();
-    Selector* selector = NULL;
-    /* Selector is usually picked up from the providers library after it has been
-     * loaded. There are a few situations where the library is not actually loaded
-     * so we get the selector from the provider manager directly. Code paths are
-     * such that we cannot just switch to the top-level provider manager version
-     * so we keep the old option as an initial try and if that fails fall back
-     * to the new location
-     */
-    if (self->provider && self->provider->lib && self->provider->lib->provmgr)
-        selector = self->provider->lib->provmgr->selector;
-    else if (self->provmgr)
-        selector = self->provmgr->selector;
+    ProvMgr* provmgr = _GetProvMgr(self);
+    Selector* selector = provmgr ? provmgr->selector : NULL;
 //#endif
 
-    // It is not clear if a Provider can Post concurrently in different threads (UT does)
-    // so protect against it
-    Lock_Acquire(&self->lock);
-
     DEBUG_ASSERT( NULL != self->strand.info.interaction.other );
     DEBUG_ASSERT( NULL == self->msgPostingLeft );
     DEBUG_ASSERT( 0 == self->tryingToPostLeft );
@@ -144,6 +148,101 @@ void Context_PostMessageLeft(
         }
     }
 #endif
+}
+
+/*
+ * Post the instances accumulated in self->instanceBatch; self->lock is held
+ */
+static void _FlushInstanceBatch(
+    _In_ Context* self)
+{
+    PostInstanceBatchMsg* msg = self->instanceBatch;
+
+    if (msg)
+    {
+        self->instanceBatch = NULL;
+        _PostMessageLeft(self, &msg->base);
+        PostInstanceBatchMsg_Release(msg);
+    }
+}
+
+static void _InstanceBatchTimerCallback(
+    _In_ Selector* selector,
+    _In_ SelectorTimer* timer,
+    MI_Uint32 mask,
+    MI_Uint64 currentTimeUsec);
+
+/*
+ * Arm the timer that flushes self->instanceBatch unless it is armed already
+ * (for a batch posted early); self->lock is held
+ */
+static void _ArmInstanceBatchTimer(
+    _In_ Context* self,
+    MI_Uint64 fireTimeoutAt)
+{
+    Selector* selector = _GetProvMgr(self)->selector;
+
+    if (self->instanceBatchTimerArmed || !selector)
+        return;
+
+    self->instanceBatchTimer.callback = _InstanceBatchTimerCallback;
+    self->instanceBatchTimer.data = self;
+
+    /* if it cannot be armed the batch waits for the next post */
+    if (MI_RESULT_OK == Selector_StartTimer(selector, &self->instanceBatchTimer, fireTimeoutAt))
+        self->instanceBatchTimerArmed = MI_TRUE;
+}
+
+/*
+ * Called in the selector thread; posts the batch if its first instance has
+ * waited long enough, otherwise waits for the batch filled since then
+ */
+static void _InstanceBatchTimerCallback(
+    _In_ Selector* selector,
+    _In_ SelectorTimer* timer,
+    MI_Uint32 mask,
+    MI_Uint64 currentTimeUsec)
+{
+    Context* self = (Context*)timer->data;
+
+    Lock_Acquire(&self->lock);
+
+    self->instanceBatchTimerArmed = MI_FALSE;
+
+    if (self->destroyOnInstanceBatchTimer)
+    {
+        Lock_Release(&self->lock);
+        _Context_Destroy(self);
+        return;
+    }
+
+    if ((mask & SELECTOR_TIMEOUT) && self->instanceBatch)
+    {
+        if (currentTimeUsec - self->instanceBatchStart >= CONTEXT_INSTANCEBATCH_DELAY_USEC)
+            _FlushInstanceBatch(self);
+        else
+            _ArmInstanceBatchTimer(self, self->instanceBatchStart + CONTEXT_INSTANCEBATCH_DELAY_USEC);
+    }
+
+    Lock_Release(&self->lock);
+}
+
+/*
+ * Post a message to the component to the left
+ */
+_Use_decl_annotations_
+void Context_PostMessageLeft(
+    Context* self,
+    Message* msg)
+{
+    // It is not clear if a Provider can Post concurrently in different threads (UT does)
+    // so protect against it
+    Lock_Acquire(&self->lock);
+
+    // Instances accumulated so far go first
+    _FlushInstanceBatch(self);
+
+    _PostMessageLeft(self, msg);
 
     Lock_Release(&self->lock);
 }
@@ -346,13 +445,15 @@ static MI_Boolean _FilterProperty(const ZChar* name, void *data)
 }
 
 /*
- * This is an internal helper function that should be called from wrappers
- * that manage the lifecycle of the instance getting posted.
+ * Packs the instance into the batch of 'resp' the way the request needs it
+ * and sets the encoding flags of 'resp'.
  */
-static MI_Result _PostInstanceToCallback_Common(
+static MI_Result _PackInstance(
     _In_ Context* self,
     _In_ const MI_Instance* instance,
-    _In_ PostInstanceMsg* resp)
+    _Inout_ Message* resp,
+    _Out_ void** packedInstancePtr,
+    _Out_ MI_Uint32* packedInstanceSize)
 {
     MI_Result r = MI_RESULT_OK;
 
@@ -390,7 +491,7 @@ static MI_Result _PostInstanceToCallback_Common(
                 encodingFlags |= WSMAN_IsShellResponse;
             }
 #endif
-            resp->base.flags |= encodingFlags;
+            resp->flags |= encodingFlags;
 
             if (EnumerateInstancesReqTag == self->request->base.tag)
                 req = (EnumerateInstancesReq*)self->request;
@@ -403,10 +504,10 @@ static MI_Result _PostInstanceToCallback_Common(
                     _FilterProperty,
                     req->wql,
                     castToClassDecl,
-                    resp->base.batch,
+                    resp->batch,
                     encodingFlags,
-                    &resp->packedInstancePtr,
-                    &resp->packedInstanceSize);
+                    packedInstancePtr,
+                    packedInstanceSize);
 
             }
             else
@@ -417,45 +518,71 @@ static MI_Result _PostInstanceToCallback_Common(
                     NULL, /* filterProperty */
                     NULL, /* filterPropertyData */
                     castToClassDecl,
-                    resp->base.batch,
+                    resp->batch,
                     encodingFlags,
-                    &resp->packedInstancePtr,
-                    &resp->packedInstanceSize);
+                    packedInstancePtr,
+                    packedInstanceSize);
             }
         }
     }
     else
     {
         EnumerateInstancesReq* req = NULL;
+        MI_Boolean (*filterProperty)(const ZChar* name, void* data) = NULL;
+        void* filterPropertyData = NULL;
 
         if (EnumerateInstancesReqTag == self->request->base.tag)
             req = (EnumerateInstancesReq*)self->request;
 
         if (req && req->wql)
         {
-            r = InstanceToBatch(
+            filterProperty = _FilterProperty;
+            filterPropertyData = req->wql;
+        }
+
+        /* the protocol sets the flag for clients that can unpack it */
+        if (self->request->base.flags & BinaryProtocol_CompactInstanceFlag)
+        {
+            r = InstanceToBatchCompact(
                 instance,
-                _FilterProperty,
-                req->wql,
-                resp->base.batch,
-                &resp->packedInstancePtr,
-                &resp->packedInstanceSize);
+                filterProperty,
+                filterPropertyData,
+                resp->batch,
+                packedInstancePtr,
+                packedInstanceSize);
         }
         else
         {
             r = InstanceToBatch(
                 instance,
-                NULL,
-                NULL,
-                resp->base.batch,
-                &resp->packedInstancePtr,
-                &resp->packedInstanceSize);
+                filterProperty,
+                filterPropertyData,
+                resp->batch,
+                packedInstancePtr,
+                packedInstanceSize);
         }
 
-        resp->base.flags |= BinaryProtocolFlag;
+        resp->flags |= BinaryProtocolFlag;
     }
 
 
+    return r;
+}
+
+/*
+ * This is an internal helper function that should be called from wrappers
+ * that manage the lifecycle of the instance getting posted.
+ */
+static MI_Result _PostInstanceToCallback_Common(
+    _In_ Context* self,
+    _In_ const MI_Instance* instance,
+    _In_ PostInstanceMsg* resp)
+{
+    MI_Result r;
+
+    r = _PackInstance(self, instance, &resp->base,
+        &resp->packedInstancePtr, &resp->packedInstanceSize);
+
     if (r != MI_RESULT_OK)
         trace_PackInstanceFailed(r);
     else
@@ -464,12 +591,102 @@ static MI_Result _PostInstanceToCallback_Common(
     return r;
 }
 
+/* Whether instances of this context are posted in PostInstanceBatchMsg */
+static MI_Boolean _BatchesInstances(
+    _In_ Context* self)
+{
+    ProvMgr* provmgr = _GetProvMgr(self);
+
+    if (!provmgr || provmgr->instanceBatchSize == 0 ||
+        self->ctxType != CTX_TYPE_SINGLE_ITEM)
+        return MI_FALSE;
+
+    switch (self->request->base.tag)
+    {
+        case EnumerateInstancesReqTag:
+        case AssociatorsOfReqTag:
+        case ReferencesOfReqTag:
+            return MI_TRUE;
+        default:
+            return MI_FALSE;
+    }
+}
+
+/*
+ * Packs the instance into self->instanceBatch and posts the batch once it
+ * is full or the first instance in it has waited long enough, here or from
+ * the instance batch timer if the provider does not post again by then.
+ */
+static MI_Result _PostInstanceToBatch(
+    _In_ Context* self,
+    _In_ const MI_Instance* instance)
+{
+    PostInstanceBatchMsg* msg;
+    PostInstanceBatchItem* item;
+    MI_Uint64 now;
+    MI_Result r;
+
+    Lock_Acquire(&self->lock);
+
+    if (!self->instanceBatch)
+    {
+        self->instanceBatch = PostInstanceBatchMsg_New(
+            self->request->base.operationId,
+            _GetProvMgr(self)->instanceBatchSize);
+
+        if (!self->instanceBatch)
+        {
+            Lock_Release(&self->lock);
+            return MI_RESULT_FAILED;
+        }
+
+        if (!PAL_Time(&self->instanceBatchStart))
+            self->instanceBatchStart = 0;
+        else
+            _ArmInstanceBatchTimer(self, self->instanceBatchStart + CONTEXT_INSTANCEBATCH_DELAY_USEC);
+    }
+
+    msg = self->instanceBatch;
+    item = &msg->items[msg->count];
+
+    r = _PackInstance(self, instance, &msg->base,
+        &item->packedInstancePtr, &item->packedInstanceSize);
+
+    if (r != MI_RESULT_OK)
+    {
+        trace_PackInstanceFailed(r);
+    }
+    else
+    {
+        msg->count++;
+        msg->packedSize += item->packedInstanceSize;
+
+        if (msg->count == msg->capacity ||
+            msg->packedSize >= CONTEXT_INSTANCEBATCH_MAX_BYTES ||
+            Batch_GetPageCount(msg->base.batch) >= CONTEXT_INSTANCEBATCH_MAX_PAGES ||
+            !PAL_Time(&now) ||
+            now - self->instanceBatchStart >= CONTEXT_INSTANCEBATCH_DELAY_USEC)
+        {
+            _FlushInstanceBatch(self);
+        }
+    }
+
+    Lock_Release(&self->lock);
+
+    return r;
+}
+
 static MI_Result _PostInstanceToCallback(
     _In_ Context* self,
     _In_ const MI_Instance* instance)
 {
     MI_Result result = MI_RESULT_OK;
-    PostInstanceMsg* resp = PostInstanceMsg_New(self->request->base.operationId);
+    PostInstanceMsg* resp;
+
+    if (_BatchesInstances(self))
+        return _PostInstanceToBatch(self, instance);
+
+    resp = PostInstanceMsg_New(self->request->base.operationId);
 
     if (!resp)
         return MI_RESULT_FAILED;
@@ -1772,6 +1989,20 @@ static void _Context_Finish( _In_ Strand* self_ )
     Context* self = FromOffset(Context,strand,self_);
 
     trace_ContextFinish( self_ );
+
+    // The context has to outlive a pending instance batch timer
+    Lock_Acquire(&self->lock);
+
+    if (self->instanceBatchTimerArmed)
+    {
+        self->destroyOnInstanceBatchTimer = MI_TRUE;
+        Selector_UpdateTimer(_GetProvMgr(self)->selector, &self->instanceBatchTimer, 0);
+        Lock_Release(&self->lock);
+        return;
+    }
+
+    Lock_Release(&self->lock);
+
     _Context_Destroy(self);
 }
 
@@ -34,6 +34,12 @@ typedef enum _Context_Type
 }
 Context_Type;
 
+// budget of Context.instanceBatch besides ProvMgr.instanceBatchSize; pages are
+// kept well below PROTOCOL_HEADER_MAX_PAGES as one instance can add a few
+#define CONTEXT_INSTANCEBATCH_MAX_BYTES     (64 * 1024)
+#define CONTEXT_INSTANCEBATCH_MAX_PAGES     32
+#define CONTEXT_INSTANCEBATCH_DELAY_USEC    (100 * 1000)
+
 // for Context.tryingToPostLeft
 #define CONTEXT_POSTLEFT_POSTING    1   // If Context_PostMessageLeft is trying to post to the left
 #define CONTEXT_POSTLEFT_SCHEDULED  2   // If CONTEXT_STRANDAUX_POSTLEFT is currently scheduled
@@ -89,6 +95,18 @@ typedef struct _Context
     MI_Boolean          postedModifyGetInstance;
     MI_Boolean          postedModifyEnumInstance;
     MI_Boolean          postedModifyInstance;
+
+    /* Instances not posted yet (see ProvMgr.instanceBatchSize) and when the
+       first of them was packed; protected by lock */
+    PostInstanceBatchMsg* instanceBatch;
+    MI_Uint64           instanceBatchStart;
+
+    /* Flushes instanceBatch when a provider stops posting; the flags are
+       protected by lock and the context is destroyed by the timer callback
+       if it finishes while the timer is armed */
+    SelectorTimer       instanceBatchTimer;
+    MI_Boolean          instanceBatchTimerArmed;
+    MI_Boolean          destroyOnInstanceBatchTimer;
 }
 Context;
 
@@ -2254,7 +2254,8 @@ void Provider_Release(Provider* provider)
                     provider->lib->provmgr->timeoutHandler.fireTimeoutAt += provider->lib->provmgr->idleTimeoutUsec;
 
                     /* wakeup main thread */
-                    Selector_Wakeup(provider->lib->provmgr->selector, MI_TRUE);
+                    Selector_UpdateHandler(provider->lib->provmgr->selector,
+                        &provider->lib->provmgr->timeoutHandler, MI_TRUE);
                 }
             }
         }
@@ -62,8 +62,16 @@ struct _ProvMgr
     ptrdiff_t localSessionInitialized; /* 0 =  no, 1 = initializing, 2 = initialized */
 
     ThreadID ioThreadId;
+
+    /* Instances an enumeration packs into one PostInstanceBatchMsg before it
+       is posted (0: one PostInstanceMsg per instance); only the server knows
+       how to split the batches, so only agents set it */
+    MI_Uint32 instanceBatchSize;
 };
 
+/* Value the agent uses for ProvMgr.instanceBatchSize */
+#define PROVMGR_INSTANCEBATCH_SIZE 64
+
 MI_Result ProvMgr_Init(
     ProvMgr* self,
     Selector* selector,
@@ -94,6 +94,13 @@ typedef struct _Options
     SSL_Options sslOptions;
     MI_Uint64 idletimeout;
     MI_Uint64 livetime;
+    MI_Uint32 iothreads;
+    MI_Uint32 agentringsize;
+    MI_Uint32 httpcompressionlevel;
+    MI_Uint32 httpcompressionthreshold;
+    MI_Uint32 maxenumcontexts;
+    MI_Uint32 maxenumcontextsmemory;
+    MI_Uint64 enumcontexttimeout;
     Log_Level logLevel;
     char *ntlmCredFile;
 }
@@ -101,6 +108,21 @@ Options;
 
 static Lock s_disp_mutex = LOCK_INITIALIZER;
 
+/* upper limit for 'iothreads' option */
+#define MAX_IO_THREADS 256
+
+/* upper limit for 'agentringsize' option (kilobytes) */
+#define MAX_AGENT_RING_SIZE_KB (64 * 1024)
+
+/* upper limit for 'httpcompressionlevel' option (zlib levels) */
+#define MAX_HTTP_COMPRESSION_LEVEL 9
+
+/* upper limit for 'maxenumcontextsmemory' option (megabytes) */
+#define MAX_ENUM_CONTEXTS_MEMORY_MB (1024 * 1024)
+
+/* upper limit for 'enumcontexttimeout' option (seconds) */
+#define MAX_ENUM_CONTEXT_TIMEOUT (365 * 24 * 60 * 60)
+
 static Options s_opts;
 
 static ServerData s_data;
@@ -121,6 +143,11 @@ OPTIONS:\n\
     --httpport PORT             HTTP protocol listener port.\n\
     --httpsport PORT            HTTPS protocol listener port.\n\
     --idletimeout TIMEOUT       Idle providers unload timeout (in seconds).\n\
+    --iothreads COUNT           Threads serving WS-Man connections (default 0:\n\
+                                served by the main server thread).\n\
+    --agentringsize KB          Pass message pages to and from agents through\n\
+                                shared-memory rings of this size (default 0:\n\
+                                through the socket).\n\
     -v, --version               Print version information.\n\
     -l, --logstderr             Send log output to standard error.\n\
     --loglevel LEVEL            Set logging level to one of the following\n\
@@ -468,6 +495,8 @@ static void GetCommandLineOptions(
         "--httpsport:",
         "--idletimeout:",
         "--livetime:",
+        "--iothreads:",
+        "--agentringsize:",
         "--ignoreAuthentication",
         "-i",
         "--prefix:",
@@ -613,6 +642,32 @@ static void GetCommandLineOptions(
 
             s_opts.livetime = x;
         }
+        else if (strcmp(state.opt, "--iothreads") == 0)
+        {
+            char* end;
+            MI_Uint64 x = Strtoull(state.arg, &end, 10);
+
+            if (*end != '\0' || x > MAX_IO_THREADS)
+            {
+                err(ZT("bad option argument for --iothreads: %s"), 
+                    scs(state.arg));
+            }
+
+            s_opts.iothreads = (MI_Uint32)x;
+        }
+        else if (strcmp(state.opt, "--agentringsize") == 0)
+        {
+            char* end;
+            MI_Uint64 x = Strtoull(state.arg, &end, 10);
+
+            if (*end != '\0' || x > MAX_AGENT_RING_SIZE_KB)
+            {
+                err(ZT("bad option argument for --agentringsize: %s"), 
+                    scs(state.arg));
+            }
+
+            s_opts.agentringsize = (MI_Uint32)x;
+        }
         else if (strcmp(state.opt, "--ignoreAuthentication") == 0 ||
              strcmp(state.opt, "-i") == 0)
         {
@@ -805,6 +860,97 @@ static void GetConfigFileOptions()
 
             s_opts.livetime = x;
         }
+        else if (strcmp(key, "iothreads") == 0)
+        {
+            char* end;
+            MI_Uint64 x = Strtoull(value, &end, 10);
+
+            if (*end != '\0' || x > MAX_IO_THREADS)
+            {
+                err(ZT("%s(%u): invalid value for '%s': %s"), scs(path), 
+                    Conf_Line(conf), scs(key), scs(value));
+            }
+
+            s_opts.iothreads = (MI_Uint32)x;
+        }
+        else if (strcmp(key, "agentringsize") == 0)
+        {
+            char* end;
+            MI_Uint64 x = Strtoull(value, &end, 10);
+
+            if (*end != '\0' || x > MAX_AGENT_RING_SIZE_KB)
+            {
+                err(ZT("%s(%u): invalid value for '%s': %s"), scs(path), 
+                    Conf_Line(conf), scs(key), scs(value));
+            }
+
+            s_opts.agentringsize = (MI_Uint32)x;
+        }
+        else if (strcmp(key, "httpcompressionlevel") == 0)
+        {
+            char* end;
+            MI_Uint64 x = Strtoull(value, &end, 10);
+
+            if (*end != '\0' || x > MAX_HTTP_COMPRESSION_LEVEL)
+            {
+                err(ZT("%s(%u): invalid value for '%s': %s"), scs(path), 
+                    Conf_Line(conf), scs(key), scs(value));
+            }
+
+            s_opts.httpcompressionlevel = (MI_Uint32)x;
+        }
+        else if (strcmp(key, "httpcompressionthreshold") == 0)
+        {
+            char* end;
+            MI_Uint64 x = Strtoull(value, &end, 10);
+
+            if (*end != '\0' || x > PAL_UINT32_MAX)
+            {
+                err(ZT("%s(%u): invalid value for '%s': %s"), scs(path), 
+                    Conf_Line(conf), scs(key), scs(value));
+            }
+
+            s_opts.httpcompressionthreshold = (MI_Uint32)x;
+        }
+        else if (strcmp(key, "maxenumcontexts") == 0)
+        {
+            char* end;
+            MI_Uint64 x = Strtoull(value, &end, 10);
+
+            if (*end != '\0' || x == 0 || x > PAL_UINT32_MAX)
+            {
+                err(ZT("%s(%u): invalid value for '%s': %s"), scs(path), 
+                    Conf_Line(conf), scs(key), scs(value));
+            }
+
+            s_opts.maxenumcontexts = (MI_Uint32)x;
+        }
+        else if (strcmp(key, "maxenumcontextsmemory") == 0)
+        {
+            char* end;
+            MI_Uint64 x = Strtoull(value, &end, 10);
+
+            if (*end != '\0' || x > MAX_ENUM_CONTEXTS_MEMORY_MB)
+            {
+                err(ZT("%s(%u): invalid value for '%s': %s"), scs(path), 
+                    Conf_Line(conf), scs(key), scs(value));
+            }
+
+            s_opts.maxenumcontextsmemory = (MI_Uint32)x;
+        }
+        else if (strcmp(key, "enumcontexttimeout") == 0)
+        {
+            char* end;
+            MI_Uint64 x = Strtoull(value, &end, 10);
+
+            if (*end != '\0' || x > MAX_ENUM_CONTEXT_TIMEOUT)
+            {
+                err(ZT("%s(%u): invalid value for '%s': %s"), scs(path), 
+                    Conf_Line(conf), scs(key), scs(value));
+            }
+
+            s_opts.enumcontexttimeout = x;
+        }
         else if (strcmp(key, "trace") == 0)
         {
             if (Strcasecmp(value, "true") == 0)
@@ -1002,6 +1148,11 @@ int servermain(int argc, const char* argv[])
     s_opts.sslOptions = DISABLE_SSL_V2;
     s_opts.idletimeout = 0;
     s_opts.livetime = 0;
+    s_opts.httpcompressionlevel = HTTP_DEFAULT_COMPRESSION_LEVEL;
+    s_opts.httpcompressionthreshold = HTTP_DEFAULT_COMPRESSION_THRESHOLD;
+    s_opts.maxenumcontexts = WSMAN_DEFAULT_MAX_ENUM_CONTEXTS;
+    s_opts.maxenumcontextsmemory = WSMAN_DEFAULT_MAX_ENUM_CONTEXTS_MEMORY / (1024 * 1024);
+    s_opts.enumcontexttimeout = WSMAN_DEFAULT_ENUM_CONTEXT_TIMEOUT_USEC / 1000000;
 
     /* Get --destdir command-line option */
     GetCommandLineDestDirOption(&argc, argv);
@@ -1176,6 +1327,8 @@ int servermain(int argc, const char* argv[])
             s_data.disp.agentmgr.provmgr.idleTimeoutUsec = s_opts.idletimeout * 1000000;
         }
 
+        s_data.disp.agentmgr.ringSize = (size_t)s_opts.agentringsize * 1024;
+
         /* Set WSMAN options and create WSMAN server */
         s_data.wsman_size = s_opts.httpport_size + s_opts.httpsport_size;
         if ( s_data.wsman_size > 0 )
@@ -1194,6 +1347,13 @@ int servermain(int argc, const char* argv[])
             options.enableTracing = s_opts.trace;
 #endif
             options.enableHTTPTracing = s_opts.httptrace;
+            options.ioThreads = s_opts.iothreads;
+            options.compressionLevel = s_opts.httpcompressionlevel;
+            options.compressionThreshold = s_opts.httpcompressionthreshold;
+            options.maxEnumContexts = s_opts.maxenumcontexts;
+            options.maxEnumContextsMemory =
+                (MI_Uint64)s_opts.maxenumcontextsmemory * 1024 * 1024;
+            options.timeoutEnumContextUsec = s_opts.enumcontexttimeout * 1000000;
 
             /* Start up the non-encrypted listeners */
             int count;
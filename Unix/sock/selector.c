@@ -14,6 +14,7 @@
 #include <base/log.h>
 #include <base/result.h>
 #include <pal/atomic.h>
+#include <pal/lock.h>
 
 //#define  ENABLE_TRACING 1
 #ifdef ENABLE_TRACING
@@ -65,6 +66,10 @@ static const char* FmtTime(MI_Uint64 Time)
 /* maximum instances that can be allocated */
 #define MAX_ALLOCATED_INSTANCES 500
 
+static void _FlushTimers(
+    Selector* self,
+    MI_Uint32 mask);
+
 /*
 **==============================================================================
 **
@@ -122,6 +127,11 @@ typedef struct _SelectorRep
     /* io thread id */
     ThreadID    ioThreadHandle;
 
+    /* pending timers: min-heap ordered by expiration time */
+    SelectorTimer* timers;
+    size_t timersCount;
+    Lock timersLock;
+
     /* flag to stop running */
     MI_Boolean keepRunning;
     MI_Boolean keepRunningNoReadsMode;
@@ -218,6 +228,7 @@ MI_Result Selector_Init(
     }
 
     rep->callbacksList = &rep->__callback_list_object;
+    Lock_Init(&rep->timersLock);
 
     rep->callbacksAreAvailable = CreateEvent( 0, TRUE, FALSE, NULL );
 
@@ -251,6 +262,8 @@ void Selector_Destroy(Selector* self)
         (*p->callback)(self, p, SELECTOR_DESTROY, 0);
     }
 
+    _FlushTimers(self, SELECTOR_DESTROY);
+
     CloseHandle(rep->event);
     CloseHandle(rep->callbacksAreAvailable);
 
@@ -343,6 +356,8 @@ MI_Result Selector_RemoveAllHandlers(
         p = next;
     }
 
+    _FlushTimers(self, SELECTOR_REMOVE);
+
     return MI_RESULT_OK;
 }
 
@@ -465,9 +480,90 @@ MI_Result Selector_CallInIOThread(
 # include <netdb.h>
 # include <fcntl.h>
 # include <arpa/inet.h>
+# if defined(CONFIG_HAVE_EVENTFD)
+#  include <sys/eventfd.h>
+# endif
+# if defined(CONFIG_HAVE_EPOLL)
+#  include <sys/epoll.h>
+
+/* maximum number of events returned by a single epoll_wait call */
+#  define SELECTOR_MAX_EVENTS 256
+# endif
+# if defined(CONFIG_HAVE_IO_URING)
+#  include <poll.h>
+#  include <endian.h>
+#  include <sys/mman.h>
+#  include <sys/syscall.h>
+#  include <linux/io_uring.h>
+
+/* number of submission queue entries */
+#  define SELECTOR_RING_ENTRIES 256
+
+/* user_data of completions that do not belong to a socket */
+#  define SELECTOR_RING_NOTIFY ((MI_Uint64)-1)
+#  define SELECTOR_RING_CANCEL ((MI_Uint64)-2)
+
+/* io_uring instance shared with the kernel */
+typedef struct _SelectorRing
+{
+    /* -1 when io_uring is not in use */
+    int fd;
+
+    /* submission queue */
+    unsigned* sqHead;
+    unsigned* sqTail;
+    unsigned* sqArray;
+    unsigned sqMask;
+    unsigned sqEntries;
+    struct io_uring_sqe* sqes;
+
+    /* entries queued since last submission */
+    unsigned sqLocalTail;
+    unsigned sqPending;
+
+    /* completion queue */
+    unsigned* cqHead;
+    unsigned* cqTail;
+    unsigned cqMask;
+    struct io_uring_cqe* cqes;
+
+    /* mappings */
+    void* sqRing;
+    size_t sqRingSize;
+    void* cqRing;
+    size_t cqRingSize;
+    size_t sqesSize;
+
+    /* notification channel poll is pending */
+    MI_Boolean notifyArmed;
+
+    /* polls submitted or queued whose completion was not reaped yet */
+    unsigned inflight;
+
+    /* thread that armed the polls (see _RingTakeOver) and its record */
+    ThreadID owner;
+    MI_Boolean ownerSet;
+    struct _SelectorRingThread* thread;
+}
+SelectorRing;
+
+/* poll state of a socket; polls are one-shot and re-armed by the loop */
+typedef struct _SelectorRingSlot
+{
+    /* bumped on every arm/disarm; stale completions are recognized by it */
+    MI_Uint32 seq;
+
+    /* events of the pending poll, 0 if none */
+    MI_Uint32 armed;
+}
+SelectorRingSlot;
+# endif
 
 typedef struct _SelectorCallbacksItem
 {
+    /* Link in the list of posted callbacks */
+    struct _SelectorCallbacksItem* next;
+
     Selector_NotificationCallback  callback;
     void* callback_self;
     /* message has to be add-refed when added and dec-refed upon callback invocation */
@@ -477,18 +573,65 @@ SelectorCallbacksItem;
 
 typedef struct _SelectorRep
 {
+#if defined(CONFIG_HAVE_EPOLL)
+    /* epoll instance monitoring all handler sockets */
+    int epollFd;
+
+    /* handlers registered with epoll, indexed by socket */
+    Handler** sockHandlers;
+    int sockHandlersSize;
+
+# if defined(CONFIG_HAVE_IO_URING)
+    /* used instead of epoll when kernel supports it; polls for sockets 
+        are queued and then submitted together with the wait */
+    SelectorRing ring;
+
+    /* same index as sockHandlers */
+    SelectorRingSlot* ringSlots;
+# endif
+#else
     /* File descriptor sets */
     fd_set readSet;
     fd_set writeSet;
     fd_set exceptSet;
+#endif
 
     /* Linked list of event watchers */
     ListElem* head;
     ListElem* tail;
 
-    /* notifications channel */
+    /* notifications channel: [0] is watched by the io thread, [1] is
+        written by other threads; both are the same eventfd if available */
     int notificationSockets[2];
 
+    /* callbacks posted by other threads (SelectorCallbacksItem*); pushed
+        lock-free, most recent first, and taken by the io thread at once */
+    volatile ptrdiff_t callbacks;
+
+    /* pending timers: min-heap ordered by expiration time */
+    SelectorTimer* timers;
+    size_t timersCount;
+    Lock timersLock;
+
+    /* handlers added by other threads once selector has run; they are
+        moved to the list by the io thread (guarded by pendingLock) */
+    ListElem* pendingHead;
+    ListElem* pendingTail;
+    Lock pendingLock;
+    MI_Boolean ioThreadSet;
+
+#if defined(CONFIG_HAVE_EPOLL)
+    /* handlers whose mask or timeout may have changed since their socket
+        was last registered and timer scheduled (guarded by pendingLock) */
+    Handler* changedHead;
+
+    /* mode sockets are registered for; a nested run may use another one */
+    MI_Boolean noReadsMode;
+
+    /* every handler has to be brought up to date (polls were cancelled) */
+    MI_Boolean syncAll;
+#endif
+
     /* flag to stop running */
     MI_Boolean keepRunning;
     MI_Boolean keepRunningNoReadsMode;
@@ -507,297 +650,1562 @@ typedef struct _SelectorRep
 }
 SelectorRep;
 
-static int _Select(
-    fd_set* readSet,
-    fd_set* writeSet,
-    fd_set* exceptSet,
+static void _AddPendingHandlers(
+    Selector* self);
+
+#if defined(CONFIG_HAVE_EPOLL)
+static void _MarkHandlerChanged(
+    SelectorRep* rep,
+    Handler* p);
+
+static void _UnscheduleHandler(
+    SelectorRep* rep,
+    Handler* p);
+
+static int _EpollWait(
+    SelectorRep* rep,
+    struct epoll_event* events,
     MI_Uint64 timeoutUsec,
     MI_Boolean* keepRunning)
 {
-    int n = FD_SETSIZE;
     int r;
-    struct timeval tv;
-    struct timeval* _tv = 0;
+    int timeoutMsec = -1;
 
     if ((MI_Uint64)-1 != timeoutUsec)
     {
-        tv.tv_sec = (long)(timeoutUsec / 1000000);
-        tv.tv_usec = (long)(timeoutUsec % 1000000);
-        _tv = &tv;
+        /* round up, so sub-millisecond timeouts do not spin */
+        MI_Uint64 msec = (timeoutUsec + 999) / 1000;
+        timeoutMsec = msec > 0x7FFFFFFF ? 0x7FFFFFFF : (int)msec;
     }
 
     do
     {
-        r = select(n, readSet, writeSet, exceptSet, _tv);
+        r = epoll_wait(rep->epollFd, events, SELECTOR_MAX_EVENTS, timeoutMsec);
     }
     while( (*keepRunning == MI_TRUE) && ( -1 == r ) && ( errno == EINTR ) );
 
     return r;
 }
 
-MI_INLINE void _FDSet(Sock sock, fd_set* set)
+#if defined(CONFIG_HAVE_IO_URING)
+
+static void* _RingMap(
+    int fd,
+    size_t size,
+    off_t offset)
 {
-    FD_SET(sock, set);
+    void* p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, offset);
+
+    return p == MAP_FAILED ? NULL : p;
 }
 
-MI_INLINE void _FDClr(Sock sock, fd_set* set)
+static void _RingClose(
+    SelectorRing* ring)
 {
-    FD_CLR(sock, set);
+    if (ring->sqes)
+        munmap(ring->sqes, ring->sqesSize);
+
+    if (ring->cqRing && ring->cqRing != ring->sqRing)
+        munmap(ring->cqRing, ring->cqRingSize);
+
+    if (ring->sqRing)
+        munmap(ring->sqRing, ring->sqRingSize);
+
+    if (ring->fd != -1)
+        close(ring->fd);
+
+    memset(ring, 0, sizeof(*ring));
+    ring->fd = -1;
 }
 
-MI_Result Selector_Init(
-    Selector* self)
+/* Sets up the ring; returns -1 if kernel does not support all we need */
+static int _RingOpen(
+    SelectorRing* ring)
 {
-    self->rep = (SelectorRep*)PAL_Calloc(1, sizeof(SelectorRep));
+    struct io_uring_params params;
+    const MI_Uint32 features = IORING_FEAT_NODROP | IORING_FEAT_EXT_ARG;
 
-    if (!self->rep)
-        return MI_RESULT_FAILED;
+    memset(ring, 0, sizeof(*ring));
+    memset(&params, 0, sizeof(params));
 
-    if (pipe(self->rep->notificationSockets) != 0)
-        return MI_RESULT_FAILED;
+    /* ring fd is always close-on-exec */
+    ring->fd = (int)syscall(__NR_io_uring_setup, SELECTOR_RING_ENTRIES, &params);
 
-    /* set non-blocking for reader [0] */
-    Sock_SetBlocking( self->rep->notificationSockets[0], MI_FALSE);
+    if (ring->fd == -1)
+        return -1;
 
-    /* Protect notification sockets from child processes */
-    if (MI_RESULT_OK != Sock_SetCloseOnExec(self->rep->notificationSockets[0],MI_TRUE) ||
-        MI_RESULT_OK != Sock_SetCloseOnExec(self->rep->notificationSockets[1],MI_TRUE))
+    /* completions of many pending polls must not be dropped and
+        waits take a timeout */
+    if ((params.features & features) != features)
+        goto failed;
+
+    ring->sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring->cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    ring->sqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+
+    if (params.features & IORING_FEAT_SINGLE_MMAP)
     {
-        trace_fcntl_failed( errno );
+        if (ring->cqRingSize > ring->sqRingSize)
+            ring->sqRingSize = ring->cqRingSize;
+
+        ring->cqRingSize = ring->sqRingSize;
     }
 
-    return MI_RESULT_OK;
+    ring->sqRing = _RingMap(ring->fd, ring->sqRingSize, IORING_OFF_SQ_RING);
+
+    if (!ring->sqRing)
+        goto failed;
+
+    if (params.features & IORING_FEAT_SINGLE_MMAP)
+        ring->cqRing = ring->sqRing;
+    else
+        ring->cqRing = _RingMap(ring->fd, ring->cqRingSize, IORING_OFF_CQ_RING);
+
+    ring->sqes = (struct io_uring_sqe*)_RingMap(ring->fd, ring->sqesSize, IORING_OFF_SQES);
+
+    if (!ring->cqRing || !ring->sqes)
+        goto failed;
+
+    ring->sqHead = (unsigned*)((char*)ring->sqRing + params.sq_off.head);
+    ring->sqTail = (unsigned*)((char*)ring->sqRing + params.sq_off.tail);
+    ring->sqArray = (unsigned*)((char*)ring->sqRing + params.sq_off.array);
+    ring->sqMask = *(unsigned*)((char*)ring->sqRing + params.sq_off.ring_mask);
+    ring->sqEntries = params.sq_entries;
+    ring->sqLocalTail = *ring->sqTail;
+
+    ring->cqHead = (unsigned*)((char*)ring->cqRing + params.cq_off.head);
+    ring->cqTail = (unsigned*)((char*)ring->cqRing + params.cq_off.tail);
+    ring->cqMask = *(unsigned*)((char*)ring->cqRing + params.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe*)((char*)ring->cqRing + params.cq_off.cqes);
+
+    return 0;
+
+failed:
+    _RingClose(ring);
+    return -1;
 }
 
-void Selector_Destroy(Selector* self)
+static int _RingEnter(
+    SelectorRing* ring,
+    unsigned minComplete,
+    unsigned flags,
+    void* arg,
+    size_t argSize)
 {
-    SelectorRep* rep = (SelectorRep*)self->rep;
-    Handler* p;
-    Handler* next;
+    int r;
 
-    /* Free all watchers */
-    for (p = (Handler*)rep->head; p; p = next)
+    /* make queued entries visible to the kernel */
+    __atomic_store_n(ring->sqTail, ring->sqLocalTail, __ATOMIC_RELEASE);
+
+    r = (int)syscall(__NR_io_uring_enter, ring->fd, ring->sqPending, 
+        minComplete, flags, arg, argSize);
+
+    /* returns number of entries consumed, if any */
+    if (r > 0)
+        ring->sqPending -= (unsigned)r > ring->sqPending ? ring->sqPending : (unsigned)r;
+
+    return r;
+}
+
+/* Hands queued entries to the kernel without waiting */
+static int _RingSubmit(
+    SelectorRing* ring)
+{
+    int r;
+
+    if (!ring->sqPending)
+        return 0;
+
+    do
     {
-        next = (Handler*)p->next;
+        r = _RingEnter(ring, 0, 0, NULL, 0);
+    }
+    while (-1 == r && EINTR == errno);
 
-        (*p->callback)(self, p, SELECTOR_DESTROY, 0);
-        p = next;
+    return r < 0 ? -1 : 0;
+}
+
+static struct io_uring_sqe* _RingGetSqe(
+    SelectorRing* ring)
+{
+    struct io_uring_sqe* sqe;
+    unsigned index;
+
+    /* queue is full: flush it first */
+    if (ring->sqLocalTail - __atomic_load_n(ring->sqHead, __ATOMIC_ACQUIRE) >= ring->sqEntries)
+    {
+        if (0 != _RingSubmit(ring) ||
+            ring->sqLocalTail - __atomic_load_n(ring->sqHead, __ATOMIC_ACQUIRE) >= ring->sqEntries)
+        {
+            return NULL;
+        }
     }
 
-    Sock_Close(rep->notificationSockets[0]);
-    Sock_Close(rep->notificationSockets[1]);
+    index = ring->sqLocalTail & ring->sqMask;
+    sqe = &ring->sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    ring->sqArray[index] = index;
+    ring->sqLocalTail++;
+    ring->sqPending++;
 
-    PAL_Free(rep);
+    return sqe;
 }
 
-MI_Result Selector_AddHandler(
-    Selector* self,
-    Handler* handler)
+static void _RingPrepPoll(
+    struct io_uring_sqe* sqe,
+    int fd,
+    MI_Uint32 events,
+    MI_Uint64 userData)
 {
-    SelectorRep* rep = (SelectorRep*)self->rep;
-    Handler* p;
-    MI_Uint64 currentTimeUsec = 0;
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = fd;
+#if __BYTE_ORDER == __BIG_ENDIAN
+    /* kernel reads the field as two 16-bit halves */
+    sqe->poll32_events = (events << 16) | (events >> 16);
+#else
+    sqe->poll32_events = events;
+#endif
+    sqe->user_data = userData;
+}
 
-    if (PAL_TRUE != PAL_Time(&currentTimeUsec))
+MI_INLINE MI_Uint64 _RingUserData(
+    Sock sock,
+    MI_Uint32 seq)
+{
+    return ((MI_Uint64)seq << 32) | (MI_Uint32)sock;
+}
+
+/* Queues a poll for 'wanted' selector events on the socket */
+static MI_Result _RingArm(
+    SelectorRep* rep,
+    Sock sock,
+    MI_Uint32 wanted)
+{
+    SelectorRingSlot* slot = &rep->ringSlots[sock];
+    struct io_uring_sqe* sqe = _RingGetSqe(&rep->ring);
+    MI_Uint32 events = 0;
+
+    if (!sqe)
         return MI_RESULT_FAILED;
 
-    /* Reject duplicates */
-    for (p = (Handler*)rep->head; p; p = (Handler*)p->next)
-    {
-        if (p == handler)
-            return MI_RESULT_ALREADY_EXISTS;
-    }
+    if (wanted & SELECTOR_READ)
+        events |= POLLIN;
 
-    /* Add new handler to list */
-    List_Append(&rep->head, &rep->tail, (ListElem*)handler);
+    if (wanted & SELECTOR_WRITE)
+        events |= POLLOUT;
 
-    (*handler->callback)(self, handler, SELECTOR_ADD, currentTimeUsec);
+    slot->seq++;
+    slot->armed = wanted;
+    rep->ring.inflight++;
+    _RingPrepPoll(sqe, sock, events, _RingUserData(sock, slot->seq));
 
     return MI_RESULT_OK;
 }
 
-MI_Result Selector_RemoveHandler(
-    Selector* self,
-    Handler* handler)
+/* Queues removal of the socket's pending poll, if any */
+static void _RingDisarm(
+    SelectorRep* rep,
+    Sock sock)
 {
-    SelectorRep* rep = (SelectorRep*)self->rep;
-    Handler* p;
+    SelectorRingSlot* slot = &rep->ringSlots[sock];
+    struct io_uring_sqe* sqe;
 
-    /* Find and remove handler from list */
-    for (p = (Handler*)rep->head; p; p = (Handler*)p->next)
-    {
-        if (p == handler)
-        {
-            /* Remove handler */
-            List_Remove(&rep->head, &rep->tail, (ListElem*)p);
+    if (!slot->armed)
+        return;
 
-            /* Notify handler of removal */
-            (*handler->callback)(self, p, SELECTOR_REMOVE, 0);
+    sqe = _RingGetSqe(&rep->ring);
 
-            return MI_RESULT_OK;
-        }
+    if (sqe)
+    {
+        sqe->opcode = IORING_OP_POLL_REMOVE;
+        sqe->fd = -1;
+        sqe->addr = _RingUserData(sock, slot->seq);
+        sqe->user_data = SELECTOR_RING_CANCEL;
     }
 
-    return MI_RESULT_NOT_FOUND;
+    /* completion of removed poll (if it fires anyway) is ignored */
+    slot->seq++;
+    slot->armed = 0;
 }
 
-MI_Result Selector_RemoveAllHandlers(
-    Selector* self)
+/* Submits queued polls, waits for completions and converts them into
+    epoll events, so they are dispatched the same way */
+static int _RingWait(
+    SelectorRep* rep,
+    struct epoll_event* events,
+    MI_Uint64 timeoutUsec,
+    MI_Boolean* keepRunning)
 {
-    SelectorRep* rep = (SelectorRep*)self->rep;
-    Handler* p;
+    SelectorRing* ring = &rep->ring;
+    struct io_uring_getevents_arg arg;
+    struct __kernel_timespec ts;
+    unsigned head;
+    unsigned tail;
+    int n = 0;
+    int r;
 
-    /* Find and remove handler from list */
-    for (p = (Handler*)rep->head; p; )
+    if (!ring->notifyArmed)
     {
-        Handler* next = p->next;
+        struct io_uring_sqe* sqe = _RingGetSqe(ring);
 
-        /* Remove handler */
-        List_Remove(&rep->head, &rep->tail, (ListElem*)p);
+        if (!sqe)
+            return -1;
 
-        /* Notify handler of removal */
-        (*p->callback)(self, p, SELECTOR_REMOVE, 0);
+        _RingPrepPoll(sqe, rep->notificationSockets[0], POLLIN, SELECTOR_RING_NOTIFY);
+        ring->notifyArmed = MI_TRUE;
+        ring->inflight++;
+    }
 
-        p = next;
+    memset(&arg, 0, sizeof(arg));
+
+    if ((MI_Uint64)-1 != timeoutUsec)
+    {
+        ts.tv_sec = (long long)(timeoutUsec / 1000000);
+        ts.tv_nsec = (long long)(timeoutUsec % 1000000) * 1000;
+        arg.ts = (MI_Uint64)(ptrdiff_t)&ts;
     }
 
-    return MI_RESULT_OK;
-}
+    do
+    {
+        r = _RingEnter(ring, 1, IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, 
+            &arg, sizeof(arg));
+    }
+    while( (*keepRunning == MI_TRUE) && ( -1 == r ) && ( errno == EINTR ) );
 
-static void _ProcessCallbacks(
-    SelectorRep* rep)
-{
-    SelectorCallbacksItem* item = NULL;
-    size_t read = 0;
-    MI_Result r;
+    /* timeout expired */
+    if (-1 == r && ETIME != errno)
+        return -1;
 
-    LOGD2((ZT("_ProcessCallbacks - Begin. notification socket: %d"), rep->notificationSockets[0]));
-    while( (r = Sock_Read(rep->notificationSockets[0], &item, sizeof(item), &read)) == MI_RESULT_OK &&
-           read == sizeof(item) )
+    head = *ring->cqHead;
+    tail = __atomic_load_n(ring->cqTail, __ATOMIC_ACQUIRE);
+
+    /* completions beyond SELECTOR_MAX_EVENTS are left for next wait */
+    for (; head != tail && n < SELECTOR_MAX_EVENTS; head++)
     {
-        if (item)
+        struct io_uring_cqe* cqe = &ring->cqes[head & ring->cqMask];
+        Sock sock = (Sock)(MI_Uint32)cqe->user_data;
+        SelectorRingSlot* slot;
+
+        if (SELECTOR_RING_CANCEL == cqe->user_data)
+            continue;
+
+        ring->inflight--;
+
+        if (SELECTOR_RING_NOTIFY == cqe->user_data)
+        {
+            ring->notifyArmed = MI_FALSE;
+            sock = rep->notificationSockets[0];
+        }
+        else
         {
-            LOGD2((ZT("_ProcessCallbacks - Calling item callback")));
-            (*item->callback) (item->callback_self, item->message);
-            Message_Release(item->message);
-            //Atomic_Dec( &rep->queueLength );
+            if (sock < 0 || sock >= rep->sockHandlersSize)
+                continue;
+
+            slot = &rep->ringSlots[sock];
+
+            /* socket was disarmed or re-armed meanwhile */
+            if (!slot->armed || _RingUserData(sock, slot->seq) != cqe->user_data)
+                continue;
+
+            slot->armed = 0;
         }
+
+        /* poll events have the same values as epoll ones; failure to
+            poll is reported as an error on the socket */
+        events[n].events = cqe->res < 0 ? EPOLLERR : (MI_Uint32)cqe->res;
+        events[n].data.fd = sock;
+        n++;
     }
-    LOGD2((ZT("_ProcessCallbacks - End. last result: %d (%s)"), r, mistrerror(r)));
-}
 
-void _Selector_WakeupFromWait(
-    SelectorRep* rep)
-{
-    void* p = 0;
-    size_t sent = 0;
+    __atomic_store_n(ring->cqHead, head, __ATOMIC_RELEASE);
 
-    Sock_Write( rep->notificationSockets[1], &p, sizeof(p), &sent);
+    return n;
 }
 
-/* 
-    * This function guaranties that callback is called in 'Run'/'IO' thread context,
-    * so locking is required for accessing sokcet objects, updating buffers etc
-*/
-MI_Result Selector_CallInIOThread(
-    Selector* self,
-    Selector_NotificationCallback  callback,
-    void* callback_self,
-    Message* message)
+/* Cancels all polls and waits for them to complete. Completion of a poll 
+    is run by the thread that submitted it; if that thread is gone, kernel 
+    finishes the poll (and closes its socket) in the background. So polls
+    are cancelled before the thread that armed them exits, when another 
+    thread takes over the selector and when the selector is destroyed */
+static void _RingQuiesce(
+    SelectorRep* rep)
 {
-    SelectorRep* rep = (SelectorRep*)self->rep;
-    SelectorCallbacksItem* newItem;
-    MI_Result r;
-    size_t sent = 0;
-    ThreadID current = Thread_ID();
+    SelectorRing* ring = &rep->ring;
+    struct io_uring_getevents_arg arg;
+    struct __kernel_timespec ts;
+    int sock;
+    int r;
 
-    if (Thread_Equal(&rep->ioThreadHandle, &current))
+    for (sock = 0; sock < rep->sockHandlersSize; sock++)
+        _RingDisarm(rep, sock);
+
+    if (ring->notifyArmed)
     {
-        /* direct call - we can write to socket instantly */
+        struct io_uring_sqe* sqe = _RingGetSqe(ring);
 
-        trace_Sock_SendingOnOwnThread(
-            message,
-            message->tag,
-            MessageName(message->tag),
-            message->operationId);
-        
-        (*callback)(callback_self, message);
-        return MI_RESULT_OK;
+        if (sqe)
+        {
+            sqe->opcode = IORING_OP_POLL_REMOVE;
+            sqe->fd = -1;
+            sqe->addr = SELECTOR_RING_NOTIFY;
+            sqe->user_data = SELECTOR_RING_CANCEL;
+        }
+
+        ring->notifyArmed = MI_FALSE;
     }
 
-    /* add item to the list and set event */
-    newItem = (SelectorCallbacksItem*) Batch_GetClear( message->batch, sizeof(SelectorCallbacksItem));
+    /* cancellation completes at once; timeout only guards against 
+        a broken ring */
+    memset(&arg, 0, sizeof(arg));
+    ts.tv_sec = 1;
+    ts.tv_nsec = 0;
+    arg.ts = (MI_Uint64)(ptrdiff_t)&ts;
 
-    if (!newItem)
-        return MI_RESULT_FAILED;
+    while (ring->inflight)
+    {
+        unsigned head;
+        unsigned tail;
 
-    newItem->callback = callback;
-    newItem->callback_self = callback_self;
-    newItem->message = message;
+        r = _RingEnter(ring, 1, IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, 
+            &arg, sizeof(arg));
 
-    Message_AddRef(message);
-    r = Sock_Write(rep->notificationSockets[1], &newItem, sizeof(newItem), &sent);
+        if (-1 == r && EINTR != errno)
+            break;
 
-    trace_Sock_SentResult(
-        message,
-        message->tag,
-        MessageName(message->tag),
-        message->operationId,
-        r);
-    
-    if ( MI_RESULT_OK != r )
-        Message_Release(message);
+        head = *ring->cqHead;
+        tail = __atomic_load_n(ring->cqTail, __ATOMIC_ACQUIRE);
 
-    return r;
+        for (; head != tail; head++)
+        {
+            if (SELECTOR_RING_CANCEL != ring->cqes[head & ring->cqMask].user_data)
+                ring->inflight--;
+        }
+
+        __atomic_store_n(ring->cqHead, head, __ATOMIC_RELEASE);
+    }
 }
 
-static MI_Result _SetSockEvents(SelectorRep* rep, Handler* p, MI_Uint32 mask, MI_Boolean noReadsMode )
+/*
+    Every thread that runs a ring keeps a record of the selector it armed
+    polls for, so it can cancel them when it exits. Records and owners of
+    rings change under s_ringThreadsLock.
+*/
+typedef struct _SelectorRingThread
 {
-    if( !noReadsMode && (mask & SELECTOR_READ) )
+    SelectorRep* rep;
+}
+SelectorRingThread;
+
+static Lock s_ringThreadsLock = LOCK_INITIALIZER;
+static pthread_once_t s_ringThreadOnce = PTHREAD_ONCE_INIT;
+static pthread_key_t s_ringThreadKey;
+static MI_Boolean s_ringThreadKeyCreated;
+
+/* Cancels polls of the ring and forgets the thread that armed them */
+static void _RingDisown(
+    SelectorRep* rep)
+{
+    if (rep->ring.thread)
     {
-        _FDSet(p->sock, &rep->readSet);
+        rep->ring.thread->rep = NULL;
+        rep->ring.thread = NULL;
     }
-    if (mask & SELECTOR_WRITE)
+
+    rep->ring.ownerSet = MI_FALSE;
+
+    if (rep->ring.inflight)
     {
-        _FDSet(p->sock, &rep->writeSet);
+        _RingQuiesce(rep);
+        rep->syncAll = MI_TRUE;
     }
-
-    return MI_RESULT_OK;
 }
 
-static MI_Result _GetSockEvents(SelectorRep* rep, Handler* p, MI_Uint32* mask)
+static void _RingThreadExit(
+    void* data)
 {
-    *mask = 0;
+    SelectorRingThread* thread = (SelectorRingThread*)data;
+
+    Lock_Acquire(&s_ringThreadsLock);
+
+    if (thread->rep)
+        _RingDisown(thread->rep);
+
+    Lock_Release(&s_ringThreadsLock);
+
+    PAL_Free(thread);
+}
+
+static void _RingThreadKeyCreate()
+{
+    s_ringThreadKeyCreated = 
+        0 == pthread_key_create(&s_ringThreadKey, _RingThreadExit);
+}
+
+/* Returns record of the current thread; NULL if it cannot have one */
+static SelectorRingThread* _RingThreadRecord()
+{
+    SelectorRingThread* thread;
+
+    if (0 != pthread_once(&s_ringThreadOnce, _RingThreadKeyCreate) ||
+        !s_ringThreadKeyCreated)
+    {
+        return NULL;
+    }
+
+    thread = (SelectorRingThread*)pthread_getspecific(s_ringThreadKey);
+
+    if (!thread)
+    {
+        thread = (SelectorRingThread*)PAL_Calloc(1, sizeof(SelectorRingThread));
+
+        if (thread && 0 != pthread_setspecific(s_ringThreadKey, thread))
+        {
+            PAL_Free(thread);
+            thread = NULL;
+        }
+    }
+
+    return thread;
+}
+
+/* Makes the current thread the one arming polls of the ring. Polls stay
+    armed from one run to the next; polls armed by another thread are 
+    cancelled first (they are re-armed by this one) */
+static void _RingTakeOver(
+    SelectorRep* rep)
+{
+    ThreadID current = Thread_ID();
+    SelectorRingThread* thread;
+
+    if (rep->ring.ownerSet && Thread_Equal(&rep->ring.owner, &current))
+        return;
+
+    Lock_Acquire(&s_ringThreadsLock);
+
+    _RingDisown(rep);
+
+    thread = _RingThreadRecord();
+
+    if (thread)
+    {
+        /* only one ring is tracked per thread */
+        if (thread->rep)
+            _RingDisown(thread->rep);
+
+        thread->rep = rep;
+    }
+
+    rep->ring.thread = thread;
+    rep->ring.owner = current;
+    rep->ring.ownerSet = MI_TRUE;
+
+    Lock_Release(&s_ringThreadsLock);
+}
+
+#endif /* defined(CONFIG_HAVE_IO_URING) */
+
+/* Makes sure 'sockHandlers' table can be indexed by given socket */
+static MI_Result _ReserveSockHandlers(
+    SelectorRep* rep,
+    Sock sock)
+{
+    if (sock >= rep->sockHandlersSize)
+    {
+        int size = rep->sockHandlersSize ? rep->sockHandlersSize : 64;
+        Handler** table;
+
+        while (size <= sock)
+            size *= 2;
+
+        table = (Handler**)PAL_Realloc(rep->sockHandlers, size * sizeof(Handler*));
+
+        if (!table)
+            return MI_RESULT_FAILED;
+
+        memset(table + rep->sockHandlersSize, 0,
+            (size - rep->sockHandlersSize) * sizeof(Handler*));
+        rep->sockHandlers = table;
+
+#if defined(CONFIG_HAVE_IO_URING)
+        if (rep->ring.fd != -1)
+        {
+            SelectorRingSlot* slots = (SelectorRingSlot*)PAL_Realloc(
+                rep->ringSlots, size * sizeof(SelectorRingSlot));
+
+            if (!slots)
+                return MI_RESULT_FAILED;
+
+            memset(slots + rep->sockHandlersSize, 0,
+                (size - rep->sockHandlersSize) * sizeof(SelectorRingSlot));
+            rep->ringSlots = slots;
+        }
+#endif
+
+        rep->sockHandlersSize = size;
+    }
+
+    return MI_RESULT_OK;
+}
+
+static Handler* _FindSockHandler(
+    SelectorRep* rep,
+    Sock sock)
+{
+    if (sock < 0 || sock >= rep->sockHandlersSize)
+        return NULL;
+
+    return rep->sockHandlers[sock];
+}
+
+static void _UnregisterHandler(
+    SelectorRep* rep,
+    Handler* p)
+{
+    /* socket may have been closed and re-used by another handler already;
+      only drop registration that still belongs to this handler */
+    if (p->registeredMask && _FindSockHandler(rep, p->registeredSock) == p)
+    {
+        struct epoll_event ev;
+
+        rep->sockHandlers[p->registeredSock] = NULL;
+
+#if defined(CONFIG_HAVE_IO_URING)
+        if (rep->ring.fd != -1)
+        {
+            /* pending poll holds a reference to the socket; submit the 
+                removal now, so closing the socket takes effect at once */
+            _RingDisarm(rep, p->registeredSock);
+            _RingSubmit(&rep->ring);
+        }
+        else
+#endif
+        {
+            memset(&ev, 0, sizeof(ev));
+            epoll_ctl(rep->epollFd, EPOLL_CTL_DEL, p->registeredSock, &ev);
+        }
+    }
+
+    p->registeredSock = INVALID_SOCK;
+    p->registeredMask = 0;
+}
+
+static MI_Uint32 _EventsToMask(
+    MI_Uint32 events,
+    MI_Uint32 registeredMask)
+{
+    MI_Uint32 mask = 0;
+
+    if (events & EPOLLIN)
+        mask |= SELECTOR_READ;
+
+    if (events & EPOLLOUT)
+        mask |= SELECTOR_WRITE;
+
+    /* select() reports errors and hang-ups as readiness - do the same */
+    if (events & (EPOLLERR | EPOLLHUP))
+        mask |= registeredMask;
+
+    return mask;
+}
+
+#else /* defined(CONFIG_HAVE_EPOLL) */
+
+static int _Select(
+    fd_set* readSet,
+    fd_set* writeSet,
+    fd_set* exceptSet,
+    MI_Uint64 timeoutUsec,
+    MI_Boolean* keepRunning)
+{
+    int n = FD_SETSIZE;
+    int r;
+    struct timeval tv;
+    struct timeval* _tv = 0;
+
+    if ((MI_Uint64)-1 != timeoutUsec)
+    {
+        tv.tv_sec = (long)(timeoutUsec / 1000000);
+        tv.tv_usec = (long)(timeoutUsec % 1000000);
+        _tv = &tv;
+    }
+
+    do
+    {
+        r = select(n, readSet, writeSet, exceptSet, _tv);
+    }
+    while( (*keepRunning == MI_TRUE) && ( -1 == r ) && ( errno == EINTR ) );
+
+    return r;
+}
+
+MI_INLINE void _FDSet(Sock sock, fd_set* set)
+{
+    FD_SET(sock, set);
+}
+
+MI_INLINE void _FDClr(Sock sock, fd_set* set)
+{
+    FD_CLR(sock, set);
+}
+
+#endif /* defined(CONFIG_HAVE_EPOLL) */
+
+/* Creates the channel other threads use to wake up the io thread */
+static int _OpenNotificationChannel(
+    SelectorRep* rep)
+{
+#if defined(CONFIG_HAVE_EVENTFD)
+    int fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+    if (fd == -1)
+        return -1;
+
+    rep->notificationSockets[0] = fd;
+    rep->notificationSockets[1] = fd;
+#else
+    if (pipe(rep->notificationSockets) != 0)
+        return -1;
+
+    /* set non-blocking for both ends; a full pipe already means
+        io thread has a wakeup pending */
+    Sock_SetBlocking( rep->notificationSockets[0], MI_FALSE);
+    Sock_SetBlocking( rep->notificationSockets[1], MI_FALSE);
+
+    /* Protect notification sockets from child processes */
+    if (MI_RESULT_OK != Sock_SetCloseOnExec(rep->notificationSockets[0],MI_TRUE) ||
+        MI_RESULT_OK != Sock_SetCloseOnExec(rep->notificationSockets[1],MI_TRUE))
+    {
+        trace_fcntl_failed( errno );
+    }
+#endif
+
+    return 0;
+}
+
+static void _CloseNotificationChannel(
+    SelectorRep* rep)
+{
+    Sock_Close(rep->notificationSockets[0]);
+
+    if (rep->notificationSockets[1] != rep->notificationSockets[0])
+        Sock_Close(rep->notificationSockets[1]);
+}
+
+/* Consumes all pending wakeups */
+static void _DrainNotificationChannel(
+    SelectorRep* rep)
+{
+#if defined(CONFIG_HAVE_EVENTFD)
+    eventfd_t value;
+
+    /* reading resets the counter */
+    eventfd_read(rep->notificationSockets[0], &value);
+#else
+    char buf[64];
+    size_t read = 0;
+
+    while (Sock_Read(rep->notificationSockets[0], buf, sizeof(buf), &read) == MI_RESULT_OK &&
+           read == sizeof(buf))
+        ;
+#endif
+}
+
+MI_Result Selector_Init(
+    Selector* self)
+{
+    self->rep = (SelectorRep*)PAL_Calloc(1, sizeof(SelectorRep));
+
+    if (!self->rep)
+        return MI_RESULT_FAILED;
+
+    if (_OpenNotificationChannel(self->rep) != 0)
+    {
+        PAL_Free(self->rep);
+        self->rep = NULL;
+        return MI_RESULT_FAILED;
+    }
+
+    Lock_Init(&self->rep->timersLock);
+    Lock_Init(&self->rep->pendingLock);
+
+#if defined(CONFIG_HAVE_EPOLL)
+    self->rep->epollFd = -1;
+
+# if defined(CONFIG_HAVE_IO_URING)
+    /* epoll is only needed where kernel does not offer io_uring */
+    if (_RingOpen(&self->rep->ring) != 0)
+# endif
+    {
+        struct epoll_event ev;
+
+        memset(&ev, 0, sizeof(ev));
+        ev.events = EPOLLIN;
+        ev.data.fd = self->rep->notificationSockets[0];
+
+        self->rep->epollFd = epoll_create1(EPOLL_CLOEXEC);
+
+        if (self->rep->epollFd == -1 ||
+            epoll_ctl(self->rep->epollFd, EPOLL_CTL_ADD, ev.data.fd, &ev) != 0)
+        {
+            goto failed;
+        }
+    }
+
+    /* Size the socket table up front so adding handlers for the first
+     * few sockets never needs to allocate */
+    if (MI_RESULT_OK != _ReserveSockHandlers(self->rep, self->rep->notificationSockets[0]))
+        goto failed;
+#endif
+
+    return MI_RESULT_OK;
+
+#if defined(CONFIG_HAVE_EPOLL)
+failed:
+# if defined(CONFIG_HAVE_IO_URING)
+    _RingClose(&self->rep->ring);
+    PAL_Free(self->rep->ringSlots);
+# endif
+    if (self->rep->epollFd != -1)
+        close(self->rep->epollFd);
+
+    PAL_Free(self->rep->sockHandlers);
+    _CloseNotificationChannel(self->rep);
+    PAL_Free(self->rep);
+    self->rep = NULL;
+    return MI_RESULT_FAILED;
+#endif
+}
+
+void Selector_Destroy(Selector* self)
+{
+    SelectorRep* rep = (SelectorRep*)self->rep;
+    Handler* p;
+    Handler* next;
+
+    _AddPendingHandlers(self);
+
+#if defined(CONFIG_HAVE_IO_URING)
+    /* pending polls hold the sockets handlers are about to close */
+    if (rep->ring.fd != -1)
+    {
+        Lock_Acquire(&s_ringThreadsLock);
+        _RingDisown(rep);
+        Lock_Release(&s_ringThreadsLock);
+    }
+#endif
+
+    /* Free all watchers */
+    for (p = (Handler*)rep->head; p; p = next)
+    {
+        next = (Handler*)p->next;
+
+#if defined(CONFIG_HAVE_EPOLL)
+        _UnscheduleHandler(rep, p);
+#endif
+        (*p->callback)(self, p, SELECTOR_DESTROY, 0);
+        p = next;
+    }
+
+    _FlushTimers(self, SELECTOR_DESTROY);
+
+    _CloseNotificationChannel(rep);
+
+#if defined(CONFIG_HAVE_EPOLL)
+# if defined(CONFIG_HAVE_IO_URING)
+    _RingClose(&rep->ring);
+    PAL_Free(rep->ringSlots);
+# endif
+    if (rep->epollFd != -1)
+        close(rep->epollFd);
+
+    PAL_Free(rep->sockHandlers);
+#endif
+
+    PAL_Free(rep);
+}
+
+static MI_Result _AddHandler(
+    Selector* self,
+    Handler* handler)
+{
+    SelectorRep* rep = (SelectorRep*)self->rep;
+    Handler* p;
+    MI_Uint64 currentTimeUsec = 0;
+
+    if (PAL_TRUE != PAL_Time(&currentTimeUsec))
+        return MI_RESULT_FAILED;
+
+    /* Reject duplicates */
+    for (p = (Handler*)rep->head; p; p = (Handler*)p->next)
+    {
+        if (p == handler)
+            return MI_RESULT_ALREADY_EXISTS;
+    }
+
+#if defined(CONFIG_HAVE_EPOLL)
+    /* Reserve table slot now, so registering in the loop does not allocate */
+    if (INVALID_SOCK != handler->sock &&
+        MI_RESULT_OK != _ReserveSockHandlers(rep, handler->sock))
+    {
+        return MI_RESULT_FAILED;
+    }
+#endif
+
+    /* Not registered with the kernel until the next loop */
+    handler->registeredSock = INVALID_SOCK;
+    handler->registeredMask = 0;
+    handler->timer.scheduled = MI_FALSE;
+    handler->timer.callback = NULL;
+    handler->timer.data = handler;
+    handler->changed = MI_FALSE;
+
+    /* Add new handler to list */
+    List_Append(&rep->head, &rep->tail, (ListElem*)handler);
+
+#if defined(CONFIG_HAVE_EPOLL)
+    Lock_Acquire(&rep->pendingLock);
+    handler->selected = MI_TRUE;
+    _MarkHandlerChanged(rep, handler);
+    Lock_Release(&rep->pendingLock);
+#endif
+
+    (*handler->callback)(self, handler, SELECTOR_ADD, currentTimeUsec);
+
+    return MI_RESULT_OK;
+}
+
+/* Moves handlers queued by other threads into the list; called by the
+    io thread (or by the owner once the selector stopped for good) */
+static void _AddPendingHandlers(
+    Selector* self)
+{
+    SelectorRep* rep = (SelectorRep*)self->rep;
+    Handler* p;
+    Handler* next;
+
+    Lock_Acquire(&rep->pendingLock);
+    p = (Handler*)rep->pendingHead;
+    rep->pendingHead = rep->pendingTail = NULL;
+    Lock_Release(&rep->pendingLock);
+
+    for (; p; p = next)
+    {
+        next = (Handler*)p->next;
+
+        /* Adding can only fail on allocation; report it as removal */
+        if (MI_RESULT_OK != _AddHandler(self, p))
+        {
+            trace_SelectorAddHandler_Failed();
+            (*p->callback)(self, p, SELECTOR_REMOVE, 0);
+        }
+    }
+}
+
+MI_Result Selector_AddHandler(
+    Selector* self,
+    Handler* handler)
+{
+    SelectorRep* rep = (SelectorRep*)self->rep;
+    ThreadID current = Thread_ID();
+    MI_Boolean queued = MI_FALSE;
+
+    /* Handler list belongs to the thread running the selector; other
+        threads hand new handlers over to it (e.g. connections to agents
+        opened while serving requests on http io threads) */
+    Lock_Acquire(&rep->pendingLock);
+
+    if (rep->ioThreadSet && !Thread_Equal(&rep->ioThreadHandle, &current))
+    {
+        List_Append(&rep->pendingHead, &rep->pendingTail, (ListElem*)handler);
+        queued = MI_TRUE;
+    }
+
+    Lock_Release(&rep->pendingLock);
+
+    if (queued)
+        return Selector_Wakeup(self, MI_FALSE);
+
+    return _AddHandler(self, handler);
+}
+
+MI_Result Selector_RemoveHandler(
+    Selector* self,
+    Handler* handler)
+{
+    SelectorRep* rep = (SelectorRep*)self->rep;
+    Handler* p;
+
+    /* Handler may not have been taken over by io thread yet */
+    Lock_Acquire(&rep->pendingLock);
+
+    for (p = (Handler*)rep->pendingHead; p; p = (Handler*)p->next)
+    {
+        if (p == handler)
+        {
+            List_Remove(&rep->pendingHead, &rep->pendingTail, (ListElem*)p);
+            break;
+        }
+    }
+
+    Lock_Release(&rep->pendingLock);
+
+    if (p)
+    {
+        (*handler->callback)(self, p, SELECTOR_REMOVE, 0);
+        return MI_RESULT_OK;
+    }
+
+    /* Find and remove handler from list */
+    for (p = (Handler*)rep->head; p; p = (Handler*)p->next)
+    {
+        if (p == handler)
+        {
+            /* Remove handler */
+            List_Remove(&rep->head, &rep->tail, (ListElem*)p);
+
+#if defined(CONFIG_HAVE_EPOLL)
+            /* Unselect events on this socket */
+            _UnregisterHandler(rep, p);
+            _UnscheduleHandler(rep, p);
+#endif
+
+            /* Notify handler of removal */
+            (*handler->callback)(self, p, SELECTOR_REMOVE, 0);
+
+            return MI_RESULT_OK;
+        }
+    }
+
+    return MI_RESULT_NOT_FOUND;
+}
+
+MI_Result Selector_RemoveAllHandlers(
+    Selector* self)
+{
+    SelectorRep* rep = (SelectorRep*)self->rep;
+    Handler* p;
+
+    _AddPendingHandlers(self);
+
+    /* Find and remove handler from list */
+    for (p = (Handler*)rep->head; p; )
+    {
+        Handler* next = p->next;
+
+        /* Remove handler */
+        List_Remove(&rep->head, &rep->tail, (ListElem*)p);
+
+#if defined(CONFIG_HAVE_EPOLL)
+        /* Unselect events on this socket */
+        _UnregisterHandler(rep, p);
+        _UnscheduleHandler(rep, p);
+#endif
+
+        /* Notify handler of removal */
+        (*p->callback)(self, p, SELECTOR_REMOVE, 0);
+
+        p = next;
+    }
+
+    _FlushTimers(self, SELECTOR_REMOVE);
+
+    return MI_RESULT_OK;
+}
+
+static void _ProcessCallbacks(
+    SelectorRep* rep)
+{
+    SelectorCallbacksItem* item;
+    SelectorCallbacksItem* next;
+    SelectorCallbacksItem* ordered = NULL;
+
+    LOGD2((ZT("_ProcessCallbacks - Begin. notification socket: %d"), rep->notificationSockets[0]));
+
+    /* drain first: an item posted after the list is taken below will 
+        find it empty and signal again */
+    _DrainNotificationChannel(rep);
+
+    item = (SelectorCallbacksItem*)Atomic_Swap(&rep->callbacks, 0);
+
+    /* list is most recent first; restore posting order */
+    while (item)
+    {
+        next = item->next;
+        item->next = ordered;
+        ordered = item;
+        item = next;
+    }
+
+    for (item = ordered; item; item = next)
+    {
+        /* item lives in message's batch */
+        next = item->next;
+
+        LOGD2((ZT("_ProcessCallbacks - Calling item callback")));
+        (*item->callback) (item->callback_self, item->message);
+        Message_Release(item->message);
+    }
+
+    LOGD2((ZT("_ProcessCallbacks - End")));
+}
+
+void _Selector_WakeupFromWait(
+    SelectorRep* rep)
+{
+    size_t sent = 0;
+#if defined(CONFIG_HAVE_EVENTFD)
+    eventfd_t value = 1;
+#else
+    char value = 0;
+#endif
+
+    Sock_Write( rep->notificationSockets[1], &value, sizeof(value), &sent);
+}
+
+/* 
+    * This function guaranties that callback is called in 'Run'/'IO' thread context,
+    * so locking is required for accessing sokcet objects, updating buffers etc
+*/
+MI_Result Selector_CallInIOThread(
+    Selector* self,
+    Selector_NotificationCallback  callback,
+    void* callback_self,
+    Message* message)
+{
+    SelectorRep* rep = (SelectorRep*)self->rep;
+    SelectorCallbacksItem* newItem;
+    ptrdiff_t head;
+    ThreadID current = Thread_ID();
+
+    if (Thread_Equal(&rep->ioThreadHandle, &current))
+    {
+        /* direct call - we can write to socket instantly */
+
+        trace_Sock_SendingOnOwnThread(
+            message,
+            message->tag,
+            MessageName(message->tag),
+            message->operationId);
+        
+        (*callback)(callback_self, message);
+        return MI_RESULT_OK;
+    }
+
+    /* add item to the list and set event */
+    newItem = (SelectorCallbacksItem*) Batch_GetClear( message->batch, sizeof(SelectorCallbacksItem));
+
+    if (!newItem)
+        return MI_RESULT_FAILED;
+
+    newItem->callback = callback;
+    newItem->callback_self = callback_self;
+    newItem->message = message;
+
+    Message_AddRef(message);
+
+    do
+    {
+        head = Atomic_Read(&rep->callbacks);
+        newItem->next = (SelectorCallbacksItem*)head;
+    }
+    while (Atomic_CompareAndSwap(&rep->callbacks, head, (ptrdiff_t)newItem) != head);
+
+    /* io thread takes the whole list once woken up, so only the first 
+        item posted since then needs to wake it */
+    if (!head)
+        _Selector_WakeupFromWait(rep);
+
+    trace_Sock_SentResult(
+        message,
+        message->tag,
+        MessageName(message->tag),
+        message->operationId,
+        MI_RESULT_OK);
+
+    return MI_RESULT_OK;
+}
+
+#if defined(CONFIG_HAVE_EPOLL)
+
+/* Brings kernel registration of the handler's socket in line with 'mask';
+   no system call is made when neither socket nor mask have changed */
+static MI_Result _SetSockEvents(SelectorRep* rep, Handler* p, MI_Uint32 mask, MI_Boolean noReadsMode )
+{
+    MI_Uint32 wanted = 0;
+    struct epoll_event ev;
+    int op;
+
+    if (INVALID_SOCK != p->sock)
+    {
+        if( !noReadsMode && (mask & SELECTOR_READ) )
+            wanted |= SELECTOR_READ;
+
+        if (mask & SELECTOR_WRITE)
+            wanted |= SELECTOR_WRITE;
+    }
+
+    if (wanted == p->registeredMask && (!wanted || p->sock == p->registeredSock))
+    {
+#if defined(CONFIG_HAVE_IO_URING)
+        /* polls are one-shot: re-arm the ones that fired */
+        if (wanted && rep->ring.fd != -1 && !rep->ringSlots[p->sock].armed)
+            return _RingArm(rep, p->sock, wanted);
+#endif
+        return MI_RESULT_OK;
+    }
+
+    if (!wanted || p->sock != p->registeredSock)
+        _UnregisterHandler(rep, p);
+
+    if (!wanted)
+        return MI_RESULT_OK;
+
+    if (MI_RESULT_OK != _ReserveSockHandlers(rep, p->sock))
+        return MI_RESULT_FAILED;
+
+#if defined(CONFIG_HAVE_IO_URING)
+    if (rep->ring.fd != -1)
+    {
+        /* socket may still be armed for a previous owner */
+        if (rep->ringSlots[p->sock].armed != wanted)
+        {
+            _RingDisarm(rep, p->sock);
+
+            if (MI_RESULT_OK != _RingArm(rep, p->sock, wanted))
+                return MI_RESULT_FAILED;
+        }
+
+        rep->sockHandlers[p->sock] = p;
+        p->registeredSock = p->sock;
+        p->registeredMask = wanted;
+
+        return MI_RESULT_OK;
+    }
+#endif
+
+    memset(&ev, 0, sizeof(ev));
+    ev.data.fd = p->sock;
+
+    if (wanted & SELECTOR_READ)
+        ev.events |= EPOLLIN;
+
+    if (wanted & SELECTOR_WRITE)
+        ev.events |= EPOLLOUT;
+
+    op = (p->registeredMask && rep->sockHandlers[p->sock] == p) ?
+        EPOLL_CTL_MOD : EPOLL_CTL_ADD;
+
+    if (epoll_ctl(rep->epollFd, op, p->sock, &ev) != 0)
+    {
+        /* socket re-used before its previous owner was removed */
+        if (EPOLL_CTL_ADD != op || EEXIST != errno ||
+            epoll_ctl(rep->epollFd, EPOLL_CTL_MOD, p->sock, &ev) != 0)
+        {
+            return MI_RESULT_FAILED;
+        }
+    }
+
+    rep->sockHandlers[p->sock] = p;
+    p->registeredSock = p->sock;
+    p->registeredMask = wanted;
+
+    return MI_RESULT_OK;
+}
+
+#else /* defined(CONFIG_HAVE_EPOLL) */
+
+static MI_Result _SetSockEvents(SelectorRep* rep, Handler* p, MI_Uint32 mask, MI_Boolean noReadsMode )
+{
+    if( !noReadsMode && (mask & SELECTOR_READ) )
+    {
+        _FDSet(p->sock, &rep->readSet);
+    }
+    if (mask & SELECTOR_WRITE)
+    {
+        _FDSet(p->sock, &rep->writeSet);
+    }
+
+    return MI_RESULT_OK;
+}
+
+static MI_Result _GetSockEvents(SelectorRep* rep, Handler* p, MI_Uint32* mask)
+{
+    *mask = 0;
     if (p->mask & (SELECTOR_READ | SELECTOR_WRITE | SELECTOR_EXCEPTION))
     {
-        /* Check for read event */
-        if (FD_ISSET(p->sock, &rep->readSet))
-        {
-            *mask |= SELECTOR_READ;
-            _FDClr(p->sock, &rep->readSet);
-        }
-    
-        /* Check for write event */
-        if (FD_ISSET(p->sock, &rep->writeSet))
-        {
-            *mask |= SELECTOR_WRITE;
-            _FDClr(p->sock, &rep->writeSet);
-        }
-    
-        /* Check for exception event */
-        if (FD_ISSET(p->sock, &rep->exceptSet))
-        {
-            _FDClr(p->sock, &rep->exceptSet);
-        }
+        /* Check for read event */
+        if (FD_ISSET(p->sock, &rep->readSet))
+        {
+            *mask |= SELECTOR_READ;
+            _FDClr(p->sock, &rep->readSet);
+        }
+    
+        /* Check for write event */
+        if (FD_ISSET(p->sock, &rep->writeSet))
+        {
+            *mask |= SELECTOR_WRITE;
+            _FDClr(p->sock, &rep->writeSet);
+        }
+    
+        /* Check for exception event */
+        if (FD_ISSET(p->sock, &rep->exceptSet))
+        {
+            _FDClr(p->sock, &rep->exceptSet);
+        }
+    }
+
+    return MI_RESULT_OK;
+}
+
+#endif /* defined(CONFIG_HAVE_EPOLL) */
+
+#endif /* defined(CONFIG_POSIX) */
+
+/************************************/
+/* generic functionality */
+
+/*
+**==============================================================================
+**
+** Timers: intrusive binary min-heap ordered by fireTimeoutAt. Position of
+** the last node follows from the number of nodes, so no array is needed and
+** arming a timer never allocates.
+**
+**==============================================================================
+*/
+
+/* Swaps a timer with one of its children */
+static void _TimerSwap(
+    SelectorRep* rep,
+    SelectorTimer* parent,
+    SelectorTimer* child)
+{
+    SelectorTimer* p = parent->parent;
+    SelectorTimer* l = parent->left;
+    SelectorTimer* r = parent->right;
+    SelectorTimer* sibling;
+
+    parent->parent = child->parent;
+    parent->left = child->left;
+    parent->right = child->right;
+    child->parent = p;
+    child->left = l;
+    child->right = r;
+
+    parent->parent = child;
+
+    if (child->left == child)
+    {
+        child->left = parent;
+        sibling = child->right;
+    }
+    else
+    {
+        child->right = parent;
+        sibling = child->left;
+    }
+
+    if (sibling)
+        sibling->parent = child;
+
+    if (parent->left)
+        parent->left->parent = parent;
+
+    if (parent->right)
+        parent->right->parent = parent;
+
+    if (!child->parent)
+        rep->timers = child;
+    else if (child->parent->left == parent)
+        child->parent->left = child;
+    else
+        child->parent->right = child;
+}
+
+/* Returns link that points to the n-th node (1-based, breadth-first) */
+static SelectorTimer** _TimerFindSlot(
+    SelectorRep* rep,
+    size_t n,
+    SelectorTimer** parent)
+{
+    SelectorTimer** slot = &rep->timers;
+    size_t path = 0;
+    size_t k = 0;
+
+    for (; n >= 2; k++, n /= 2)
+        path = (path << 1) | (n & 1);
+
+    *parent = NULL;
+
+    for (; k > 0; k--, path >>= 1)
+    {
+        *parent = *slot;
+        slot = (path & 1) ? &(*slot)->right : &(*slot)->left;
+    }
+
+    return slot;
+}
+
+static void _TimerInsert(
+    SelectorRep* rep,
+    SelectorTimer* timer)
+{
+    SelectorTimer* parent;
+    SelectorTimer** slot = _TimerFindSlot(rep, rep->timersCount + 1, &parent);
+
+    timer->left = NULL;
+    timer->right = NULL;
+    timer->parent = parent;
+    timer->scheduled = MI_TRUE;
+    *slot = timer;
+    rep->timersCount++;
+
+    while (timer->parent && timer->fireTimeoutAt < timer->parent->fireTimeoutAt)
+        _TimerSwap(rep, timer->parent, timer);
+}
+
+static void _TimerRemove(
+    SelectorRep* rep,
+    SelectorTimer* timer)
+{
+    SelectorTimer* parent;
+    SelectorTimer** slot = _TimerFindSlot(rep, rep->timersCount, &parent);
+    SelectorTimer* last = *slot;
+
+    rep->timersCount--;
+    *slot = NULL;
+    timer->scheduled = MI_FALSE;
+
+    if (last == timer)
+        return;
+
+    /* Move last node into removed node's place and restore heap order */
+    last->left = timer->left;
+    last->right = timer->right;
+    last->parent = timer->parent;
+
+    if (last->left)
+        last->left->parent = last;
+
+    if (last->right)
+        last->right->parent = last;
+
+    if (!timer->parent)
+        rep->timers = last;
+    else if (timer->parent->left == timer)
+        timer->parent->left = last;
+    else
+        timer->parent->right = last;
+
+    for (;;)
+    {
+        SelectorTimer* smallest = last;
+
+        if (last->left && last->left->fireTimeoutAt < smallest->fireTimeoutAt)
+            smallest = last->left;
+
+        if (last->right && last->right->fireTimeoutAt < smallest->fireTimeoutAt)
+            smallest = last->right;
+
+        if (smallest == last)
+            break;
+
+        _TimerSwap(rep, last, smallest);
+    }
+
+    while (last->parent && last->fireTimeoutAt < last->parent->fireTimeoutAt)
+        _TimerSwap(rep, last->parent, last);
+}
+
+/* Removes earliest timer if it is due at 'currentTimeUsec' */
+static SelectorTimer* _TimerPopExpired(
+    SelectorRep* rep,
+    MI_Uint64 currentTimeUsec)
+{
+    SelectorTimer* timer;
+
+    Lock_Acquire(&rep->timersLock);
+
+    timer = rep->timers;
+
+    if (timer && timer->fireTimeoutAt <= currentTimeUsec)
+        _TimerRemove(rep, timer);
+    else
+        timer = NULL;
+
+    Lock_Release(&rep->timersLock);
+
+    return timer;
+}
+
+/* Invokes all pending timers with given mask; used on shutdown */
+static void _FlushTimers(
+    Selector* self,
+    MI_Uint32 mask)
+{
+    SelectorRep* rep = (SelectorRep*)self->rep;
+    SelectorTimer* timer;
+
+    while (NULL != (timer = _TimerPopExpired(rep, (MI_Uint64)-1)))
+    {
+        /* handlers' timers are gone along with their handlers */
+        if (timer->callback)
+            (*timer->callback)(self, timer, mask, 0);
+    }
+}
+
+MI_Result Selector_StartTimer(
+    Selector* self,
+    SelectorTimer* timer,
+    MI_Uint64 fireTimeoutAt)
+{
+    SelectorRep* rep = (SelectorRep*)self->rep;
+    MI_Boolean earliest;
+
+    Lock_Acquire(&rep->timersLock);
+
+    if (timer->scheduled)
+    {
+        Lock_Release(&rep->timersLock);
+        return MI_RESULT_ALREADY_EXISTS;
     }
 
+    timer->fireTimeoutAt = fireTimeoutAt;
+    _TimerInsert(rep, timer);
+    earliest = (rep->timers == timer);
+
+    Lock_Release(&rep->timersLock);
+
+    /* selector's wait only needs to be shortened for a new earliest timer */
+    if (earliest)
+        Selector_Wakeup(self, MI_FALSE);
+
     return MI_RESULT_OK;
 }
 
-#endif /* defined(CONFIG_POSIX) */
+MI_Result Selector_UpdateTimer(
+    Selector* self,
+    SelectorTimer* timer,
+    MI_Uint64 fireTimeoutAt)
+{
+    SelectorRep* rep = (SelectorRep*)self->rep;
 
-/************************************/
-/* generic functionality */
+    Lock_Acquire(&rep->timersLock);
+
+    if (!timer->scheduled)
+    {
+        Lock_Release(&rep->timersLock);
+        return MI_RESULT_NOT_FOUND;
+    }
+
+    _TimerRemove(rep, timer);
+    timer->fireTimeoutAt = fireTimeoutAt;
+    _TimerInsert(rep, timer);
+
+    Lock_Release(&rep->timersLock);
+
+    return Selector_Wakeup(self, MI_TRUE);
+}
 
 MI_Result Selector_ContainsHandler(
     Selector* self,
@@ -869,7 +2277,225 @@ MI_Result Selector_StopRunningNoReadsMode(
     return Selector_Wakeup(self, MI_FALSE);
 }
 
-MI_Result Selector_Run(
+#if defined(CONFIG_HAVE_EPOLL)
+
+/* Queues handler to have its registration and timer brought up to date
+    before selector waits again; pendingLock has to be held */
+static void _MarkHandlerChanged(
+    SelectorRep* rep,
+    Handler* p)
+{
+    if (p->selected && !p->changed)
+    {
+        p->changed = MI_TRUE;
+        p->nextChanged = rep->changedHead;
+        rep->changedHead = p;
+    }
+}
+
+/* Drops handler's timer and queued update when handler is removed */
+static void _UnscheduleHandler(
+    SelectorRep* rep,
+    Handler* p)
+{
+    Handler** link;
+
+    Lock_Acquire(&rep->timersLock);
+
+    if (p->timer.scheduled)
+        _TimerRemove(rep, &p->timer);
+
+    Lock_Release(&rep->timersLock);
+
+    Lock_Acquire(&rep->pendingLock);
+
+    if (p->changed)
+    {
+        for (link = &rep->changedHead; *link != p; link = &(*link)->nextChanged)
+            ;
+
+        *link = p->nextChanged;
+        p->changed = MI_FALSE;
+    }
+
+    p->selected = MI_FALSE;
+
+    Lock_Release(&rep->pendingLock);
+}
+
+/* Keeps handler's timer in line with its 'fireTimeoutAt'; handler timers
+    are only touched by the io thread, so the check needs no lock */
+static void _ScheduleHandlerTimeout(
+    SelectorRep* rep,
+    Handler* p)
+{
+    if (TIME_NEVER == p->fireTimeoutAt ? !p->timer.scheduled :
+        p->timer.scheduled && p->timer.fireTimeoutAt == p->fireTimeoutAt)
+    {
+        return;
+    }
+
+    Lock_Acquire(&rep->timersLock);
+
+    if (p->timer.scheduled)
+        _TimerRemove(rep, &p->timer);
+
+    if (TIME_NEVER != p->fireTimeoutAt)
+    {
+        p->timer.fireTimeoutAt = p->fireTimeoutAt;
+        _TimerInsert(rep, &p->timer);
+    }
+
+    Lock_Release(&rep->timersLock);
+}
+
+static MI_Result _SyncHandler(
+    Selector* self,
+    Handler* p,
+    MI_Boolean noReadsMode)
+{
+    SelectorRep* rep = (SelectorRep*)self->rep;
+    MI_Result r = _SetSockEvents(rep, p, p->mask, noReadsMode);
+
+    if (r != MI_RESULT_OK)
+    {
+        LOGE2((ZT("Selector_Run - _SetSockEvents failed")));
+        trace_SelectorRun_SetSocketEventsError( self, r, p );
+        return r;
+    }
+
+    _ScheduleHandlerTimeout(rep, p);
+
+    return MI_RESULT_OK;
+}
+
+/* Brings registrations and timers of changed handlers up to date, so
+    waiting does not need to visit every handler */
+static MI_Result _SyncChangedHandlers(
+    Selector* self,
+    MI_Boolean noReadsMode)
+{
+    SelectorRep* rep = (SelectorRep*)self->rep;
+    Handler* p;
+    MI_Result r;
+
+    if (rep->syncAll || rep->noReadsMode != noReadsMode)
+    {
+        /* sockets are registered for another mode (nested run) or
+            polls were cancelled for another io thread */
+        rep->syncAll = MI_FALSE;
+        rep->noReadsMode = noReadsMode;
+
+        for (p = (Handler*)rep->head; p; p = p->next)
+        {
+            r = _SyncHandler(self, p, noReadsMode);
+
+            if (r != MI_RESULT_OK)
+                return r;
+        }
+    }
+
+    for (;;)
+    {
+        /* taken one at a time: others may queue it again once unlocked */
+        Lock_Acquire(&rep->pendingLock);
+
+        p = rep->changedHead;
+
+        if (p)
+        {
+            rep->changedHead = p->nextChanged;
+            p->changed = MI_FALSE;
+        }
+
+        Lock_Release(&rep->pendingLock);
+
+        if (!p)
+            return MI_RESULT_OK;
+
+        r = _SyncHandler(self, p, noReadsMode);
+
+        if (r != MI_RESULT_OK)
+            return r;
+    }
+}
+
+#endif /* defined(CONFIG_HAVE_EPOLL) */
+
+MI_Result Selector_UpdateHandler(
+    _In_    Selector*   self,
+    _In_    Handler*    handler,
+            MI_Boolean  retryDispatching )
+{
+#if defined(CONFIG_HAVE_EPOLL)
+    SelectorRep* rep = (SelectorRep*)self->rep;
+
+    Lock_Acquire(&rep->pendingLock);
+    _MarkHandlerChanged(rep, handler);
+    Lock_Release(&rep->pendingLock);
+#else
+    MI_UNUSED(handler);
+#endif
+
+    return Selector_Wakeup(self, retryDispatching);
+}
+
+/* Invokes handler's callback with given events and removes the handler
+    from selector if it is not interested in further events */
+static MI_Result _DispatchHandlerEvents(
+    Selector* self,
+    Handler* p,
+    MI_Uint32 mask,
+    MI_Uint64* currentTimeUsec,
+    MI_Boolean noReadsMode)
+{
+    SelectorRep* rep = (SelectorRep*)self->rep;
+    MI_Boolean more;
+
+    LOGD2((ZT("Selector_Run - Calling event dispatcher, handler = %p, rep = %p, mask = %u"), p, rep,  mask));
+    /*MI_Uint32 oldMask = p->mask;*/
+    more = (*p->callback)(self, p, mask, *currentTimeUsec);
+
+    /* If callback wants to continue getting events */
+    if (!more)
+    {
+        /* Remove handler */
+        List_Remove(&rep->head, &rep->tail, (ListElem*)p);
+
+        /* Refresh current time stamp */
+        if (PAL_TRUE != PAL_Time(currentTimeUsec))
+        {
+            LOGE2((ZT("Selector_Run - PAL_Time failed")));
+            trace_SelectorRun_PALTimeError( self );
+            return MI_RESULT_FAILED;
+        }
+
+#if defined(CONFIG_OS_WINDOWS) || defined(CONFIG_HAVE_EPOLL)
+        /* Unselect events on this socket */
+        _SetSockEvents(rep, p, 0, noReadsMode);
+#endif
+#if defined(CONFIG_HAVE_EPOLL)
+        _UnscheduleHandler(rep, p);
+#endif
+
+        /* Notify handler of removal */
+        LOGD2((ZT("Selector_Run - Calling event dispatcher, handler = %p, rep = %p, mask = SELECTOR_REMOVE"), p, rep));
+        (*p->callback)(self, p, SELECTOR_REMOVE, *currentTimeUsec);
+    }
+#if defined(CONFIG_HAVE_EPOLL)
+    else if (!p->changed)
+    {
+        /* callback may have changed its mask or timeout */
+        Lock_Acquire(&rep->pendingLock);
+        _MarkHandlerChanged(rep, p);
+        Lock_Release(&rep->pendingLock);
+    }
+#endif
+
+    return MI_RESULT_OK;
+}
+
+static MI_Result _Run(
     Selector* self,
     MI_Uint64 timeoutUsec,
     MI_Boolean noReadsMode )
@@ -910,7 +2536,14 @@ MI_Result Selector_Run(
         timeoutSelectorAt += timeoutUsec;
     }
 
+#if defined(CONFIG_POSIX)
+    Lock_Acquire(&rep->pendingLock);
+    rep->ioThreadHandle = Thread_ID();
+    rep->ioThreadSet = MI_TRUE;
+    Lock_Release(&rep->pendingLock);
+#else
     rep->ioThreadHandle = Thread_ID();
+#endif
 
     /* Loop while detecting and dispatching events */
     for (*keepRunningVar = MI_TRUE; *keepRunningVar; )
@@ -918,7 +2551,6 @@ MI_Result Selector_Run(
         Handler* p;
         MI_Uint64 currentTimeUsec = 0;
         MI_Uint64 breakCurrentSelectAt = (MI_Uint64)-1;
-        MI_Boolean more;
         MI_Result r;
 #if defined(CONFIG_OS_WINDOWS)
         DWORD result;
@@ -926,6 +2558,15 @@ MI_Result Selector_Run(
 #else
         int n;
 #endif 
+#if defined(CONFIG_HAVE_EPOLL)
+        struct epoll_event events[SELECTOR_MAX_EVENTS];
+        MI_Boolean notified = MI_FALSE;
+        int i;
+#endif
+
+#if defined(CONFIG_POSIX)
+        _AddPendingHandlers(self);
+#endif
 
         if (PAL_TRUE != PAL_Time(&currentTimeUsec))
         {
@@ -947,6 +2588,19 @@ MI_Result Selector_Run(
             breakCurrentSelectAt = timeoutSelectorAt;
         }
 
+#if defined(CONFIG_HAVE_EPOLL)
+# if defined(CONFIG_HAVE_IO_URING)
+        if (rep->ring.fd != -1)
+            _RingTakeOver(rep);
+# endif
+
+        /* only changed handlers are re-registered; their timeouts are kept
+            on the timer heap, so none of the others is visited */
+        r = _SyncChangedHandlers(self, noReadsMode);
+
+        if (r != MI_RESULT_OK)
+            return r;
+#else
 #if defined(CONFIG_POSIX)
         /* Set up FD sets from handlers */
         memset(&rep->readSet, 0, sizeof(rep->readSet));
@@ -990,9 +2644,23 @@ MI_Result Selector_Run(
 #if defined(CONFIG_POSIX)
         _FDSet(rep->notificationSockets[0], &rep->readSet);
 #endif /* defined(CONFIG_POSIX) */
+#endif /* defined(CONFIG_HAVE_EPOLL) */
+
+        /* earliest timer is on top of the heap */
+        Lock_Acquire(&rep->timersLock);
+
+        if (rep->timers)
+        {
+            if (currentTimeUsec >= rep->timers->fireTimeoutAt)
+                breakCurrentSelectAt = currentTimeUsec;
+            else if (rep->timers->fireTimeoutAt < breakCurrentSelectAt)
+                breakCurrentSelectAt = rep->timers->fireTimeoutAt;
+        }
+
+        Lock_Release(&rep->timersLock);
 
         /* empty list - return */
-        if (!rep->head && !rep->allowEmptySelector)
+        if (!rep->head && !rep->timers && !rep->allowEmptySelector)
         {
             LOGE2((ZT("Selector_Run - Empty list")));
             trace_SelectorRun_EmptyList( self );
@@ -1011,6 +2679,32 @@ MI_Result Selector_Run(
             trace_SelectorRun_WaitError( self, result );
             return MI_RESULT_FAILED;
         }
+#elif defined(CONFIG_HAVE_EPOLL)
+        /* Wait for events; only sockets with pending events are returned */
+#if defined(CONFIG_HAVE_IO_URING)
+        if (rep->ring.fd != -1)
+            n = _RingWait(rep, events,
+                breakCurrentSelectAt == (MI_Uint64)-1 ? (MI_Uint64)-1: breakCurrentSelectAt - currentTimeUsec,
+                keepRunningVar);
+        else
+#endif
+        n = _EpollWait(rep, events,
+            breakCurrentSelectAt == (MI_Uint64)-1 ? (MI_Uint64)-1: breakCurrentSelectAt - currentTimeUsec,
+            keepRunningVar);
+
+        /* ignore signals, since it canbe part of normal operation */
+        if (-1 == n && errno != EINTR)
+        {
+            LOGE2((ZT("Selector_Run - _EpollWait failed. errno: %d (%s)"), errno, strerror(errno)));
+            trace_SelectorRun_WaitError( self, errno );
+            return MI_RESULT_FAILED;
+        }
+
+        for (i = 0; i < n; i++)
+        {
+            if (events[i].data.fd == rep->notificationSockets[0])
+                notified = MI_TRUE;
+        }
 #else
         /* Perform system select */
         n = _Select(&rep->readSet, &rep->writeSet, NULL, 
@@ -1032,13 +2726,56 @@ MI_Result Selector_Run(
 
 #if defined(CONFIG_OS_WINDOWS)
             //if ((WAIT_OBJECT_0 + 1) == result)  /* other thread wants to call callback */
+#elif defined(CONFIG_HAVE_EPOLL)
+            if (notified)
 #else
             if (FD_ISSET(rep->notificationSockets[0], &rep->readSet))
 #endif
             {
+#if defined(CONFIG_POSIX)
+                /* handlers queued before callbacks that may refer to them */
+                _AddPendingHandlers(self);
+#endif
                 _ProcessCallbacks(rep);
             }
             
+#if defined(CONFIG_HAVE_EPOLL)
+            /* Dispatch events on ready sockets */
+            for (i = 0; i < n; i++)
+            {
+                MI_Uint32 mask;
+
+                /* notification pipe or handler removed by earlier callback */
+                p = _FindSockHandler(rep, events[i].data.fd);
+
+                if (!p)
+                    continue;
+
+                mask = _EventsToMask(events[i].events, p->registeredMask);
+
+                /* Refresh current time stamp */
+                if (PAL_TRUE != PAL_Time(&currentTimeUsec))
+                {
+                    LOGE2((ZT("Selector_Run - PAL_Time failed")));
+                    trace_SelectorRun_PALTimeError( self );
+                    return MI_RESULT_FAILED;
+                }
+
+                r = _DispatchHandlerEvents(self, p, mask, &currentTimeUsec, noReadsMode);
+
+                if (r != MI_RESULT_OK)
+                    return r;
+            }
+
+            /* events are consumed; retries only look for timeouts */
+            n = 0;
+
+            /* timeouts set by callbacks may be due already */
+            r = _SyncChangedHandlers(self, noReadsMode);
+
+            if (r != MI_RESULT_OK)
+                return r;
+#else
             /* Dispatch events on each socket */
             for (p = (Handler*)rep->head; p; )
             {
@@ -1076,36 +2813,43 @@ MI_Result Selector_Run(
                 /* If there were any events on this socket, dispatch them */
                 if (mask)
                 {
-                    LOGD2((ZT("Selector_Run - Calling event dispatcher, handler = %p, rep = %p, mask = %u"), p, rep,  mask));
-                    /*MI_Uint32 oldMask = p->mask;*/
-                    more = (*p->callback)(self, p, mask, currentTimeUsec);
+                    r = _DispatchHandlerEvents(self, p, mask, &currentTimeUsec, noReadsMode);
 
-                    /* If callback wants to continue getting events */
-                    if (!more)
-                    {
-                        /* Remove handler */
-                        List_Remove(&rep->head, &rep->tail, (ListElem*)p);
+                    if (r != MI_RESULT_OK)
+                        return r;
+                }
 
-                        /* Refresh current time stamp */
-                        if (PAL_TRUE != PAL_Time(&currentTimeUsec))
-                        {
-                            LOGE2((ZT("Selector_Run - PAL_Time failed")));
-                            trace_SelectorRun_PALTimeError( self );
-                            return MI_RESULT_FAILED;
-                        }
+                p = next;
+            }
+#endif /* defined(CONFIG_HAVE_EPOLL) */
 
-#if defined(CONFIG_OS_WINDOWS)
-                        /* Unselect events on this socket */
-                        _SetSockEvents(rep, p, 0, noReadsMode);
-#endif
+            /* Fire expired timers */
+            {
+                SelectorTimer* timer;
 
-                        /* Notify handler of removal */
-                        LOGD2((ZT("Selector_Run - Calling event dispatcher, handler = %p, rep = %p, mask = SELECTOR_REMOVE"), p, rep));
-                        (*p->callback)(self, p, SELECTOR_REMOVE, currentTimeUsec);
-                    }
+                /* Refresh current time stamp */
+                if (PAL_TRUE != PAL_Time(&currentTimeUsec))
+                {
+                    LOGE2((ZT("Selector_Run - PAL_Time failed")));
+                    trace_SelectorRun_PALTimeError( self );
+                    return MI_RESULT_FAILED;
                 }
 
-                p = next;
+                while (NULL != (timer = _TimerPopExpired(rep, currentTimeUsec)))
+                {
+                    if (timer->callback)
+                    {
+                        (*timer->callback)(self, timer, SELECTOR_TIMEOUT, currentTimeUsec);
+                        continue;
+                    }
+
+                    /* handler's timeout */
+                    r = _DispatchHandlerEvents(self, (Handler*)timer->data,
+                        SELECTOR_TIMEOUT, &currentTimeUsec, noReadsMode);
+
+                    if (r != MI_RESULT_OK)
+                        return r;
+                }
             }
         }
         while( rep->keepDispatching );
@@ -1116,6 +2860,28 @@ MI_Result Selector_Run(
     return MI_RESULT_OK;
 }
 
+MI_Result Selector_Run(
+    Selector* self,
+    MI_Uint64 timeoutUsec,
+    MI_Boolean noReadsMode )
+{
+    MI_Result r = _Run(self, timeoutUsec, noReadsMode);
+
+#if defined(CONFIG_HAVE_IO_URING)
+    SelectorRep* rep = (SelectorRep*)self->rep;
+
+    /* without a record, nothing cancels the polls when this thread exits */
+    if (rep->ring.fd != -1 && rep->ring.ownerSet && !rep->ring.thread)
+    {
+        Lock_Acquire(&s_ringThreadsLock);
+        _RingDisown(rep);
+        Lock_Release(&s_ringThreadsLock);
+    }
+#endif
+
+    return r;
+}
+
 int Selector_IsSelectorThread(Selector* self, ThreadID *id)
 {
     if( NULL == self || NULL == self->rep )
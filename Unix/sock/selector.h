@@ -28,6 +28,23 @@ BEGIN_EXTERNC
 
 typedef struct _Selector Selector;
 typedef struct _Handler Handler;
+typedef struct _SelectorTimer SelectorTimer;
+
+/* Timer kept by the selector in a min-heap ordered by 'fireTimeoutAt';
+  callback is invoked from the selector's thread with SELECTOR_TIMEOUT once
+  the timer expires, or with SELECTOR_REMOVE/SELECTOR_DESTROY if handlers
+  are removed or selector is destroyed before that */
+struct _SelectorTimer
+{
+    /* heap links; maintained by the selector */
+    SelectorTimer* parent;
+    SelectorTimer* left;
+    SelectorTimer* right;
+    MI_Boolean scheduled;
+    MI_Uint64 fireTimeoutAt;
+    void (*callback)(Selector*, SelectorTimer*, MI_Uint32 mask, MI_Uint64 currentTimeUsec);
+    void* data;
+};
 
 struct _Handler
 {
@@ -40,6 +57,17 @@ struct _Handler
     MI_Uint64 fireTimeoutAt;  
     MI_Boolean (*callback)(Selector*, Handler*, MI_Uint32 mask, MI_Uint64 currentTimeUsec);
     void* data;
+    /* socket and events currently registered with the kernel;
+      maintained by the selector (epoll backend), not by the handler owner */
+    Sock registeredSock;
+    MI_Uint32 registeredMask;
+    /* 'fireTimeoutAt' as scheduled in the selector's timer heap and link
+      in its list of handlers to bring up to date; maintained by the
+      selector (epoll backend) */
+    SelectorTimer timer;
+    Handler* nextChanged;
+    MI_Boolean changed;
+    MI_Boolean selected;
 };
 
 struct _Selector
@@ -96,12 +124,23 @@ MI_Result Selector_StopRunningNoReadsMode(
     Selector* self);
 
 /* Wakes up selector's thread 
-    Typical usage is to recalculate timeouts on handlers
-    when selector's Run is running in different thread */
+    Typical usage is to recalculate timeouts when selector's Run is
+    running in different thread; handlers changed that way have to be
+    passed to Selector_UpdateHandler instead */
 MI_Result Selector_Wakeup(
     _In_    Selector*   self,
             MI_Boolean  retryDispatching );
 
+/* Makes selector pick up changes of handler's 'mask' or 'fireTimeoutAt'
+    done outside of handler's own callback (by another handler's callback,
+    an io thread callback or another thread) and wakes up selector's thread
+    as Selector_Wakeup does; changes done by the callback itself are picked
+    up without it */
+MI_Result Selector_UpdateHandler(
+    _In_    Selector*   self,
+    _In_    Handler*    handler,
+            MI_Boolean  retryDispatching );
+
 /* 
     * This function guaranties that callback is called in 'Run'/'IO' thread context,
     * so no locking is required for accessing sokcet objects, updating buffers etc
@@ -112,6 +151,29 @@ MI_Result Selector_CallInIOThread(
     void* callback_self,
     Message* message);
 
+/* Schedules timer to expire at 'fireTimeoutAt'; callback and data have to 
+    be set by caller. Safe to call from any thread.
+    Returns:
+    OK - timer was scheduled
+    ALREADY_EXISTS - timer is already scheduled
+*/
+MI_Result Selector_StartTimer(
+    Selector* self,
+    SelectorTimer* timer,
+    MI_Uint64 fireTimeoutAt);
+
+/* Moves expiration time of a scheduled timer (typically to 'now' to
+    trigger it early) and wakes up selector's thread. Safe to call from
+    any thread.
+    Returns:
+    OK - timer was rescheduled
+    NOT_FOUND - timer is not scheduled (already expired or never started)
+*/
+MI_Result Selector_UpdateTimer(
+    Selector* self,
+    SelectorTimer* timer,
+    MI_Uint64 fireTimeoutAt);
+
 /*
     Sets flag 'allowEmptySelector' to allow 
     'run' call on empty selector
@@ -398,6 +398,27 @@ MI_Result Sock_ReuseAddr(
     return MI_RESULT_OK;
 }
 
+MI_Result Sock_ReusePort(
+    Sock self,
+    MI_Boolean flag_)
+{
+#if defined(SO_REUSEPORT)
+    int flag = flag_ ? 1 : 0;
+    int r;
+
+    r = setsockopt(self, SOL_SOCKET, SO_REUSEPORT, (char*)&flag, sizeof(flag));
+
+    if (r != 0)
+        return MI_RESULT_FAILED;
+
+    return MI_RESULT_OK;
+#else
+    MI_UNUSED(self);
+    MI_UNUSED(flag_);
+    return MI_RESULT_NOT_SUPPORTED;
+#endif
+}
+
 MI_Result Sock_SetBlocking(
     Sock self,
     MI_Boolean flag_)
@@ -623,9 +644,10 @@ MI_Result Sock_WriteV(
     return MI_RESULT_FAILED;
 }
 
-MI_Result Sock_CreateListener(
+static MI_Result _CreateListener(
     Sock* sock,
-    const Addr* addr)
+    const Addr* addr,
+    MI_Boolean shared)
 {
     MI_Result r;
 
@@ -648,6 +670,18 @@ MI_Result Sock_CreateListener(
         }
     }
 
+    /* Let other sockets listen on the same address */
+    if (shared)
+    {
+        r = Sock_ReusePort(*sock, MI_TRUE);
+
+        if (r != MI_RESULT_OK)
+        {
+            Sock_Close(*sock);
+            return r;
+        }
+    }
+
     /* Bind the socket to the address */
     {
         r = Sock_Bind(*sock, addr);
@@ -673,6 +707,20 @@ MI_Result Sock_CreateListener(
     return MI_RESULT_OK;
 }
 
+MI_Result Sock_CreateListener(
+    Sock* sock,
+    const Addr* addr)
+{
+    return _CreateListener(sock, addr, MI_FALSE);
+}
+
+MI_Result Sock_CreateSharedListener(
+    Sock* sock,
+    const Addr* addr)
+{
+    return _CreateListener(sock, addr, MI_TRUE);
+}
+
 MI_Result Sock_CreateLocalListener(
     Sock* sock,
     const char* socketName)
@@ -72,6 +72,11 @@ MI_Result Sock_ReuseAddr(
     Sock self,
     MI_Boolean flag);
 
+/* Returns MI_RESULT_NOT_SUPPORTED if platform has no SO_REUSEPORT */
+MI_Result Sock_ReusePort(
+    Sock self,
+    MI_Boolean flag);
+
 MI_Result Sock_SetBlocking(
     Sock self,
     MI_Boolean flag);
@@ -112,6 +117,12 @@ MI_Result Sock_CreateListener(
     Sock* sock,
     const Addr* addr);
 
+/* Creates listener that can share its address with other shared listeners
+    (SO_REUSEPORT); incoming connections are spread among them by the OS */
+MI_Result Sock_CreateSharedListener(
+    Sock* sock,
+    const Addr* addr);
+
 /* AF_LOCAL family */
 MI_Result Sock_CreateLocalListener(
     Sock* sock,
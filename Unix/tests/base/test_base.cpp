@@ -8,6 +8,7 @@
 */
 
 #include <vector>
+#include <string>
 #include <algorithm>
 #include <ut/ut.h>
 #include <base/base.h>
@@ -1892,6 +1893,180 @@ Error:
 }
 NitsEndTest
 
+static std::string _PrintInstance(const MI_Instance* inst)
+{
+    std::string result;
+    char data[1024];
+    size_t n;
+    FILE* os = tmpfile();
+
+    if (!os)
+        return result;
+
+    Instance_Print(inst, os, 0, MI_TRUE, MI_FALSE);
+    rewind(os);
+
+    while ((n = fread(data, 1, sizeof(data), os)) > 0)
+        result.append(data, n);
+
+    fclose(os);
+    return result;
+}
+
+NitsTestWithSetup(TestPackInstanceCompact, TestBaseSetup)
+{
+    MI_Instance* inst1 = NULL;
+    MI_Instance* inst2 = NULL;
+    MI_Instance* inst3 = NULL;
+    MI_Instance* inst4 = NULL;
+    MI_Instance* outer = NULL;
+    Batch batch = BATCH_INITIALIZER;
+    Buf buf = BUF_INITIALIZER;
+    Buf compactBuf = BUF_INITIALIZER;
+    MI_Instance* data[3];
+    MI_Value value;
+    MI_Result r;
+
+    /* Embed several instances of MSFT_AllTypes into a dynamic instance */
+    inst1 = NewAllTypes(&batch);
+    if(!TEST_ASSERT(inst1 != NULL))
+        goto Error;
+
+    r = Instance_NewDynamic(&outer, PAL_T("X_Outer"), MI_FLAG_CLASS, &batch);
+    if(!TEST_ASSERT(r == MI_RESULT_OK))
+        goto Error;
+
+    r = MI_Instance_SetNameSpace(outer, PAL_T("root/test"));
+    TEST_ASSERT(r == MI_RESULT_OK);
+
+    value.sint64 = -1234567;
+    r = MI_Instance_AddElement(outer, PAL_T("Number"), &value, MI_SINT64, MI_FLAG_KEY);
+    TEST_ASSERT(r == MI_RESULT_OK);
+
+    r = MI_Instance_AddElement(outer, PAL_T("Nothing"), NULL, MI_STRING, 0);
+    TEST_ASSERT(r == MI_RESULT_OK);
+
+    data[0] = data[1] = data[2] = inst1;
+    value.instancea.data = data;
+    value.instancea.size = MI_COUNT(data);
+    r = MI_Instance_AddElement(outer, PAL_T("Items"), &value, MI_INSTANCEA, 0);
+    TEST_ASSERT(r == MI_RESULT_OK);
+
+    r = Instance_Pack(outer, MI_FALSE, NULL, NULL, &buf);
+    TEST_ASSERT(r == MI_RESULT_OK);
+
+    r = Instance_PackCompact(outer, NULL, NULL, &compactBuf);
+    TEST_ASSERT(r == MI_RESULT_OK);
+
+    /* Class and property names of the embedded instances are sent once */
+    TEST_ASSERT(compactBuf.size * 3 < buf.size);
+
+    r = Instance_Unpack(&inst2, &buf, &batch, MI_FALSE);
+    if(!TEST_ASSERT(r == MI_RESULT_OK))
+        goto Error;
+
+    r = Instance_Unpack(&inst3, &compactBuf, &batch, MI_FALSE);
+    if(!TEST_ASSERT(r == MI_RESULT_OK))
+        goto Error;
+
+    TEST_ASSERT(compactBuf.offset == compactBuf.size);
+    TEST_ASSERT(_PrintInstance(inst3) == _PrintInstance(inst2));
+    TEST_ASSERT(_PrintInstance(inst3).find("Items") != std::string::npos);
+
+    /* Truncated data is rejected (before anything is allocated) */
+    {
+        MI_Uint32 size = compactBuf.size;
+
+        compactBuf.offset = 0;
+        compactBuf.size = 8;
+        r = Instance_Unpack(&inst4, &compactBuf, &batch, MI_FALSE);
+        TEST_ASSERT(r != MI_RESULT_OK);
+        TEST_ASSERT(inst4 == NULL);
+        compactBuf.size = size;
+    }
+
+Error:
+    if(inst1)
+        MI_Instance_Delete(inst1);
+    if(inst2)
+        MI_Instance_Delete(inst2);
+    if(inst3)
+        MI_Instance_Delete(inst3);
+    if(outer)
+        MI_Instance_Delete(outer);
+    Buf_Destroy(&buf);
+    Buf_Destroy(&compactBuf);
+    Batch_Destroy(&batch);
+}
+NitsEndTest
+
+NitsTestWithSetup(TestPackInstanceCompactStringArray, TestBaseSetup)
+{
+    NitsDisableFaultSim;
+
+    const MI_Uint32 COUNT = 20000;
+    MI_Instance* outer = NULL;
+    MI_Instance* inst = NULL;
+    Batch batch = BATCH_INITIALIZER;
+    Buf buf = BUF_INITIALIZER;
+    Buf compactBuf = BUF_INITIALIZER;
+    std::vector<ZChar> chars(COUNT * 16);
+    std::vector<ZChar*> data(COUNT);
+    MI_Value value;
+    MI_Type type;
+    MI_Result r;
+
+    /* Every value of a large string array comes twice: the second one
+       refers to the first one in the string table */
+    for (MI_Uint32 i = 0; i < COUNT; i++)
+    {
+        data[i] = &chars[i * 16];
+        Stprintf(data[i], 16, MI_T("Value%u"), (unsigned int)(i % (COUNT / 2)));
+    }
+
+    r = Instance_NewDynamic(&outer, PAL_T("X_Strings"), MI_FLAG_CLASS, &batch);
+    if(!TEST_ASSERT(r == MI_RESULT_OK))
+        goto Error;
+
+    value.stringa.data = &data[0];
+    value.stringa.size = COUNT;
+    r = MI_Instance_AddElement(outer, PAL_T("Values"), &value, MI_STRINGA, 0);
+    TEST_ASSERT(r == MI_RESULT_OK);
+
+    r = Instance_Pack(outer, MI_FALSE, NULL, NULL, &buf);
+    TEST_ASSERT(r == MI_RESULT_OK);
+
+    r = Instance_PackCompact(outer, NULL, NULL, &compactBuf);
+    TEST_ASSERT(r == MI_RESULT_OK);
+    TEST_ASSERT(compactBuf.size * 2 < buf.size);
+
+    r = Instance_Unpack(&inst, &compactBuf, &batch, MI_FALSE);
+    if(!TEST_ASSERT(r == MI_RESULT_OK))
+        goto Error;
+
+    r = MI_Instance_GetElement(inst, PAL_T("Values"), &value, &type, NULL, NULL);
+    if(!TEST_ASSERT(r == MI_RESULT_OK) ||
+        !TEST_ASSERT(type == MI_STRINGA) ||
+        !TEST_ASSERT(value.stringa.size == COUNT))
+        goto Error;
+
+    for (MI_Uint32 i = 0; i < COUNT; i++)
+    {
+        if (!TEST_ASSERT(Tcscmp(value.stringa.data[i], data[i]) == 0))
+            break;
+    }
+
+Error:
+    if(inst)
+        MI_Instance_Delete(inst);
+    if(outer)
+        MI_Instance_Delete(outer);
+    Buf_Destroy(&buf);
+    Buf_Destroy(&compactBuf);
+    Batch_Destroy(&batch);
+}
+NitsEndTest
+
 NitsTestWithSetup(TestPage, TestBaseSetup)
 {
     size_t n = sizeof (Page);
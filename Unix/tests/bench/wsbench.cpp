@@ -0,0 +1,815 @@
+/*
+**==============================================================================
+**
+** Copyright (c) Microsoft Corporation. All rights reserved. See file LICENSE
+** for license information.
+**
+**==============================================================================
+*/
+
+/*
+    Throughput benchmark for the XML parser and the WS-Management parsing and
+    serialization paths:
+
+        xml_next        XML_Next() over every *.xml file of a corpus directory
+                        (tests/xml) and over generated envelopes.
+        ws_parse        WS_ParseSoapEnvelope(), WS_ParseWSHeader() and, for
+                        Enumerate requests, WS_ParseEnumerateBody() over
+                        recorded requests (tests/protocol/posthttp).
+        ws_serialize    WSBuf_InstanceToBuf() over dynamic instances shaped
+                        like the Test_BigProvider ones (a single key) and
+                        over a wide instance with all common property types.
+
+    Results are printed as JSON with a fixed layout: one object per case, in
+    a fixed order (corpus files sorted by name), with fixed key order and
+    precision, so runs can be diffed and compared by scripts.
+
+    Every parse iteration copies the input first since the parser works in
+    place; the copy is part of the measured time as it is for the server,
+    which parses a private copy of the request page.
+*/
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cctype>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <xml/xml.h>
+#include <wsman/wstags.h>
+#include <wsman/wsbuf.h>
+#include <wsman/wsmanparser.h>
+#include <base/batch.h>
+#include <base/instance.h>
+#include <base/messages.h>
+#include <pal/dir.h>
+#include <pal/sleep.h>
+#include <pal/format.h>
+
+using namespace std;
+
+typedef vector<XML_Char> Text;
+
+static const char* arg0;
+
+/* Options */
+static unsigned long s_iterations;      /* fixed count; 0: calibrate */
+static unsigned long s_minTimeMs = 200; /* calibrated round length */
+static unsigned long s_rounds = 5;      /* best of */
+
+/*
+**==============================================================================
+**
+** Input
+**
+**==============================================================================
+*/
+
+static void Widen(const string& s, Text& text)
+{
+    /* plain copy; inputs are ASCII */
+    text.resize(s.size() + 1);
+
+    for (size_t i = 0; i < s.size(); i++)
+        text[i] = (XML_Char)(unsigned char)s[i];
+
+    text[s.size()] = 0;
+}
+
+static bool Inhale(const string& path, string& data)
+{
+    FILE* is = fopen(path.c_str(), "rb");
+    size_t n;
+    char buf[4096];
+
+    if (!is)
+        return false;
+
+    data.clear();
+
+    while ((n = fread(buf, 1, sizeof(buf), is)) != 0)
+        data.append(buf, n);
+
+    fclose(is);
+    return true;
+}
+
+/* Drops the line breaks and indentation following tags; recorded requests
+   are pretty-printed but clients send them on one line, and the header
+   parser neither accepts text between some tags (w:OptionSet) nor leading
+   space in some values (boolean options) */
+static void Compact(string& s)
+{
+    string out;
+    size_t i = 0;
+    size_t j;
+
+    out.reserve(s.size());
+
+    while (i < s.size())
+    {
+        char c = s[i++];
+
+        out += c;
+
+        if (c != '>')
+            continue;
+
+        for (j = i; j < s.size() && isspace((unsigned char)s[j]); j++)
+            ;
+
+        if (j < s.size() && (s[j] == '<' || memchr(&s[i], '\n', j - i)))
+            i = j;
+    }
+
+    s.swap(out);
+}
+
+static const char* BaseName(const string& path)
+{
+    const char* p = strrchr(path.c_str(), '/');
+    return p ? p + 1 : path.c_str();
+}
+
+static bool ListXmlFiles(const string& dir, vector<string>& paths)
+{
+    Dir* d = Dir_Open(dir.c_str());
+    DirEnt* ent;
+
+    if (!d)
+        return false;
+
+    while ((ent = Dir_Read(d)) != NULL)
+    {
+        size_t len = strlen(ent->name);
+
+        if (!ent->isDir && len > 4 && strcmp(ent->name + len - 4, ".xml") == 0)
+            paths.push_back(dir + "/" + ent->name);
+    }
+
+    Dir_Close(d);
+    sort(paths.begin(), paths.end());
+    return true;
+}
+
+/* Builds an Enumerate/Pull response envelope of at least 'size' bytes */
+static void MakeEnvelope(size_t size, string& s)
+{
+    char buf[128];
+    unsigned long i;
+
+    s = "<s:Envelope"
+        " xmlns:s=\"http://www.w3.org/2003/05/soap-envelope\""
+        " xmlns:a=\"http://schemas.xmlsoap.org/ws/2004/08/addressing\""
+        " xmlns:n=\"http://schemas.xmlsoap.org/ws/2004/09/enumeration\""
+        " xmlns:w=\"http://schemas.dmtf.org/wbem/wsman/1/wsman.xsd\""
+        " xmlns:p=\"http://schemas.microsoft.com/wbem/wsman/1/wsman.xsd\""
+        " xmlns:xsi=\"http://www.w3.org/2001/XMLSchema-instance\">"
+        "<s:Header>"
+        "<a:To>http://schemas.xmlsoap.org/ws/2004/08/addressing/role/anonymous</a:To>"
+        "<a:Action>http://schemas.xmlsoap.org/ws/2004/09/enumeration/PullResponse</a:Action>"
+        "<a:MessageID>uuid:6D1D6C4A-3A9B-4B5E-9C7E-1A2B3C4D5E6F</a:MessageID>"
+        "<a:RelatesTo>uuid:498D1C73-D311-425A-8F2E-14D19629467F</a:RelatesTo>"
+        "</s:Header>"
+        "<s:Body><n:PullResponse>"
+        "<n:EnumerationContext>42</n:EnumerationContext>"
+        "<n:Items>\n";
+
+    for (i = 0; s.size() < size; i++)
+    {
+        s += "<p:StressTestClass0"
+            " xmlns:p=\"http://schemas.microsoft.com/wbem/wscim/1/cim-schema/2/StressTestClass0\""
+            " xsi:type=\"p:StressTestClass0_Type\">\n";
+        sprintf(buf, "  <p:someKey0>%lu</p:someKey0>\n", i);
+        s += buf;
+        s += "  <p:Caption>Stress &amp; load test instance</p:Caption>\n"
+            "  <p:Description>Instance returned by the stress test provider;"
+            " the description is long enough to span several scan blocks"
+            " of the character data reducer.</p:Description>\n"
+            "  <p:Enabled>true</p:Enabled>\n"
+            "  <p:Values>1</p:Values><p:Values>22</p:Values>"
+            "<p:Values>333</p:Values>\n"
+            "  <p:Empty xsi:nil=\"true\"/>\n"
+            "</p:StressTestClass0>\n";
+    }
+
+    s += "</n:Items><n:EndOfSequence/></n:PullResponse></s:Body></s:Envelope>";
+}
+
+/*
+**==============================================================================
+**
+** Timing
+**
+**==============================================================================
+*/
+
+typedef bool (*RunProc)(void* data, unsigned long iterations);
+
+static double Now()
+{
+    PAL_Uint64 usec = 0;
+    PAL_Time(&usec);
+    return (double)usec * 1000.0;
+}
+
+/* Returns the best time of one iteration in nanoseconds or a negative
+   value if the case failed */
+static double Measure(RunProc run, void* data, unsigned long* iterationsOut)
+{
+    unsigned long iterations = s_iterations;
+    double best = 0;
+    unsigned long i;
+
+    if (!run(data, 1))
+        return -1;
+
+    if (!iterations)
+    {
+        double minTime = (double)s_minTimeMs * 1000000.0;
+        double elapsed = 0;
+
+        for (iterations = 1; iterations < 0x10000000; iterations *= 2)
+        {
+            double start = Now();
+
+            if (!run(data, iterations))
+                return -1;
+
+            elapsed = Now() - start;
+
+            if (elapsed >= minTime / 8)
+                break;
+        }
+
+        if (elapsed > 0)
+            iterations = (unsigned long)(iterations * (minTime / elapsed)) + 1;
+    }
+
+    for (i = 0; i < s_rounds; i++)
+    {
+        double start = Now();
+        double elapsed;
+
+        if (!run(data, iterations))
+            return -1;
+
+        elapsed = Now() - start;
+
+        if (i == 0 || elapsed < best)
+            best = elapsed;
+    }
+
+    *iterationsOut = iterations;
+    return best / iterations;
+}
+
+/*
+**==============================================================================
+**
+** Output
+**
+**==============================================================================
+*/
+
+static bool s_first = true;
+static int s_failures;
+
+static void PrintString(const char* s)
+{
+    putchar('"');
+
+    for (; *s; s++)
+    {
+        if (*s == '"' || *s == '\\')
+            putchar('\\');
+        putchar(*s);
+    }
+
+    putchar('"');
+}
+
+static void Report(
+    const char* group,
+    const char* name,
+    size_t bytes,
+    size_t elements,
+    unsigned long iterations,
+    double ns)
+{
+    printf("%s\n    {\n", s_first ? "" : ",");
+    s_first = false;
+
+    printf("      \"group\": ");
+    PrintString(group);
+    printf(",\n      \"name\": ");
+    PrintString(name);
+
+    if (ns < 0)
+    {
+        printf(",\n      \"error\": true\n    }");
+        s_failures++;
+        return;
+    }
+
+    printf(",\n      \"bytes\": %lu", (unsigned long)bytes);
+    printf(",\n      \"elements\": %lu", (unsigned long)elements);
+    printf(",\n      \"iterations\": %lu", iterations);
+    printf(",\n      \"ns_per_iteration\": %.1f", ns);
+    printf(",\n      \"ns_per_element\": %.2f",
+        elements ? ns / elements : 0.0);
+    printf(",\n      \"mb_per_sec\": %.2f\n    }",
+        ns > 0 ? (double)bytes * 1000.0 / ns : 0.0);
+}
+
+/*
+**==============================================================================
+**
+** xml_next
+**
+**==============================================================================
+*/
+
+struct XmlCase
+{
+    Text text;
+    Text copy;
+    XML xml;
+    size_t elements;
+};
+
+/* Counts the elements returned up to the end of the document or the first
+   error; the error cases of the corpus are measured up to the error */
+static bool RunXmlNext(void* data, unsigned long iterations)
+{
+    XmlCase* c = (XmlCase*)data;
+    XML_Elem e;
+
+    while (iterations--)
+    {
+        size_t elements = 0;
+
+        memcpy(&c->copy[0], &c->text[0], c->text.size() * sizeof(XML_Char));
+        XML_Init(&c->xml);
+        XML_SetText(&c->xml, &c->copy[0]);
+
+        while (XML_Next(&c->xml, &e) == 0)
+            elements++;
+
+        c->elements = elements;
+    }
+
+    return true;
+}
+
+static void BenchXmlNext(const char* name, const string& data)
+{
+    XmlCase* c = new XmlCase;
+    unsigned long iterations = 0;
+    double ns;
+
+    Widen(data, c->text);
+    c->copy.resize(c->text.size());
+    c->elements = 0;
+
+    ns = Measure(RunXmlNext, c, &iterations);
+    Report("xml_next", name, data.size(), c->elements, iterations, ns);
+
+    delete c;
+}
+
+/*
+**==============================================================================
+**
+** ws_parse
+**
+**==============================================================================
+*/
+
+struct WsCase
+{
+    Text text;
+    Text copy;
+    XML base;
+    XML xml;
+    WSMAN_WSHeader wsheader;
+    WSMAN_WSEnumeratePullBody wsenumbody;
+};
+
+static void InitWsmanXml(XML* xml)
+{
+    /* the namespaces registered by WSMAN_New() */
+    XML_Init(xml);
+    XML_RegisterNameSpace(xml, 's',
+        ZT("http://www.w3.org/2003/05/soap-envelope"));
+    XML_RegisterNameSpace(xml, 'a',
+        ZT("http://schemas.xmlsoap.org/ws/2004/08/addressing"));
+    XML_RegisterNameSpace(xml, 'w',
+        ZT("http://schemas.dmtf.org/wbem/wsman/1/wsman.xsd"));
+    XML_RegisterNameSpace(xml, 'n',
+        ZT("http://schemas.xmlsoap.org/ws/2004/09/enumeration"));
+    XML_RegisterNameSpace(xml, 'b',
+        ZT("http://schemas.dmtf.org/wbem/wsman/1/cimbinding.xsd"));
+    XML_RegisterNameSpace(xml, 'p',
+        ZT("http://schemas.microsoft.com/wbem/wsman/1/wsman.xsd"));
+    XML_RegisterNameSpace(xml, 'i',
+        ZT("http://schemas.dmtf.org/wbem/wsman/identity/1/wsmanidentity.xsd"));
+    XML_RegisterNameSpace(xml, 'x',
+        ZT("http://www.w3.org/2001/XMLSchema-instance"));
+    XML_RegisterNameSpace(xml, MI_T('e'),
+        ZT("http://schemas.xmlsoap.org/ws/2004/08/eventing"));
+#ifndef DISABLE_SHELL
+    XML_RegisterNameSpace(xml, MI_T('h'),
+        ZT("http://schemas.microsoft.com/wbem/wsman/1/windows/shell"));
+#endif
+}
+
+/* Parses the request the way wsman.c does up to the dispatch of the
+   action; only Enumerate bodies are parsed */
+static bool RunWsParse(void* data, unsigned long iterations)
+{
+    WsCase* c = (WsCase*)data;
+
+    while (iterations--)
+    {
+        memcpy(&c->copy[0], &c->text[0], c->text.size() * sizeof(XML_Char));
+        memcpy(&c->xml, &c->base, sizeof(XML));
+        XML_SetText(&c->xml, &c->copy[0]);
+
+        if (WS_ParseSoapEnvelope(&c->xml) != 0 || c->xml.status)
+            return false;
+
+        if (WS_ParseWSHeader(&c->xml, &c->wsheader, USERAGENT_UNKNOWN) != 0 ||
+            c->xml.status)
+            return false;
+
+        if (c->wsheader.rqtAction == WSMANTAG_ACTION_ENUMERATE)
+        {
+            if (!c->wsheader.instanceBatch)
+                c->wsheader.instanceBatch = Batch_New(BATCH_MAX_PAGES);
+
+            if (WS_ParseEnumerateBody(&c->xml, &c->wsheader.instanceBatch,
+                &c->wsenumbody) != 0 || c->xml.status)
+                return false;
+        }
+    }
+
+    return true;
+}
+
+static void BenchWsParse(const char* name, const string& data)
+{
+    WsCase* c = new WsCase;
+    unsigned long iterations = 0;
+    size_t elements = 0;
+    double ns;
+
+    Widen(data, c->text);
+    c->copy.resize(c->text.size());
+    InitWsmanXml(&c->base);
+    memset(&c->wsheader, 0, sizeof(c->wsheader));
+
+    ns = Measure(RunWsParse, c, &iterations);
+
+    /* element count of the whole request for reference */
+    {
+        XmlCase count;
+        count.text = c->text;
+        count.copy.resize(c->text.size());
+        RunXmlNext(&count, 1);
+        elements = count.elements;
+    }
+
+    Report("ws_parse", name, data.size(), elements, iterations, ns);
+
+    if (c->wsheader.instanceBatch)
+        Batch_Delete(c->wsheader.instanceBatch);
+
+    delete c;
+}
+
+/*
+**==============================================================================
+**
+** ws_serialize
+**
+**==============================================================================
+*/
+
+struct SerializeCase
+{
+    MI_Instance* instance;
+    size_t bytes;
+    size_t elements;
+};
+
+static bool RunSerialize(void* data, unsigned long iterations)
+{
+    SerializeCase* c = (SerializeCase*)data;
+
+    while (iterations--)
+    {
+        Batch batch;
+        void* ptr;
+        MI_Uint32 size;
+
+        Batch_Init(&batch, BATCH_MAX_PAGES);
+
+        if (WSBuf_InstanceToBuf(USERAGENT_UNKNOWN, c->instance, NULL, NULL,
+            NULL, &batch, WSMAN_ObjectFlag, &ptr, &size) != MI_RESULT_OK)
+        {
+            Batch_Destroy(&batch);
+            return false;
+        }
+
+        c->bytes = size;
+        Batch_Destroy(&batch);
+    }
+
+    return true;
+}
+
+static MI_Result AddString(
+    MI_Instance* inst,
+    const MI_Char* name,
+    const MI_Char* str)
+{
+    MI_Value value;
+    value.string = (MI_Char*)str;
+    return __MI_Instance_AddElement(inst, name, &value, MI_STRING, 0);
+}
+
+/* One uint32 key, like the StressTestClassN instances of Test_BigProvider */
+static MI_Result MakeSmallInstance(Batch* batch, MI_Instance** inst)
+{
+    MI_Value value;
+    MI_Result r;
+
+    r = Instance_NewDynamic(inst, MI_T("StressTestClass0"), MI_FLAG_CLASS,
+        batch);
+
+    if (r != MI_RESULT_OK)
+        return r;
+
+    value.uint32 = 12345;
+    return __MI_Instance_AddElement(*inst, MI_T("someKey0"), &value,
+        MI_UINT32, MI_FLAG_KEY);
+}
+
+/* Keys, strings needing escaping, numbers, booleans and arrays */
+static MI_Result MakeWideInstance(Batch* batch, MI_Instance** inst)
+{
+    static MI_Char* strings[] =
+    {
+        (MI_Char*)MI_T("alpha"),
+        (MI_Char*)MI_T("beta & gamma"),
+        (MI_Char*)MI_T("<delta>"),
+        (MI_Char*)MI_T("epsilon"),
+    };
+    static MI_Uint32 numbers[] = { 1, 22, 333, 4444, 55555, 666666 };
+    MI_Value value;
+    MI_Result r;
+    MI_Char name[32];
+    int i;
+
+    r = Instance_NewDynamic(inst, MI_T("StressTestClassWide"), MI_FLAG_CLASS,
+        batch);
+
+    if (r != MI_RESULT_OK)
+        return r;
+
+    value.uint32 = 7;
+    r = __MI_Instance_AddElement(*inst, MI_T("Id"), &value, MI_UINT32,
+        MI_FLAG_KEY);
+
+    if (r == MI_RESULT_OK)
+        r = AddString(*inst, MI_T("Caption"),
+            MI_T("Stress & load test instance"));
+
+    if (r == MI_RESULT_OK)
+        r = AddString(*inst, MI_T("Description"),
+            MI_T("Instance returned by the stress test provider; the ")
+            MI_T("description is long enough to span several blocks of ")
+            MI_T("the escaping code <and> contains markup characters."));
+
+    for (i = 0; r == MI_RESULT_OK && i < 16; i++)
+    {
+        Stprintf(name, MI_COUNT(name), MI_T("Name%d"), i);
+        r = AddString(*inst, name, MI_T("/usr/lib/omi/provider-name.so"));
+    }
+
+    for (i = 0; r == MI_RESULT_OK && i < 16; i++)
+    {
+        Stprintf(name, MI_COUNT(name), MI_T("Count%d"), i);
+        value.uint32 = 1000u * i + 17;
+        r = __MI_Instance_AddElement(*inst, name, &value, MI_UINT32, 0);
+    }
+
+    for (i = 0; r == MI_RESULT_OK && i < 8; i++)
+    {
+        Stprintf(name, MI_COUNT(name), MI_T("Size%d"), i);
+        value.sint64 = -1234567890123LL * (i + 1);
+        r = __MI_Instance_AddElement(*inst, name, &value, MI_SINT64, 0);
+    }
+
+    for (i = 0; r == MI_RESULT_OK && i < 8; i++)
+    {
+        Stprintf(name, MI_COUNT(name), MI_T("Flag%d"), i);
+        value.boolean = (MI_Boolean)(i & 1);
+        r = __MI_Instance_AddElement(*inst, name, &value, MI_BOOLEAN, 0);
+    }
+
+    if (r == MI_RESULT_OK)
+    {
+        value.real64 = 3.25;
+        r = __MI_Instance_AddElement(*inst, MI_T("Ratio"), &value,
+            MI_REAL64, 0);
+    }
+
+    if (r == MI_RESULT_OK)
+    {
+        value.stringa.data = strings;
+        value.stringa.size = MI_COUNT(strings);
+        r = __MI_Instance_AddElement(*inst, MI_T("Tags"), &value,
+            MI_STRINGA, 0);
+    }
+
+    if (r == MI_RESULT_OK)
+    {
+        value.uint32a.data = numbers;
+        value.uint32a.size = MI_COUNT(numbers);
+        r = __MI_Instance_AddElement(*inst, MI_T("Values"), &value,
+            MI_UINT32A, 0);
+    }
+
+    return r;
+}
+
+static void BenchSerialize(
+    const char* name,
+    MI_Result (*make)(Batch* batch, MI_Instance** inst))
+{
+    SerializeCase c;
+    Batch* batch = Batch_New(BATCH_MAX_PAGES);
+    unsigned long iterations = 0;
+    MI_Uint32 count = 0;
+    double ns = -1;
+
+    c.instance = NULL;
+    c.bytes = 0;
+    c.elements = 0;
+
+    if (batch && make(batch, &c.instance) == MI_RESULT_OK)
+    {
+        MI_Instance_GetElementCount(c.instance, &count);
+        c.elements = count;
+        ns = Measure(RunSerialize, &c, &iterations);
+    }
+
+    Report("ws_serialize", name, c.bytes, c.elements, iterations, ns);
+
+    if (batch)
+        Batch_Delete(batch);
+}
+
+/*
+**==============================================================================
+**
+** main
+**
+**==============================================================================
+*/
+
+static void Usage()
+{
+    fprintf(stderr,
+        "Usage: %s [OPTIONS]\n"
+        "\n"
+        "OPTIONS:\n"
+        "    --xml DIR           Benchmark XML_Next() on DIR/*.xml.\n"
+        "    --request FILE      Benchmark WS-Man parsing of a request.\n"
+        "    --iterations N      Run N iterations per round (no calibration).\n"
+        "    --time MS           Calibrate rounds to MS milliseconds [200].\n"
+        "    --rounds N          Report the best of N rounds [5].\n"
+        "\n", arg0);
+    exit(1);
+}
+
+static unsigned long ULongArg(int argc, char** argv, int i)
+{
+    char* end;
+    unsigned long n;
+
+    if (i >= argc)
+        Usage();
+
+    n = strtoul(argv[i], &end, 10);
+
+    if (*end || !n)
+        Usage();
+
+    return n;
+}
+
+int main(int argc, char** argv)
+{
+    vector<string> xmlDirs;
+    vector<string> requests;
+    size_t i;
+    int j;
+
+    arg0 = argv[0];
+
+    for (j = 1; j < argc; j++)
+    {
+        string opt = argv[j];
+
+        if (opt == "--xml" && j + 1 < argc)
+            xmlDirs.push_back(argv[++j]);
+        else if (opt == "--request" && j + 1 < argc)
+            requests.push_back(argv[++j]);
+        else if (opt == "--iterations")
+            s_iterations = ULongArg(argc, argv, ++j);
+        else if (opt == "--time")
+            s_minTimeMs = ULongArg(argc, argv, ++j);
+        else if (opt == "--rounds")
+            s_rounds = ULongArg(argc, argv, ++j);
+        else
+            Usage();
+    }
+
+    printf("{\n  \"benchmark\": \"wsbench\",\n");
+    printf("  \"char_size\": %u,\n", (unsigned int)sizeof(XML_Char));
+    printf("  \"results\": [");
+
+    /* xml_next: corpus */
+    for (i = 0; i < xmlDirs.size(); i++)
+    {
+        vector<string> paths;
+        size_t k;
+
+        if (!ListXmlFiles(xmlDirs[i], paths))
+        {
+            fprintf(stderr, "%s: cannot read directory: %s\n", arg0,
+                xmlDirs[i].c_str());
+            exit(1);
+        }
+
+        for (k = 0; k < paths.size(); k++)
+        {
+            string data;
+
+            if (!Inhale(paths[k], data))
+            {
+                fprintf(stderr, "%s: cannot read file: %s\n", arg0,
+                    paths[k].c_str());
+                exit(1);
+            }
+
+            BenchXmlNext(BaseName(paths[k]), data);
+        }
+    }
+
+    /* xml_next: generated envelopes */
+    {
+        static const struct { const char* name; size_t size; } sizes[] =
+        {
+            { "envelope-64k", 64 * 1024 },
+            { "envelope-1m", 1024 * 1024 },
+        };
+
+        for (i = 0; i < MI_COUNT(sizes); i++)
+        {
+            string data;
+            MakeEnvelope(sizes[i].size, data);
+            BenchXmlNext(sizes[i].name, data);
+        }
+    }
+
+    /* ws_parse */
+    for (i = 0; i < requests.size(); i++)
+    {
+        string data;
+
+        if (!Inhale(requests[i], data))
+        {
+            fprintf(stderr, "%s: cannot read file: %s\n", arg0,
+                requests[i].c_str());
+            exit(1);
+        }
+
+        Compact(data);
+        BenchWsParse(BaseName(requests[i]), data);
+    }
+
+    /* ws_serialize */
+    BenchSerialize("instance-small", MakeSmallInstance);
+    BenchSerialize("instance-wide", MakeWideInstance);
+
+    printf("\n  ]\n}\n");
+
+    return s_failures ? 1 : 0;
+}
@@ -12,6 +12,7 @@
 #include <ut/ut.h>
 #include <pal/thread.h>
 #include <http/httpcommon.h>
+#include <http/httpcompress.h>
 #include <base/result.h>
 #include <base/Strand.h>
 #include <base/log.h>
@@ -120,6 +121,7 @@ struct ThreadParam
     string messageToSend;
     size_t  bytesToSendPerOperation;
     string response;
+    string responseEnd;     /* if set, read until response ends with it */
     bool gotRsp;
 };
 
@@ -204,6 +206,21 @@ static void* MI_CALL _http_client_proc(void* param)
 
     p->response = string(r_buf, read);
 
+    while (r == MI_RESULT_OK && read && !p->responseEnd.empty() &&
+        (p->response.size() < p->responseEnd.size() ||
+         p->response.compare(p->response.size() - p->responseEnd.size(), 
+            p->responseEnd.size(), p->responseEnd) != 0))
+    {
+        do
+        {
+            r = Sock_Read(sock, r_buf, sizeof(r_buf), &read);
+            err = Sock_GetLastError();
+        }
+        while (r != MI_RESULT_OK && err == EAGAIN);
+
+        p->response += string(r_buf, read);
+    }
+
     p->gotRsp = true;
     Sock_Close(sock);
 
@@ -239,11 +256,23 @@ struct CallbackStruct
     size_t  contentLength;
     string data;
     string response;
+    size_t responsePageSize;    /* if set, response is a list of such pages */
+    bool responseGather;        /* pages refer to 'response' (HttpContentRef) */
+    size_t pages;               /* pages the request content came in */
+    bool piecesEndWithTag;      /* every page but the last ends with '>' */
 
-    CallbackStruct() : contentLength(0){}
+    CallbackStruct() : contentLength(0), responsePageSize(0), responseGather(false),
+        pages(0), piecesEndWithTag(true){}
 };
 
 BEGIN_EXTERNC
+static ptrdiff_t s_contentRefsReleased;
+
+static void _ReleaseContentRef( void* owner )
+{
+    Atomic_Inc(&s_contentRefsReleased);
+}
+
 static void _StrandTestPost( _In_ Strand* self_, _In_ Message* msg ) 
 {
     CallbackStruct* data = (CallbackStruct*)self_;
@@ -267,20 +296,71 @@ static void _StrandTestPost( _In_ Strand* self_, _In_ Message* msg )
 
     data->contentLength = request->headers->contentLength;
 
-    data->data = string( (char*) ((request->page)+1), (size_t)(request->page)->u.s.size);
+    data->data.clear();
 
-    Page* rsp = (Page*)PAL_Malloc(sizeof(Page) + data->response.size());
-    
-    TEST_ASSERT(rsp);
+    for (Page* page = request->page; page; page = page->u.s.next)
+    {
+        const char* text = (const char*)(page + 1);
 
-    if(rsp)
+        data->data.append(text, (size_t)page->u.s.size);
+        data->pages++;
+
+        if (page->u.s.next &&
+            (page->u.s.size == 0 || text[page->u.s.size - 1] != '>' ||
+             text[page->u.s.size] != '\0'))
+            data->piecesEndWithTag = false;
+    }
+
+    Page* rsp = NULL;
+    Page** tail = &rsp;
+    size_t offset = 0;
+
+    do
     {
-        rsp->u.s.size = data->response.size();
-        memcpy(rsp+1, data->response.c_str(), data->response.size());
+        size_t size = data->response.size() - offset;
+
+        if (data->responsePageSize && size > data->responsePageSize)
+            size = data->responsePageSize;
+
+        if (data->responseGather)
+        {
+            *tail = HttpContentRef_New(data->response.c_str() + offset, size,
+                _ReleaseContentRef, data);
 
+            TEST_ASSERT(*tail);
+
+            if (!*tail)
+                break;
+
+            offset += size;
+            tail = &(*tail)->u.s.next;
+            continue;
+        }
+
+        *tail = (Page*)PAL_Malloc(sizeof(Page) + size);
+
+        TEST_ASSERT(*tail);
+
+        if (!*tail)
+            break;
+
+        memset(*tail, 0, sizeof(Page));
+        (*tail)->u.s.size = size;
+        memcpy(*tail+1, data->response.c_str() + offset, size);
+
+        offset += size;
+        tail = &(*tail)->u.s.next;
+    }
+    while (offset < data->response.size());
+
+    if(rsp)
+    {
         msgRsp = HttpResponseMsg_New(rsp, HTTP_ERROR_CODE_OK);
 
         TEST_ASSERT( NULL != msg );
+
+        if (msgRsp)
+            msgRsp->gather = data->responseGather;
     }
     Strand_Ack( &data->strand );
     if(msgRsp)
@@ -498,6 +578,427 @@ TestEnd:
 }
 NitsEndTest
 
+NitsTestWithSetup(TestHttp_IOThreads, TestHttpSetup)
+{
+    NitsDisableFaultSim;
+
+    Http* http = 0;
+    CallbackStruct cb;
+    HttpOptions options = DEFAULT_HTTP_OPTIONS;
+
+    cb.response = "Response";
+    options.ioThreads = 2;
+
+    /* create a server; connections are served by its own I/O threads */
+    if(!TEST_ASSERT( MI_RESULT_OK == Http_New_Server(
+        &http, 0, PORT, 0, NULL, (SSL_Options) 0,
+        _callback,
+        &cb,
+        &options) ))
+        return;
+
+    /* create a client */
+    ThreadParam param;
+    Thread t;
+
+    param.messageToSend = 
+        "POST /wsman HTTP/1.1\r\n"
+        "Content-Type: application/soap+xml;charset=UTF-8\r\n"
+        "User-Agent: Microsoft WinRM Client\r\n"
+        "Host: localhost:7778\r\n"
+        "Content-Length: 5\r\n"
+        "Authorization: auth\r\n"
+        "\r\n"
+        "Hello";
+    param.bytesToSendPerOperation = 30000;
+    param.gotRsp = false;
+
+    int threadCreatedResult = Thread_CreateJoinable(
+        &t, (ThreadProc)http_client_proc, NULL, &param);
+    TEST_ASSERT(MI_RESULT_OK == threadCreatedResult);
+    if(threadCreatedResult != MI_RESULT_OK)
+        goto EndTest;
+
+    // no pumping needed: the client finishes once an I/O thread answers
+    PAL_Uint32 ret;
+    TEST_ASSERT( Thread_Join( &t, &ret ) == 0 );
+    Thread_Destroy( &t );
+
+    TEST_ASSERT( param.gotRsp );
+    TEST_ASSERT( cb.contentType == "application/soap+xml" );
+    TEST_ASSERT( cb.contentLength == 5 );
+    TEST_ASSERT( cb.data == "Hello" );
+    TEST_ASSERT( param.response.find("200") != string::npos );
+
+EndTest:
+    TEST_ASSERT( MI_RESULT_OK == Http_Delete(http) );
+}
+NitsEndTest
+
+NitsTestWithSetup(TestHttp_ChunkedResponse, TestHttpSetup)
+{
+    NitsDisableFaultSim;
+
+    Http* http = 0;
+    CallbackStruct cb;
+
+    /* a list of pages is sent as one chunk per page */
+    cb.response = "0123456789abcdefghij";
+    cb.responsePageSize = 8;
+
+    /* create a server */
+    if(!TEST_ASSERT( MI_RESULT_OK == Http_New_Server(
+        &http, 0, PORT, 0, NULL, (SSL_Options) 0,
+        _callback,
+        &cb,
+        NULL) ))
+        return;
+
+    /* create a client */
+    ThreadParam param;
+    Thread t;
+
+    param.messageToSend =
+        "POST /wsman HTTP/1.1\r\n"
+        "Content-Type: application/soap+xml;charset=UTF-8\r\n"
+        "User-Agent: Microsoft WinRM Client\r\n"
+        "Host: localhost:7778\r\n"
+        "Content-Length: 5\r\n"
+        "Authorization: auth\r\n"
+        "\r\n"
+        "Hello";
+    param.bytesToSendPerOperation = 30000;
+    param.responseEnd = "0\r\n\r\n";
+    param.gotRsp = false;
+
+    int threadCreatedResult = Thread_CreateJoinable(
+        &t, (ThreadProc)http_client_proc, NULL, &param);
+    TEST_ASSERT(MI_RESULT_OK == threadCreatedResult);
+    if(threadCreatedResult != MI_RESULT_OK)
+        goto EndTest;
+
+    // pump messages
+    for (int i = 0; !param.gotRsp && i < 10000; i++ )
+        Http_Run( http, SELECT_BASE_TIMEOUT_MSEC * 1000 );
+
+    // wait for completion and check that
+    PAL_Uint32 ret;
+    TEST_ASSERT( Thread_Join( &t, &ret ) == 0 );
+    Thread_Destroy( &t );
+
+    TEST_ASSERT( cb.data == "Hello" );
+    TEST_ASSERT( param.response.find("Transfer-Encoding: chunked\r\n") != string::npos );
+    TEST_ASSERT( param.response.find("Content-Length") == string::npos );
+    TEST_ASSERT( param.response.find("\r\n\r\n"
+        "8\r\n01234567\r\n"
+        "8\r\n89abcdef\r\n"
+        "4\r\nghij\r\n"
+        "0\r\n\r\n") != string::npos );
+
+EndTest:
+    TEST_ASSERT( MI_RESULT_OK == Http_Delete(http) );
+}
+NitsEndTest
+
+NitsTestWithSetup(TestHttp_GatheredResponse, TestHttpSetup)
+{
+    NitsDisableFaultSim;
+
+    Http* http = 0;
+    CallbackStruct cb;
+
+    /* gathered content refers to the caller's data and is sent as one
+       body; every piece is released once it is written */
+    cb.response = "0123456789abcdefghij";
+    cb.responsePageSize = 8;
+    cb.responseGather = true;
+    s_contentRefsReleased = 0;
+
+    /* create a server */
+    if(!TEST_ASSERT( MI_RESULT_OK == Http_New_Server(
+        &http, 0, PORT, 0, NULL, (SSL_Options) 0,
+        _callback,
+        &cb,
+        NULL) ))
+        return;
+
+    /* create a client */
+    ThreadParam param;
+    Thread t;
+
+    param.messageToSend =
+        "POST /wsman HTTP/1.1\r\n"
+        "Content-Type: application/soap+xml;charset=UTF-8\r\n"
+        "User-Agent: Microsoft WinRM Client\r\n"
+        "Host: localhost:7778\r\n"
+        "Content-Length: 5\r\n"
+        "Authorization: auth\r\n"
+        "\r\n"
+        "Hello";
+    param.bytesToSendPerOperation = 30000;
+    param.responseEnd = "ghij";
+    param.gotRsp = false;
+
+    int threadCreatedResult = Thread_CreateJoinable(
+        &t, (ThreadProc)http_client_proc, NULL, &param);
+    TEST_ASSERT(MI_RESULT_OK == threadCreatedResult);
+    if(threadCreatedResult != MI_RESULT_OK)
+        goto EndTest;
+
+    // pump messages
+    for (int i = 0; !param.gotRsp && i < 10000; i++ )
+        Http_Run( http, SELECT_BASE_TIMEOUT_MSEC * 1000 );
+
+    // wait for completion and check that
+    PAL_Uint32 ret;
+    TEST_ASSERT( Thread_Join( &t, &ret ) == 0 );
+    Thread_Destroy( &t );
+
+    TEST_ASSERT( cb.data == "Hello" );
+    TEST_ASSERT( param.response.find("Transfer-Encoding") == string::npos );
+    TEST_ASSERT( param.response.find("Content-Length: 20\r\n") != string::npos );
+    TEST_ASSERT( param.response.find("\r\n\r\n0123456789abcdefghij") != string::npos );
+    TEST_ASSERT( 3 == s_contentRefsReleased );
+
+EndTest:
+    TEST_ASSERT( MI_RESULT_OK == Http_Delete(http) );
+}
+NitsEndTest
+
+NitsTest(TestHttp_AcceptEncoding)
+{
+    if (!HttpCompress_IsSupported())
+    {
+        TEST_ASSERT( HTTP_CONTENT_ENCODING_IDENTITY == HttpCompress_ParseAcceptEncoding("gzip") );
+        return;
+    }
+
+    TEST_ASSERT( HTTP_CONTENT_ENCODING_GZIP == HttpCompress_ParseAcceptEncoding("gzip") );
+    TEST_ASSERT( HTTP_CONTENT_ENCODING_GZIP == HttpCompress_ParseAcceptEncoding("deflate, GZIP;q=0.5") );
+    TEST_ASSERT( HTTP_CONTENT_ENCODING_GZIP == HttpCompress_ParseAcceptEncoding("*") );
+    TEST_ASSERT( HTTP_CONTENT_ENCODING_DEFLATE == HttpCompress_ParseAcceptEncoding("gzip;q=0, deflate") );
+    TEST_ASSERT( HTTP_CONTENT_ENCODING_DEFLATE == HttpCompress_ParseAcceptEncoding("gzip ; q=0.000,deflate;q=1") );
+    TEST_ASSERT( HTTP_CONTENT_ENCODING_IDENTITY == HttpCompress_ParseAcceptEncoding("identity") );
+    TEST_ASSERT( HTTP_CONTENT_ENCODING_IDENTITY == HttpCompress_ParseAcceptEncoding("") );
+    TEST_ASSERT( HTTP_CONTENT_ENCODING_IDENTITY == HttpCompress_ParseAcceptEncoding("br, gzip;q=0") );
+}
+NitsEndTest
+
+/* Decompresses chunked content: "<size>\r\n<data>\r\n" ... "0\r\n\r\n" */
+static bool _DecompressChunks(
+    const string& content,
+    string& data,
+    size_t* chunks = NULL)
+{
+    HttpCompressStream* stream = HttpCompressStream_New(HTTP_CONTENT_ENCODING_GZIP, MI_FALSE, 0);
+    size_t pos = 0;
+    bool ok = stream != NULL;
+
+    while (ok)
+    {
+        size_t size = strtoul(content.c_str() + pos, NULL, 16);
+        size_t start = content.find("\r\n", pos);
+
+        if (start == string::npos)
+        {
+            ok = false;
+            break;
+        }
+
+        start += 2;
+
+        if (size == 0)
+        {
+            ok = HttpCompressStream_Ended(stream) != MI_FALSE;
+            break;
+        }
+
+        Page* page = (Page*)PAL_Malloc(sizeof(Page) + size);
+
+        if (!page)
+        {
+            ok = false;
+            break;
+        }
+
+        memset(page, 0, sizeof(Page));
+        page->u.s.size = size;
+        memcpy(page + 1, content.c_str() + start, size);
+
+        ok = HttpCompressStream_Page(stream, &page, MI_FALSE) != MI_FALSE;
+
+        if (ok)
+            data += string((char*)(page + 1), page->u.s.size);
+
+        if (chunks)
+            (*chunks)++;
+
+        PAL_Free(page);
+        pos = start + size + 2;
+    }
+
+    if (stream)
+        HttpCompressStream_Delete(stream);
+
+    return ok;
+}
+
+NitsTestWithSetup(TestHttp_CompressedChunkedResponse, TestHttpSetup)
+{
+    NitsDisableFaultSim;
+
+    if (!HttpCompress_IsSupported())
+        return;
+
+    Http* http = 0;
+    CallbackStruct cb;
+    string content;
+    size_t pos;
+
+    /* chunks are compressed one by one as one gzip stream */
+    for (int i = 0; i < 200; i++)
+        cb.response += "<p:Number>12345</p:Number>";
+
+    cb.responsePageSize = 1000;
+
+    /* create a server */
+    if(!TEST_ASSERT( MI_RESULT_OK == Http_New_Server(
+        &http, 0, PORT, 0, NULL, (SSL_Options) 0,
+        _callback,
+        &cb,
+        NULL) ))
+        return;
+
+    /* create a client */
+    ThreadParam param;
+    Thread t;
+
+    param.messageToSend =
+        "POST /wsman HTTP/1.1\r\n"
+        "Content-Type: application/soap+xml;charset=UTF-8\r\n"
+        "User-Agent: Microsoft WinRM Client\r\n"
+        "Host: localhost:7778\r\n"
+        "Content-Length: 5\r\n"
+        "Accept-Encoding: gzip\r\n"
+        "Authorization: auth\r\n"
+        "\r\n"
+        "Hello";
+    param.bytesToSendPerOperation = 30000;
+    param.responseEnd = "\r\n0\r\n\r\n";
+    param.gotRsp = false;
+
+    int threadCreatedResult = Thread_CreateJoinable(
+        &t, (ThreadProc)http_client_proc, NULL, &param);
+    TEST_ASSERT(MI_RESULT_OK == threadCreatedResult);
+    if(threadCreatedResult != MI_RESULT_OK)
+        goto EndTest;
+
+    // pump messages
+    for (int i = 0; !param.gotRsp && i < 10000; i++ )
+        Http_Run( http, SELECT_BASE_TIMEOUT_MSEC * 1000 );
+
+    // wait for completion and check that
+    PAL_Uint32 ret;
+    TEST_ASSERT( Thread_Join( &t, &ret ) == 0 );
+    Thread_Destroy( &t );
+
+    TEST_ASSERT( cb.data == "Hello" );
+    TEST_ASSERT( param.response.find("Transfer-Encoding: chunked\r\n") != string::npos );
+    TEST_ASSERT( param.response.find("Content-Encoding: gzip\r\n") != string::npos );
+
+    pos = param.response.find("\r\n\r\n");
+    if (TEST_ASSERT( pos != string::npos ))
+    {
+        TEST_ASSERT( _DecompressChunks(param.response.substr(pos + 4), content) );
+        TEST_ASSERT( content == cb.response );
+    }
+
+EndTest:
+    TEST_ASSERT( MI_RESULT_OK == Http_Delete(http) );
+}
+NitsEndTest
+
+NitsTestWithSetup(TestHttp_CompressedGatheredResponse, TestHttpSetup)
+{
+    NitsDisableFaultSim;
+
+    if (!HttpCompress_IsSupported())
+        return;
+
+    Http* http = 0;
+    CallbackStruct cb;
+    string content;
+    size_t chunks = 0;
+    size_t pos;
+
+    /* gathered pieces are compressed from where they are, up to 64K of
+       them into one chunk, and released once they are compressed */
+    for (int i = 0; i < 3000; i++)
+        cb.response += "<p:Number>12345</p:Number>";
+
+    cb.responsePageSize = 1000;
+    cb.responseGather = true;
+    s_contentRefsReleased = 0;
+
+    /* create a server */
+    if(!TEST_ASSERT( MI_RESULT_OK == Http_New_Server(
+        &http, 0, PORT, 0, NULL, (SSL_Options) 0,
+        _callback,
+        &cb,
+        NULL) ))
+        return;
+
+    /* create a client */
+    ThreadParam param;
+    Thread t;
+
+    param.messageToSend =
+        "POST /wsman HTTP/1.1\r\n"
+        "Content-Type: application/soap+xml;charset=UTF-8\r\n"
+        "User-Agent: Microsoft WinRM Client\r\n"
+        "Host: localhost:7778\r\n"
+        "Content-Length: 5\r\n"
+        "Accept-Encoding: gzip\r\n"
+        "Authorization: auth\r\n"
+        "\r\n"
+        "Hello";
+    param.bytesToSendPerOperation = 30000;
+    param.responseEnd = "\r\n0\r\n\r\n";
+    param.gotRsp = false;
+
+    int threadCreatedResult = Thread_CreateJoinable(
+        &t, (ThreadProc)http_client_proc, NULL, &param);
+    TEST_ASSERT(MI_RESULT_OK == threadCreatedResult);
+    if(threadCreatedResult != MI_RESULT_OK)
+        goto EndTest;
+
+    // pump messages
+    for (int i = 0; !param.gotRsp && i < 10000; i++ )
+        Http_Run( http, SELECT_BASE_TIMEOUT_MSEC * 1000 );
+
+    // wait for completion and check that
+    PAL_Uint32 ret;
+    TEST_ASSERT( Thread_Join( &t, &ret ) == 0 );
+    Thread_Destroy( &t );
+
+    TEST_ASSERT( cb.data == "Hello" );
+    TEST_ASSERT( param.response.find("Transfer-Encoding: chunked\r\n") != string::npos );
+    TEST_ASSERT( param.response.find("Content-Encoding: gzip\r\n") != string::npos );
+
+    pos = param.response.find("\r\n\r\n");
+    if (TEST_ASSERT( pos != string::npos ))
+    {
+        TEST_ASSERT( _DecompressChunks(param.response.substr(pos + 4), content, &chunks) );
+        TEST_ASSERT( content == cb.response );
+        TEST_ASSERT( 2 == chunks );
+    }
+    TEST_ASSERT( 78 == s_contentRefsReleased );
+
+EndTest:
+    TEST_ASSERT( MI_RESULT_OK == Http_Delete(http) );
+}
+NitsEndTest
+
 NitsTestWithSetup(TestHttp_QuotedCharset, TestHttpSetup)
 {
     NitsDisableFaultSim;
@@ -559,6 +1060,78 @@ TestEnd:
 }
 NitsEndTest
 
+NitsTestWithSetup(TestHttp_LargeXmlContent, TestHttpSetup)
+{
+    NitsDisableFaultSim;
+
+    Http* http = 0;
+    CallbackStruct cb;
+    string content = "<?xml version=\"1.0\"?>"
+        "<s:Envelope xmlns:s=\"http://www.w3.org/2003/05/soap-envelope\">"
+        "<s:Body>";
+    char buf[64];
+
+    cb.response = "Response";
+
+    for (int i = 0; i < 5000; i++)
+    {
+        Snprintf(buf, sizeof(buf), "<Item Id=\"%d\">value %d</Item>", i, i);
+        content += buf;
+    }
+
+    content += "</s:Body></s:Envelope>";
+
+    /* create a server */
+    if(!TEST_ASSERT( MI_RESULT_OK == Http_New_Server(
+        &http, 0, PORT, 0, NULL, (SSL_Options) 0,
+        _callback,
+        &cb,
+        NULL) ))
+        return;
+
+    /* create a client */
+    ThreadParam param;
+    Thread t;
+
+    Snprintf(buf, sizeof(buf), "Content-Length: %d\r\n", (int)content.size());
+
+    param.messageToSend =
+        "POST /wsman HTTP/1.1\r\n"
+        "Content-Type: application/soap+xml;charset=UTF-8\r\n"
+        "Host: localhost:7778\r\n";
+    param.messageToSend += buf;
+    param.messageToSend +=
+        "Authorization: auth\r\n"
+        "\r\n";
+    param.messageToSend += content;
+    param.bytesToSendPerOperation = 30000;
+    param.gotRsp = false;
+
+    int threadCreatedResult = Thread_CreateJoinable(
+        &t, (ThreadProc)http_client_proc, NULL, &param);
+    TEST_ASSERT(MI_RESULT_OK == threadCreatedResult);
+    if(threadCreatedResult != MI_RESULT_OK)
+        goto TestEnd;
+    // pump messages
+    for (int i = 0; !param.gotRsp && i < 10000; i++ )
+        Http_Run( http, SELECT_BASE_TIMEOUT_MSEC * 1000 );
+
+    // wait for completion and check that
+    PAL_Uint32 ret;
+    TEST_ASSERT( Thread_Join( &t, &ret ) == 0 );
+    Thread_Destroy( &t );
+
+    /* the content came in pages cut right after tags */
+    TEST_ASSERT( cb.contentLength == content.size() );
+    TEST_ASSERT( cb.data == content );
+    TEST_ASSERT( cb.pages > 1 );
+    TEST_ASSERT( cb.piecesEndWithTag );
+
+TestEnd:
+    TEST_ASSERT( MI_RESULT_OK == Http_Delete(http) );
+}
+NitsEndTest
+
 NitsTestWithSetup(TestHttp_Base64Decoding, TestHttpSetup)
 {
     NitsDisableFaultSim;
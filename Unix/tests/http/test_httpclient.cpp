@@ -200,6 +200,7 @@ void _StrandTestClientPost( _In_ Strand* self_, _In_ Message* msg )
     if(rsp == NULL)
         return;
 
+    memset(rsp, 0, sizeof(Page));
     rsp->u.s.size = s_response.size();
     memcpy(rsp+1, s_response.c_str(), s_response.size());
 
@@ -2624,6 +2624,22 @@ NitsTest(TestWideCharToMultiByteConversion3)
     NitsAssert(TestWideCharConversion(src, wideCharSize, (const char*) expectedResult, expectedSize), PAL_T("conversion failed"));
 NitsEndTest
 
+NitsTest(TestMultiByteToWideCharConversion)
+    /* an ASCII run longer than 16 characters, 2, 3 and 4-byte characters,
+       then an overlong form, a surrogate and a truncated sequence */
+    const char src[] = "abcdefghijklmnopqrstuvwxyz\xC3\xA0\xE2\x92\x8B\xF0\x9F\x98\x80"
+        "\xC0\xAF\xED\xA0\x80x\xE2\x82";
+    const wchar_t expected[] = {
+        'a','b','c','d','e','f','g','h','i','j','k','l','m',
+        'n','o','p','q','r','s','t','u','v','w','x','y','z',
+        0xE0, 0x248B, 0x1F600, '?', '?', '?', '?', '?', 'x', '?', '?' };
+    wchar_t dest[sizeof(src)];
+    size_t count = ConvertMultiByteToWideChar(src, sizeof(src) - 1, dest);
+
+    NitsAssert(count == sizeof(expected)/sizeof(wchar_t), PAL_T("Wrong character count"));
+    NitsAssert(memcmp(dest, expected, sizeof(expected)) == 0, PAL_T("Result does not match expected"));
+NitsEndTest
+
 #endif
 
 #endif /* defined(CONFIG_ENABLE_WCHAR) */
@@ -8,6 +8,7 @@
 */
 
 #include <vector>
+#include <string>
 #include <cstdlib>
 #include <ut/ut.h>
 #include <protocol/protocol.h>
@@ -30,6 +31,7 @@
 # include <fcntl.h>
 # include <arpa/inet.h>
 # include <signal.h>
+# include <sys/mman.h>
 #endif
 
 #if defined(_MSC_VER)
@@ -286,7 +288,8 @@ static void _TransferMessageUsingProtocol(
     Message** result,
     bool listenerUsesExternalSelect = false, 
     bool connectorUsesExternalSelect = false,
-    Sock* socketPair = 0)
+    Sock* socketPair = 0,
+    bool useRings = false)
 {
     Selector internal_selector; // note that is is "external" selector from connector/serverSocket point of view
     Selector*   selector = 0;
@@ -330,14 +333,43 @@ static void _TransferMessageUsingProtocol(
     }
     else
     {
+        ProtocolRings* connectorRings = NULL;
+        ProtocolRings* agentRings = NULL;
+
+#if defined(CONFIG_POSIX)
+        if (useRings)
+        {
+            int fd;
+
+            r = ProtocolRings_Create(&connectorRings, 64 * 1024, &fd);
+            UT_ASSERT(MI_RESULT_OK == r);
+            if (r != MI_RESULT_OK)
+                return;
+
+            r = ProtocolRings_Attach(&agentRings, fd);
+            close(fd);
+            UT_ASSERT(MI_RESULT_OK == r);
+            if (r != MI_RESULT_OK)
+            {
+                ProtocolRings_Delete(connectorRings);
+                return;
+            }
+        }
+#endif
+
         r = ProtocolSocketAndBase_New_Agent(
             &serverSocket, 
             listenerUsesExternalSelect ? selector : 0, 
             socketPair[0], 
-            _ServerCallback, NULL);
+            _ServerCallback, NULL,
+            agentRings);
         UT_ASSERT( MI_RESULT_OK == r);
         if(r != MI_RESULT_OK)
+        {
+            if (connectorRings)
+                ProtocolRings_Delete(connectorRings);
             return;
+        }
 
         InteractionOpenParams interactionParams;
         
@@ -347,7 +379,8 @@ static void _TransferMessageUsingProtocol(
             &connector, 
             connectorUsesExternalSelect ? selector : 0, 
             socketPair[1],
-            &interactionParams);
+            &interactionParams,
+            connectorRings);
         UT_ASSERT(MI_RESULT_OK == r);
         if (MI_RESULT_OK != r)
         {
@@ -582,8 +615,244 @@ NitsTestWithSetup(TestTransferingPostInstance, TestProtocolSetup)
 }
 NitsEndTest
 
+#ifdef CONFIG_POSIX
+/* batches of instances only come from agents, so they are transferred
+   over a socket pair */
+static void _TransferMessageFromAgent(
+    Message* msg,
+    Message** result)
+{
+    Sock s[2];
+
+    UT_ASSERT(0 == socketpair(AF_UNIX, SOCK_STREAM, 0, s));
+    UT_ASSERT( MI_RESULT_OK == Sock_SetBlocking(s[0], MI_FALSE));
+    UT_ASSERT( MI_RESULT_OK == Sock_SetBlocking(s[1], MI_FALSE));
+
+    _TransferMessageUsingProtocol( msg, result, true, true, s );
+}
+#endif
+
+/* Creates a batch of 'count' packed instances (different keys, so that
+   items differ) with room for one more */
+static PostInstanceBatchMsg* _NewPostInstanceBatch(
+    MI_Uint32 count,
+    std::vector<std::string>& packed)
+{
+    PostInstanceBatchMsg* msg = PostInstanceBatchMsg_New( 1444, count + 1 );
+    MI_Uint32 i;
+
+    // instance - reuse cxx sample instance
+    MSFT_AllTypes_Class inst;
+    MI_ConstString test_string = MI_T("some very very very long string 1111111111111111111111111111111111111111111111111111111111111\
+        12333333333333333333333333333333333333333333333333333333333333333333333333333333333333333333333333333333333333333333");
+
+    UT_ASSERT( msg );
+    if (!msg)
+        return NULL;
+
+    msg->base.flags |= BinaryProtocolFlag;
+    inst.StringValue_value(test_string);
+
+    for (i = 0; i < count; i++)
+    {
+        PostInstanceBatchItem* item = &msg->items[i];
+
+        inst.Key_value(8 + i);
+
+        UT_ASSERT( MI_RESULT_OK == InstanceToBatch(
+            *((MI_Instance**)&inst), NULL, NULL, msg->base.batch,
+                &item->packedInstancePtr, &item->packedInstanceSize));
+
+        packed.push_back(std::string((const char*)item->packedInstancePtr, item->packedInstanceSize));
+        msg->count++;
+        msg->packedSize += item->packedInstanceSize;
+    }
+
+    return msg;
+}
+
+#ifdef CONFIG_POSIX
+NitsTestWithSetup(TestTransferingPostInstanceBatch, TestProtocolSetup)
+{
+    Message* result = 0;
+    std::vector<std::string> packed;
+    MI_Uint32 i;
+
+    // less items than capacity
+    PostInstanceBatchMsg* msg = _NewPostInstanceBatch( 3, packed );
+
+    if (!msg)
+        return;
+
+    _TransferMessageFromAgent( &msg->base, &result );
+
+    /* free source message */
+    UT_ASSERT(msg->base.refCounter == 1);
+    PostInstanceBatchMsg_Release(msg);
+
+    /* check received result */
+    UT_ASSERT( result );
+    if (!result)
+        return;
+
+    UT_ASSERT( result->tag == PostInstanceBatchMsgTag );
+
+    {
+        PostInstanceBatchMsg* rsp = (PostInstanceBatchMsg*)result;
+
+        UT_ASSERT( rsp->count == 3 );
+        UT_ASSERT( rsp->capacity == 4 );
+
+        for (i = 0; i < rsp->count && i < packed.size(); i++)
+        {
+            PostInstanceMsg* item = PostInstanceBatchMsg_NewItemMsg(rsp, i);
+
+            UT_ASSERT( item );
+            if (!item)
+                continue;
+
+            // the packed instance is not copied
+            UT_ASSERT( item->base.operationId == 1444 );
+            UT_ASSERT( (item->base.flags & BinaryProtocolFlag) != 0 );
+            UT_ASSERT( NULL == item->instance );
+            UT_ASSERT( item->base.payloadOwner == result );
+            UT_ASSERT( item->packedInstancePtr == rsp->items[i].packedInstancePtr );
+            UT_ASSERT( std::string((const char*)item->packedInstancePtr, item->packedInstanceSize) == packed[i] );
+
+            PostInstanceMsg_Release(item);
+        }
+    }
+
+    UT_ASSERT(result->refCounter == 1);
+    Message_Release(result);
+}
+NitsEndTest
+
+NitsTestWithSetup(TestTransferingMalformedPostInstanceBatch, TestProtocolSetup)
+{
+    Message* result = 0;
+    std::vector<std::string> packed;
+
+    /* more items than were sent: the items would run past their page */
+    PostInstanceBatchMsg* msg = _NewPostInstanceBatch( 2, packed );
+
+    if (!msg)
+        return;
+
+    msg->count = 100000;
+    msg->capacity = 100000;
+
+    _TransferMessageFromAgent( &msg->base, &result );
+    PostInstanceBatchMsg_Release(msg);
+
+    UT_ASSERT( NULL == result );
+    if (result)
+        Message_Release(result);
+
+    /* a packed instance that would run past its page */
+    SetupHelper();
+    packed.clear();
+    result = 0;
+    msg = _NewPostInstanceBatch( 2, packed );
+
+    if (!msg)
+        return;
+
+    msg->items[1].packedInstanceSize = 1024 * 1024;
+
+    _TransferMessageFromAgent( &msg->base, &result );
+    PostInstanceBatchMsg_Release(msg);
+
+    UT_ASSERT( NULL == result );
+    if (result)
+        Message_Release(result);
+}
+NitsEndTest
+#endif
+
+NitsTestWithSetup(TestTransferingPostInstanceBatchToListener, TestProtocolSetup)
+{
+    Message* result = 0;
+    std::vector<std::string> packed;
+
+    /* clients of the listener cannot send batches of instances */
+    PostInstanceBatchMsg* msg = _NewPostInstanceBatch( 2, packed );
+
+    if (!msg)
+        return;
+
+    _TransferMessageUsingProtocol( &msg->base, &result );
+    PostInstanceBatchMsg_Release(msg);
+
+    UT_ASSERT( NULL == result );
+    if (result)
+        Message_Release(result);
+}
+NitsEndTest
+
+NitsTestWithSetup(TestTransferingPostInstanceWithPayload, TestProtocolSetup)
+{
+    PostInstanceBatchMsg* owner = PostInstanceBatchMsg_New( 1444, 1 );
+    PostInstanceMsg* msg;
+    Message* result = 0;
+
+    // instance - reuse cxx sample instance
+    MSFT_AllTypes_Class inst;
+    MI_ConstString test_string = MI_T("some very very very long string 1111111111111111111111111111111111111111111111111111111111111\
+        12333333333333333333333333333333333333333333333333333333333333333333333333333333333333333333333333333333333333333333");
+
+    UT_ASSERT( owner );
+    if (!owner)
+        return;
+
+    owner->base.flags |= BinaryProtocolFlag;
+    inst.Key_value(8);
+    inst.StringValue_value(test_string);
+
+    UT_ASSERT( MI_RESULT_OK == InstanceToBatch(
+        *((MI_Instance**)&inst), NULL, NULL, owner->base.batch,
+            &owner->items[0].packedInstancePtr, &owner->items[0].packedInstanceSize));
+    owner->count = 1;
+
+    // the packed instance is only in the batch of 'owner'
+    msg = PostInstanceBatchMsg_NewItemMsg( owner, 0 );
+    UT_ASSERT( msg );
+    PostInstanceBatchMsg_Release(owner);
+    if (!msg)
+        return;
+
+    _TransferMessageUsingProtocol( &msg->base, &result );
+
+    /* free source message (and owner with it) */
+    UT_ASSERT(msg->base.refCounter == 1);
+    PostInstanceMsg_Release(msg);
+
+    /* check received result */
+    UT_ASSERT( result );
+    UT_ASSERT( result->tag == PostInstanceMsgTag );
+
+    {
+        PostInstanceMsg* rsp = (PostInstanceMsg*)result;
+
+        UT_ASSERT( NULL == rsp->base.payloadOwner );
+        UT_ASSERT( NULL == rsp->base.payloadPtr );
+
+        // instance
+        UT_ASSERT(rsp->instance);
+        MSFT_AllTypes_Class recv_inst;
+        _DynamicToStatikInstance( rsp->instance, rsp->base.batch, recv_inst );
+
+        UT_ASSERT(recv_inst.Key_value() == 8);
+        UT_ASSERT(recv_inst.StringValue_value() == test_string);
+    }
+
+    UT_ASSERT(result->refCounter == 1);
+    Message_Release(result);
+}
+NitsEndTest
+
 BEGIN_EXTERNC
-static void _TestTransferingInvoke(bool listenerUsesExternalSelect, bool connectorUsesExternalSelect, Sock* socketPair)
+static void _TestTransferingInvoke(bool listenerUsesExternalSelect, bool connectorUsesExternalSelect, Sock* socketPair, bool useRings = false)
 {
     InvokeReq* msg = InvokeReq_New( 1444, BinaryProtocolFlag );
     Message* result = 0;
@@ -608,7 +877,7 @@ static void _TestTransferingInvoke(bool listenerUsesExternalSelect, bool connect
         *((MI_Instance**)&inst), NULL, NULL, msg->base.base.batch, 
             &msg->packedInstanceParamsPtr, &msg->packedInstanceParamsSize));
 
-    _TransferMessageUsingProtocol( &msg->base.base, &result, listenerUsesExternalSelect, connectorUsesExternalSelect, socketPair );
+    _TransferMessageUsingProtocol( &msg->base.base, &result, listenerUsesExternalSelect, connectorUsesExternalSelect, socketPair, useRings );
 
     /* free source message */
     UT_ASSERT(msg->base.base.refCounter == 1);
@@ -785,4 +1054,310 @@ NitsTestWithSetup(TestFromSocket, TestProtocolSetup)
     _TestTransferingInvoke(true, true, s);
 }
 NitsEndTest
+
+NitsTestWithSetup(TestFromSocketWithRings, TestProtocolSetup)
+{
+    Sock s[2];
+
+    UT_ASSERT(0 == socketpair(AF_UNIX, SOCK_STREAM, 0, s));
+    UT_ASSERT( MI_RESULT_OK == Sock_SetBlocking(s[0], MI_FALSE));
+    UT_ASSERT( MI_RESULT_OK == Sock_SetBlocking(s[1], MI_FALSE));
+
+    _TestTransferingInvoke(true, true, s, true);
+}
+NitsEndTest
+
+/* agent side posts PIPELINE_MESSAGES responses, the server side does not
+   ack until told to */
+#define PIPELINE_MESSAGES (PROTOCOLSOCKET_RECEIVEWINDOW_MESSAGES + 16)
+
+static Strand s_pipelineAgent;
+static Strand s_pipelineServer;
+static MI_Uint64 s_pipelinePosted;
+static vector<Message*> s_pipelineReceived;
+
+BEGIN_EXTERNC
+
+static void _PipelineAgent_PostNext( _In_ Strand* self_ )
+{
+    NoOpRsp* rsp = NoOpRsp_New(s_pipelinePosted++);
+
+    Strand_Post( self_, &rsp->base );
+    NoOpRsp_Release(rsp);
+}
+
+static void _PipelineAgent_Post( _In_ Strand* self_, _In_ Message* msg)
+{
+    UT_ASSERT( NoOpReqTag == msg->tag );
+    Strand_Ack(self_);
+    _PipelineAgent_PostNext(self_);
+}
+
+static void _PipelineAgent_Ack( _In_ Strand* self_ )
+{
+    if (s_pipelinePosted < PIPELINE_MESSAGES)
+        Strand_ScheduleAux( self_, 0 );
+}
+
+static void _PipelineServer_Post( _In_ Strand* self_, _In_ Message* msg)
+{
+    // no Ack until the test schedules one
+    Message_AddRef( msg );
+    s_pipelineReceived.push_back( msg );
+}
+
+static void _Pipeline_Nothing( _In_ Strand* self_ )
+{
+}
+
+StrandFT _PipelineAgent_FT =
+{
+    _PipelineAgent_Post,
+    NULL,
+    _PipelineAgent_Ack,
+    NULL,
+    _Pipeline_Nothing,
+    _Pipeline_Nothing,
+    NULL,
+    _PipelineAgent_PostNext,
+    NULL,
+    NULL,
+    NULL,
+    NULL
+};
+
+StrandFT _PipelineServer_FT =
+{
+    _PipelineServer_Post,
+    NULL,
+    _Pipeline_Nothing,
+    NULL,
+    _Pipeline_Nothing,
+    _Pipeline_Nothing,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL
+};
+
+NITS_EXTERN_C void _PipelineAgentCallback(
+    _Inout_ InteractionOpenParams* interactionParams )
+{
+    Strand_Init( STRAND_DEBUG( TestServer ) &s_pipelineAgent, &_PipelineAgent_FT, 0, interactionParams );
+}
+
+END_EXTERNC
+
+NitsTestWithSetup(TestFromSocketReceiveWindow, TestProtocolSetup)
+{
+    Sock s[2];
+    ProtocolSocketAndBase* agent = NULL;
+    ProtocolSocketAndBase* server = NULL;
+    ProtocolSocket* window;
+    InteractionOpenParams params;
+    MI_Result r;
+
+    s_pipelinePosted = 0;
+    s_pipelineReceived.clear();
+
+    UT_ASSERT(0 == socketpair(AF_UNIX, SOCK_STREAM, 0, s));
+    UT_ASSERT( MI_RESULT_OK == Sock_SetBlocking(s[0], MI_FALSE));
+    UT_ASSERT( MI_RESULT_OK == Sock_SetBlocking(s[1], MI_FALSE));
+
+    r = ProtocolSocketAndBase_New_Agent(&agent, 0, s[0], _PipelineAgentCallback, NULL, NULL);
+    UT_ASSERT( MI_RESULT_OK == r );
+    if (MI_RESULT_OK != r)
+        NitsReturn;
+
+    Strand_Init( STRAND_DEBUG( TestClient ) &s_pipelineServer, &_PipelineServer_FT, STRAND_FLAG_ENTERSTRAND, NULL );
+    Strand_OpenPrepare(&s_pipelineServer, &params, NULL, NULL, MI_TRUE);
+
+    r = ProtocolSocketAndBase_New_AgentConnector(&server, 0, s[1], &params, NULL);
+    UT_ASSERT( MI_RESULT_OK == r );
+    if (MI_RESULT_OK != r)
+    {
+        ProtocolSocketAndBase_ReadyToFinish(agent);
+        NitsReturn;
+    }
+
+    window = &server->protocolSocket;
+    UT_ASSERT( PROTOCOLSOCKET_RECEIVEWINDOW_MESSAGES == window->windowMessages );
+
+    NoOpReq* rqt = NoOpReq_New(1);
+    Strand_SchedulePost( &s_pipelineServer, &rqt->base.base );
+    NoOpReq_Release(rqt);
+
+    /* the first response is posted up and the window fills behind it */
+    for (int attempt = 0; attempt < 100 && !window->windowFull; attempt++)
+    {
+        Protocol_Run( &agent->internalProtocolBase, SELECT_BASE_TIMEOUT_MSEC * 1000);
+        Protocol_Run( &server->internalProtocolBase, SELECT_BASE_TIMEOUT_MSEC * 1000);
+    }
+
+    UT_ASSERT( window->windowFull );
+    UT_ASSERT( 1 == s_pipelineReceived.size() );
+    UT_ASSERT( PROTOCOLSOCKET_RECEIVEWINDOW_MESSAGES == window->windowCount );
+
+    /* acks post the queued responses in order and reopen the window */
+    for (int attempt = 0; attempt < 1000 && s_pipelineReceived.size() < PIPELINE_MESSAGES; attempt++)
+    {
+        size_t received = s_pipelineReceived.size();
+
+        Strand_ScheduleAck( &s_pipelineServer );
+
+        while (s_pipelineReceived.size() == received && attempt++ < 1000)
+        {
+            Protocol_Run( &server->internalProtocolBase, SELECT_BASE_TIMEOUT_MSEC * 1000);
+            Protocol_Run( &agent->internalProtocolBase, SELECT_BASE_TIMEOUT_MSEC * 1000);
+        }
+    }
+
+    UT_ASSERT( PIPELINE_MESSAGES == s_pipelineReceived.size() );
+    UT_ASSERT( !window->windowFull );
+    UT_ASSERT( 0 == window->windowCount );
+    UT_ASSERT( 0 == window->windowSize );
+
+    for (size_t i = 0; i < s_pipelineReceived.size(); i++)
+    {
+        UT_ASSERT( NoOpRspTag == s_pipelineReceived[i]->tag );
+        UT_ASSERT( i == s_pipelineReceived[i]->operationId );
+        Message_Release( s_pipelineReceived[i] );
+    }
+
+    s_pipelineReceived.clear();
+    Strand_ScheduleAck( &s_pipelineServer );
+
+    ProtocolSocketAndBase_ReadyToFinish(server);
+    ProtocolSocketAndBase_ReadyToFinish(agent);
+}
+NitsEndTest
+
+NitsTest(TestRings)
+{
+    ProtocolRings* server = NULL;
+    ProtocolRings* agent = NULL;
+    int fd = -1;
+    char out[3000];
+    char in[3000];
+    char big[PROTOCOLRINGS_MIN_SIZE + 1];
+    IOVec vec[2];
+
+    if (!TEST_ASSERT(MI_RESULT_OK == ProtocolRings_Create(&server, 1, &fd)))
+        NitsReturn;
+
+    if (!TEST_ASSERT(MI_RESULT_OK == ProtocolRings_Attach(&agent, fd)))
+    {
+        close(fd);
+        ProtocolRings_Delete(server);
+        NitsReturn;
+    }
+
+    close(fd);
+
+    for (int round = 0; round < 3; round++)
+    {
+        /* second and third rounds wrap around the end of the ring */
+        for (size_t i = 0; i < sizeof(out); i++)
+            out[i] = (char)(i * 7 + round);
+
+        vec[0].ptr = out;
+        vec[0].len = 1000;
+        vec[1].ptr = out + 1000;
+        vec[1].len = sizeof(out) - 1000;
+        UT_ASSERT(MI_RESULT_OK == ProtocolRings_Write(server, vec, 2));
+
+        /* nothing written into a ring with too little space left */
+        vec[0].len = PROTOCOLRINGS_MIN_SIZE - sizeof(out) + 1;
+        UT_ASSERT(MI_RESULT_WOULD_BLOCK == ProtocolRings_Write(server, vec, 1));
+
+        /* nothing consumed from a ring with too few bytes */
+        memset(in, 0, sizeof(in));
+        vec[0].ptr = in;
+        vec[0].len = sizeof(in) + 1;
+        UT_ASSERT(!ProtocolRings_Read(agent, vec, 1));
+
+        vec[0].len = 10;
+        vec[1].ptr = in + 10;
+        vec[1].len = sizeof(in) - 10;
+        UT_ASSERT(ProtocolRings_Read(agent, vec, 2));
+        UT_ASSERT(memcmp(in, out, sizeof(out)) == 0);
+
+        /* the other direction is independent */
+        UT_ASSERT(!ProtocolRings_Read(server, vec, 1));
+    }
+
+    memset(big, 'x', sizeof(big));
+    vec[0].ptr = big;
+    vec[0].len = sizeof(big);
+    UT_ASSERT(MI_RESULT_WOULD_BLOCK == ProtocolRings_Write(agent, vec, 1));
+    vec[0].len = PROTOCOLRINGS_MIN_SIZE;
+    UT_ASSERT(MI_RESULT_OK == ProtocolRings_Write(agent, vec, 1));
+
+    /* never more than the ring holds, even if that much is there */
+    vec[0].len = sizeof(big);
+    UT_ASSERT(!ProtocolRings_Read(server, vec, 1));
+    vec[0].len = PROTOCOLRINGS_MIN_SIZE;
+    UT_ASSERT(ProtocolRings_Read(server, vec, 1));
+
+    ProtocolRings_Delete(agent);
+    ProtocolRings_Delete(server);
+}
+NitsEndTest
+
+NitsTest(TestRingsBrokenPeer)
+{
+    ProtocolRings* server = NULL;
+    int fd = -1;
+    char data[100];
+    IOVec vec[1];
+    size_t ringSize = PROTOCOLRINGS_MIN_SIZE;
+    size_t memSize = 2 * (3 * 64 + ringSize);
+    char* mem;
+    volatile ptrdiff_t* outHead;
+    volatile ptrdiff_t* outTail;
+    volatile ptrdiff_t* inHead;
+
+    if (!TEST_ASSERT(MI_RESULT_OK == ProtocolRings_Create(&server, 1, &fd)))
+        NitsReturn;
+
+    /* play the agent: each ring header has the magic/size, 'head' and
+       'tail' on their own 64-byte lines, followed by the data */
+    mem = (char*)mmap(NULL, memSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (!TEST_ASSERT(MAP_FAILED != mem))
+    {
+        ProtocolRings_Delete(server);
+        NitsReturn;
+    }
+
+    outHead = (volatile ptrdiff_t*)(mem + 64);
+    outTail = (volatile ptrdiff_t*)(mem + 128);
+    inHead = (volatile ptrdiff_t*)(mem + 3 * 64 + ringSize + 64);
+
+    memset(data, 'x', sizeof(data));
+    vec[0].ptr = data;
+    vec[0].len = sizeof(data);
+
+    /* more written than the ring can hold */
+    *inHead = (ptrdiff_t)(2 * ringSize);
+    UT_ASSERT(!ProtocolRings_Read(server, vec, 1));
+    *inHead = (ptrdiff_t)sizeof(data);
+    UT_ASSERT(ProtocolRings_Read(server, vec, 1));
+
+    /* consumer claims to have read more than was written */
+    UT_ASSERT(MI_RESULT_OK == ProtocolRings_Write(server, vec, 1));
+    *outTail = *outHead + 1;
+    UT_ASSERT(MI_RESULT_FAILED == ProtocolRings_Write(server, vec, 1));
+    *outTail = *outHead - (ptrdiff_t)ringSize - 1;
+    UT_ASSERT(MI_RESULT_FAILED == ProtocolRings_Write(server, vec, 1));
+    *outTail = *outHead;
+    UT_ASSERT(MI_RESULT_OK == ProtocolRings_Write(server, vec, 1));
+
+    munmap(mem, memSize);
+    ProtocolRings_Delete(server);
+}
+NitsEndTest
 #endif
@@ -293,6 +293,7 @@ struct ReceivedMessage
     MI_Char errorStr[TEST_CTX_ERROR_STRING_SIZE];
     MI_Instance* cimError;
     MI_Uint32 indicationCount;
+    MI_Uint32 instanceCount;
 };
 
 static ReceivedMessage latestMessage = { 0 };
@@ -333,6 +334,10 @@ NITS_EXTERN_C void ContextTest_Post_CheckedAck( _In_ Strand* self_, _In_ Message
     {
         latestMessage.indicationCount++;
     }
+    else if (PostInstanceBatchMsgTag == msg->tag)
+    {
+        latestMessage.instanceCount += ((PostInstanceBatchMsg*)msg)->count;
+    }
     Strand_Ack(self_);
 
     if (PostResultMsgTag == msg->tag)
@@ -1464,6 +1469,84 @@ NitsEndTest
 // TODO: PostIndication_SubscriptionContext scenarios
 
 
+/*****************************************************************************
+ *
+ * Instance batches (agent side)
+ *
+ *****************************************************************************/
+STRAND_DEBUGNAME( test_Context_InstanceBatch_Strand );
+
+NitsTest1(TestContext_InstanceBatchTimer, TestContext_SetupProvider, genericContextTemplate)
+{
+    TestContext_Struct* setupStruct = NitsContext()->_TestContext_SetupProvider->_TestContext_Struct;
+    MI_Context* context = &setupStruct->context.base;
+    InteractionOpenParams params;
+    EnumerateInstancesReq* req;
+    Selector selector;
+
+    NitsAssertOrReturn( MI_RESULT_OK == Selector_Init( &selector ), PAL_T("Unable to initialize selector") );
+    Selector_SetAllowEmptyFlag( &selector, MI_TRUE );
+
+    req = EnumerateInstancesReq_New(1, 0);
+    if (!NitsAssert( NULL != req, PAL_T("create EnumerateInstancesReq message failed") ))
+    {
+        Selector_Destroy( &selector );
+        NitsReturn;
+    }
+
+    Sem_Init( &setupStruct->semFinalMessagePosted, SEM_USER_ACCESS_DEFAULT, 0 );
+    g_sem = &setupStruct->semFinalMessagePosted;
+
+    Strand_Init( STRAND_DEBUG(test_Context_InstanceBatch_Strand) &setupStruct->leftSideStrand, &ContextTest_Left_CheckedInteractionFT, 0, NULL );
+    setupStruct->leftSideStrand.info.opened = MI_TRUE;
+    setupStruct->leftSideStrand.info.thisAckPending = MI_TRUE;
+
+    setupStruct->provMgr.selector = &selector;
+    setupStruct->provMgr.instanceBatchSize = 16;
+    setupStruct->library.provmgr = &setupStruct->provMgr;
+    setupStruct->provider.lib = &setupStruct->library;
+
+    InteractionOpenParams_Init(&params);
+    params.interaction = &setupStruct->leftSideStrand.info.interaction;
+    params.msg = &req->base.base;
+
+    NitsAssertOrReturn( MI_RESULT_OK == Context_Init( &setupStruct->context, &setupStruct->provMgr, &setupStruct->provider, &params ), PAL_T("Context init failed") );
+    NitsAssertOrReturn( MI_RESULT_OK == _InitializeCimInstCreation( &setupStruct->instCreation ), PAL_T("Unable to create instance") );
+
+    // A lone instance goes out once the batch timer fires
+    NitsAssert( MI_RESULT_OK == MI_Context_PostInstance( context, &setupStruct->instCreation.__instance ), PAL_T("PostInstance failed") );
+    NitsAssert( 0 == latestMessage.instanceCount, PAL_T("Instance posted before the batch delay") );
+
+    for (int attempt = 0; attempt < 100 && 0 == latestMessage.instanceCount; attempt++)
+    {
+        Selector_Run( &selector, 10 * 1000, MI_FALSE );
+    }
+
+    NitsAssert( 1 == latestMessage.instanceCount, PAL_T("Expected the batch timer to post the instance") );
+
+    // The context outlives the timer armed for a batch that went out with the result
+    NitsAssert( MI_RESULT_OK == MI_Context_PostInstance( context, &setupStruct->instCreation.__instance ), PAL_T("PostInstance failed") );
+    NitsAssert( MI_RESULT_OK == MI_Context_PostResult( context, MI_RESULT_OK ), PAL_T("PostResult failed") );
+
+    NitsAssert( 2 == latestMessage.instanceCount, PAL_T("Expected the instance to go out before the result") );
+    NitsAssert( MI_RESULT_OK == latestMessage.result, PAL_T("Unexpected result") );
+
+    for (int attempt = 0; attempt < 100 && 0xFFFFFFFF != setupStruct->context.magic; attempt++)
+    {
+        Selector_Run( &selector, 10 * 1000, MI_FALSE );
+    }
+
+    NitsAssert( 0xFFFFFFFF == setupStruct->context.magic, PAL_T("Expected the batch timer to destroy the context") );
+
+    _ClearReceivedMessage();
+    MI_Instance_Destruct( &setupStruct->instCreation.__instance );
+    EnumerateInstancesReq_Release( req );
+    Selector_Destroy( &selector );
+    Sem_Destroy( &setupStruct->semFinalMessagePosted );
+    g_sem = NULL;
+}
+NitsEndTest
+
 /*
 **==============================================================================
 **
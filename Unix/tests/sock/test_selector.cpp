@@ -15,6 +15,7 @@
 #include <pal/sleep.h>
 #include <pal/thread.h>
 #include <base/result.h>
+#include <base/messages.h>
 #include <sock/sock.h>
 #include <sock/selector.h>
 
@@ -774,6 +775,292 @@ TestEnd:
 }
 NitsEndTest
 
+BEGIN_EXTERNC
+static MI_Boolean _LateTimeoutCallback(
+    Selector* sel,
+    Handler* handler,
+    MI_Uint32 mask, 
+    MI_Uint64 currentTimeUsec)
+{
+    MI_UNUSED(sel);
+    MI_UNUSED(currentTimeUsec);
+
+    if (mask & SELECTOR_TIMEOUT)
+    {
+        s_timeout_called = true;
+        return MI_FALSE;
+    }
+
+    if (mask & (SELECTOR_REMOVE | SELECTOR_DESTROY))
+        PAL_Free(handler);
+
+    return MI_TRUE;
+}
+
+/* sets timeout on the handler from outside of its callback */
+static void _SetTimeoutTimerCallback(
+    Selector* sel,
+    SelectorTimer* timer,
+    MI_Uint32 mask,
+    MI_Uint64 currentTimeUsec)
+{
+    Handler* handler = (Handler*)timer->data;
+
+    if (mask & SELECTOR_TIMEOUT)
+    {
+        handler->fireTimeoutAt = currentTimeUsec + 1000;
+        Selector_UpdateHandler(sel, handler, MI_FALSE);
+    }
+}
+END_EXTERNC
+
+NitsTestWithSetup(TestSelectorUpdateHandler, TestSelectorSetup)
+{
+    Selector sel;
+    SelectorTimer timer;
+    Handler* h;
+    MI_Result r;
+    MI_Result selectorInitResult;
+    MI_Uint64 currentTimeUsec = 0;
+
+    // Initialize the network:
+    Sock_Start();
+
+    // Initialize the selector object.
+    selectorInitResult = Selector_Init(&sel);
+    if(!TEST_ASSERT(MI_RESULT_OK == selectorInitResult))
+        goto TestEnd;
+
+    // handler without timeout
+    h = (Handler*)PAL_Calloc(1, sizeof(Handler));
+
+    if(!TEST_ASSERT(h))
+        goto TestEnd;
+
+    h->sock = INVALID_SOCK;
+    h->callback = _LateTimeoutCallback;
+
+    r = Selector_AddHandler(&sel, h);
+    TEST_ASSERT(r == MI_RESULT_OK);
+
+    // timer gives the handler a timeout once selector is running
+    memset(&timer, 0, sizeof(timer));
+    timer.callback = _SetTimeoutTimerCallback;
+    timer.data = h;
+    PAL_Time(&currentTimeUsec);
+    r = Selector_StartTimer(&sel, &timer, currentTimeUsec + 1000);
+    TEST_ASSERT(r == MI_RESULT_OK);
+
+    s_timeout_called = false;
+    r = Selector_Run(&sel, 1000*1000, MI_FALSE);
+    TEST_ASSERT(s_timeout_called);
+    // handler is removed on timeout, so selector runs out of handlers
+    TEST_ASSERT(r == MI_RESULT_FAILED);
+TestEnd:
+    // Destroy the selector.
+    if(MI_RESULT_OK == selectorInitResult)
+        Selector_Destroy(&sel);
+
+    // Shutdown the network.
+    Sock_Stop();
+}
+NitsEndTest
+
+static vector<size_t> s_timers_fired;
+static MI_Uint32 s_timers_mask;
+
+static void _OrderTimerCallback(
+    Selector* sel,
+    SelectorTimer* timer,
+    MI_Uint32 mask,
+    MI_Uint64 currentTimeUsec)
+{
+    MI_UNUSED(sel);
+    MI_UNUSED(currentTimeUsec);
+
+    s_timers_fired.push_back((size_t)timer->data);
+    s_timers_mask |= mask;
+}
+
+NitsTestWithSetup(TestSelectorTimerOrder, TestSelectorSetup)
+{
+    /* deadlines (in ms from now) given out of order */
+    static const size_t delays[] = { 7, 3, 9, 1, 8, 2, 6, 4, 5 };
+    const size_t count = MI_COUNT(delays);
+    SelectorTimer timers[MI_COUNT(delays)];
+    SelectorTimer late;
+    Selector sel;
+    MI_Result selectorInitResult;
+    MI_Uint64 now = 0;
+    size_t i;
+
+    s_timers_fired.clear();
+    s_timers_mask = 0;
+    memset(timers, 0, sizeof(timers));
+    memset(&late, 0, sizeof(late));
+
+    Sock_Start();
+
+    selectorInitResult = Selector_Init(&sel);
+    if(!TEST_ASSERT(MI_RESULT_OK == selectorInitResult))
+        goto TestEnd;
+
+    TEST_ASSERT(PAL_TRUE == PAL_Time(&now));
+
+    for (i = 0; i < count; i++)
+    {
+        timers[i].callback = _OrderTimerCallback;
+        timers[i].data = (void*)delays[i];
+        TEST_ASSERT(MI_RESULT_OK == Selector_StartTimer(&sel, &timers[i], now + delays[i] * 1000));
+    }
+
+    /* starting a scheduled timer twice is rejected */
+    TEST_ASSERT(MI_RESULT_ALREADY_EXISTS == Selector_StartTimer(&sel, &timers[0], now));
+
+    /* moving a timer ahead of the others makes it fire first */
+    TEST_ASSERT(MI_RESULT_OK == Selector_UpdateTimer(&sel, &timers[2], now));
+
+    /* far-away timer is still pending when selector is destroyed */
+    late.callback = _OrderTimerCallback;
+    late.data = (void*)1000;
+    TEST_ASSERT(MI_RESULT_OK == Selector_StartTimer(&sel, &late, now + 1000*1000*1000));
+
+    while (s_timers_fired.size() < count)
+    {
+        if (MI_RESULT_OK != Selector_Run(&sel, 1000*1000, MI_TRUE))
+            break;
+    }
+
+    if (TEST_ASSERT(s_timers_fired.size() == count))
+    {
+        TEST_ASSERT(s_timers_fired[0] == 9);
+
+        for (i = 1; i < count; i++)
+            TEST_ASSERT(s_timers_fired[i] == i);
+    }
+    TEST_ASSERT(s_timers_mask == SELECTOR_TIMEOUT);
+
+    /* fired timers are no longer scheduled */
+    TEST_ASSERT(MI_RESULT_NOT_FOUND == Selector_UpdateTimer(&sel, &timers[0], now));
+
+    Selector_Destroy(&sel);
+    selectorInitResult = MI_RESULT_FAILED;
+
+    TEST_ASSERT(s_timers_fired.size() == count + 1);
+    TEST_ASSERT(s_timers_mask == (SELECTOR_TIMEOUT | SELECTOR_DESTROY));
+
+TestEnd:
+    if(MI_RESULT_OK == selectorInitResult)
+        Selector_Destroy(&sel);
+
+    Sock_Stop();
+}
+NitsEndTest
+
+#define POSTING_THREADS 4
+#define POSTS_PER_THREAD 2000
+
+struct PostedCallbacks
+{
+    Selector* sel;
+    MI_Uint64 next[POSTING_THREADS];
+    size_t received;
+    bool ordered;
+};
+
+static PostedCallbacks s_posted;
+
+BEGIN_EXTERNC
+static void _PostedCallback(void* self, Message* msg)
+{
+    PostedCallbacks* posted = (PostedCallbacks*)self;
+    size_t thread = (size_t)(msg->operationId >> 32);
+    MI_Uint64 seq = msg->operationId & 0xFFFFFFFF;
+
+    /* each thread's callbacks run in the order they were posted */
+    if (thread >= POSTING_THREADS || posted->next[thread] != seq)
+        posted->ordered = false;
+    else
+        posted->next[thread]++;
+
+    if (++posted->received == POSTING_THREADS * POSTS_PER_THREAD)
+        Selector_StopRunning(posted->sel);
+}
+
+static void* MI_CALL _PostingThread(void* param)
+{
+    MI_Uint64 thread = (MI_Uint64)(size_t)param;
+
+    for (MI_Uint64 i = 0; i < POSTS_PER_THREAD; i++)
+    {
+        NoOpReq* msg = NoOpReq_New((thread << 32) | i);
+
+        if (!TEST_ASSERT(msg))
+            break;
+
+        TEST_ASSERT(MI_RESULT_OK == Selector_CallInIOThread(
+            s_posted.sel, _PostedCallback, &s_posted, &msg->base.base));
+        NoOpReq_Release(msg);
+    }
+    return 0;
+}
+END_EXTERNC
+
+NitsTestWithSetup(TestSelectorCallInIOThread, TestSelectorSetup)
+{
+    NitsDisableFaultSim;
+
+    Selector sel;
+    MI_Result r;
+    MI_Result selectorInitResult;
+    Thread threads[POSTING_THREADS];
+    size_t started = 0;
+    PAL_Uint32 ret;
+
+    Sock_Start();
+
+    selectorInitResult = Selector_Init(&sel);
+    if(!TEST_ASSERT(MI_RESULT_OK == selectorInitResult))
+        goto TestEnd;
+
+    memset(&s_posted, 0, sizeof(s_posted));
+    s_posted.sel = &sel;
+    s_posted.ordered = true;
+
+    /* no handlers: selector only waits for posted callbacks */
+    Selector_SetAllowEmptyFlag(&sel, MI_TRUE);
+
+    for (; started < POSTING_THREADS; started++)
+    {
+        if (!TEST_ASSERT(0 == Thread_CreateJoinable(
+            &threads[started], (ThreadProc) _PostingThread, NULL, (void*)started)))
+            break;
+    }
+
+    if (started == POSTING_THREADS)
+    {
+        r = Selector_Run(&sel, 60 * 1000*1000, MI_FALSE);
+        TEST_ASSERT(r == MI_RESULT_OK);
+    }
+
+    while (started)
+    {
+        started--;
+        TEST_ASSERT(Thread_Join(&threads[started], &ret) == 0);
+        Thread_Destroy(&threads[started]);
+    }
+
+    TEST_ASSERT(s_posted.received == POSTING_THREADS * POSTS_PER_THREAD);
+    TEST_ASSERT(s_posted.ordered);
+
+TestEnd:
+    if(MI_RESULT_OK == selectorInitResult)
+        Selector_Destroy(&sel);
+
+    Sock_Stop();
+}
+NitsEndTest
+
 NitsTestWithSetup(TestSelectorStopRunning, TestSelectorSetup)
 {
     Selector sel;
@@ -71,6 +71,58 @@ NitsTestWithSetup(TestXMLStringEncoding, TestWsbufSetup)
 }
 NitsEndTest
 
+NitsTestWithSetup(TestXMLStringEncodingRuns, TestWsbufSetup)
+{
+    /* special characters after runs of every length up to two 32-byte
+       blocks, so that they are found in every position of a block */
+    static const ZChar specials[] = MI_T("<>&\"'\t\x7F\x01");
+    static const char* encoded[] = {
+        "&lt;", "&gt;", "&amp;", "&quot;", "&apos;", "&#9;", "&#127;", "&#1;" };
+    String str;
+    String result;
+    size_t n = 0;
+
+    for (size_t run = 0; run <= 64; run++)
+    {
+        for (size_t i = 0; i < run; i++)
+        {
+            str += (ZChar)('a' + i % 26);
+            result += (ZChar)('a' + i % 26);
+        }
+
+        str += specials[n];
+        for (const char* e = encoded[n]; *e; e++)
+            result += (ZChar)*e;
+
+        n = (n + 1) % (MI_COUNT(specials) - 1);
+    }
+
+#if (MI_CHAR_TYPE == 1)
+    /* multi-byte characters are not encoded */
+    str += "x\xC3\xA9\xE2\x82\xAC" "0123456789abcdefghijklmnopqrstuvwxyz";
+    result += "x\xC3\xA9\xE2\x82\xAC" "0123456789abcdefghijklmnopqrstuvwxyz";
+#endif
+
+    if(!TEST_ASSERT (MI_RESULT_OK == WSBuf_Init(&s_buf, 10)))
+        NitsReturn;
+
+    TEST_ASSERT (MI_RESULT_OK == WSBuf_AddString(&s_buf, str.c_str()) );
+    TEST_ASSERT (MI_RESULT_OK == WSBuf_AddString(&s_buf, MI_T("")) );
+
+    Page* p = WSBuf_StealPage(&s_buf);
+    TEST_ASSERT(0 != p);
+
+    if (p)
+    {
+        String buf_result( (const ZChar*) (p + 1) );
+        TEST_ASSERT(result == buf_result);
+        PAL_Free(p);
+    }
+
+    TEST_ASSERT (MI_RESULT_OK == WSBuf_Destroy(&s_buf));
+}
+NitsEndTest
+
 NitsTestWithSetup(TestToFromXML, TestWsbufSetup)
 {
     String result;
@@ -126,6 +178,62 @@ cleanup:
 }
 NitsEndTest
 
+NitsTestWithSetup(TestSoapResponseHeader, TestWsbufSetup)
+{
+    Page* p = NULL;
+    String header;
+    String prevID;
+
+    for (int i = 0; i < 2; i++)
+    {
+        /* small initial size so that the header has to grow the buffer */
+        if(!TEST_ASSERT (MI_RESULT_OK == WSBuf_Init(&s_buf, 10)))
+            NitsReturn;
+
+        if(!TEST_ASSERT (MI_RESULT_OK == WSBuf_CreateSoapResponseHeader(&s_buf,
+            LIT(ZT("http://schemas.xmlsoap.org/ws/2004/09/transfer/GetResponse")),
+            i ? ZT("uuid:FEF3DF41-FFEC-4ABE-ADFC-A8305DAB71C9") : NULL)))
+        {
+            WSBuf_Destroy(&s_buf);
+            NitsReturn;
+        }
+
+        p = WSBuf_StealPage(&s_buf);
+        if(!TEST_ASSERT(0 != p))
+            NitsReturn;
+
+        header = (const ZChar*) (p + 1);
+        TEST_ASSERT(header.size() * sizeof(ZChar) == p->u.s.size);
+        PAL_Free(p);
+
+        TEST_ASSERT(header.find(ZT("<SOAP-ENV:Envelope ")) == 0);
+        TEST_ASSERT(header.find(ZT("<wsa:Action>http://schemas.xmlsoap.org/ws/2004/09/transfer/GetResponse</wsa:Action>")) != String::npos);
+
+        String::size_type id = header.find(ZT("<wsa:MessageID>"));
+        if(!TEST_ASSERT(id != String::npos))
+            NitsReturn;
+
+        /* uuid:xxxxxxxx-xxxx-xxxx-xxxx-xxxxxxxxxxxx */
+        String msgID = header.substr(id + 15, WS_MSG_ID_SIZE - 1);
+        TEST_ASSERT(msgID.find(ZT("uuid:")) == 0);
+        TEST_ASSERT(msgID[13] == '-' && msgID[18] == '-' && msgID[23] == '-' && msgID[28] == '-');
+        TEST_ASSERT(msgID.find_first_not_of(ZT("0123456789ABCDEF-"), 5) == String::npos);
+        TEST_ASSERT(header.find(ZT("</wsa:MessageID>"), id) == id + 15 + WS_MSG_ID_SIZE - 1);
+        TEST_ASSERT(msgID != prevID);
+        prevID = msgID;
+
+        if (i)
+        {
+            TEST_ASSERT(header.find(ZT("</wsa:MessageID><wsa:RelatesTo>uuid:FEF3DF41-FFEC-4ABE-ADFC-A8305DAB71C9</wsa:RelatesTo>")) != String::npos);
+        }
+        else
+        {
+            TEST_ASSERT(header.find(ZT("RelatesTo")) == String::npos);
+        }
+    }
+}
+NitsEndTest
+
 NitsTestWithSetup(TestGetRequest, TestWsbufSetup)
 {
     MI_Char expected[1024];
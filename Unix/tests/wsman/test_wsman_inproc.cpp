@@ -143,7 +143,9 @@ MI_Result StartWSManInproc(
 
 BEGIN_EXTERNC
 static string _CreateEnumRequestXML(
-    const char* cn )
+    const char* cn,
+    bool optimize = false,
+    const char* timeout = "PT60.000S" )
 {
     string res =
 "<s:Envelope xmlns:s=\"http://www.w3.org/2003/05/soap-envelope\""
@@ -168,10 +170,19 @@ static string _CreateEnumRequestXML(
 "ns"
 "</w:Selector>"
 "</w:SelectorSet>"
-"<w:OperationTimeout>PT60.000S</w:OperationTimeout>"
+"<w:OperationTimeout>";
+
+    res += timeout;
+    res +=
+"</w:OperationTimeout>"
 "</s:Header>"
 "<s:Body>"
-"<n:Enumerate>"
+"<n:Enumerate>";
+
+    if (optimize)
+        res += "<w:OptimizeEnumeration/>";
+
+    res +=
 "<w:MaxElements>10</w:MaxElements>"
 "</n:Enumerate></s:Body></s:Envelope>"
 ;
@@ -282,6 +293,113 @@ static void _callback(
 
     PostResultMsg_Release(resp);
 }
+
+static StrandFT strandUserFT2 = {
+        NULL,
+        NULL,
+        _StrandTestAck,
+        NULL,
+        NULL,
+        NULL,   // deletes the strand once finished
+        NULL,
+        NULL,
+        NULL,
+        NULL,
+        NULL };
+
+// same as _callback, but on a strand of its own for every request,
+// so that several enumerations can be open at the same time
+static void _callbackNewStrand(
+    _Inout_     InteractionOpenParams*    interactionParams )
+{
+    MI_Result r = (MI_Result) (long)interactionParams->callbackData;
+    PostResultMsg* resp = NULL;
+    Strand* strand;
+
+    UT_ASSERT (interactionParams->msg != 0);
+    if(interactionParams->msg == 0)
+    {
+        Strand_FailOpen(interactionParams);
+        return;
+    }
+
+    resp = PostResultMsg_New( interactionParams->msg->operationId );
+    strand = Strand_New( STRAND_DEBUG( TestWsman ) &strandUserFT2, 0, STRAND_FLAG_ENTERSTRAND, interactionParams );
+
+    UT_ASSERT (resp != 0);
+    UT_ASSERT (strand != 0);
+    if (!resp || !strand)
+    {
+        if (resp)
+            PostResultMsg_Release(resp);
+        if (strand)
+            Strand_Delete(strand);
+        Strand_FailOpen(interactionParams);
+        return;
+    }
+
+    resp->result = r;
+
+    Strand_Ack( strand );   // Ack open
+    Strand_Post( strand, &resp->base );
+    Strand_Close( strand );
+    Strand_Leave( strand );
+
+    PostResultMsg_Release(resp);
+}
+
+// finishes a request held by _callbackNoResult once it is cancelled
+static void _StrandTestCancel( _In_ Strand* self)
+{
+    PostResultMsg* resp = PostResultMsg_New( 0 );
+
+    if (resp)
+    {
+        resp->result = MI_RESULT_CANCELED;
+        Strand_Post( self, &resp->base );
+        PostResultMsg_Release(resp);
+    }
+    Strand_Close( self );
+}
+
+static StrandFT strandUserFT3 = {
+        NULL,
+        NULL,
+        _StrandTestAck,
+        _StrandTestCancel,
+        NULL,
+        NULL,   // deletes the strand once finished
+        NULL,
+        NULL,
+        NULL,
+        NULL,
+        NULL };
+
+// accepts the request, but posts nothing until it is cancelled
+static void _callbackNoResult(
+    _Inout_     InteractionOpenParams*    interactionParams )
+{
+    Strand* strand;
+
+    UT_ASSERT (interactionParams->msg != 0);
+    if(interactionParams->msg == 0)
+    {
+        Strand_FailOpen(interactionParams);
+        return;
+    }
+
+    strand = Strand_New( STRAND_DEBUG( TestWsman ) &strandUserFT3, 0, STRAND_FLAG_ENTERSTRAND, interactionParams );
+
+    UT_ASSERT (strand != 0);
+    if (!strand)
+    {
+        Strand_FailOpen(interactionParams);
+        return;
+    }
+
+    Strand_Ack( strand );   // Ack open
+    Strand_Leave( strand );
+}
 END_EXTERNC
 
 // These tests startup wsman for 1 second and
@@ -369,3 +487,566 @@ NitsTestWithSetup(TestWSMAN_PullWithInvalidCtxID, Wsman_Inproc_Setup)
 }
 NitsEndTest
 
+
+NitsTestWithSetup(TestWSMAN_EnumManyContexts, Wsman_Inproc_Setup)
+{
+    NitsDisableFaultSim;
+
+    StartWSManInproc( _callbackNewStrand, (void*)MI_RESULT_OK);
+
+    // keep more enumerations open than the table of contexts starts with
+    Sock s = SockConnectLocal(PORT);
+    string r_b, r_h;
+    vector<string> ctxIDs;
+    set<string> uniqueIDs;
+
+    for (int i = 0; i < 100; i++)
+    {
+        SockSendRecvHTTP(s, false, _CreateEnumRequestXML("InvalidClassname"), r_h, r_b );
+
+        string ctxID = GetCtxID(r_b);
+
+        UT_ASSERT(!ctxID.empty());
+        if (ctxID.empty())
+            break;
+
+        ctxIDs.push_back(ctxID);
+        uniqueIDs.insert(ctxID);
+    }
+
+    UT_ASSERT_EQUAL(uniqueIDs.size(), ctxIDs.size());
+
+    // every context is still there
+    for (size_t i = 0; i < ctxIDs.size(); i++)
+    {
+        SockSendRecvHTTP(s, false, CreatePullRequestXML(ctxIDs[i]), r_h, r_b );
+
+        UT_ASSERT(r_b.find("wsen:EndOfSequence") != string::npos);
+    }
+
+    Sock_Close(s);
+}
+NitsEndTest
+
+NitsTestWithSetup(TestWSMAN_EnumContextsLimit, Wsman_Inproc_Setup)
+{
+    NitsDisableFaultSim;
+
+    WSMAN_Options options = DEFAULT_WSMAN_OPTIONS;
+    options.maxEnumContexts = 2;
+
+    StartWSManInproc( _callbackNewStrand, (void*)MI_RESULT_OK, &options);
+
+    Sock s = SockConnectLocal(PORT);
+    string r_b, r_h;
+
+    SockSendRecvHTTP(s, false, _CreateEnumRequestXML("InvalidClassname"), r_h, r_b );
+    string ctxID = GetCtxID(r_b);
+    UT_ASSERT(!ctxID.empty());
+
+    SockSendRecvHTTP(s, false, _CreateEnumRequestXML("InvalidClassname"), r_h, r_b );
+    UT_ASSERT(!GetCtxID(r_b).empty());
+
+    // all contexts are used
+    SockSendRecvHTTP(s, false, _CreateEnumRequestXML("InvalidClassname"), r_h, r_b );
+    UT_ASSERT(GetCtxID(r_b).empty());
+    UT_ASSERT(r_h.find("500") != string::npos);
+
+    // released context can be reused
+    SockSendRecvHTTP(s, false, _CreateReleaseRequestXML(ctxID), r_h, r_b );
+    UT_ASSERT(r_b.find("ReleaseResponse") != string::npos);
+
+    SockSendRecvHTTP(s, false, _CreateEnumRequestXML("InvalidClassname"), r_h, r_b );
+    UT_ASSERT(!GetCtxID(r_b).empty());
+
+    Sock_Close(s);
+}
+NitsEndTest
+
+NitsTestWithSetup(TestWSMAN_EnumContextExpired, Wsman_Inproc_Setup)
+{
+    NitsDisableFaultSim;
+
+    WSMAN_Options options = DEFAULT_WSMAN_OPTIONS;
+    options.timeoutEnumContextUsec = 1000;
+
+    StartWSManInproc( _callbackNewStrand, (void*)MI_RESULT_OK, &options);
+
+    Sock s = SockConnectLocal(PORT);
+    string r_b, r_h;
+
+    SockSendRecvHTTP(s, false, _CreateEnumRequestXML("InvalidClassname"), r_h, r_b );
+    string ctxID = GetCtxID(r_b);
+    UT_ASSERT(!ctxID.empty());
+
+    ut::sleep_ms(10);
+
+    // contexts not used for the timeout are closed when a new one is made
+    SockSendRecvHTTP(s, false, _CreateEnumRequestXML("InvalidClassname"), r_h, r_b );
+    string ctxID2 = GetCtxID(r_b);
+    UT_ASSERT(!ctxID2.empty());
+
+    SockSendRecvHTTP(s, false, CreatePullRequestXML(ctxID), r_h, r_b );
+    UT_ASSERT(r_b.find("Enumeration context not found") != string::npos);
+
+    SockSendRecvHTTP(s, false, CreatePullRequestXML(ctxID2), r_h, r_b );
+    UT_ASSERT(r_b.find("wsen:EndOfSequence") != string::npos);
+
+    Sock_Close(s);
+}
+NitsEndTest
+
+NitsTestWithSetup(TestWSMAN_EnumOptimized, Wsman_Inproc_Setup)
+{
+    NitsDisableFaultSim;
+
+    StartWSManInproc( _callbackNewStrand, (void*)MI_RESULT_OK);
+
+    Sock s = SockConnectLocal(PORT);
+    string r_b, r_h;
+
+    // results come with the enumerate response, no pull is needed
+    SockSendRecvHTTP(s, false, _CreateEnumRequestXML("InvalidClassname", true), r_h, r_b );
+    UT_ASSERT(r_b.find("wsen:EnumerateResponse") != string::npos);
+    UT_ASSERT(r_b.find("wsman:EndOfSequence") != string::npos);
+
+    Sock_Close(s);
+}
+NitsEndTest
+
+NitsTestWithSetup(TestWSMAN_EnumOptimizedTimeout, Wsman_Inproc_Setup)
+{
+    NitsDisableFaultSim;
+
+    StartWSManInproc( _callbackNoResult, NULL);
+
+    Sock s = SockConnectLocal(PORT);
+    string r_b, r_h;
+
+    // nothing arrives within the operation timeout: an empty first batch
+    // is returned with a context to pull the rest from
+    SockSendRecvHTTP(s, false, _CreateEnumRequestXML("InvalidClassname", true, "PT0.200S"), r_h, r_b );
+    UT_ASSERT(r_b.find("wsen:EnumerateResponse") != string::npos);
+    UT_ASSERT(r_b.find("wsman:EndOfSequence") == string::npos);
+    UT_ASSERT(r_b.find("Fault") == string::npos);
+
+    string ctxID = GetCtxID(r_b);
+    UT_ASSERT(!ctxID.empty());
+
+    SockSendRecvHTTP(s, false, _CreateReleaseRequestXML(ctxID), r_h, r_b );
+    UT_ASSERT(r_b.find("ReleaseResponse") != string::npos);
+
+    Sock_Close(s);
+}
+NitsEndTest
+
+#ifndef DISABLE_INDICATION
+
+static MI_Uint16 SINK_PORT = PORT + 1;
+
+BEGIN_EXTERNC
+static string _CreateSubscribeRequestXML(
+    const char* mode,
+    const string& notifyTo,
+    int maxElements)
+{
+    char maxElementsStr[16];
+    string res =
+"<s:Envelope xmlns:s=\"http://www.w3.org/2003/05/soap-envelope\""
+"   xmlns:a=\"http://schemas.xmlsoap.org/ws/2004/08/addressing\""
+"   xmlns:e=\"http://schemas.xmlsoap.org/ws/2004/08/eventing\""
+"   xmlns:w=\"http://schemas.dmtf.org/wbem/wsman/1/wsman.xsd\">"
+"<s:Header>"
+"<a:To>http://linux-22kv:22000/wsman</a:To>"
+"<w:ResourceURI s:mustUnderstand=\"true\">http://schemas.dmtf.org/wbem/wscim/1/cim-schema/2/X_Event</w:ResourceURI>"
+"<a:ReplyTo>"
+"<a:Address s:mustUnderstand=\"true\">http://schemas.xmlsoap.org/ws/2004/08/addressing/role/anonymous</a:Address>"
+"</a:ReplyTo>"
+"<a:Action s:mustUnderstand=\"true\">http://schemas.xmlsoap.org/ws/2004/08/eventing/Subscribe</a:Action>"
+"<w:MaxEnvelopeSize s:mustUnderstand=\"true\">102400</w:MaxEnvelopeSize>"
+"<a:MessageID>uuid:FEF3DF41-FFEC-4ABE-ADFC-A8305DAB71C9</a:MessageID>"
+"<w:Locale xml:lang=\"en-US\" s:mustUnderstand=\"false\" /><w:SelectorSet>"
+"<w:Selector Name=\"__cimnamespace\">"
+"ns"
+"</w:Selector>"
+"</w:SelectorSet>"
+"<w:OperationTimeout>PT60.000S</w:OperationTimeout>"
+"</s:Header>"
+"<s:Body>"
+"<e:Subscribe>"
+"<e:Delivery Mode=\"";
+
+    res += mode;
+    res += "\"><e:NotifyTo><a:Address>";
+    res += notifyTo;
+    res += "</a:Address></e:NotifyTo>";
+
+    Snprintf(maxElementsStr, MI_COUNT(maxElementsStr), "%d", maxElements);
+    res += "<w:MaxElements>";
+    res += maxElementsStr;
+    res +=
+"</w:MaxElements>"
+"</e:Delivery>"
+"<w:Filter Dialect=\"http://schemas.microsoft.com/wbem/wsman/1/WQL\">Select * from X_Event</w:Filter>"
+"</e:Subscribe></s:Body></s:Envelope>";
+
+    return res;
+}
+
+static string _CreateUnsubscribeRequestXML(const string& identifier)
+{
+    string res =
+"<s:Envelope xmlns:s=\"http://www.w3.org/2003/05/soap-envelope\""
+"   xmlns:a=\"http://schemas.xmlsoap.org/ws/2004/08/addressing\""
+"   xmlns:e=\"http://schemas.xmlsoap.org/ws/2004/08/eventing\""
+"   xmlns:w=\"http://schemas.dmtf.org/wbem/wsman/1/wsman.xsd\">"
+"<s:Header>"
+"<a:To>http://linux-22kv:22000/wsman</a:To>"
+"<w:ResourceURI s:mustUnderstand=\"true\">http://schemas.dmtf.org/wbem/wscim/1/cim-schema/2/X_Event</w:ResourceURI>"
+"<a:ReplyTo>"
+"<a:Address s:mustUnderstand=\"true\">http://schemas.xmlsoap.org/ws/2004/08/addressing/role/anonymous</a:Address>"
+"</a:ReplyTo>"
+"<a:Action s:mustUnderstand=\"true\">http://schemas.xmlsoap.org/ws/2004/08/eventing/Unsubscribe</a:Action>"
+"<w:MaxEnvelopeSize s:mustUnderstand=\"true\">102400</w:MaxEnvelopeSize>"
+"<a:MessageID>uuid:FEF3DF41-FFEC-4ABE-ADFC-A8305DAB71C9</a:MessageID>"
+"<e:Identifier>";
+
+    res += identifier;
+    res +=
+"</e:Identifier>"
+"</s:Header>"
+"<s:Body><e:Unsubscribe/></s:Body></s:Envelope>";
+
+    return res;
+}
+
+// provider of the subscription: posts the next event every time the
+// previous one is acknowledged, up to s_pushEvents events
+static int s_pushEvents;
+static int s_pushPosted;
+static MI_Uint64 s_pushOperationId;
+static const char s_pushEvent[] =
+    "<p:X_Event xmlns:p=\"http://schemas.dmtf.org/wbem/wscim/1/cim-schema/2/X_Event\">"
+    "<p:Number>7</p:Number></p:X_Event>";
+
+static void _StrandPushAck( _In_ Strand* self)
+{
+    // the ack of a post may come back while still in here
+    Strand_ScheduleAux( self, 0 );
+}
+
+static void _StrandPushNext( _In_ Strand* self)
+{
+    PostIndicationMsg* msg;
+
+    if (s_pushPosted >= s_pushEvents)
+        return;
+
+    msg = PostIndicationMsg_New( s_pushOperationId );
+
+    UT_ASSERT (msg != 0);
+    if (!msg)
+        return;
+
+    msg->base.packedInstancePtr = (void*)s_pushEvent;
+    msg->base.packedInstanceSize = sizeof(s_pushEvent) - 1;
+    s_pushPosted++;
+
+    Strand_Post( self, &msg->base.base );
+    PostIndicationMsg_Release(msg);
+}
+
+static StrandFT strandUserFT4 = {
+        NULL,
+        NULL,
+        _StrandPushAck,
+        _StrandTestCancel,
+        NULL,
+        NULL,   // deletes the strand once finished
+        NULL,
+        _StrandPushNext,
+        NULL,
+        NULL,
+        NULL };
+
+static void _callbackPush(
+    _Inout_     InteractionOpenParams*    interactionParams )
+{
+    SubscribeRes* resp;
+    Strand* strand;
+
+    UT_ASSERT (interactionParams->msg != 0);
+    if(interactionParams->msg == 0)
+    {
+        Strand_FailOpen(interactionParams);
+        return;
+    }
+
+    s_pushOperationId = interactionParams->msg->operationId;
+    resp = SubscribeRes_New( s_pushOperationId );
+    strand = Strand_New( STRAND_DEBUG( TestWsman ) &strandUserFT4, 0, STRAND_FLAG_ENTERSTRAND, interactionParams );
+
+    UT_ASSERT (resp != 0);
+    UT_ASSERT (strand != 0);
+    if (!resp || !strand)
+    {
+        if (resp)
+            SubscribeRes_Release(resp);
+        if (strand)
+            Strand_Delete(strand);
+        Strand_FailOpen(interactionParams);
+        return;
+    }
+
+    Strand_Ack( strand );   // Ack open
+    Strand_Post( strand, &resp->base );
+    Strand_Leave( strand );
+
+    SubscribeRes_Release(resp);
+}
+
+// event sink: receives the deliveries on a single connection and
+// answers each of them, with an Ack if requested
+struct PushSinkParam
+{
+    bool ack;
+    int events;
+    volatile bool started;
+    vector<string> deliveries;
+};
+
+static int _CountEvents(const string& delivery)
+{
+    int count = 0;
+    string::size_type pos = 0;
+
+    if (delivery.find("/wsman/Events</wsa:Action>") == string::npos)
+        return 1;
+
+    while ((pos = delivery.find("<wsman:Event ", pos)) != string::npos)
+    {
+        count++;
+        pos++;
+    }
+    return count;
+}
+
+static void* MI_CALL _PushSinkProc(void* param)
+{
+    PushSinkParam* p = (PushSinkParam*)param;
+    Addr addr;
+    Sock sock, listener;
+    MI_Result r;
+    string data;
+    int events = 0;
+
+    Addr_InitAny(&addr, SINK_PORT);
+
+    r = Sock_CreateListener(&listener, &addr);
+    UT_ASSERT_EQUAL(r, MI_RESULT_OK);
+    if (r != MI_RESULT_OK)
+    {
+        p->started = true;
+        return 0;
+    }
+    UT_ASSERT_EQUAL(Sock_SetBlocking(listener, MI_FALSE), MI_RESULT_OK);
+
+    p->started = true;
+
+    for (int i = 0; ; i++)
+    {
+        if (!NitsAssert(i < 5000, MI_T("no delivery connection")))
+        {
+            Sock_Close(listener);
+            return 0;
+        }
+
+        r = Sock_Accept(listener, &sock, &addr);
+
+        if (MI_RESULT_WOULD_BLOCK == r)
+        {
+            ut::sleep_ms(1);
+            continue;
+        }
+
+        NitsCompare(r, MI_RESULT_OK, MI_T("Failed to accept connection"));
+        break;
+    }
+    Sock_Close(listener);
+
+    if (r != MI_RESULT_OK)
+        return 0;
+
+    Sock_SetBlocking(sock, MI_FALSE);
+
+    for (int i = 0; events < p->events; )
+    {
+        char buf[1024];
+        size_t read = 0;
+        string::size_type headersEnd, pos;
+        size_t contentLength;
+
+        r = Sock_Read(sock, buf, sizeof(buf), &read);
+
+        if (MI_RESULT_WOULD_BLOCK == r)
+        {
+            if (!NitsAssert(i++ < 5000, MI_T("no delivery")))
+                break;
+            ut::sleep_ms(1);
+            continue;
+        }
+
+        if (r != MI_RESULT_OK || 0 == read)
+            break;
+
+        data.append(buf, read);
+
+        // complete deliveries
+        while ((headersEnd = data.find("\r\n\r\n")) != string::npos)
+        {
+            pos = data.find("Content-Length:");
+            if (pos == string::npos || pos > headersEnd)
+                break;
+
+            contentLength = (size_t)atoi(data.c_str() + pos + 15);
+            if (data.size() < headersEnd + 4 + contentLength)
+                break;
+
+            string delivery = data.substr(headersEnd + 4, contentLength);
+            data.erase(0, headersEnd + 4 + contentLength);
+
+            p->deliveries.push_back(delivery);
+            events += _CountEvents(delivery);
+
+            string body;
+            if (p->ack)
+            {
+                body =
+"<s:Envelope xmlns:s=\"http://www.w3.org/2003/05/soap-envelope\""
+"   xmlns:a=\"http://schemas.xmlsoap.org/ws/2004/08/addressing\">"
+"<s:Header>"
+"<a:Action>http://schemas.dmtf.org/wbem/wsman/1/wsman/Ack</a:Action>"
+"</s:Header><s:Body/></s:Envelope>";
+            }
+
+            char header[128];
+            Snprintf(header, MI_COUNT(header),
+                "HTTP/1.1 200 OK\r\nContent-Length: %d\r\n\r\n", (int)body.size());
+            string response = string(header) + body;
+
+            size_t sent = 0;
+            while (sent < response.size())
+            {
+                size_t written = 0;
+                r = Sock_Write(sock, response.c_str() + sent, response.size() - sent, &written);
+                if (MI_RESULT_WOULD_BLOCK == r)
+                {
+                    ut::sleep_ms(1);
+                    continue;
+                }
+                if (r != MI_RESULT_OK)
+                    break;
+                sent += written;
+            }
+        }
+    }
+
+    Sock_Close(sock);
+    return 0;
+}
+END_EXTERNC
+
+static void _TestPushDelivery(const char* mode, bool ack, int maxElements)
+{
+    PushSinkParam param;
+    Thread t;
+    char notifyTo[64];
+
+    param.ack = ack;
+    param.events = 5;
+    param.started = false;
+
+    s_pushEvents = param.events;
+    s_pushPosted = 0;
+
+    StartWSManInproc( _callbackPush, NULL);
+
+    if (!NitsCompare(MI_RESULT_OK, Thread_CreateJoinable(&t, (ThreadProc)_PushSinkProc, NULL, &param),
+        MI_T("Failed to create thread")))
+        return;
+
+    while (!param.started)
+        ut::sleep_ms(1);
+
+    Snprintf(notifyTo, MI_COUNT(notifyTo), "http://127.0.0.1:%d/events", (int)SINK_PORT);
+
+    Sock s = SockConnectLocal(PORT);
+    string r_b, r_h;
+
+    SockSendRecvHTTP(s, false, _CreateSubscribeRequestXML(mode, notifyTo, maxElements), r_h, r_b );
+    UT_ASSERT(r_b.find("e:SubscribeResponse") != string::npos);
+
+    string identifier = GetElementByTag("<e:Identifier>", "</e:Identifier>", r_b);
+    UT_ASSERT(!identifier.empty());
+
+    // events arrive at the sink without any pull
+    PAL_Uint32 ret;
+    Thread_Join(&t, &ret);
+    Thread_Destroy(&t);
+
+    int events = 0;
+    for (size_t i = 0; i < param.deliveries.size(); i++)
+    {
+        const string& delivery = param.deliveries[i];
+
+        UT_ASSERT(delivery.find(string("<wsa:To>") + notifyTo + "</wsa:To>") != string::npos);
+        UT_ASSERT(delivery.find("<p:Number>7</p:Number>") != string::npos);
+        UT_ASSERT((delivery.find("<wsman:AckRequested/>") != string::npos) == ack);
+        if (1 == maxElements)
+            UT_ASSERT(delivery.find("/wsman/Event</wsa:Action>") != string::npos);
+
+        events += _CountEvents(delivery);
+    }
+    UT_ASSERT_EQUAL(events, param.events);
+
+    SockSendRecvHTTP(s, false, _CreateUnsubscribeRequestXML(identifier), r_h, r_b );
+    UT_ASSERT(r_b.find("UnsubscribeResponse") != string::npos);
+
+    Sock_Close(s);
+}
+
+NitsTestWithSetup(TestWSMAN_SubscribePush, Wsman_Inproc_Setup)
+{
+    NitsDisableFaultSim;
+
+    _TestPushDelivery("http://schemas.xmlsoap.org/ws/2004/08/eventing/DeliveryModes/Push", false, 1);
+}
+NitsEndTest
+
+NitsTestWithSetup(TestWSMAN_SubscribePushWithAck, Wsman_Inproc_Setup)
+{
+    NitsDisableFaultSim;
+
+    _TestPushDelivery("http://schemas.dmtf.org/wbem/wsman/1/wsman/PushWithAck", true, 10);
+}
+NitsEndTest
+
+NitsTestWithSetup(TestWSMAN_SubscribePushInvalidNotifyTo, Wsman_Inproc_Setup)
+{
+    NitsDisableFaultSim;
+
+    StartWSManInproc( _callbackPush, NULL);
+
+    Sock s = SockConnectLocal(PORT);
+    string r_b, r_h;
+
+    SockSendRecvHTTP(s, false, _CreateSubscribeRequestXML(
+        "http://schemas.xmlsoap.org/ws/2004/08/eventing/DeliveryModes/Push", "mailto:events", 1), r_h, r_b );
+    UT_ASSERT(r_h.find("500") != string::npos);
+    UT_ASSERT(r_b.find("wsman:EventDeliverToUnusable") != string::npos);
+
+    Sock_Close(s);
+}
+NitsEndTest
+
+#endif /* DISABLE_INDICATION */
@@ -617,6 +617,136 @@ NitsTestWithSetup(TestCreateResponse, TestParserSetup)
 }
 NitsEndTest
 
+static void _InitCreateResponseBody(
+    XML* xml,
+    XML_Char* data)
+{
+    XML_Elem e;
+
+    XML_Init(xml);
+
+    XML_RegisterNameSpace(xml, 's',
+                          ZT("http://www.w3.org/2003/05/soap-envelope"));
+
+    XML_RegisterNameSpace(xml, 'a',
+                          ZT("http://schemas.xmlsoap.org/ws/2004/08/addressing"));
+
+    XML_RegisterNameSpace(xml, 'w',
+                          ZT("http://schemas.dmtf.org/wbem/wsman/1/wsman.xsd"));
+
+    XML_SetText(xml, data);
+
+    /* Skip the envelope start without WS_ParseSoapEnvelope, so the body is
+       parsed with no tag hash installed */
+    XML_Expect(xml, &e, XML_START, PAL_T('s'), PAL_T("Envelope"));
+}
+
+NitsTestWithSetup(TestCreateResponseBodyOnly, TestParserSetup)
+{
+    MI_Uint32 count = 0;
+    MI_Value value;
+    MI_Type type;
+    const MI_Char *name;
+    MI_Uint32 flags;
+    XML xml;
+    MI_Instance *instance = NULL;
+    Batch *batch = NULL;
+    MI_Char *epr;
+
+    XML_Char data[] = PAL_T("<SOAP-ENV:Envelope xmlns:SOAP-ENV=\"http://www.w3.org/2003/05/soap-envelope\" ")
+        PAL_T("xmlns:wsa=\"http://schemas.xmlsoap.org/ws/2004/08/addressing\" ")
+        PAL_T("xmlns:wsman=\"http://schemas.dmtf.org/wbem/wsman/1/wsman.xsd\" ")
+        PAL_T("xmlns:wxf=\"http://schemas.xmlsoap.org/ws/2004/09/transfer\">")
+        PAL_T("<SOAP-ENV:Body>")
+        PAL_T("<wxf:ResourceCreated>\n<wsa:Address>http://schemas.xmlsoap.org/ws/2004/08/addressing/role/anonymous</wsa:Address>\n")
+        PAL_T("<wsa:ReferenceParameters>\n<wsman:ResourceURI>http://schemas.dmtf.org/wbem/wscim/1/cim-schema/2/MSFT_Person</wsman:ResourceURI>\n")
+        PAL_T("<wsman:SelectorSet>\n<wsman:Selector Name=\"Key\">8</wsman:Selector></wsman:SelectorSet>\n</wsa:ReferenceParameters>\n")
+        PAL_T("</wxf:ResourceCreated>\n</SOAP-ENV:Body></SOAP-ENV:Envelope>");
+
+    _InitCreateResponseBody(&xml, data);
+
+    batch = Batch_New(BATCH_MAX_PAGES);
+    if (!NitsAssert(batch != NULL, PAL_T("Unable to create new batch")))
+    {
+        goto cleanup;
+    }
+    if (!NitsCompare(MI_RESULT_OK, WS_ParseCreateResponseBody(&xml, batch, &epr, &instance, MI_FALSE), PAL_T("Unable to retrieve reference")))
+    {
+        goto cleanup;
+    }
+    if (!NitsAssert(instance != NULL, PAL_T("No instance")))
+    {
+        goto cleanup;
+    }
+
+    if (!NitsCompare(MI_RESULT_OK, __MI_Instance_GetElementCount(instance, &count), PAL_T("Unable to get element count")))
+    {
+        goto cleanup;
+    }
+    if (!NitsCompare(count, 1, PAL_T("Element count error")))
+    {
+        goto cleanup;
+    }
+    if (!NitsCompare(MI_RESULT_OK, __MI_Instance_GetElementAt(instance, 0, &name, &value, &type, &flags), PAL_T("Unable to get element 1")))
+    {
+        goto cleanup;
+    }
+    if (!NitsCompareString(name, PAL_T("Key"), PAL_T("Invalid element #1 name")))
+    {
+        goto cleanup;
+    }
+    if (!NitsCompareString(value.string, PAL_T("8"), PAL_T("Invalid element #1 value")))
+    {
+        goto cleanup;
+    }
+
+    cleanup:
+    if (batch)
+    {
+        Batch_Delete(batch);
+    }
+}
+NitsEndTest
+
+NitsTestWithSetup(TestCreateResponseNoSelectorSet, TestParserSetup)
+{
+    XML xml;
+    MI_Instance *instance = NULL;
+    Batch *batch = NULL;
+    MI_Char *epr;
+
+    // A shell reference without a selector set has no instance to hold the
+    // resource URI; it must fail rather than return an empty instance
+
+    XML_Char data[] = PAL_T("<SOAP-ENV:Envelope xmlns:SOAP-ENV=\"http://www.w3.org/2003/05/soap-envelope\" ")
+        PAL_T("xmlns:wsa=\"http://schemas.xmlsoap.org/ws/2004/08/addressing\" ")
+        PAL_T("xmlns:wsman=\"http://schemas.dmtf.org/wbem/wsman/1/wsman.xsd\" ")
+        PAL_T("xmlns:wxf=\"http://schemas.xmlsoap.org/ws/2004/09/transfer\">")
+        PAL_T("<SOAP-ENV:Body>")
+        PAL_T("<wxf:ResourceCreated>\n<wsa:Address>http://schemas.xmlsoap.org/ws/2004/08/addressing/role/anonymous</wsa:Address>\n")
+        PAL_T("<wsa:ReferenceParameters>\n<wsman:ResourceURI>http://schemas.microsoft.com/powershell/Microsoft.PowerShell</wsman:ResourceURI>\n")
+        PAL_T("</wsa:ReferenceParameters>\n")
+        PAL_T("</wxf:ResourceCreated>\n</SOAP-ENV:Body></SOAP-ENV:Envelope>");
+
+    _InitCreateResponseBody(&xml, data);
+
+    batch = Batch_New(BATCH_MAX_PAGES);
+    if (!NitsAssert(batch != NULL, PAL_T("Unable to create new batch")))
+    {
+        goto cleanup;
+    }
+
+    NitsAssert(WS_ParseCreateResponseBody(&xml, batch, &epr, &instance, MI_TRUE) != 0, PAL_T("Reference without selector set was accepted"));
+    NitsAssert(instance == NULL, PAL_T("Unexpected instance"));
+
+    cleanup:
+    if (batch)
+    {
+        Batch_Delete(batch);
+    }
+}
+NitsEndTest
+
 NitsTestWithSetup(TestInvokeResponse, TestParserSetup)
 {
     MI_Uint32 count = 0;
@@ -10,9 +10,11 @@
 #include <iostream>
 #include <string>
 #include <vector>
+#include <algorithm>
 #include <ut/ut.h>
 #include <common.h>
 #include <xml/xml.h>
+#include <xml/xmlreader.h>
 #include <pal/strings.h>
 #include <pal/dir.h>
 #include <pal/file.h>
@@ -909,3 +911,421 @@ NitsEndTest
 
 
 
+
+typedef basic_string<XML_Char> XmlString;
+
+static XmlString DescribeName(const XML_Name& name)
+{
+    XmlString r;
+    r += name.namespaceId ? name.namespaceId : '-';
+    r += PAL_T("{");
+    r += name.namespaceUri;
+    r += PAL_T("}");
+    r += XmlString(name.data, name.size);
+    return r;
+}
+
+/* One line per element; ends of empty tags have no attributes */
+static XmlString DescribeElem(XML_Type type, const XML_Name& data, const XML_Attr* attrs, size_t attrsSize)
+{
+    XmlString r;
+    r += (XML_Char)('0' + type);
+    r += ' ';
+    r += DescribeName(data);
+
+    for (size_t i = 0; type != XML_END && i < attrsSize; i++)
+    {
+        r += ' ';
+
+        /* XML_Next() does not translate instruction attributes */
+        if (type == XML_INSTRUCTION)
+            r += XmlString(attrs[i].name.data, attrs[i].name.size);
+        else
+            r += DescribeName(attrs[i].name);
+        r += '=';
+        r += XmlString(attrs[i].value, attrs[i].valueSize);
+    }
+
+    r += '\n';
+    return r;
+}
+
+static void RegisterReaderNameSpaces(XML_Reader* reader)
+{
+    XML_Reader_RegisterNameSpace(reader, 'a', PAL_T("auri"));
+    XML_Reader_RegisterNameSpace(reader, 'b', PAL_T("buri"));
+    XML_Reader_RegisterNameSpace(reader, 'c', PAL_T("curi"));
+}
+
+/* Parses whole text with XML_Next */
+static int ParseWhole(const XmlString& text, XmlString& out)
+{
+    XML * xml = (XML *) PAL_Malloc(sizeof(XML));
+    vector<XML_Char> data(text.begin(), text.end());
+    XML_Elem e;
+    int r;
+
+    if (!xml)
+        return -1;
+
+    data.push_back(0);
+    XML_Init(xml);
+    XML_SetText(xml, &data[0]);
+    XML_RegisterNameSpace(xml, 'a', PAL_T("auri"));
+    XML_RegisterNameSpace(xml, 'b', PAL_T("buri"));
+    XML_RegisterNameSpace(xml, 'c', PAL_T("curi"));
+
+    while ((r = XML_Next(xml, &e)) == 0)
+        out += DescribeElem(e.type, e.data, e.attrs, e.attrsSize);
+
+    PAL_Free(xml);
+    return r;
+}
+
+/* Feeds text to the reader in pieces of the given size */
+static int ParseFed(const XmlString& text, size_t pieceSize, XmlString& out, XmlString* message = NULL)
+{
+    XML_Reader reader;
+    XML_ReaderElem e;
+    size_t offset = 0;
+    int r;
+
+    XML_Reader_Init(&reader);
+    RegisterReaderNameSpaces(&reader);
+
+    for (;;)
+    {
+        r = XML_Reader_Next(&reader, &e);
+
+        if (r == 0)
+        {
+            out += DescribeElem(e.type, e.data, e.attrs, e.attrsSize);
+            continue;
+        }
+
+        if (r != XML_READER_MORE)
+            break;
+
+        size_t n = text.size() - offset < pieceSize ? text.size() - offset : pieceSize;
+
+        if (!TEST_ASSERT(n || offset == text.size()))
+            break;
+
+        XML_Reader_Feed(&reader, text.data() + offset, n, offset + n == text.size());
+        offset += n;
+    }
+
+    if (message)
+        *message = reader.message;
+
+    XML_Reader_Destroy(&reader);
+    return r;
+}
+
+static const XML_Char* s_readerDocs[] =
+{
+    PAL_T("<a>       one         </a>"),
+    PAL_T("<?xml version=\"1.0\" encoding='UTF-8'?>\n<!-- comment -->\n")
+    PAL_T("<!DOCTYPE root>\n")
+    PAL_T("<root xmlns=\"auri\" xmlns:b='buri' b:x=\"1 &amp; 2 &gt; &#49;&#x32;\">")
+    PAL_T("<b:item b:y='&quot;q&apos;' z=\"a>b\"/>")
+    PAL_T("text &lt;tag&gt; <![CDATA[<raw & data>]]><!--x-y-->")
+    PAL_T("<c:empty xmlns:c=\"curi\" xml:lang='en'></c:empty  >")
+    PAL_T("<b:b><inner xmlns=''>x</inner></b:b></root  >\n"),
+};
+
+NitsTestWithSetup(TestReaderFed, TestXmlSetup)
+{
+    vector<XmlString> docs(s_readerDocs, s_readerDocs + MI_COUNT(s_readerDocs));
+    vector<XML_Char> file;
+
+    UT_ASSERT(Inhale("test14.xml", file));
+    docs.push_back(XmlString(&file[0]));
+
+    for (size_t i = 0; i < docs.size(); i++)
+    {
+        XmlString expected;
+
+        UT_ASSERT(ParseWhole(docs[i], expected) == 1);
+
+        /* byte by byte, odd pieces, everything at once */
+        static const size_t pieces[] = { 1, 2, 7, 64, 100000 };
+
+        for (size_t j = 0; j < MI_COUNT(pieces); j++)
+        {
+            XmlString result;
+
+            UT_ASSERT(ParseFed(docs[i], pieces[j], result) == 1);
+            UT_ASSERT(result == expected);
+        }
+    }
+}
+NitsEndTest
+
+/* Nesting, namespaces and attributes beyond the limits of XML_Next */
+NitsTestWithSetup(TestReaderNoLimits, TestXmlSetup)
+{
+    XmlString doc;
+    XmlString result;
+    const size_t depth = 200;
+    char buf[64];
+
+    for (size_t i = 0; i < depth; i++)
+    {
+        snprintf(buf, sizeof(buf), "<n%u:e xmlns:n%u='u%u' a%u='%u'", (unsigned)i, (unsigned)i, (unsigned)i, (unsigned)i, (unsigned)i);
+        doc += XmlString(buf, buf + strlen(buf));
+
+        if (i == 0)
+        {
+            for (size_t j = 0; j < depth; j++)
+            {
+                snprintf(buf, sizeof(buf), " x%u='%u'", (unsigned)j, (unsigned)j);
+                doc += XmlString(buf, buf + strlen(buf));
+            }
+        }
+
+        doc += '>';
+    }
+
+    for (size_t i = depth; i--; )
+    {
+        snprintf(buf, sizeof(buf), "</n%u:e>", (unsigned)i);
+        doc += XmlString(buf, buf + strlen(buf));
+    }
+
+    UT_ASSERT(ParseFed(doc, 13, result) == 1);
+
+    /* each element and its end */
+    UT_ASSERT(std::count(result.begin(), result.end(), '\n') == (ptrdiff_t)(2 * depth));
+    UT_ASSERT(result.find(PAL_T("1 -{u199}e -{http://www.w3.org/2000/xmlns/}n199=u199 -{}a199=199\n")) != XmlString::npos);
+    UT_ASSERT(result.find(PAL_T(" -{}x199=199")) != XmlString::npos);
+}
+NitsEndTest
+
+/* Offsets right after each start and end tag, as the reader finds them */
+static vector<size_t> FindCuts(const XmlString& text)
+{
+    XML_Reader reader;
+    XML_ReaderElem e;
+    vector<size_t> cuts;
+
+    XML_Reader_Init(&reader);
+    RegisterReaderNameSpaces(&reader);
+    XML_Reader_Feed(&reader, text.data(), text.size(), 1);
+
+    while (XML_Reader_Next(&reader, &e) == 0)
+    {
+        if (e.type == XML_START || e.type == XML_END)
+            cuts.push_back(XML_Reader_Offset(&reader));
+    }
+
+    XML_Reader_Destroy(&reader);
+    return cuts;
+}
+
+struct TextPieces
+{
+    vector< vector<XML_Char> > texts;
+    size_t next;
+};
+
+static XML_Char* NextTextPiece(void* data, size_t* size)
+{
+    TextPieces* pieces = (TextPieces*)data;
+
+    if (pieces->next == pieces->texts.size())
+        return NULL;
+
+    vector<XML_Char>& text = pieces->texts[pieces->next++];
+    *size = text.size() - 1;
+    return &text[0];
+}
+
+/* Parses text cut at every step-th offset with XML_SetTextPieces */
+static int ParsePieces(const XmlString& text, const vector<size_t>& cuts, size_t step, XmlString& out)
+{
+    XML * xml = (XML *) PAL_Malloc(sizeof(XML));
+    TextPieces pieces;
+    size_t start = 0;
+    XML_Elem e;
+    int r;
+
+    if (!xml)
+        return -1;
+
+    for (size_t i = step - 1; i <= cuts.size(); i += step)
+    {
+        size_t end = i < cuts.size() ? cuts[i] : text.size();
+
+        pieces.texts.push_back(vector<XML_Char>(text.begin() + start, text.begin() + end));
+        pieces.texts.back().push_back(0);
+        start = end;
+    }
+
+    /* the rest (possibly nothing) */
+    pieces.texts.push_back(vector<XML_Char>(text.begin() + start, text.end()));
+    pieces.texts.back().push_back(0);
+    pieces.next = 1;
+
+    XML_Init(xml);
+    XML_SetTextPieces(xml, &pieces.texts[0][0], pieces.texts[0].size() - 1, NextTextPiece, &pieces);
+    XML_RegisterNameSpace(xml, 'a', PAL_T("auri"));
+    XML_RegisterNameSpace(xml, 'b', PAL_T("buri"));
+    XML_RegisterNameSpace(xml, 'c', PAL_T("curi"));
+
+    while ((r = XML_Next(xml, &e)) == 0)
+        out += DescribeElem(e.type, e.data, e.attrs, e.attrsSize);
+
+    PAL_Free(xml);
+    return r;
+}
+
+/* Documents cut right after tags parse as if they were given whole */
+NitsTestWithSetup(TestTextPieces, TestXmlSetup)
+{
+    NitsDisableFaultSim;
+
+    vector<XmlString> docs(s_readerDocs, s_readerDocs + MI_COUNT(s_readerDocs));
+    vector<XML_Char> file;
+
+    UT_ASSERT(Inhale("test14.xml", file));
+    docs.push_back(XmlString(&file[0]));
+
+    for (size_t i = 0; i < docs.size(); i++)
+    {
+        XmlString expected;
+        vector<size_t> cuts = FindCuts(docs[i]);
+
+        UT_ASSERT(ParseWhole(docs[i], expected) == 1);
+        UT_ASSERT(!cuts.empty());
+
+        /* at every tag, every other one and a few */
+        static const size_t steps[] = { 1, 2, 5 };
+
+        for (size_t j = 0; j < MI_COUNT(steps); j++)
+        {
+            XmlString result;
+
+            UT_ASSERT(ParsePieces(docs[i], cuts, steps[j], result) == 1);
+            UT_ASSERT(result == expected);
+        }
+    }
+}
+NitsEndTest
+
+NitsTestWithSetup(TestReaderErrors, TestXmlSetup)
+{
+    static const XML_Char* docs[] =
+    {
+        PAL_T("<a><b></a></b>"),
+        PAL_T("<a><b></b>"),
+        PAL_T("<a>&bad;</a>"),
+        PAL_T("<x:a></x:a>"),
+        PAL_T("<a b='1></a>"),
+        PAL_T("<a><!-- x -- y --></a>"),
+        PAL_T("text"),
+    };
+
+    for (size_t i = 0; i < MI_COUNT(docs); i++)
+    {
+        XmlString result;
+        XmlString message;
+
+        UT_ASSERT(ParseFed(docs[i], 3, result, &message) == -1);
+        UT_ASSERT(message.size() != 0);
+        UT_ASSERT(message != XML_ERROR_OUT_OF_MEMORY);
+    }
+}
+NitsEndTest
+
+/* Runs of every length from 0 to 80 characters at every alignment */
+NitsTestWithSetup(TestScanRuns, TestXmlSetup)
+{
+    for (size_t k = 0; k <= 80; k++)
+    {
+        XmlString name = XmlString(PAL_T("e")) + XmlString(k, 'n') + PAL_T("-1._x") + XmlString(k, 'n');
+        XmlString value = XmlString(k, 'x') + PAL_T("\n&\"") + XmlString(k, 'y');
+        XmlString chars = XmlString(k, 'z') + PAL_T("\n<") + XmlString(k, 'w');
+        XmlString doc;
+
+        doc += PAL_T("<") + name + XmlString(k, ' ') + PAL_T("\n\t\r");
+        doc += PAL_T("a='") + XmlString(k, 'x') + PAL_T("\n&amp;\"") + XmlString(k, 'y') + PAL_T("'");
+        doc += XmlString(k, '\n') + PAL_T(">");
+        doc += XmlString(k, 'z') + PAL_T("\n&lt;") + XmlString(k, 'w');
+        doc += PAL_T("</") + name + PAL_T(">");
+
+        XML * xml = (XML *) PAL_Malloc(sizeof(XML));
+        if (!TEST_ASSERT(xml))
+            return;
+
+        vector<XML_Char> data(doc.begin(), doc.end());
+        XML_Elem e;
+
+        data.push_back(0);
+        XML_Init(xml);
+        XML_SetText(xml, &data[0]);
+
+        UT_ASSERT(XML_Next(xml, &e) == 0);
+        UT_ASSERT(e.type == XML_START);
+        UT_ASSERT(XmlString(e.data.data, e.data.size) == name);
+        UT_ASSERT(e.attrsSize == 1);
+        UT_ASSERT(XmlString(e.attrs[0].value, e.attrs[0].valueSize) == value);
+
+        UT_ASSERT(XML_Next(xml, &e) == 0);
+        UT_ASSERT(e.type == XML_CHARS);
+        UT_ASSERT(XmlString(e.data.data, e.data.size) == chars);
+
+        UT_ASSERT(XML_Next(xml, &e) == 0);
+        UT_ASSERT(e.type == XML_END);
+        UT_ASSERT(XML_Next(xml, &e) == 1);
+        UT_ASSERT(xml->line == 1 + (size_t)std::count(doc.begin(), doc.end(), '\n'));
+
+        PAL_Free(xml);
+    }
+}
+NitsEndTest
+
+static int TestTagHash(XML_Char nsId, const XML_Char* name, size_t size)
+{
+    if (nsId == 'a' && size == 4 && Tcscmp(name, PAL_T("root")) == 0)
+        return 1;
+
+    if (nsId == 'b' && size == 5 && Tcscmp(name, PAL_T("empty")) == 0)
+        return 2;
+
+    return 0;
+}
+
+NitsTestWithSetup(TestTags, TestXmlSetup)
+{
+    XML * xml = (XML *) PAL_Malloc(sizeof(XML)); if(!TEST_ASSERT(xml != NULL)) NitsReturn;
+    XML_Char data[] = PAL_T("<a:root xmlns:a='auri' xmlns:b='buri'><b:empty/>text<a:empty/><b:root></b:root></a:root>");
+    XML_Elem e;
+
+    XML_Init(xml);
+    XML_SetText(xml, data);
+    XML_RegisterNameSpace(xml, 'a', PAL_T("auri"));
+    XML_RegisterNameSpace(xml, 'b', PAL_T("buri"));
+    XML_SetTagHash(xml, TestTagHash);
+
+    UT_ASSERT(XML_Next(xml, &e) == 0 && e.type == XML_START && e.tag == 1);
+    UT_ASSERT(XML_Next(xml, &e) == 0 && e.type == XML_START && e.tag == 2);
+    UT_ASSERT(XML_Next(xml, &e) == 0 && e.type == XML_END && e.tag == 2);
+    UT_ASSERT(XML_Next(xml, &e) == 0 && e.type == XML_CHARS && e.tag == 0);
+
+    /* same names in other namespaces */
+    UT_ASSERT(XML_Next(xml, &e) == 0 && e.type == XML_START && e.tag == 0);
+    UT_ASSERT(XML_Next(xml, &e) == 0 && e.type == XML_END && e.tag == 0);
+    UT_ASSERT(XML_Next(xml, &e) == 0 && e.type == XML_START && e.tag == 0);
+    UT_ASSERT(XML_Next(xml, &e) == 0 && e.type == XML_END && e.tag == 0);
+
+    UT_ASSERT(XML_Next(xml, &e) == 0 && e.type == XML_END && e.tag == 1);
+
+    /* put back elements keep their tag */
+    UT_ASSERT(XML_PutBack(xml, &e) == 0);
+    UT_ASSERT(XML_Next(xml, &e) == 0 && e.type == XML_END && e.tag == 1);
+    UT_ASSERT(XML_Next(xml, &e) == 1);
+
+    PAL_Free(xml);
+}
+NitsEndTest
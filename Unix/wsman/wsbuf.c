@@ -210,6 +210,13 @@ static const BUF_FaultItem s_faults[] = {
         "SOAP-ENV:Sender",
         "wsman:InvalidBookmark",
         ZT("Bookmark must be non-empty if specified.")
+    },
+    /* WSBUF_FAULT_EVENT_DELIVER_TO_UNUSABLE */
+    {
+        LIT(ZT("http://schemas.dmtf.org/wbem/wsman/1/wsman/fault")),
+        "SOAP-ENV:Sender",
+        "wsman:EventDeliverToUnusable",
+        ZT("The event source cannot process the subscription because it cannot connect to the event delivery endpoint as requested in the Delivery element.")
     }
 };
 
@@ -502,18 +509,90 @@ static const ZChar* s_miTypeToXmlType[MI_TYPE_MAX] =
 #endif
 
 #if (MI_CHAR_TYPE == 1)
-/* This table idnetifies special XML characters. */
+/* This table idnetifies special XML characters (the ones that are encoded
+   by s_specialCharEncodings); bytes of multi-byte UTF-8 characters are
+   copied as they are. */
 static const char s_specialChars[256] =
 {
     1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,
     0,0,1,0,0,0,1,1,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,1,0,1,0,
     0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
     0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,1,
-    1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,
-    1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,
-    1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,
-    1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,
+    0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
+    0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
+    0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
+    0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
 };
+
+/*
+    Vectorized search for special characters: 16 (SSE2) or 32 (AVX2)
+    bytes are checked at once; the table above handles the rest.
+    Special are bytes below 0x20, 0x7F and '"', '&', '\'', '<', '>';
+    '&'/'\'' (0x26/0x27) and '<'/'>' (0x3C/0x3E) are checked in pairs by
+    masking the bit that differs.
+*/
+#if defined(__GNUC__) && defined(__AVX2__)
+# include <immintrin.h>
+# define WSBUF_SIMD_WIDTH 32
+
+static unsigned int _SpecialCharsMask(
+    const unsigned char* p)
+{
+    __m256i v = _mm256_loadu_si256((const __m256i*)p);
+    __m256i m = _mm256_cmpeq_epi8(_mm256_min_epu8(v, _mm256_set1_epi8(0x1F)), v);
+
+    m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('"')));
+    m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, _mm256_set1_epi8(0x7F)));
+    m = _mm256_or_si256(m, _mm256_cmpeq_epi8(
+        _mm256_or_si256(v, _mm256_set1_epi8(0x01)), _mm256_set1_epi8('\'')));
+    m = _mm256_or_si256(m, _mm256_cmpeq_epi8(
+        _mm256_or_si256(v, _mm256_set1_epi8(0x02)), _mm256_set1_epi8('>')));
+
+    return (unsigned int)_mm256_movemask_epi8(m);
+}
+#elif defined(__GNUC__) && defined(__SSE2__)
+# include <emmintrin.h>
+# define WSBUF_SIMD_WIDTH 16
+
+static unsigned int _SpecialCharsMask(
+    const unsigned char* p)
+{
+    __m128i v = _mm_loadu_si128((const __m128i*)p);
+    __m128i m = _mm_cmpeq_epi8(_mm_min_epu8(v, _mm_set1_epi8(0x1F)), v);
+
+    m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8('"')));
+    m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8(0x7F)));
+    m = _mm_or_si128(m, _mm_cmpeq_epi8(
+        _mm_or_si128(v, _mm_set1_epi8(0x01)), _mm_set1_epi8('\'')));
+    m = _mm_or_si128(m, _mm_cmpeq_epi8(
+        _mm_or_si128(v, _mm_set1_epi8(0x02)), _mm_set1_epi8('>')));
+
+    return (unsigned int)_mm_movemask_epi8(m);
+}
+#endif
+
+/* Returns first special character in [p, end) or end */
+static const unsigned char* _FindSpecialChar(
+    const unsigned char* p,
+    const unsigned char* end)
+{
+#if defined(WSBUF_SIMD_WIDTH)
+    while (end - p >= WSBUF_SIMD_WIDTH)
+    {
+        unsigned int mask = _SpecialCharsMask(p);
+
+        if (mask)
+            return p + __builtin_ctz(mask);
+
+        p += WSBUF_SIMD_WIDTH;
+    }
+#endif
+
+    while (p != end && !s_specialChars[*p])
+        p++;
+
+    return p;
+}
 #endif
 
 /*
@@ -750,31 +829,37 @@ MI_Result WSBuf_AddString(
 {
 #if (MI_CHAR_TYPE == 1)
 
-    /* Process leading non-special characters in the hope that little will
-     * be left over to be encoded the expensive way below this block.
+    /* Copy runs of non-special characters as they are, encoding the
+     * special character that ends each run.
      */
     {
-        const unsigned char* start = (const unsigned char*)str;
-        const unsigned char* p = start;
+        const unsigned char* p = (const unsigned char*)str;
+        const unsigned char* end = p + strlen(str);
 
-        while (!s_specialChars[*p])
-            p++;
-
-        if (p != start)
+        for (;;)
         {
-            if (WSBuf_AddLit(buf, (const char*)start, (MI_Uint32)(p - start)))
+            const unsigned char* start = p;
+
+            p = _FindSpecialChar(p, end);
+
+            if (p != start &&
+                WSBuf_AddLit(buf, (const char*)start, (MI_Uint32)(p - start)))
                 return MI_RESULT_FAILED;
 
-            str = (const char*)p;
-        }
+            if (p == end)
+                return MI_RESULT_OK;
 
-        if (!*str)
-            return MI_RESULT_OK;
+            if (WSBuf_AddLit(buf, s_specialCharEncodings[*p] + 1,
+                (MI_Uint32)s_specialCharEncodings[*p][0]))
+                return MI_RESULT_FAILED;
+
+            p++;
+        }
     }
 
-#endif
+#else
 
-    /* Now encode what remains (starting with first special char hit above)*/
+    /* Encode character by character */
     {
         /*MI_Uint32 size = (MI_Uint32)((MI_Strlen(str)+ 1)*sizeof(ZChar));*/
         ZChar* start = (ZChar*)(((char*)(buf->page +1))+ buf->position);
@@ -829,6 +914,8 @@ MI_Result WSBuf_AddString(
 
         return MI_RESULT_OK;
     }
+
+#endif
 }
 
 #if defined(CONFIG_ENABLE_WCHAR)
@@ -2323,9 +2410,34 @@ MI_Result WSBuf_InstanceToBuf(
     return WSBuf_InstanceToBufWithClassName(userAgent, instance, filterProperty, filterPropertyData, castToClassDecl, batch, flags, NULL, ptrOut, sizeOut);
 }
 
-_Use_decl_annotations_
-void WSBuf_GenerateMessageID(
-    ZChar msgID[WS_MSG_ID_SIZE])
+/*
+    Message IDs are "uuid:%08X-%04X-%04X-%04X-%08X%04X" of two counters:
+    the start time, which only changes when the second counter wraps, and
+    a sequence number. The part made of the start time is formatted once.
+*/
+#define WS_MSG_ID_PREFIX_SIZE 24
+
+static const ZChar s_hexDigits[] = ZT("0123456789ABCDEF");
+
+static ZChar* _FormatHex(
+    ZChar* p,
+    MI_Uint32 x,
+    int digits)
+{
+    int i;
+
+    for (i = digits - 1; i >= 0; i--)
+    {
+        p[i] = s_hexDigits[x & 0xF];
+        x >>= 4;
+    }
+
+    return p + digits;
+}
+
+/* Writes WS_MSG_ID_SIZE - 1 characters of a new message id (no zero) */
+static void _WriteMessageID(
+    ZChar* msgID)
 {
     //WS-Management qualifies the use of wsa:MessageID and wsa:RelatesTo as follows:
     //R5.4.6.4-1: The MessageID and RelatesTo URIs may be of any format, as long as they are valid
@@ -2358,7 +2470,11 @@ void WSBuf_GenerateMessageID(
     //not create or employ MessageID values that differ only in case. For any message transmitted by
     //the service, the MessageID shall not be reused.
 
+
     static MI_Uint64  s1, s2;
+    static MI_Uint64  prefixOf;
+    static ZChar prefix[WS_MSG_ID_PREFIX_SIZE];
+    ZChar* p;
 
     if (!s1)
         PAL_Time(&s1);
@@ -2369,14 +2485,78 @@ void WSBuf_GenerateMessageID(
     if (!s2)
         s1++;
 
-    Stprintf(msgID, WS_MSG_ID_SIZE,
-        ZT("uuid:%08X-%04X-%04X-%04X-%08X%04X"),
-        (MI_Uint32)(s1 & 0xFFFFFFFF),
-        (MI_Uint32)((s1 >> 32)& 0xFFFF),
-        (MI_Uint32)((s1 >> 48)& 0xFFFF),
-        (MI_Uint32)((s2 >> 48)& 0xFFFF),
-        (MI_Uint32)(s2 & 0xFFFFFFFF),
-        (MI_Uint32)((s2 >> 32)& 0xFFFF));
+    if (prefixOf != s1)
+    {
+        p = prefix;
+        memcpy(p, ZT("uuid:"), 5 * sizeof(ZChar));
+        p = _FormatHex(p + 5, (MI_Uint32)(s1 & 0xFFFFFFFF), 8);
+        *p++ = '-';
+        p = _FormatHex(p, (MI_Uint32)((s1 >> 32)& 0xFFFF), 4);
+        *p++ = '-';
+        p = _FormatHex(p, (MI_Uint32)((s1 >> 48)& 0xFFFF), 4);
+        *p++ = '-';
+        prefixOf = s1;
+    }
+
+    memcpy(msgID, prefix, sizeof(prefix));
+    p = _FormatHex(msgID + WS_MSG_ID_PREFIX_SIZE, (MI_Uint32)((s2 >> 48)& 0xFFFF), 4);
+    *p++ = '-';
+    p = _FormatHex(p, (MI_Uint32)(s2 & 0xFFFFFFFF), 8);
+    _FormatHex(p, (MI_Uint32)((s2 >> 32)& 0xFFFF), 4);
+}
+
+_Use_decl_annotations_
+void WSBuf_GenerateMessageID(
+    ZChar msgID[WS_MSG_ID_SIZE])
+{
+    _WriteMessageID(msgID);
+    msgID[WS_MSG_ID_SIZE - 1] = 0;
+}
+
+/*
+    SOAP response header template: static spans copied as they are, with
+    slots for the action, the message id and the optional RelatesTo value:
+
+    <SOAP-ENV:Envelope ...><SOAP-ENV:Header><wsa:To>...</wsa:To>
+    <wsa:Action>[action]</wsa:Action><wsa:MessageID>[id]</wsa:MessageID>
+    <wsa:RelatesTo>[relatesTo]</wsa:RelatesTo>
+*/
+static const ZChar s_responseHeaderStart[] =
+    ZT("<SOAP-ENV:Envelope ")
+    ZT("xmlns:SOAP-ENV=\"http://www.w3.org/2003/05/soap-envelope\" ")
+    ZT("xmlns:wsa=\"http://schemas.xmlsoap.org/ws/2004/08/addressing\" ")
+    ZT("xmlns:wsen=\"http://schemas.xmlsoap.org/ws/2004/09/enumeration\" ")
+    ZT("xmlns:e=\"http://schemas.xmlsoap.org/ws/2004/08/eventing\" ")
+    ZT("xmlns:xsi=\"http://www.w3.org/2001/XMLSchema-instance\" ")
+    ZT("xmlns:wsmb=\"http://schemas.dmtf.org/wbem/wsman/1/cimbinding.xsd\" ")
+    ZT("xmlns:wsman=\"http://schemas.dmtf.org/wbem/wsman/1/wsman.xsd\" ")
+    ZT("xmlns:wxf=\"http://schemas.xmlsoap.org/ws/2004/09/transfer\" ")
+    ZT("xmlns:cim=\"http://schemas.dmtf.org/wbem/wscim/1/common\" ")
+    ZT("xmlns:msftwinrm=\"http://schemas.microsoft.com/wbem/wsman/1/wsman.xsd\" ")
+    /* ZT("xmlns:xml=\"http://www.w3.org/XML/1998/namespace\" ")*/
+    ZT("xmlns:wsmid=\"http://schemas.dmtf.org/wbem/wsman/identity/1/wsmanidentity.xsd\">")
+    ZT("<SOAP-ENV:Header>");
+static const ZChar s_responseHeaderTo[] =
+    ZT("<wsa:To>http://schemas.xmlsoap.org/ws/2004/08/addressing/role/anonymous</wsa:To>")
+    ZT("<wsa:Action>");
+static const ZChar s_responseHeaderMessageID[] =
+    ZT("</wsa:Action><wsa:MessageID>");
+static const ZChar s_responseHeaderMessageIDEnd[] =
+    ZT("</wsa:MessageID>");
+static const ZChar s_responseHeaderRelatesTo[] =
+    ZT("<wsa:RelatesTo>");
+static const ZChar s_responseHeaderRelatesToEnd[] =
+    ZT("</wsa:RelatesTo>");
+
+#define SPAN_SIZE(span) ((MI_Uint32)MI_COUNT(span) - 1)
+
+static ZChar* _CopySpan(
+    ZChar* p,
+    const ZChar* span,
+    MI_Uint32 size)
+{
+    memcpy(p, span, size * sizeof(ZChar));
+    return p + size;
 }
 
 MI_Result WSBuf_CreateSoapResponseHeader(
@@ -2385,67 +2565,117 @@ MI_Result WSBuf_CreateSoapResponseHeader(
     MI_Uint32 actionSize,
     const ZChar* relatesTo)
 {
-    ZChar msgID[WS_MSG_ID_SIZE];
+    MI_Uint32 relatesToSize = relatesTo ? (MI_Uint32)Tcslen(relatesTo) : 0;
+    MI_Uint32 size;
+    ZChar* p;
 
-    /* Response header */
-    if (MI_RESULT_OK != WSBuf_AddLit(buf,
-        LIT(
-        ZT("<SOAP-ENV:Envelope ")
-        ZT("xmlns:SOAP-ENV=\"http://www.w3.org/2003/05/soap-envelope\" ")
-        ZT("xmlns:wsa=\"http://schemas.xmlsoap.org/ws/2004/08/addressing\" ")
-        ZT("xmlns:wsen=\"http://schemas.xmlsoap.org/ws/2004/09/enumeration\" ")
-        ZT("xmlns:e=\"http://schemas.xmlsoap.org/ws/2004/08/eventing\" ")
-        ZT("xmlns:xsi=\"http://www.w3.org/2001/XMLSchema-instance\" ")
-        ZT("xmlns:wsmb=\"http://schemas.dmtf.org/wbem/wsman/1/cimbinding.xsd\" ")
-        ZT("xmlns:wsman=\"http://schemas.dmtf.org/wbem/wsman/1/wsman.xsd\" ")
-        ZT("xmlns:wxf=\"http://schemas.xmlsoap.org/ws/2004/09/transfer\" ")
-        ZT("xmlns:cim=\"http://schemas.dmtf.org/wbem/wscim/1/common\" ")
-        ZT("xmlns:msftwinrm=\"http://schemas.microsoft.com/wbem/wsman/1/wsman.xsd\" ")
-        /* ZT("xmlns:xml=\"http://www.w3.org/XML/1998/namespace\" ")*/
-        ZT("xmlns:wsmid=\"http://schemas.dmtf.org/wbem/wsman/identity/1/wsmanidentity.xsd\">")
-        ZT("<SOAP-ENV:Header>")
-        ZT("<wsa:To>http://schemas.xmlsoap.org/ws/2004/08/addressing/role/anonymous</wsa:To>")
-        ZT("<wsa:Action>"))))
+    size = SPAN_SIZE(s_responseHeaderStart) + SPAN_SIZE(s_responseHeaderTo) + actionSize +
+        SPAN_SIZE(s_responseHeaderMessageID) + WS_MSG_ID_SIZE - 1 +
+        SPAN_SIZE(s_responseHeaderMessageIDEnd);
+
+    if (relatesTo)
     {
-        goto failed;
+        size += SPAN_SIZE(s_responseHeaderRelatesTo) + relatesToSize +
+            SPAN_SIZE(s_responseHeaderRelatesToEnd);
     }
 
-    if (MI_RESULT_OK != WSBuf_AddLit(buf, action, actionSize))
-        goto failed;
+    /* one allocation for the whole header (and the terminating zero) */
+    if (buf->position + (size + 1) * sizeof(ZChar) > buf->page->u.s.size &&
+        _ReallocPage(buf, buf->position + (size + 1) * sizeof(ZChar)) != MI_RESULT_OK)
+    {
+        return MI_RESULT_FAILED;
+    }
 
-    if (MI_RESULT_OK != WSBuf_AddLit(buf,
-            LIT(ZT("</wsa:Action>")
-            ZT("<wsa:MessageID>"))))
-        goto failed;
+    p = (ZChar*)((char*)(buf->page + 1) + buf->position);
 
-    /* Generate new uniqueue msg id */
-    WSBuf_GenerateMessageID(msgID);
+    p = _CopySpan(p, LIT(s_responseHeaderStart));
+    p = _CopySpan(p, LIT(s_responseHeaderTo));
+    p = _CopySpan(p, action, actionSize);
+    p = _CopySpan(p, LIT(s_responseHeaderMessageID));
 
-    if (MI_RESULT_OK != WSBuf_AddLit(buf, msgID, WS_MSG_ID_SIZE - 1))
-        goto failed;
+    /* new unique msg id */
+    _WriteMessageID(p);
+    p += WS_MSG_ID_SIZE - 1;
 
-    if (MI_RESULT_OK != WSBuf_AddLit(buf,
-        LIT(ZT("</wsa:MessageID>"))))
-        goto failed;
+    p = _CopySpan(p, LIT(s_responseHeaderMessageIDEnd));
 
     if (relatesTo)
     {
-        if (MI_RESULT_OK != WSBuf_AddLit(buf,
-            LIT(ZT("<wsa:RelatesTo>"))))
-            goto failed;
+        p = _CopySpan(p, LIT(s_responseHeaderRelatesTo));
+        p = _CopySpan(p, relatesTo, relatesToSize);
+        p = _CopySpan(p, LIT(s_responseHeaderRelatesToEnd));
+    }
 
-        if (MI_RESULT_OK != WSBuf_AddStringNoEncoding(buf, relatesTo))
-            goto failed;
+    *p = 0;
+    buf->position += size * sizeof(ZChar);
 
-        if (MI_RESULT_OK != WSBuf_AddLit(buf,
-            LIT(ZT("</wsa:RelatesTo>"))))
-            goto failed;
+    return MI_RESULT_OK;
+}
+
+/*
+    Event header: the same envelope, addressed to the event sink:
+
+    <SOAP-ENV:Envelope ...><SOAP-ENV:Header><wsa:To>[to]</wsa:To>
+    <wsa:Action>[action]</wsa:Action><wsa:MessageID>[id]</wsa:MessageID>
+    <wsman:AckRequested/>
+*/
+static const ZChar s_eventHeaderTo[] =
+    ZT("<wsa:To>");
+static const ZChar s_eventHeaderAction[] =
+    ZT("</wsa:To><wsa:Action>");
+static const ZChar s_eventHeaderAckRequested[] =
+    ZT("<wsman:AckRequested/>");
+
+MI_Result WSBuf_CreateSoapEventHeader(
+    WSBuf* buf,
+    const ZChar* action,
+    MI_Uint32 actionSize,
+    const ZChar* to,
+    MI_Boolean ackRequested)
+{
+    MI_Uint32 size = SPAN_SIZE(s_responseHeaderStart) + SPAN_SIZE(s_eventHeaderTo);
+    ZChar* p;
+
+    if (buf->position + (size + 1) * sizeof(ZChar) > buf->page->u.s.size &&
+        _ReallocPage(buf, buf->position + (size + 1) * sizeof(ZChar)) != MI_RESULT_OK)
+    {
+        return MI_RESULT_FAILED;
     }
 
-    return MI_RESULT_OK;
+    p = (ZChar*)((char*)(buf->page + 1) + buf->position);
+    p = _CopySpan(p, LIT(s_responseHeaderStart));
+    p = _CopySpan(p, LIT(s_eventHeaderTo));
+    *p = 0;
+    buf->position += size * sizeof(ZChar);
 
-failed:
-    return MI_RESULT_FAILED;
+    /* the address comes from the client */
+    if (WSBuf_AddString(buf, to) != MI_RESULT_OK ||
+        WSBuf_AddLit(buf, LIT(s_eventHeaderAction)) != MI_RESULT_OK ||
+        WSBuf_AddLit(buf, action, actionSize) != MI_RESULT_OK ||
+        WSBuf_AddLit(buf, LIT(s_responseHeaderMessageID)) != MI_RESULT_OK)
+    {
+        return MI_RESULT_FAILED;
+    }
+
+    if (buf->position + WS_MSG_ID_SIZE * sizeof(ZChar) > buf->page->u.s.size &&
+        _ReallocPage(buf, buf->position + WS_MSG_ID_SIZE * sizeof(ZChar)) != MI_RESULT_OK)
+    {
+        return MI_RESULT_FAILED;
+    }
+
+    p = (ZChar*)((char*)(buf->page + 1) + buf->position);
+    _WriteMessageID(p);
+    p[WS_MSG_ID_SIZE - 1] = 0;
+    buf->position += (WS_MSG_ID_SIZE - 1) * sizeof(ZChar);
+
+    if (WSBuf_AddLit(buf, LIT(s_responseHeaderMessageIDEnd)) != MI_RESULT_OK)
+        return MI_RESULT_FAILED;
+
+    if (ackRequested &&
+        WSBuf_AddLit(buf, LIT(s_eventHeaderAckRequested)) != MI_RESULT_OK)
+        return MI_RESULT_FAILED;
+
+    return MI_RESULT_OK;
 }
 
 Page* WSBuf_CreateFaultResponsePage(
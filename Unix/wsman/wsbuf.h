@@ -47,7 +47,8 @@ typedef enum _WSBUF_FAULT_CODE
     WSBUF_FAULT_INVALID_HEARTBEAT,
     WSBUF_FAULT_ACTION_NOT_SUPPORTED,
     WSBUF_FAULT_CONNECTION_RETRY_NOT_SUPPORTED,
-    WSBUF_FAULT_BOOKMARK_INVALID_FORMAT
+    WSBUF_FAULT_BOOKMARK_INVALID_FORMAT,
+    WSBUF_FAULT_EVENT_DELIVER_TO_UNUSABLE
 }
 WSBUF_FAULT_CODE;
 
@@ -231,6 +232,15 @@ MI_Result WSBuf_CreateSoapResponseHeader(
     MI_Uint32       actionSize,
     const ZChar*     relatesTo);
 
+/* Creates soap header of a pushed event message (sent to 'to', the
+    subscription's NotifyTo address); leaves header open as well */
+MI_Result WSBuf_CreateSoapEventHeader(
+    WSBuf   *buf,
+    const ZChar*  action,
+    MI_Uint32       actionSize,
+    const ZChar*     to,
+    MI_Boolean      ackRequested);
+
 #define LIT(str) str,(sizeof(str)/sizeof(str[0])-1)
 
 INLINE ZChar* PageData(Page* page)
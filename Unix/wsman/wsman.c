@@ -23,9 +23,11 @@
 #include <base/Strand.h>
 #include <base/base.h>
 #include <base/list.h>
+#include <pal/hashmap.h>
 #include <pal/lock.h>
 #include <indication/common/indicommon.h>
 #include <pal/cpu.h>
+#include <http/httpclient.h>
 
 #if defined(CONFIG_USE_WCHAR)
 # define HASHSTR_CHAR wchar_t
@@ -58,6 +60,7 @@ STRAND_DEBUGNAME1( WsmanConnection, ProcessRequest )
 #define ENUMERATIONCONTEXT_STRANDAUX_PULLATTACHED               0
 #define ENUMERATIONCONTEXT_STRANDAUX_UNSUBSCRIBEATTACHED        1
 #define ENUMERATIONCONTEXT_STRANDAUX_CONNECTION_DATA_TIMEOUT    2
+#define ENUMERATIONCONTEXT_STRANDAUX_PUSHCOMPLETED              3
 
 STRAND_DEBUGNAME2( WsmanEnumerationContext, PullAttached, UnsubscribeAttached )
 
@@ -133,9 +136,28 @@ static const MI_Uint32 _MAGIC = 0x1CF2BCB7;
 typedef struct _WSMAN_ConnectionData    WSMAN_ConnectionData;
 typedef struct _WSMAN_EnumerateContext  WSMAN_EnumerateContext;
 
-/* Maximum number of enumeration contexts stored at the same time
-    effectively limits number of concurent enumerations */
-#define WSMAN_MAX_ENUM_CONTEXTS 64
+/* Initial number of hash lists of the enumeration context table;
+    doubled whenever there are more contexts than lists */
+#define WSMAN_ENUM_CONTEXT_LISTS 64
+
+/* Entry of an enumeration context in the table of WSMAN */
+typedef struct _WSMAN_EnumContextEntry
+{
+    /* must be the first field: entries are linked in the order of use */
+    ListElem lru;
+
+    HashBucket bucket;
+
+    MI_Uint32 enumerationContextID;
+
+    /* last time the context was used by a request (usec) */
+    MI_Uint64 lastUsed;
+
+    /* being deleted (released, unsubscribed or expired): cannot be found
+        any more and is not on the list of use */
+    MI_Boolean deleted;
+}
+WSMAN_EnumContextEntry;
 
 struct _WSMAN
 {
@@ -153,14 +175,22 @@ struct _WSMAN
     // to synchronize access to enumeration contexts
     RecursiveLock lock;
 
-    /* Array of enumeration contexts:
+    /* Enumeration contexts by enumerationContextID:
         each 'pull' will look for corresponding context
     */
-    WSMAN_EnumerateContext* enumerateContexts[WSMAN_MAX_ENUM_CONTEXTS];
-    // If the particular enumerate context is in the process of being deleted
-    MI_Boolean enumerateContextDeleted[WSMAN_MAX_ENUM_CONTEXTS];
+    HashMap enumerateContexts;
+
+    /* Contexts not being deleted, least recently used first */
+    WSMAN_EnumContextEntry* lruHead;
+    WSMAN_EnumContextEntry* lruTail;
+
+    /* to make up unique context IDs */
+    MI_Uint32 enumerateContextSerial;
 
     ptrdiff_t numEnumerateContexts;
+
+    /* Instance data queued by all enumeration contexts (bytes) */
+    volatile ptrdiff_t enumerateContextsMemory;
     MI_Boolean deleting;
 
     /* Cached xml parser with all namespaces registered */
@@ -247,6 +277,56 @@ typedef struct _WSMAN_EnumerateContextData
     MI_Boolean responsed;
 }WSMAN_EnumerateContextData;
 
+#ifndef DISABLE_INDICATION
+
+/* Event delivery of a Push/PushWithAck subscription: queued events are
+    posted to the NotifyTo address, up to maxElements per message, waiting
+    no longer than maxTime for a batch to fill; connection is kept open
+    between deliveries.
+    HttpClient is only used on selector's thread (from the timers below),
+    so http callbacks never run into the context strand and vice versa */
+typedef struct _WSMAN_PushDelivery
+{
+    /* owning context; NULL once it is finished */
+    struct _WSMAN_EnumerateContext* ec;
+
+    /* WSMAN_DELIVERY_MODE_PUSH or WSMAN_DELIVERY_MODE_PUSH_WITH_ACK */
+    MI_Uint32 mode;
+
+    /* NotifyTo address (wsa:To of events) and its parts */
+    ZChar* address;
+    char* host;
+    char* path;
+    unsigned short port;
+    MI_Boolean secure;
+
+    MI_Uint32 maxElements;
+    MI_Uint64 maxTimeUsec;          /* 0 - batch is sent right away */
+    MI_Uint32 maxEnvelopeSize;
+
+    HttpClient* http;
+
+    /* message being sent */
+    Page* page;
+    MI_Boolean inFlight;
+
+    /* maxTime elapsed for the batch being collected */
+    MI_Boolean batchTimeUp;
+
+    /* outcome of the message in flight, set by http callbacks; 'requested'
+       tells the status of a request from that of an idle connection */
+    MI_Boolean requested;
+    MI_Result result;
+    MI_Uint32 httpError;
+    MI_Boolean acked;
+
+    SelectorTimer send;             /* sends 'page' */
+    SelectorTimer release;          /* deletes http and this struct */
+}
+WSMAN_PushDelivery;
+
+#endif /* ifndef DISABLE_INDICATION */
+
 /* Enumeration context:
     'derived' from socket Handler, so it can subscribe for timeouts */
 
@@ -270,8 +350,11 @@ struct _WSMAN_EnumerateContext
     /* Number of messages in repsonse queue */
     MI_Uint32   totalResponses;
 
-    /* lower 16 bits is aninxed in self->enumerateContexts, upper 16 bits are random data (for validation) */
+    /* unique serial number in lower 16 bits, upper 16 bits are random data (for validation) */
     MI_Uint32   enumerationContextID;
+
+    /* entry in self->wsman->enumerateContexts */
+    WSMAN_EnumContextEntry entry;
     MI_Result   finalResult;
     PostResultMsg *errorMessage;
 
@@ -292,6 +375,9 @@ struct _WSMAN_EnumerateContext
 #ifndef DISABLE_INDICATION
     /* Whether the subscribe request asked for bookmarks during event delivery. */
     MI_Boolean sendBookmarks;
+
+    /* Push/PushWithAck subscriptions; NULL for Pull */
+    WSMAN_PushDelivery* push;
 #endif
 
     /* additional data associated with operation */
@@ -316,6 +402,27 @@ static void _WSMAN_ReleaseEnumerateContext(
     _In_    WSMAN*      self,
             MI_Uint32   enumerationContextID);
 
+static void _WSMAN_EnumContextUsed(
+    _In_    WSMAN*                  self,
+    _In_    WSMAN_EnumerateContext* context);
+
+#if !defined(CONFIG_ENABLE_WCHAR)
+/* Returns the text of the request page after *data (see XML_SetTextPieces) */
+static XML_Char* _NextRequestPiece(
+    void* data,
+    size_t* size)
+{
+    Page** piece = (Page**)data;
+
+    if (!(*piece)->u.s.next)
+        return NULL;
+
+    *piece = (*piece)->u.s.next;
+    *size = (*piece)->u.s.size;
+    return (XML_Char*)(*piece + 1);
+}
+#endif
+
 static void _HttpProcessRequest(
     _In_    WSMAN_ConnectionData*   selfCD,
     _In_    const HttpHeaders*      headers,
@@ -366,6 +473,38 @@ MI_INLINE   MI_Uint32 _convertWSMANtoMsgEnumerationMode(
 *   Enumeration Context operations
 \************************************************************************/
 
+// Called inside the EC strand
+// Accounts instance data added to (size > 0) or removed from (size < 0) the
+// response queue, both for the context and for all contexts of WSMAN
+static void _EC_AccountResponse(
+    WSMAN_EnumerateContext* self,
+    ptrdiff_t               size)
+{
+    self->totalResponseSize = (MI_Uint32)(self->totalResponseSize + size);
+    Atomic_Add(&self->wsman->enumerateContextsMemory, size);
+}
+
+// Called inside the EC strand
+// Checks if the message can be added to the response queue: queues are
+// limited per context and for all contexts together; a context with empty
+// queue can always take a message, so that no context waits for the others
+static MI_Boolean _EC_CanQueueResponse(
+    WSMAN_EnumerateContext* self,
+    PostInstanceMsg*        message)
+{
+    MI_Uint64 maxMemory = self->wsman->options.maxEnumContextsMemory;
+
+    if (self->totalResponseSize + message->packedInstanceSize > MAX_WSMAN_BUFFER_SIZE ||
+        self->totalResponses >= MAX_WSMAN_COLLECTION_SIZE)
+    {
+        return MI_FALSE;
+    }
+
+    return !self->totalResponses || !maxMemory ||
+        (MI_Uint64)Atomic_Read(&self->wsman->enumerateContextsMemory) +
+            message->packedInstanceSize <= maxMemory;
+}
+
 static void _EC_ReleasePendingMessage(
     WSMAN_EnumerateContext* self)
 {
@@ -395,7 +534,7 @@ static void _EC_ReleaseAllMessages(
         PostInstanceMsg_Release(msg);
     }
     self->totalResponses = 0;
-    self->totalResponseSize = 0;
+    _EC_AccountResponse(self, -(ptrdiff_t)self->totalResponseSize);
 
     _EC_ReleasePendingMessage(self);
 }
@@ -410,6 +549,9 @@ static void _EC_CloseLeft(
     DEBUG_ASSERT( !self->strand.base.info.thisClosedOther );
     DEBUG_ASSERT( NULL != self->activeConnection );
 
+    // request is done with the context; it is idle from now on
+    _WSMAN_EnumContextUsed( self->wsman, self );
+
     if( fromRequest )
     {
         // We set this manually
@@ -478,41 +620,170 @@ static void _EC_CheckCloseRight(
 /************************************************************************\
 *   WSman operations
 \************************************************************************/
-MI_INLINE
-MI_Uint32 _WSMAN_GetEnumContextIndex(
+static size_t _WSMAN_EnumContextHash(
+    const HashBucket* bucket)
+{
+    return FromOffsetConst(WSMAN_EnumContextEntry, bucket, bucket)->enumerationContextID;
+}
+
+static int _WSMAN_EnumContextEqual(
+    _In_ const HashBucket* bucket1,
+    _In_ const HashBucket* bucket2)
+{
+    return FromOffsetConst(WSMAN_EnumContextEntry, bucket, bucket1)->enumerationContextID ==
+        FromOffsetConst(WSMAN_EnumContextEntry, bucket, bucket2)->enumerationContextID;
+}
+
+static void _WSMAN_EnumContextRelease(
+    _In_ HashBucket* bucket)
+{
+    /* contexts are owned by their strands */
+    MI_UNUSED(bucket);
+}
+
+static MI_Uint64 _WSMAN_Now()
+{
+    MI_Uint64 now = 0;
+
+    PAL_Time(&now);
+    return now;
+}
+
+// Lock should be acquired when calling here
+static WSMAN_EnumerateContext* _WSMAN_GetEnumContext(
         WSMAN*      self,
         MI_Uint32   enumerationContextID,
         MI_Boolean  isRelease )
 {
-    MI_Uint32 index = enumerationContextID & 0xFFFF;
+    WSMAN_EnumContextEntry key;
+    HashBucket* bucket;
+    WSMAN_EnumContextEntry* entry;
+
+    key.enumerationContextID = enumerationContextID;
+    bucket = HashMap_Find(&self->enumerateContexts, &key.bucket);
+
+    if (!bucket)
+        return NULL;
+
+    entry = FromOffset(WSMAN_EnumContextEntry, bucket, bucket);
+
+    /* contexts being deleted are only found to be released */
+    if (!isRelease && entry->deleted)
+        return NULL;
+
+    return FromOffset(WSMAN_EnumerateContext, entry, entry);
+}
+
+// Lock should be acquired when calling here
+// Moves the context to the end of the list of use
+static void _WSMAN_TouchEnumContext(
+    WSMAN*                  self,
+    WSMAN_EnumContextEntry* entry,
+    MI_Uint64               now)
+{
+    List_Remove(
+        (ListElem**)&self->lruHead,
+        (ListElem**)&self->lruTail,
+        &entry->lru);
+    List_Append(
+        (ListElem**)&self->lruHead,
+        (ListElem**)&self->lruTail,
+        &entry->lru);
+    entry->lastUsed = now;
+}
 
-    /* verify that context exist and has the same id as required */
-    if (index < MI_COUNT(self->enumerateContexts) &&
-        self->enumerateContexts[index] &&
-        (isRelease || !self->enumerateContextDeleted[index]) &&
-        self->enumerateContexts[index]->enumerationContextID == enumerationContextID)
+// Lock should be acquired when calling here
+static void _WSMAN_MarkEnumContextDeleted(
+    WSMAN*                  self,
+    WSMAN_EnumContextEntry* entry)
+{
+    List_Remove(
+        (ListElem**)&self->lruHead,
+        (ListElem**)&self->lruTail,
+        &entry->lru);
+    entry->deleted = MI_TRUE;
+}
+
+// Lock should be acquired when calling here
+// Cancels contexts that no request used for timeoutEnumContextUsec (abandoned
+// by their clients); contexts with a request attached are in use
+static void _WSMAN_ExpireEnumContexts(
+    WSMAN*      self,
+    MI_Uint64   now)
+{
+    MI_Uint64 timeout = self->options.timeoutEnumContextUsec;
+
+    if (!timeout)
+        return;
+
+    while (self->lruHead &&
+        now > self->lruHead->lastUsed && now - self->lruHead->lastUsed >= timeout)
     {
-        return index;
+        WSMAN_EnumContextEntry* entry = self->lruHead;
+        WSMAN_EnumerateContext* context = FromOffset(WSMAN_EnumerateContext, entry, entry);
+
+        if (context->activeConnection || context->attachingConnection
+#ifndef DISABLE_INDICATION
+            /* push subscriptions are used by the event delivery */
+            || context->push
+#endif
+            )
+        {
+            _WSMAN_TouchEnumContext(self, entry, now);
+            continue;
+        }
+
+        _WSMAN_MarkEnumContextDeleted(self, entry);
+
+        // Remove it and also cancel anything outgoing (as Release does)
+        StrandBoth_ScheduleCancel(&context->strand);
     }
-    else
+}
+
+// Lock should be acquired when calling here
+// Doubles the number of hash lists; the table stays as it is if there is no memory
+static void _WSMAN_GrowEnumContexts(
+    WSMAN* self)
+{
+    HashMap bigger;
+    HashMapIterator iterator;
+    const HashBucket* bucket;
+
+    if (HashMap_Init(
+        &bigger,
+        self->enumerateContexts.numLists * 2,
+        _WSMAN_EnumContextHash,
+        _WSMAN_EnumContextEqual,
+        _WSMAN_EnumContextRelease) != 0)
     {
-        return WSMAN_MAX_ENUM_CONTEXTS;
+        return;
     }
+
+    HashMap_BeginIteration(&self->enumerateContexts, &iterator);
+
+    while ((bucket = HashMap_Iterate(&self->enumerateContexts, &iterator)) != NULL)
+        HashMap_Insert(&bigger, (HashBucket*)bucket);
+
+    /* entries are linked in the new lists by now */
+    memset(self->enumerateContexts.lists, 0,
+        self->enumerateContexts.numLists * sizeof(HashBucket*));
+    HashMap_Destroy(&self->enumerateContexts);
+
+    self->enumerateContexts = bigger;
 }
 
 static WSMAN_EnumerateContext* _WSMAN_FindEnumContext(
     WSMAN* self,
     MI_Uint32   enumerationContextID)
 {
-    MI_Uint32 index;
-    WSMAN_EnumerateContext* context = NULL;
+    WSMAN_EnumerateContext* context;
 
     RecursiveLock_Acquire(&self->lock);
 
-    index = _WSMAN_GetEnumContextIndex(self, enumerationContextID, MI_FALSE );
-    if( index < WSMAN_MAX_ENUM_CONTEXTS )
+    context = _WSMAN_GetEnumContext(self, enumerationContextID, MI_FALSE );
+    if( context )
     {
-        context = self->enumerateContexts[index];
+        _WSMAN_TouchEnumContext(self, &context->entry, _WSMAN_Now());
     }
     else
     {
@@ -529,16 +800,14 @@ static WSMAN_EnumerateContext* _WSMAN_FindAndDeleteEnumContext(
     WSMAN* self,
     MI_Uint32   enumerationContextID)
 {
-    MI_Uint32 index;
-    WSMAN_EnumerateContext* context = NULL;
+    WSMAN_EnumerateContext* context;
 
     RecursiveLock_Acquire(&self->lock);
 
-    index = _WSMAN_GetEnumContextIndex(self, enumerationContextID, MI_FALSE );
-    if( index < WSMAN_MAX_ENUM_CONTEXTS )
+    context = _WSMAN_GetEnumContext(self, enumerationContextID, MI_FALSE );
+    if( context )
     {
-        context = self->enumerateContexts[index];
-        self->enumerateContextDeleted[index] = MI_TRUE;
+        _WSMAN_MarkEnumContextDeleted(self, &context->entry);
     }
     else
     {
@@ -550,21 +819,36 @@ static WSMAN_EnumerateContext* _WSMAN_FindAndDeleteEnumContext(
     return context;
 }
 
+// Called on enum context strand when the request attached to it is done
+static void _WSMAN_EnumContextUsed(
+    _In_    WSMAN*                  self,
+    _In_    WSMAN_EnumerateContext* context)
+{
+    RecursiveLock_Acquire(&self->lock);
+
+    if (!context->entry.deleted)
+        _WSMAN_TouchEnumContext(self, &context->entry, _WSMAN_Now());
+
+    RecursiveLock_Release(&self->lock);
+}
+
 // Called on enum context strand or on CD strand during creation
 static void _WSMAN_ReleaseEnumerateContext(
     _In_    WSMAN*      self,
             MI_Uint32   enumerationContextID)
 {
     MI_Boolean broadcast = MI_FALSE;
-    MI_Uint32 index;
+    WSMAN_EnumerateContext* context;
 
     RecursiveLock_Acquire(&self->lock);
 
-    index = _WSMAN_GetEnumContextIndex(self, enumerationContextID, MI_TRUE );
-    if( index < WSMAN_MAX_ENUM_CONTEXTS )
+    context = _WSMAN_GetEnumContext(self, enumerationContextID, MI_TRUE );
+    if( context )
     {
-        self->enumerateContexts[index] = 0;
-        self->enumerateContextDeleted[index] = MI_FALSE;
+        if (!context->entry.deleted)
+            _WSMAN_MarkEnumContextDeleted(self, &context->entry);
+
+        HashMap_Remove(&self->enumerateContexts, &context->entry.bucket);
         --self->numEnumerateContexts;
 
         broadcast = self->deleting;
@@ -584,17 +868,21 @@ static void _WSMAN_ReleaseEnumerateContext(
 static void _WSMAN_CancelAllEnumerateContexts(
     WSMAN* self)
 {
-    MI_Uint32 index;
+    HashMapIterator iterator;
+    const HashBucket* bucket;
 
-    for (index = 0; index < MI_COUNT(self->enumerateContexts); index++ )
+    HashMap_BeginIteration(&self->enumerateContexts, &iterator);
+
+    // iterator is past the context before it is canceled (and maybe released)
+    while ((bucket = HashMap_Iterate(&self->enumerateContexts, &iterator)) != NULL)
     {
-        if (self->enumerateContexts[index])
-        {
-            // delete timer if was set
-            Selector_RemoveHandler(self->selector, &self->enumerateContexts[index]->base);
+        WSMAN_EnumContextEntry* entry = FromOffset(WSMAN_EnumContextEntry, bucket, bucket);
+        WSMAN_EnumerateContext* context = FromOffset(WSMAN_EnumerateContext, entry, entry);
 
-            StrandBoth_ScheduleCancel( &self->enumerateContexts[index]->strand );
-        }
+        // delete timer if was set
+        Selector_RemoveHandler(self->selector, &context->base);
+
+        StrandBoth_ScheduleCancel( &context->strand );
     }
 }
 
@@ -605,30 +893,23 @@ static WSMAN_EnumerateContext* _WSMAN_AllocateEnumContext(
     MI_Uint32   enumerationContextID;
     WSMAN_EnumerateContext* enumContext;
     InteractionOpenParams params;
+    MI_Uint64 now = _WSMAN_Now();
 
     RecursiveLock_Acquire(&self->lock);
 
-    if( self->numEnumerateContexts >= MI_COUNT(self->enumerateContexts) )
-    {
-        trace_EnumContexAllocFailed_TooManyConcurrent();
-        RecursiveLock_Release(&self->lock);
-        return NULL;   /* no more slots available */
-    }
-
-    /* Find empty slot */
-    for (enumerationContextID = 0; enumerationContextID < MI_COUNT(self->enumerateContexts); enumerationContextID++)
-    {
-        if (!self->enumerateContexts[enumerationContextID])
-            break;
-    }
+    _WSMAN_ExpireEnumContexts(self, now);
 
-    if (MI_COUNT(self->enumerateContexts) == enumerationContextID)
+    if( (MI_Uint32)self->numEnumerateContexts >= self->options.maxEnumContexts )
     {
         trace_EnumContexAllocFailed_TooManyConcurrent();
         RecursiveLock_Release(&self->lock);
         return NULL;   /* no more slots available */
     }
 
+    /* keep hash chains short */
+    if( (size_t)self->numEnumerateContexts >= self->enumerateContexts.numLists )
+        _WSMAN_GrowEnumContexts(self);
+
     InteractionOpenParams_Init( &params );
     params.interaction = withInteraction;
 
@@ -647,17 +928,28 @@ static WSMAN_EnumerateContext* _WSMAN_AllocateEnumContext(
         return 0;
     }
 
+    /* Make up unique context-id: serial number and random data */
+    do
+    {
+        enumerationContextID = (++self->enumerateContextSerial & 0xFFFF) |
+            (((MI_Uint32)rand() & 0xFFFF) << 16);
+        enumContext->entry.enumerationContextID = enumerationContextID;
+    }
+    while (!enumerationContextID ||
+        HashMap_Insert(&self->enumerateContexts, &enumContext->entry.bucket) != 0);
+
     /* Store reference to a new context */
-    self->enumerateContexts[enumerationContextID] = enumContext;
-    self->enumerateContextDeleted[enumerationContextID] = MI_FALSE;
+    enumContext->entry.deleted = MI_FALSE;
+    enumContext->entry.lastUsed = now;
+    List_Append(
+        (ListElem**)&self->lruHead,
+        (ListElem**)&self->lruTail,
+        &enumContext->entry.lru);
 
     ++self->numEnumerateContexts;
 
     RecursiveLock_Release(&self->lock);
 
-
-    /* Add random data to the context-id */
-    enumerationContextID |= (rand() & 0xFFFF) << 16;
     enumContext->enumerationContextID = enumerationContextID;
 
     enumContext->wsman = self;
@@ -703,8 +995,7 @@ MI_INLINE void _CD_SetPage(
     WSMAN_ConnectionData* self,
     Page*   page)
 {
-    if (self->page)
-        PAL_Free(self->page);
+    HttpRequestMsg_FreePages(self->page);
 
     self->page = page;
 }
@@ -754,74 +1045,164 @@ static void _CD_Cleanup(
     }
 }
 
-// Used for both WSMAN_ConnectionData and WSMAN_EnumerateContext
-static HttpResponseMsg* _PrepareResponseMsg(
+#if defined(CONFIG_ENABLE_WCHAR)
+
+/* Converts page to wire XML character representation; releases data */
+static Page* _ConvertResponsePage(
     int httpErrorCode,
     Page* data)
 {
-    HttpResponseMsg* msg;
+    size_t count = data->u.s.size / sizeof(ZChar);
+    ZChar* src = (ZChar*)(data + 1);
+    size_t firstNonAscii = 0; // temp variable used by this conversion function between two passes
+    Page* page = NULL;
+    int neededSpace = 0;
+
+    neededSpace = ConvertWideCharToMultiByte(
+                    src,
+                    count,
+                    &firstNonAscii,
+                    NULL,
+                    neededSpace);
 
-#if defined(CONFIG_ENABLE_WCHAR)
+    // output string would not be smaller than input
+    if(neededSpace < (int)count)
+    {
+        PAL_Free(data);
+        trace_Wsman_HttpResponseMsg_ConversionError();
+        return NULL;
+    }
 
-    if( NULL != data )
+    page = (Page*)PAL_Malloc(sizeof(Page) + (neededSpace * sizeof(char)));
+
+    if (!page)
     {
-        /* Convert page to wire XML character representation */
+        trace_Wsman_HttpResponseMsgPage_AllocError( httpErrorCode );
+        PAL_Free(data);
+        return NULL;
+    }
 
-        size_t count = data->u.s.size / sizeof(ZChar);
-        ZChar* src = (ZChar*)(data + 1);
-        size_t firstNonAscii = 0; // temp variable used by this conversion function between two passes
-        Page* page = NULL;
-        int neededSpace = 0;
+    memset(page, 0, sizeof(Page));
+    page->u.s.size = neededSpace;
 
-        neededSpace = ConvertWideCharToMultiByte(
-                        src,
-                        count,
-                        &firstNonAscii,
-                        NULL,
-                        neededSpace);
+    neededSpace = ConvertWideCharToMultiByte(
+                    src,
+                    count,
+                    &firstNonAscii,
+                    (Utf8Char *)(page + 1),
+                    neededSpace);
 
-        // output string would not be smaller than input
-        if(neededSpace < (int)count)
+    // previously computed length must be equal to the neededSpace
+    if(neededSpace != page->u.s.size)
+    {
+        PAL_Free(data);
+        PAL_Free(page);
+        trace_Wsman_HttpResponseMsg_ConversionError();
+        return NULL;
+    }
+
+#if 0
+    Tprintf(ZT("PAGE{%.*s}"), (int)(page->u.s.size), (char*)(page + 1));
+#endif
+
+    PAL_Free(data);
+
+    return page;
+}
+
+/* Copies gathered content into a single page; releases data */
+static Page* _JoinContentRefs(
+    int httpErrorCode,
+    Page* data)
+{
+    Page* ref;
+    Page* page;
+    size_t size = 0;
+    char* p;
+
+    for (ref = data; ref; ref = ref->u.s.next)
+        size += ref->u.s.size;
+
+    page = (Page*)PAL_Malloc(sizeof(Page) + size);
+
+    if (page)
+    {
+        memset(page, 0, sizeof(Page));
+        page->u.s.size = (unsigned int)size;
+        p = (char*)(page + 1);
+
+        for (ref = data; ref; ref = ref->u.s.next)
         {
-            PAL_Free(data);
-            trace_Wsman_HttpResponseMsg_ConversionError();
-            return NULL;
+            memcpy(p, HttpContentRef_Data(ref), ref->u.s.size);
+            p += ref->u.s.size;
         }
+    }
+    else
+    {
+        trace_Wsman_HttpResponseMsgPage_AllocError( httpErrorCode );
+    }
 
-        page = (Page*)PAL_Malloc(sizeof(Page) + (neededSpace * sizeof(char)));
+    HttpContentRef_FreeList(data);
+    return page;
+}
 
-        if (!page)
-        {
-            trace_Wsman_HttpResponseMsgPage_AllocError( httpErrorCode );
-            PAL_Free(data);
+#endif /* defined(CONFIG_ENABLE_WCHAR) */
+
+// Used for both WSMAN_ConnectionData and WSMAN_EnumerateContext; data is
+// a list of HttpContentRef pages if 'gather' is set
+static HttpResponseMsg* _PrepareResponseMsg(
+    int httpErrorCode,
+    Page* data,
+    MI_Boolean gather)
+{
+    HttpResponseMsg* msg;
+
+#if defined(CONFIG_ENABLE_WCHAR)
+
+    /* gathered content is converted as a whole */
+    if (gather)
+    {
+        gather = MI_FALSE;
+        data = _JoinContentRefs(httpErrorCode, data);
+
+        if (!data)
             return NULL;
-        }
+    }
 
-        memset(page, 0, sizeof(Page));
-        page->u.s.size = neededSpace;
+    /* data may be a list of pages; each one is converted on its own */
+    {
+        Page* list = data;
+        Page** tail = &data;
 
-        neededSpace = ConvertWideCharToMultiByte(
-                        src,
-                        count,
-                        &firstNonAscii,
-                        (Utf8Char *)(page + 1),
-                        neededSpace);
+        data = NULL;
 
-        // previously computed length must be equal to the neededSpace
-        if(neededSpace != page->u.s.size)
+        while (list)
         {
-            PAL_Free(data);
-            trace_Wsman_HttpResponseMsg_ConversionError();
-            return NULL;
-        }
+            Page* next = list->u.s.next;
+            Page* page = _ConvertResponsePage(httpErrorCode, list);
 
-#if 0
-        Tprintf(ZT("PAGE{%.*s}"), (int)(page->u.s.size), (char*)(page + 1));
-#endif
+            list = next;
 
-        PAL_Free(data);
+            if (!page)
+            {
+                while (list)
+                {
+                    next = list->u.s.next;
+                    PAL_Free(list);
+                    list = next;
+                }
+                while (data)
+                {
+                    next = data->u.s.next;
+                    PAL_Free(data);
+                    data = next;
+                }
+                return NULL;
+            }
 
-        data = page;
+            *tail = page;
+            tail = &page->u.s.next;
+        }
     }
 
 #endif /* !defined(CONFIG_ENABLE_WCHAR) */
@@ -832,11 +1213,23 @@ static HttpResponseMsg* _PrepareResponseMsg(
     {
         trace_Wsman_HttpResponseMsg_AllocError( httpErrorCode );
 
-        if (data)
+        if (gather)
+        {
+            HttpContentRef_FreeList(data);
+            data = NULL;
+        }
+
+        while (data)
         {
+            Page* next = data->u.s.next;
             PAL_Free(data);
+            data = next;
         }
     }
+    else
+    {
+        msg->gather = gather;
+    }
 
     return msg;
 }
@@ -844,13 +1237,14 @@ static HttpResponseMsg* _PrepareResponseMsg(
 MI_Result _SendResponse(
     StrandBoth* self,
     int httpErrorCode,
-    Page* data)
+    Page* data,
+    MI_Boolean gather)
 {
     HttpResponseMsg* msg;
 
     STRAND_ASSERTONSTRAND(&self->base);
 
-    msg = _PrepareResponseMsg( httpErrorCode, data );
+    msg = _PrepareResponseMsg( httpErrorCode, data, gather );
 
     if( NULL != msg )
     {
@@ -872,7 +1266,16 @@ MI_Result _EC_SendResponse(
     int httpErrorCode,
     Page* data)
 {
-    return _SendResponse( &selfEC->strand, httpErrorCode, data );
+    return _SendResponse( &selfEC->strand, httpErrorCode, data, MI_FALSE );
+}
+
+/* Sends a list of HttpContentRef pages as an OK response */
+MI_INLINE
+MI_Result _EC_SendGatheredResponse(
+    WSMAN_EnumerateContext* selfEC,
+    Page* data)
+{
+    return _SendResponse( &selfEC->strand, HTTP_ERROR_CODE_OK, data, MI_TRUE );
 }
 
 MI_INLINE
@@ -882,7 +1285,17 @@ MI_Result _CD_SendResponse(
     Page* data)
 {
     selfCD->outstandingRequest = MI_FALSE;
-    return _SendResponse( &selfCD->strand, httpErrorCode, data );
+    return _SendResponse( &selfCD->strand, httpErrorCode, data, MI_FALSE );
+}
+
+/* Sends a list of HttpContentRef pages as an OK response */
+MI_INLINE
+MI_Result _CD_SendGatheredResponse(
+    WSMAN_ConnectionData* selfCD,
+    Page* data)
+{
+    selfCD->outstandingRequest = MI_FALSE;
+    return _SendResponse( &selfCD->strand, HTTP_ERROR_CODE_OK, data, MI_TRUE );
 }
 
 MI_INLINE MI_Result _CD_SendErrorFailedResponse(
@@ -1551,9 +1964,12 @@ static void _OpenRightEnum(
 #else
     // TODO: Remove this else once OMI is multi-threaded
     // In Linux and Unix, only start the CD timer if the operation is a subscribe
-    // request. All other complex operations will not support timers until OMI
-    // is multi-threaded.
-    if (WSMANTAG_ACTION_SUBSCRIBE == self->wsheader.rqtAction)
+    // request or an optimized enumerate request, which waits for its first
+    // batch of instances no longer than the operation timeout. All other
+    // complex operations will not support timers until OMI is multi-threaded.
+    if (WSMANTAG_ACTION_SUBSCRIBE == self->wsheader.rqtAction ||
+        (WSMANTAG_ACTION_ENUMERATE == self->wsheader.rqtAction &&
+         self->u.wsenumpullbody.allowOptimization))
     {
         self->enumCtxId = enumContext->enumerationContextID;
         _CD_StartTimer( self );
@@ -2615,75 +3031,417 @@ static void _EC_GetMessageSubset(
         (*totalSize) += (*subsetEnd)->packedInstanceSize;
         count++;
 
-        (*subsetEnd) = (PostInstanceMsg*)(*subsetEnd)->base.next;
+        (*subsetEnd) = (PostInstanceMsg*)(*subsetEnd)->base.next;
+    }
+
+#ifndef DISABLE_INDICATION
+    /* Subscribe enumerate contexts will only hold indications and
+     * bookmarks should only be sent if requested. */
+    if (selfEC->sendBookmarks &&
+        NULL != lastMsg)
+    {
+        PostIndicationMsg* indication = (PostIndicationMsg*)lastMsg;
+        *bookmark = indication->bookmark;
+    }
+#endif
+
+}
+
+
+static void _EC_ProcessPendingMessage(
+    WSMAN_EnumerateContext* selfEC)
+{
+    if (selfEC->pendingMessage)
+    {
+         if (_EC_CanQueueResponse(selfEC, selfEC->pendingMessage))
+         {
+            List_Append(
+                (ListElem**)&selfEC->head,
+                (ListElem**)&selfEC->tail,
+                (ListElem*)selfEC->pendingMessage);
+
+            /* Increment total instance size */
+            _EC_AccountResponse(selfEC, selfEC->pendingMessage->packedInstanceSize);
+
+            /* Increment total number of responses */
+            selfEC->totalResponses++;
+
+            selfEC->pendingMessage = NULL;
+            StrandBoth_ScheduleAckRight(&selfEC->strand);
+         }
+    }
+
+    return;
+}
+
+/*
+ * Encapsulates the check to see if the last message has been sent for an
+ * WSMAN_Enumeratecontext.  Returns TRUE if the last message has been sent
+ * and it is OK to begin cleanup.
+ */
+static MI_Boolean _EC_IsLastMessageSent(
+    WSMAN_EnumerateContext* selfEC )
+{
+    return (selfEC->enumerationCompleted && !selfEC->head);
+}
+
+static void _EC_StartHeartbeatTimer(
+    WSMAN_EnumerateContext* selfEC )
+{
+    if (TIME_NEVER != selfEC->ecTimer.heartbeatInterval &&
+        MI_FALSE == _EC_IsLastMessageSent(selfEC))
+    {
+        /* Timer is not running because it was already fired or never
+         * started during the subscribe request. */
+        DEBUG_ASSERT( MI_FALSE == Strand_HaveTimer(&selfEC->strand.base) );
+
+        Strand_StartTimer( &selfEC->strand.base, &selfEC->ecTimer.timer, selfEC->ecTimer.heartbeatInterval );
+    }
+}
+
+static void _FreeResponsePage(
+    void* page)
+{
+    PAL_Free(page);
+}
+
+static void _ReleaseInstanceMsg(
+    void* msg)
+{
+    PostInstanceMsg_Release((PostInstanceMsg*)msg);
+}
+
+/* Appends a piece of gathered response content to the list ending at
+   *tail; owner is released along with the piece, unless this fails */
+static MI_Boolean _AppendContentRef(
+    _Inout_ Page***                 tail,
+    _In_reads_bytes_(size) const void* data,
+            size_t                  size,
+            void                    (*release)(void* owner),
+    _In_    void*                   owner)
+{
+    Page* ref = HttpContentRef_New(data, size, release, owner);
+
+    if (!ref)
+        return MI_FALSE;
+
+    **tail = ref;
+    *tail = &ref->u.s.next;
+    return MI_TRUE;
+}
+
+#ifndef DISABLE_INDICATION
+
+/************************************************************************\
+*   Push delivery of events
+\************************************************************************/
+
+#define WSMAN_PUSH_CONTENT_TYPE "Content-Type: application/soap+xml;charset=UTF-8"
+
+#define WSMAN_EVENT_ACTION \
+    ZT("http://schemas.dmtf.org/wbem/wsman/1/wsman/Event")
+#define WSMAN_EVENTS_ACTION \
+    ZT("http://schemas.dmtf.org/wbem/wsman/1/wsman/Events")
+#define WSMAN_ACK_ACTION \
+    "http://schemas.dmtf.org/wbem/wsman/1/wsman/Ack"
+
+static const ZChar s_pushEventStart[] =
+    ZT("<wsman:Event Action=\"") WSMAN_EVENT_ACTION ZT("\">");
+static const ZChar s_pushEventEnd[] =
+    ZT("</wsman:Event>");
+
+static void _WSMAN_PushDeliveryDelete(
+    _In_    WSMAN_PushDelivery*     push)
+{
+    PAL_Free(push->address);
+    PAL_Free(push->host);
+    PAL_Free(push->path);
+    PAL_Free(push);
+}
+
+/* Called on selector's thread */
+static void _WSMAN_PushRelease(
+    Selector* selector,
+    SelectorTimer* timer,
+    MI_Uint32 mask,
+    MI_Uint64 currentTimeUsec)
+{
+    WSMAN_PushDelivery* push = (WSMAN_PushDelivery*)timer->data;
+    HttpClient* http = push->http;
+
+    push->http = NULL;
+    HttpClient_Delete(http);
+    _WSMAN_PushDeliveryDelete(push);
+}
+
+/* Called on selector's thread, from inside of HttpClient */
+static MI_Boolean _WSMAN_PushResponse(
+    HttpClient* http,
+    void* callbackData,
+    const HttpClientResponseHeader* headers,
+    MI_Sint64 contentSize,
+    MI_Boolean lastChunk,
+    Page** data)
+{
+    WSMAN_PushDelivery* push = (WSMAN_PushDelivery*)callbackData;
+
+    if (http != push->http || !push->ec)
+        return MI_TRUE;
+
+    if (headers)
+        push->httpError = headers->httpError;
+
+    if (data && *data && push->mode == WSMAN_DELIVERY_MODE_PUSH_WITH_ACK)
+    {
+        const char* p = (const char*)(*data + 1);
+        const char* end = p + (*data)->u.s.size;
+        size_t n = sizeof(WSMAN_ACK_ACTION) - 1;
+
+        for (; (size_t)(end - p) >= n && !push->acked; p++)
+        {
+            if (memcmp(p, WSMAN_ACK_ACTION, n) == 0)
+                push->acked = MI_TRUE;
+        }
+    }
+
+    return MI_TRUE;
+}
+
+/* Called on selector's thread, from inside of HttpClient */
+static void _WSMAN_PushStatus(
+    HttpClient* http,
+    void* callbackData,
+    MI_Result result,
+    const ZChar* errorText,
+    const Probable_Cause_Data* cause)
+{
+    WSMAN_PushDelivery* push = (WSMAN_PushDelivery*)callbackData;
+
+    if (http != push->http || !push->ec || !push->requested)
+        return;
+
+    push->requested = MI_FALSE;
+    push->result = result;
+    StrandBoth_ScheduleAuxLeft(&push->ec->strand, ENUMERATIONCONTEXT_STRANDAUX_PUSHCOMPLETED);
+}
+
+/* Called on selector's thread; sends push->page over the kept-alive
+    connection, or a new one if there is none (or it was closed) */
+static void _WSMAN_PushSend(
+    Selector* selector,
+    SelectorTimer* timer,
+    MI_Uint32 mask,
+    MI_Uint64 currentTimeUsec)
+{
+    WSMAN_PushDelivery* push = (WSMAN_PushDelivery*)timer->data;
+    WSMAN_EnumerateContext* ec = push->ec;
+    Page* page = push->page;
+    MI_Result r = MI_RESULT_FAILED;
+
+    push->page = NULL;
+
+    if (mask & SELECTOR_TIMEOUT)
+    {
+        if (push->http)
+        {
+            r = HttpClient_StartRequestV2(push->http, "POST", push->path,
+                WSMAN_PUSH_CONTENT_TYPE, NULL, NULL, &page, NULL);
+
+            if (r != MI_RESULT_OK)
+            {
+                HttpClient* http = push->http;
+
+                push->http = NULL;
+                HttpClient_Delete(http);
+            }
+        }
+
+        if (r != MI_RESULT_OK)
+        {
+            HttpClient* http = NULL;
+
+            r = HttpClient_New_Connector2(&http, selector, push->host,
+                push->port, push->secure, NULL, _WSMAN_PushStatus,
+                _WSMAN_PushResponse, push, NULL, NULL, NULL, NULL);
+
+            if (r == MI_RESULT_OK)
+            {
+                push->http = http;
+                r = HttpClient_StartRequestV2(http, "POST", push->path,
+                    WSMAN_PUSH_CONTENT_TYPE, NULL, NULL, &page, NULL);
+            }
+        }
+    }
+
+    if (page)
+        PAL_Free(page);
+
+    if (r == MI_RESULT_OK)
+    {
+        push->requested = MI_TRUE;
+    }
+    else
+    {
+        push->result = r;
+        StrandBoth_ScheduleAuxLeft(&ec->strand, ENUMERATIONCONTEXT_STRANDAUX_PUSHCOMPLETED);
+    }
+}
+
+/* Creates the message for queued events (at least one, up to maxElements
+    and the envelope size) and hands it over to selector's thread */
+static void _EC_SendPushDelivery(
+    _In_    WSMAN_EnumerateContext* selfEC)
+{
+    WSMAN_PushDelivery* push = selfEC->push;
+    PostInstanceMsg* subsetEnd = selfEC->head;
+    PostInstanceMsg* msg;
+    MI_Uint32 count = 0;
+    MI_Uint32 size = APPROX_ENUM_RESP_ENVELOPE_SIZE;
+    MI_Boolean batch;
+    WSBuf buf;
+
+    do
+    {
+        size += subsetEnd->packedInstanceSize +
+            (MI_Uint32)(sizeof(s_pushEventStart) + sizeof(s_pushEventEnd));
+        count++;
+        subsetEnd = (PostInstanceMsg*)subsetEnd->base.next;
+    }
+    while (subsetEnd && count < push->maxElements &&
+        size + subsetEnd->packedInstanceSize <= push->maxEnvelopeSize);
+
+    batch = count > 1;
+
+    if (WSBuf_Init(&buf, size) != MI_RESULT_OK)
+        GOTO_FAILED;
+
+    if (batch)
+    {
+        if (MI_RESULT_OK != WSBuf_CreateSoapEventHeader(&buf,
+            LIT(WSMAN_EVENTS_ACTION), push->address,
+            push->mode == WSMAN_DELIVERY_MODE_PUSH_WITH_ACK))
+            GOTO_FAILED;
+    }
+    else
+    {
+        if (MI_RESULT_OK != WSBuf_CreateSoapEventHeader(&buf,
+            LIT(WSMAN_EVENT_ACTION), push->address,
+            push->mode == WSMAN_DELIVERY_MODE_PUSH_WITH_ACK))
+            GOTO_FAILED;
+    }
+
+    if (MI_RESULT_OK != WSBuf_AddLit(&buf,
+        LIT(ZT("</SOAP-ENV:Header>")
+        ZT("<SOAP-ENV:Body>"))))
+        GOTO_FAILED;
+
+    if (batch && MI_RESULT_OK != WSBuf_AddLit(&buf, LIT(ZT("<wsman:Events>"))))
+        GOTO_FAILED;
+
+    for (msg = selfEC->head; msg != subsetEnd; msg = (PostInstanceMsg*)msg->base.next)
+    {
+        if (batch && MI_RESULT_OK != WSBuf_AddLit(&buf, LIT(s_pushEventStart)))
+            GOTO_FAILED;
+
+        if (MI_RESULT_OK != WSBuf_AddLit(&buf, (const ZChar*)msg->packedInstancePtr,
+            msg->packedInstanceSize / sizeof(ZChar)))
+            GOTO_FAILED;
+
+        if (batch && MI_RESULT_OK != WSBuf_AddLit(&buf, LIT(s_pushEventEnd)))
+            GOTO_FAILED;
     }
 
-#ifndef DISABLE_INDICATION
-    /* Subscribe enumerate contexts will only hold indications and
-     * bookmarks should only be sent if requested. */
-    if (selfEC->sendBookmarks &&
-        NULL != lastMsg)
-    {
-        PostIndicationMsg* indication = (PostIndicationMsg*)lastMsg;
-        *bookmark = indication->bookmark;
-    }
-#endif
+    if (batch && MI_RESULT_OK != WSBuf_AddLit(&buf, LIT(ZT("</wsman:Events>"))))
+        GOTO_FAILED;
 
-}
+    if (MI_RESULT_OK != WSBuf_AddLit(&buf,
+        LIT(ZT("</SOAP-ENV:Body>")
+        ZT("</SOAP-ENV:Envelope>"))))
+        GOTO_FAILED;
 
+    push->page = WSBuf_StealPage(&buf);
 
-static void _EC_ProcessPendingMessage(
-    WSMAN_EnumerateContext* selfEC)
-{
-    if (selfEC->pendingMessage)
+    if (!push->page)
+        GOTO_FAILED;
+
+    /* remove sent messages from the list */
+    while (selfEC->head != subsetEnd)
     {
-         if ((selfEC->totalResponseSize + selfEC->pendingMessage->packedInstanceSize <= MAX_WSMAN_BUFFER_SIZE)
-        && (selfEC->totalResponses < MAX_WSMAN_COLLECTION_SIZE))
-         {
-            List_Append(
-                (ListElem**)&selfEC->head,
-                (ListElem**)&selfEC->tail,
-                (ListElem*)selfEC->pendingMessage);
+        msg = selfEC->head;
+        selfEC->totalResponses--;
+        _EC_AccountResponse(selfEC, -(ptrdiff_t)msg->packedInstanceSize);
+        List_Remove(
+            (ListElem**)&selfEC->head,
+            (ListElem**)&selfEC->tail,
+            (ListElem*)msg);
+        PostInstanceMsg_Release(msg);
+    }
 
-            /* Increment total instance size */
-            selfEC->totalResponseSize += selfEC->pendingMessage->packedInstanceSize;
+    push->inFlight = MI_TRUE;
+    push->result = MI_RESULT_FAILED;
+    push->httpError = 0;
+    push->acked = MI_FALSE;
 
-            /* Increment total number of responses */
-            selfEC->totalResponses++;
+    /* keeps the context until the delivery completes */
+    Strand_SetDelayFinish(&selfEC->strand.base);
 
-            selfEC->pendingMessage = NULL;
-            StrandBoth_ScheduleAckRight(&selfEC->strand);
-         }
+    if (MI_RESULT_OK != Selector_StartTimer(selfEC->wsman->selector, &push->send, 0))
+    {
+        /* cannot happen: nothing is in flight */
+        DEBUG_ASSERT(MI_FALSE);
     }
 
+    _EC_ProcessPendingMessage(selfEC);
     return;
-}
 
-/*
- * Encapsulates the check to see if the last message has been sent for an
- * WSMAN_Enumeratecontext.  Returns TRUE if the last message has been sent
- * and it is OK to begin cleanup.
- */
-static MI_Boolean _EC_IsLastMessageSent(
-    WSMAN_EnumerateContext* selfEC )
-{
-    return (selfEC->enumerationCompleted && !selfEC->head);
+failed:
+    WSBuf_Destroy(&buf);
+
+    /* events cannot be delivered; subscription ends */
+    selfEC->enumerationCompleted = MI_TRUE;
+    Strand_Cancel(&selfEC->strand.base);
+    _EC_CheckCloseRight(selfEC);
 }
 
-static void _EC_StartHeartbeatTimer(
-    WSMAN_EnumerateContext* selfEC )
+// Called inside the EC strand
+static void _EC_ProcessPushDelivery(
+    _In_    WSMAN_EnumerateContext* selfEC)
 {
-    if (TIME_NEVER != selfEC->ecTimer.heartbeatInterval &&
-        MI_FALSE == _EC_IsLastMessageSent(selfEC))
+    WSMAN_PushDelivery* push = selfEC->push;
+
+    /* continues once the message in flight is delivered */
+    if (push->inFlight)
+        return;
+
+    if (!selfEC->head)
     {
-        /* Timer is not running because it was already fired or never
-         * started during the subscribe request. */
-        DEBUG_ASSERT( MI_FALSE == Strand_HaveTimer(&selfEC->strand.base) );
+        if (selfEC->enumerationCompleted)
+            _EC_CheckCloseRight(selfEC);
+        return;
+    }
 
-        Strand_StartTimer( &selfEC->strand.base, &selfEC->ecTimer.timer, selfEC->ecTimer.heartbeatInterval );
+    /* wait for the batch to fill up, but no longer than maxTime */
+    if (!selfEC->enumerationCompleted && push->maxTimeUsec &&
+        !push->batchTimeUp && selfEC->totalResponses < push->maxElements)
+    {
+        if (!Strand_HaveTimer(&selfEC->strand.base))
+            Strand_StartTimer(&selfEC->strand.base, &selfEC->ecTimer.timer, push->maxTimeUsec);
+        return;
+    }
+
+    if (Strand_HaveTimer(&selfEC->strand.base))
+    {
+        /* comes back here once the timer is fired */
+        Strand_FireTimer(&selfEC->strand.base);
+        return;
     }
+
+    push->batchTimeUp = MI_FALSE;
+    _EC_SendPushDelivery(selfEC);
 }
 
+#endif /* ifndef DISABLE_INDICATION */
+
 /* Sends as many instances as possible (based on envelope-size and instance counter) */
 static void _SendEnumPullResponse(
     _In_    WSMAN_EnumerateContext* selfEC,
@@ -2691,10 +3449,11 @@ static void _SendEnumPullResponse(
 {
     WSBuf outBufHeader;
     WSBuf outBufTrailer;
-    Page* responsePageCombined = 0;
+    Page* responsePages = 0;
+    Page** responseTail = &responsePages;
     Page* responsePageHeader = 0;
     Page* responsePageTrailer = 0;
-    MI_Uint32 totalSize, messagesSize = 0;
+    MI_Uint32 messagesSize = 0;
     WSMAN_ConnectionData* selfCD = selfEC->activeConnection;
     PostInstanceMsg* subsetEnd = 0;
     MI_Boolean endOfSequence = selfEC->enumerationCompleted;
@@ -2910,75 +3669,53 @@ static void _SendEnumPullResponse(
     if (!responsePageTrailer || !responsePageHeader)
         GOTO_FAILED;
 
-    /* calculate size */
-    totalSize = (MI_Uint32)(responsePageHeader->u.s.size + responsePageTrailer->u.s.size) + messagesSize;
-
-    responsePageCombined = (Page*)PAL_Malloc(sizeof(Page) + totalSize + 1);
-
-    if (!responsePageCombined)
+    /* the packed instances are sent from where they are; the response
+       keeps their messages until then */
+    if (!_AppendContentRef(&responseTail, responsePageHeader + 1,
+        responsePageHeader->u.s.size, _FreeResponsePage, responsePageHeader))
         GOTO_FAILED;
-
-    {
-        char* data = (char*) (responsePageCombined + 1);
-        data[totalSize] = 0;
-
-        memcpy(data, responsePageHeader+1, responsePageHeader->u.s.size);
-        data += responsePageHeader->u.s.size;
+    responsePageHeader = 0;
 
 #ifndef DISABLE_INDICATION
-        /* SubscribeResponse messages should NOT contain any indications if they
-         * have arrived before the SubscribeResponse message. */
-        if (selfCD->wsheader.rqtAction != WSMANTAG_ACTION_SUBSCRIBE)
+    /* SubscribeResponse messages should NOT contain any indications if they
+     * have arrived before the SubscribeResponse message. */
+    if (selfCD->wsheader.rqtAction != WSMANTAG_ACTION_SUBSCRIBE)
 #endif
+    {
+        while (selfEC->head != subsetEnd)
         {
             PostInstanceMsg* msg = selfEC->head;
-            while (msg != subsetEnd)
-            {
-                PostInstanceMsg* next = (PostInstanceMsg*)msg->base.next;
 
-                memcpy(data, msg->packedInstancePtr, msg->packedInstanceSize);
-                data += msg->packedInstanceSize;
-
-                /* remove message from the list */
-                selfEC->totalResponses--;
-                selfEC->totalResponseSize -= msg->packedInstanceSize;
-                List_Remove(
-                    (ListElem**)&selfEC->head,
-                    (ListElem**)&selfEC->tail,
-                    (ListElem*)msg);
-                PostInstanceMsg_Release(msg);
+            if (!_AppendContentRef(&responseTail, msg->packedInstancePtr,
+                msg->packedInstanceSize, _ReleaseInstanceMsg, msg))
+                GOTO_FAILED;
 
-                msg = next;
-            }
+            /* remove message from the list */
+            selfEC->totalResponses--;
+            _EC_AccountResponse(selfEC, -(ptrdiff_t)msg->packedInstanceSize);
+            List_Remove(
+                (ListElem**)&selfEC->head,
+                (ListElem**)&selfEC->tail,
+                (ListElem*)msg);
         }
-
-        memcpy(data, responsePageTrailer+1, responsePageTrailer->u.s.size);
-        data += responsePageTrailer->u.s.size;
-
-        responsePageCombined->u.s.size = totalSize;
-        responsePageCombined->u.s.next = 0;
     }
 
-    PAL_Free(responsePageHeader); responsePageHeader = 0;
-    PAL_Free(responsePageTrailer); responsePageTrailer = 0;
+    if (!_AppendContentRef(&responseTail, responsePageTrailer + 1,
+        responsePageTrailer->u.s.size, _FreeResponsePage, responsePageTrailer))
+        GOTO_FAILED;
+    responsePageTrailer = 0;
 
     if( fromRequest )
     {
         STRAND_ASSERTONSTRAND(&selfCD->strand.base);
 
-        result = _CD_SendResponse(
-            selfCD,
-            HTTP_ERROR_CODE_OK,
-            responsePageCombined);
+        result = _CD_SendGatheredResponse(selfCD, responsePages);
     }
     else
     {
         STRAND_ASSERTONSTRAND(&selfEC->strand.base);
 
-        result = _EC_SendResponse(
-            selfEC,
-            HTTP_ERROR_CODE_OK,
-            responsePageCombined);
+        result = _EC_SendGatheredResponse(selfEC, responsePages);
     }
 
     _EC_StartHeartbeatTimer( selfEC );
@@ -2988,7 +3725,7 @@ static void _SendEnumPullResponse(
 failed:
     WSBuf_Destroy(&outBufHeader);
     WSBuf_Destroy(&outBufTrailer);
-    if (responsePageCombined) PAL_Free(responsePageCombined);
+    HttpContentRef_FreeList(responsePages);
     if (responsePageHeader) PAL_Free(responsePageHeader);
     if (responsePageTrailer) PAL_Free(responsePageTrailer);
 
@@ -3332,6 +4069,15 @@ static void _EC_ProcessEnumResponse(
         return;
     }
 
+#ifndef DISABLE_INDICATION
+    /* Events of push subscriptions go to the event sink, not to a request */
+    if (selfEC->push && selfEC->data.responsed)
+    {
+        _EC_ProcessPushDelivery(selfEC);
+        return;
+    }
+#endif
+
     /* do we have connected client to send response to? */
     if( selfEC->strand.base.info.thisClosedOther )
     {
@@ -3497,6 +4243,12 @@ static void _ProcessSubscribeResponseEnumerationContext(
         _SendEnumPullResponse(selfEC, MI_FALSE);
 
         trace_ProcessSubscribeResponseEnumerationContext_Success( selfEC );
+
+#ifndef DISABLE_INDICATION
+        /* Deliver events that arrived before the response */
+        if (selfEC->push)
+            _EC_ProcessEnumResponse(selfEC, MI_FALSE);
+#endif
     }
     else
         trace_ProcessSubscribeResponseEnumerationContext_DuplicateSuccess(selfEC);
@@ -3596,8 +4348,7 @@ static void _ProcessInstanceEnumerationContext(
     /* add-ref message to keep it alive */
     Message_AddRef( &message->base);
 
-    if ((selfEC->totalResponseSize + message->packedInstanceSize > MAX_WSMAN_BUFFER_SIZE)
-        || (selfEC->totalResponses == MAX_WSMAN_COLLECTION_SIZE))
+    if (!_EC_CanQueueResponse(selfEC, message))
     {
         selfEC->pendingMessage = message;
     }
@@ -3610,7 +4361,7 @@ static void _ProcessInstanceEnumerationContext(
             (ListElem*)message);
 
         /* Increment total instance size */
-        selfEC->totalResponseSize += message->packedInstanceSize;
+        _EC_AccountResponse(selfEC, message->packedInstanceSize);
 
         /* Increment total number of responses */
         selfEC->totalResponses++;
@@ -3852,9 +4603,10 @@ static void _InteractionWsman_Transport_Timeout(
                 WSMAN_EnumerateContext* enumContext = NULL;
                 MI_Uint32 enumCtxId = 0;
 
-                /* Since CD has no reference to its EC during SubscribeReq,
-                 * one is added to make look up possible. */
-                if (WSMANTAG_ACTION_SUBSCRIBE == self->wsheader.rqtAction)
+                /* Since CD has no reference to its EC during SubscribeReq
+                 * and EnumerateReq, one is added to make look up possible. */
+                if (WSMANTAG_ACTION_SUBSCRIBE == self->wsheader.rqtAction ||
+                    WSMANTAG_ACTION_ENUMERATE == self->wsheader.rqtAction)
                     enumCtxId = self->enumCtxId;
                 else
                     enumCtxId = self->u.wsenumpullbody.enumerationContextID;
@@ -4078,6 +4830,20 @@ static void _InteractionWsmanEnum_Finish( _In_ Strand* self_)
     if (NULL != self->errorMessage)
         Message_Release(&self->errorMessage->base);
 
+#ifndef DISABLE_INDICATION
+    if (self->push)
+    {
+        self->push->ec = NULL;
+
+        /* connection is closed on selector's thread */
+        if (!self->push->http ||
+            MI_RESULT_OK != Selector_StartTimer(self->wsman->selector, &self->push->release, 0))
+        {
+            _WSMAN_PushDeliveryDelete(self->push);
+        }
+    }
+#endif
+
 #ifdef CONFIG_ENABLE_DEBUG
     // invalidate struct
     memset( ((char*)self) + sizeof(self->strand), 0xcd, sizeof(*self)-sizeof(self->strand) );
@@ -4125,6 +4891,16 @@ static void _InteractionWsmanEnum_Left_Timeout(
          */
         DEBUG_ASSERT( TimerReason_Expired == reason );
 
+#ifndef DISABLE_INDICATION
+        if (self->push)
+        {
+            /* MaxTime elapsed: deliver the batch collected so far */
+            self->push->batchTimeUp = MI_TRUE;
+            _EC_ProcessEnumResponse(self, MI_FALSE);
+            return;
+        }
+#endif
+
         if (NULL != self->activeConnection &&
             WSMANTAG_ACTION_PULL == self->activeConnection->wsheader.rqtAction)
         {
@@ -4178,6 +4954,13 @@ static void _InteractionWsmanEnum_Left_PullAttached( _In_ Strand* self_)
         // This also releases the context on WSMAN
         _EC_CheckCloseRight( self );
     }
+#ifndef DISABLE_INDICATION
+    else if( self->push )
+    {
+        _CD_SendFaultResponse(self->activeConnection, self, WSBUF_FAULT_NOT_SUPPORTED, ZT("Events of the subscription are pushed"));
+        _EC_CloseLeft( self, MI_FALSE );
+    }
+#endif
     else
     {
         _EC_ProcessEnumResponse(self, MI_TRUE);
@@ -4193,6 +4976,36 @@ static void _InteractionWsmanEnum_Left_UnsubscribeAttached( _In_ Strand* self_)
     _EC_ReleasePendingMessage(self);
 }
 
+#ifndef DISABLE_INDICATION
+
+/* ENUMERATIONCONTEXT_STRANDAUX_PUSHCOMPLETED */
+static void _InteractionWsmanEnum_Left_PushCompleted( _In_ Strand* self_)
+{
+    WSMAN_EnumerateContext* self = (WSMAN_EnumerateContext*)self_;
+    WSMAN_PushDelivery* push = self->push;
+
+    if (!push->inFlight)
+        return;
+
+    push->inFlight = MI_FALSE;
+    Strand_ResetDelayFinish(self_);
+
+    if (MI_RESULT_OK != push->result ||
+        push->httpError < 200 || push->httpError >= 300 ||
+        (WSMAN_DELIVERY_MODE_PUSH_WITH_ACK == push->mode && !push->acked))
+    {
+        /* Event sink is not usable anymore; subscription ends */
+        self->enumerationCompleted = MI_TRUE;
+        Strand_Cancel(self_);
+        _EC_CheckCloseRight( self );
+        return;
+    }
+
+    _EC_ProcessEnumResponse(self, MI_FALSE);
+}
+
+#endif /* ifndef DISABLE_INDICATION */
+
 /* ENUMERATIONCONTEXT_STRANDAUX_CONNECTION_DATA_TIMEOUT */
 static void _InteractionWsmanEnum_Left_ConnectionDataTimeout( _In_ Strand* self_)
 {
@@ -4209,7 +5022,30 @@ static void _InteractionWsmanEnum_Left_ConnectionDataTimeout( _In_ Strand* self_
         return;
     }
 
-    if (WSMANTAG_ACTION_ENUMERATE == self->activeConnection->wsheader.rqtAction ||
+    if (WSMANTAG_ACTION_ENUMERATE == self->activeConnection->wsheader.rqtAction &&
+        self->activeConnection->u.wsenumpullbody.allowOptimization)
+    {
+        /* Optimized enumeration: the first batch is whatever arrived within
+         * the operation timeout; the enumeration goes on and the client
+         * pulls the rest using the context returned with it.
+         * While waiting to execute this method, if a response was already
+         * posted or sent, there is nothing left to do (as for Pull below). */
+        if (self->activeConnection->responseMessage ||
+            self->activeConnection->single_message ||
+            self->strand.base.info.thisClosedOther)
+        {
+            trace_WSManEnumerationContext_CD_Timeout_Notification_Ignored(
+                self->activeConnection->responseMessage,
+                self->activeConnection->single_message,
+                self->strand.base.info.thisClosedOther);
+        }
+        else
+        {
+            _SendEnumPullResponse(self, MI_FALSE);
+            return;
+        }
+    }
+    else if (WSMANTAG_ACTION_ENUMERATE == self->activeConnection->wsheader.rqtAction ||
         WSMANTAG_ACTION_SUBSCRIBE == self->activeConnection->wsheader.rqtAction)
     {
         DEBUG_ASSERT( MI_FALSE == Strand_HaveTimer(self_) );
@@ -4286,6 +5122,7 @@ static void _InteractionWsmanEnum_Left_ConnectionDataTimeout( _In_ Strand* self_
  *     4. Its hearbeat timer expired without a pull attached.
  *     5. An incoming request from CD timed out prior to EC sending an
  *         initial response.
+ *     6. Events of a push subscription could not be delivered.
  *
  * Features:
  *     1. It has a heartbeat timer that tracks the amount of time between
@@ -4298,6 +5135,9 @@ static void _InteractionWsmanEnum_Left_ConnectionDataTimeout( _In_ Strand* self_
  *         coordination of responses so that EC can send partial results.
  *         For example, if MaxElements has not been reached, it will trigger
  *         a Post with the messages in its queue.
+ *     4. PushCompleted continues event delivery of a push subscription once
+ *         the previous message is delivered (on selector's thread).  The
+ *         timer then limits how long a batch of events is collected.
  */
 static StrandFT _InteractionWsmanEnum_Left_FT = {
     NULL,   // Post from left not used
@@ -4310,7 +5150,11 @@ static StrandFT _InteractionWsmanEnum_Left_FT = {
     _InteractionWsmanEnum_Left_PullAttached,
     _InteractionWsmanEnum_Left_UnsubscribeAttached,
     _InteractionWsmanEnum_Left_ConnectionDataTimeout,
+#ifndef DISABLE_INDICATION
+    _InteractionWsmanEnum_Left_PushCompleted,
+#else
     NULL,
+#endif
     NULL };
 
 static void _InteractionWsmanEnum_Right_Post( _In_ Strand* self_, _In_ Message* msg)
@@ -4415,25 +5259,24 @@ static StrandFT _InteractionWsmanEnum_Right_FT = {
 //-------------------------------------------------------------------------------------------------------------------
 
 #if defined(CONFIG_ENABLE_WCHAR)
+/* Decodes UTF-8 request body; the page is sized for the worst case of one
+   character per byte and is zero-terminated */
 static Page* _XMLToWideCharPage(const char* data, size_t size)
 {
-    size_t wsize = size * sizeof(wchar_t);
-    Page* page = (Page*)PAL_Malloc(sizeof(Page) + wsize);
+    Page* page = (Page*)PAL_Malloc(sizeof(Page) + (size + 1) * sizeof(wchar_t));
     wchar_t* p;
+    size_t count;
 
     if (!page)
         return NULL;
 
-    page->u.s.independent = 0;
-    page->u.s.next = NULL;
-    page->u.s.size = wsize;
-
     p = (wchar_t*)(page + 1);
+    count = ConvertMultiByteToWideChar(data, size, p);
+    p[count] = 0;
 
-    while (size--)
-    {
-        *p++ = *data++;
-    }
+    page->u.s.independent = 0;
+    page->u.s.next = NULL;
+    page->u.s.size = count * sizeof(wchar_t);
 
     return page;
 }
@@ -4488,6 +5331,8 @@ static void _HttpProcessRequest(
     XML * xml = (XML *) PAL_Calloc(1, sizeof (XML));
 #if defined(CONFIG_ENABLE_WCHAR)
     int adjustForBom = 0;
+#else
+    Page* piece = page;
 #endif
 
     STRAND_ASSERTONSTRAND(&selfCD->strand.base);
@@ -4496,10 +5341,7 @@ static void _HttpProcessRequest(
     {
         trace_OutOfMemory();
         _CD_SendFailedResponse(selfCD);
-        if( NULL != page )
-        {
-            PAL_Free(page);
-        }
+        HttpRequestMsg_FreePages(page);
         return;
     }
 
@@ -4609,7 +5451,16 @@ static void _HttpProcessRequest(
         XML_SetText(xml, (ZChar*)(page + 1));
     }
 #else
-    XML_SetText(xml, (ZChar*)(page + 1));
+    if (page->u.s.next)
+    {
+        /* large content is received in pages cut between tags */
+        XML_SetTextPieces(xml, (ZChar*)(page + 1), page->u.s.size,
+            _NextRequestPiece, &piece);
+    }
+    else
+    {
+        XML_SetText(xml, (ZChar*)(page + 1));
+    }
 #endif
 
     /* Parse SOAP Envelope */
@@ -4731,10 +5582,7 @@ Done:
     // as we could have abandoned the strand when opening to the right
 
     PAL_Free(xml);
-    if( NULL != page )
-    {
-        PAL_Free(page);
-    }
+    HttpRequestMsg_FreePages(page);
 }
 
 /*
@@ -4774,6 +5622,17 @@ MI_Result WSMAN_New_Listener(
             return MI_RESULT_FAILED;
     }
 
+    if (HashMap_Init(
+        &self->enumerateContexts,
+        WSMAN_ENUM_CONTEXT_LISTS,
+        _WSMAN_EnumContextHash,
+        _WSMAN_EnumContextEqual,
+        _WSMAN_EnumContextRelease) != 0)
+    {
+        PAL_Free(self);
+        return MI_RESULT_FAILED;
+    }
+
     /* Save the callback and callbackData */
     self->callback = callback;
     self->callbackData = callbackData;
@@ -4799,6 +5658,9 @@ MI_Result WSMAN_New_Listener(
 
         // Set HTTP options
         tmpHttpOptions.enableTracing = options->enableHTTPTracing;
+        tmpHttpOptions.ioThreads = options->ioThreads;
+        tmpHttpOptions.compressionLevel = options->compressionLevel;
+        tmpHttpOptions.compressionThreshold = options->compressionThreshold;
     }
 
     /* create a server */
@@ -4899,6 +5761,8 @@ MI_Result WSMAN_Delete(
 
     RecursiveLock_Release(&self->lock);
 
+    HashMap_Destroy(&self->enumerateContexts);
+
     /* Free self pointer */
     PAL_Free(self);
 
@@ -5082,6 +5946,69 @@ failed:
     return MI_RESULT_FAILED;
 }
 
+/* Splits "http[s]://host[:port][/path]" NotifyTo address into the parts
+    used for push delivery; only checks it if 'push' is NULL */
+static int _ParsePushAddress(
+    _In_z_      const ZChar*            address,
+    _Out_opt_   WSMAN_PushDelivery*     push)
+{
+    const ZChar* host;
+    const ZChar* p;
+    MI_Boolean secure;
+    PAL_Uint64 port;
+
+    if (Tcsncasecmp(address, ZT("http://"), 7) == 0)
+    {
+        secure = MI_FALSE;
+        host = address + 7;
+    }
+    else if (Tcsncasecmp(address, ZT("https://"), 8) == 0)
+    {
+        secure = MI_TRUE;
+        host = address + 8;
+    }
+    else
+        return -1;
+
+    for (p = host; *p && *p != ':' && *p != '/'; p++)
+        ;
+
+    if (p == host)
+        return -1;
+
+    port = secure ? 443 : 80;
+
+    if (*p == ':')
+    {
+        ZChar* end;
+
+        port = Tcstoull(p + 1, &end, 10);
+
+        if (end == p + 1 || !port || port > 65535 || (*end && *end != '/'))
+            return -1;
+    }
+
+    if (push)
+    {
+        const ZChar* path = Tcschr(host, '/');
+        size_t hostSize = (size_t)(p - host) + 1;
+        size_t pathSize = path ? Tcslen(path) + 1 : 2;
+
+        push->host = (char*)PAL_Malloc(hostSize);
+        push->path = (char*)PAL_Malloc(pathSize);
+
+        if (!push->host || !push->path)
+            return -1;
+
+        StrTcslcpy(push->host, host, hostSize);
+        StrTcslcpy(push->path, path ? path : ZT("/"), pathSize);
+        push->port = (unsigned short)port;
+        push->secure = secure;
+    }
+
+    return 0;
+}
+
 static int _ValidateSubscribeRequest(
     WSMAN_ConnectionData* selfCD)
 {
@@ -5106,6 +6033,30 @@ static int _ValidateSubscribeRequest(
     if (!selfCD->u.wsenumpullbody.maxElements)
         selfCD->u.wsenumpullbody.maxElements = 1;
 
+    if ((WSMAN_DELIVERY_MODE_PUSH == selfCD->u.wsenumpullbody.deliveryMode ||
+        WSMAN_DELIVERY_MODE_PUSH_WITH_ACK == selfCD->u.wsenumpullbody.deliveryMode) &&
+        (!selfCD->u.wsenumpullbody.notifyTo ||
+        _ParsePushAddress(selfCD->u.wsenumpullbody.notifyTo, NULL) != 0))
+    {
+        _CD_SendFaultResponse(
+            selfCD,
+            NULL,
+            WSBUF_FAULT_EVENT_DELIVER_TO_UNUSABLE,
+            ZT("NotifyTo must be an http or https address"));
+        return -1;
+    }
+
+    if (selfCD->u.wsenumpullbody.maxTime.exists &&
+        selfCD->u.wsenumpullbody.maxTime.value.isTimestamp)
+    {
+        _CD_SendFaultResponse(
+            selfCD,
+            NULL,
+            WSBUF_FAULT_INVALID_MESSAGE_INFORMATION_HEADER,
+            ZT("MaxTime must be xs:duration"));
+        return -1;
+    }
+
     if (selfCD->u.wsenumpullbody.heartbeat.exists &&
         selfCD->u.wsenumpullbody.heartbeat.value.isTimestamp)
     {
@@ -5151,6 +6102,39 @@ static int _ValidateUnsubscribeRequest(
     return 0;
 }
 
+static WSMAN_PushDelivery* _CD_CreatePushDelivery(
+    WSMAN_ConnectionData* selfCD)
+{
+    WSMAN_PushDelivery* push;
+
+    push = (WSMAN_PushDelivery*)PAL_Calloc(1, sizeof(WSMAN_PushDelivery));
+
+    if (!push)
+        return NULL;
+
+    push->mode = selfCD->u.wsenumpullbody.deliveryMode;
+    push->address = PAL_Tcsdup(selfCD->u.wsenumpullbody.notifyTo);
+    push->maxElements = selfCD->u.wsenumpullbody.maxElements;
+    push->maxEnvelopeSize = selfCD->u.wsenumpullbody.maxEnvelopeSize ?
+        selfCD->u.wsenumpullbody.maxEnvelopeSize : WSMAN_MAX_ENVELOPE_SIZE;
+
+    if (!push->address ||
+        _ParsePushAddress(push->address, push) != 0 ||
+        (selfCD->u.wsenumpullbody.maxTime.exists &&
+        DatetimeToUsec(&selfCD->u.wsenumpullbody.maxTime.value, &push->maxTimeUsec) != 0))
+    {
+        _WSMAN_PushDeliveryDelete(push);
+        return NULL;
+    }
+
+    push->send.callback = _WSMAN_PushSend;
+    push->send.data = push;
+    push->release.callback = _WSMAN_PushRelease;
+    push->release.data = push;
+
+    return push;
+}
+
 static void _ProcessSubscribeRequest(
     WSMAN_ConnectionData* selfCD)
 {
@@ -5238,6 +6222,20 @@ static void _ProcessSubscribeRequest(
 
     enumContext->sendBookmarks = selfCD->u.wsenumpullbody.sendBookmarks;
 
+    if (WSMAN_DELIVERY_MODE_PUSH == selfCD->u.wsenumpullbody.deliveryMode ||
+        WSMAN_DELIVERY_MODE_PUSH_WITH_ACK == selfCD->u.wsenumpullbody.deliveryMode)
+    {
+        enumContext->push = _CD_CreatePushDelivery(selfCD);
+        if (NULL == enumContext->push)
+        {
+            trace_OutOfMemory();
+            _CD_SendFailedResponse(selfCD);
+            SubscribeReq_Release(msg);
+            return;
+        }
+        enumContext->push->ec = enumContext;
+    }
+
     AuthInfo_Copy( &msg->base.authInfo, &selfCD->httpHeaders->authInfo );
 
     /* attach request tag to context */
@@ -5246,7 +6244,8 @@ static void _ProcessSubscribeRequest(
     /* mark the response flag to false */
     enumContext->data.responsed = MI_FALSE;
 
-    if (selfCD->u.wsenumpullbody.heartbeat.exists)
+    /* Heartbeats go with pulls; events are pushed as they come */
+    if (selfCD->u.wsenumpullbody.heartbeat.exists && !enumContext->push)
     {
         /* Move heartbeat value to EC so it will be preserved across
          * connections and requests */
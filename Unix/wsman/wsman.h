@@ -28,7 +28,7 @@ typedef struct _WSMAN WSMAN;
 typedef struct _WSMAN_Options
 {
     /* timeout for enumerate context expiration
-     * (time between enum/pull/pull/.. requests)
+     * (time between enum/pull/pull/.. requests; 0 for none)
      */
     MI_Uint64 timeoutEnumContextUsec;
 
@@ -37,11 +37,35 @@ typedef struct _WSMAN_Options
 
     /* Whether to do HTTP-leavel tracing */
     MI_Boolean enableHTTPTracing;
+
+    /* Number of dedicated HTTP I/O threads (0 to use caller's selector) */
+    MI_Uint32 ioThreads;
+
+    /* HTTP response compression level (0 disables) and threshold */
+    MI_Uint32 compressionLevel;
+    MI_Uint32 compressionThreshold;
+
+    /* Maximum number of enumeration contexts stored at the same time;
+     * effectively limits number of concurrent enumerations and
+     * pull subscriptions
+     */
+    MI_Uint32 maxEnumContexts;
+
+    /* Limit of instance data queued by all enumeration contexts, in bytes
+     * (0 for no limit); providers are held back when it is reached
+     */
+    MI_Uint64 maxEnumContextsMemory;
 }
 WSMAN_Options;
 
+#define WSMAN_DEFAULT_ENUM_CONTEXT_TIMEOUT_USEC (10 * 60 * 1000000)
+#define WSMAN_DEFAULT_MAX_ENUM_CONTEXTS 1024
+#define WSMAN_DEFAULT_MAX_ENUM_CONTEXTS_MEMORY (256 * 1024 * 1024)
+
 /* default WSMAN options */
-#define DEFAULT_WSMAN_OPTIONS  { (10 * 60 * 1000000), MI_FALSE, MI_FALSE }
+#define DEFAULT_WSMAN_OPTIONS  { WSMAN_DEFAULT_ENUM_CONTEXT_TIMEOUT_USEC, MI_FALSE, MI_FALSE, 0, \
+    HTTP_DEFAULT_COMPRESSION_LEVEL, HTTP_DEFAULT_COMPRESSION_THRESHOLD, \
+    WSMAN_DEFAULT_MAX_ENUM_CONTEXTS, WSMAN_DEFAULT_MAX_ENUM_CONTEXTS_MEMORY }
 
 MI_Result WSMAN_New_Listener(
     _Out_       WSMAN**                 self,
@@ -87,6 +87,7 @@ struct _WsmanClient
     MI_Uint32 maxElements;
     MI_Boolean isShell;
     Page *responsePage;
+    Page *chunkedPage;      /* chunked response body received so far */
     const char *redirectLocation;
     ptrdiff_t ackState;
     SocketState sockState;
@@ -615,6 +616,27 @@ error:
 
 }
 
+/* Appends a chunk to the chunked response body; the body is kept 
+ * zero-terminated like the page of a Content-Length response */
+static MI_Boolean _AppendChunk(WsmanClient *self, const Page *chunk)
+{
+    size_t size = self->chunkedPage ? self->chunkedPage->u.s.size : 0;
+    Page *page = (Page*)PAL_Realloc(self->chunkedPage, sizeof(Page) + size + chunk->u.s.size + 1);
+
+    if (!page)
+        return MI_FALSE;
+
+    if (!self->chunkedPage)
+        memset(page, 0, sizeof(Page));
+
+    memcpy((char*)(page + 1) + size, chunk + 1, chunk->u.s.size);
+    page->u.s.size = size + chunk->u.s.size;
+    ((char*)(page + 1))[page->u.s.size] = 0;
+
+    self->chunkedPage = page;
+    return MI_TRUE;
+}
+
 static MI_Boolean HttpClientCallbackOnResponseFn(
         HttpClient* http,
         void* callbackData,
@@ -625,6 +647,55 @@ static MI_Boolean HttpClientCallbackOnResponseFn(
 {
     WsmanClient *self = (WsmanClient*) callbackData;
 
+    if (contentSize == -1 && (headers ? headers->httpError : self->httpError) == 200)
+    {
+        /* Chunked response: the envelope may be split anywhere, so it is 
+         * collected and then handled like a Content-Length response; 
+         * other responses (redirect, auth) are handled on their header */
+        Page emptyChunk;
+        Page *body;
+        MI_Boolean result;
+
+        memset(&emptyChunk, 0, sizeof(emptyChunk));
+
+        if (headers)
+        {
+            self->httpError = headers->httpError;
+
+            if (self->chunkedPage)
+            {
+                PAL_Free(self->chunkedPage);
+                self->chunkedPage = NULL;
+            }
+        }
+
+        if (data && *data && !_AppendChunk(self, *data))
+        {
+            PostResult(self, MI_T("Out of memory"), MI_RESULT_SERVER_LIMITS_EXCEEDED, NULL);
+            return MI_FALSE;
+        }
+
+        if (!lastChunk)
+            return MI_TRUE;
+
+        if (!self->chunkedPage && !_AppendChunk(self, &emptyChunk))
+        {
+            PostResult(self, MI_T("Out of memory"), MI_RESULT_SERVER_LIMITS_EXCEEDED, NULL);
+            return MI_FALSE;
+        }
+
+        body = self->chunkedPage;
+        self->chunkedPage = NULL;
+
+        result = HttpClientCallbackOnResponseFn(http, callbackData, NULL, 
+                    (MI_Sint64)body->u.s.size, MI_TRUE, &body);
+
+        if (body)
+            PAL_Free(body);
+
+        return result;
+    }
+
     if (headers)
     {
         self->httpError = headers->httpError;
@@ -1136,6 +1207,9 @@ void _WsmanClient_Finish( _In_ Strand* self_)
     if (self->responsePage)
         PAL_Free(self->responsePage);
 
+    if (self->chunkedPage)
+        PAL_Free(self->chunkedPage);
+
     WsmanClient_Delete(self);
 }
 // PROTOCOLSOCKET_STRANDAUX_POSTMSG
@@ -59,6 +59,22 @@
 **
 **==============================================================================
 */
+
+/* Tag ID of a start or end element. Bodies parsed without going through
+   WS_ParseSoapEnvelope have no tag hash installed, so hash on demand. */
+static int _Tag(
+    _In_ XML* xml,
+    _In_ const XML_Elem* e)
+{
+    if (xml->tagHash)
+        return e->tag;
+
+    if (e->type != XML_START && e->type != XML_END)
+        return 0;
+
+    return HashStr(e->data.namespaceId, e->data.data, e->data.size);
+}
+
 static int _GetReference(
     XML* xml,
     XML_Elem *start,
@@ -213,17 +229,13 @@ static int _GetOptionSet(
     if (XML_Next(xml, &e) != 0)
         RETURN(-1);
 
-    if((e.type == XML_END) &&
-        (e.data.namespaceId == MI_T('w')) &&
-        (Tcscmp(PAL_T("OptionSet"), e.data.data) == 0))
+    if((e.type == XML_END) && (_Tag(xml, &e) == WSMANTAG_OPTION_SET))
     {
         /* Empty option set */
         return 0;
     }
 
-    if((e.type != XML_START) ||
-        (e.data.namespaceId != MI_T('w')) ||
-        (Tcscmp(PAL_T("Option"), e.data.data) != 0))
+    if((e.type != XML_START) || (_Tag(xml, &e) != WSMANTAG_OPTION))
     {
         RETURN(-1);
     }
@@ -296,8 +308,7 @@ static int _GetSelector(
                 }
 
                 if((e->type == XML_START) &&
-                   (e->data.namespaceId == MI_T('a')) &&
-                   (Tcscmp(PAL_T("EndpointReference"), e->data.data) == 0))
+                   (_Tag(xml, e) == WSMANTAG_ENDPOINT_REFERENCE))
                 {
                     if (XML_Next(xml, e) != 0)
                     {
@@ -501,8 +512,7 @@ static int _GetReferenceParameters(
         if (XML_END == e.type)
             break;
 
-        if (PAL_T('w') == e.data.namespaceId &&
-            0 == Tcscmp(PAL_T("ResourceURI"), e.data.data))
+        if (_Tag(xml, &e) == WSMANTAG_RESOURCE_URI)
         {
             if (XML_Expect(xml, &e, XML_CHARS, 0, NULL) != 0)
                 RETURN(-1);
@@ -526,8 +536,7 @@ static int _GetReferenceParameters(
             continue;
         }
 
-        if (PAL_T('w') == e.data.namespaceId &&
-            0 == Tcscmp(PAL_T("SelectorSet"), e.data.data))
+        if (_Tag(xml, &e) == WSMANTAG_SELECTOR_SET)
         {
             /* Allocate an instance */
             if (!*dynamicInstanceParams)
@@ -587,6 +596,19 @@ static int _GetReferenceParameters(
         }
     }
 
+    /* A shell reference without a selector set has no instance to carry
+       its resource URI */
+    if (!*dynamicInstanceParams)
+    {
+        if (resourceURI)
+        {
+            XML_Raise(xml, WSMAN_ERROR_BAD_SELECTOR);
+            RETURN(-1);
+        }
+
+        return 0;
+    }
+
     if (nameSpace)
         (*dynamicInstanceParams)->nameSpace = nameSpace;
 
@@ -615,8 +637,7 @@ static int _GetReference(
     /* extract all parameters */
     for (;;)
     {
-        if (e.data.namespaceId != MI_T('a') ||
-            0 != Tcscmp(PAL_T("ReferenceParameters"), e.data.data))
+        if (_Tag(xml, &e) != WSMANTAG_REFERENCE_PARAMETERS)
         {
             if (XML_Skip(xml) != 0)
                 RETURN(-1);
@@ -1229,9 +1250,7 @@ int WS_ParseWSHeader(
 
         if (e.type == XML_END)// && strcmp(e.data, "s:Header") == 0)
         {
-            int tag = HashStr(e.data.namespaceId, e.data.data, e.data.size);
-
-            if (WSMANTAG_HEADER != tag)
+            if (_Tag(xml, &e) != WSMANTAG_HEADER)
             {
                 trace_Wsman_UnexpectedCloseTag(tcs(e.data.data));
                 RETURN(-1);
@@ -1244,7 +1263,7 @@ int WS_ParseWSHeader(
         if (e.type != XML_START)
             continue;
 
-        switch (HashStr(e.data.namespaceId, e.data.data, e.data.size))
+        switch (_Tag(xml, &e))
         {
             case WSMANTAG_TO:
             {
@@ -1305,7 +1324,7 @@ int WS_ParseWSHeader(
                 if (XML_Expect(xml, &e, XML_START, PAL_T('a'), PAL_T("Address")) != 0)
                     RETURN(-1);
 
-                if (HashStr(e.data.namespaceId, e.data.data, e.data.size) != WSMANTAG_ADDRESS)
+                if (_Tag(xml, &e) != WSMANTAG_ADDRESS)
                     RETURN(-1);
 
                 if (XML_Expect(xml, &e, XML_CHARS, 0, NULL) != 0)
@@ -1317,7 +1336,7 @@ int WS_ParseWSHeader(
                 if (XML_Expect(xml, &e, XML_END, PAL_T('a'), PAL_T("ReplyTo")) != 0)
                     RETURN(-1);
 
-                if (HashStr(e.data.namespaceId, e.data.data, e.data.size) != WSMANTAG_REPLY_TO)
+                if (_Tag(xml, &e) != WSMANTAG_REPLY_TO)
                     RETURN(-1);
             }
             break;
@@ -1547,6 +1566,9 @@ int WS_ParseSoapEnvelope(XML* xml)
 {
     XML_Elem e;
 
+    /* Tags of the envelope are dispatched by the IDs of wstags.txt */
+    XML_SetTagHash(xml, HashStr);
+
     /* Ignore the processing instruction (if any) */
     {
         if (GetNextSkipCharsAndComments(xml, &e) != 0)
@@ -1644,8 +1666,7 @@ static int _ParseAssociationFilterObject(
 
         /* Handle "Object" tag */
 
-        if (PAL_T('a') == e.data.namespaceId &&
-            Tcscmp(e.data.data, PAL_T("ReferenceParameters")) == 0)
+        if (_Tag(xml, &e) == WSMANTAG_REFERENCE_PARAMETERS)
         {
             if (_GetReferenceParameters(
                 xml,
@@ -1656,8 +1677,7 @@ static int _ParseAssociationFilterObject(
                 RETURN(-1);
             }
         }
-        else if (PAL_T('a') == e.data.namespaceId &&
-            Tcscmp(e.data.data, PAL_T("Address")) == 0)
+        else if (_Tag(xml, &e) == WSMANTAG_ADDRESS)
         {
             filter->address = _ExpectCharsAndEnd(xml, PAL_T('a'), PAL_T("Address"));
 
@@ -1735,13 +1755,11 @@ static int _ParseAssociationFilter(
         RETURN(-1);
     }
 
-    if (PAL_T('b') == e.data.namespaceId &&
-        Tcscmp(e.data.data, PAL_T("AssociatedInstances")) == 0)
+    if (_Tag(xml, &e) == WSMANTAG_ASSOCIATED_INSTANCES)
     {
         filter->isAssosiatorOperation = MI_TRUE;
     }
-    else if (PAL_T('b') == e.data.namespaceId &&
-        Tcscmp(e.data.data, PAL_T("AssociationInstances")) == 0)
+    else if (_Tag(xml, &e) == WSMANTAG_ASSOCIATION_INSTANCES)
     {
         filter->isAssosiatorOperation = MI_FALSE;
     }
@@ -1769,55 +1787,64 @@ static int _ParseAssociationFilter(
 
         /* Handle "Object" tag */
 
-        if (PAL_T('b') == e.data.namespaceId &&
-            Tcscmp(e.data.data, PAL_T("Object")) == 0)
+        switch (_Tag(xml, &e))
         {
-            if (_ParseAssociationFilterObject(xml, batch, filter) != 0)
-                RETURN(-1);
-        }
-        else if (PAL_T('b') == e.data.namespaceId &&
-            Tcscmp(e.data.data, PAL_T("AssociationClassName")) == 0)
-        {
-            filter->associationClassName = _ExpectCharsAndEnd(
-                xml, PAL_T('b'), PAL_T("AssociationClassName"));
+            case WSMANTAG_ASSOCIATION_OBJECT:
+            {
+                if (_ParseAssociationFilterObject(xml, batch, filter) != 0)
+                    RETURN(-1);
+            }
+            break;
 
-            if (!filter->associationClassName)
-                RETURN(-1);
-        }
-        else if (PAL_T('b') == e.data.namespaceId &&
-            Tcscmp(e.data.data, PAL_T("Role")) == 0)
-        {
-            filter->role = _ExpectCharsAndEnd(xml, PAL_T('b'), PAL_T("Role"));
+            case WSMANTAG_ASSOCIATION_CLASS_NAME:
+            {
+                filter->associationClassName = _ExpectCharsAndEnd(
+                    xml, PAL_T('b'), PAL_T("AssociationClassName"));
 
-            if (!filter->role)
-                RETURN(-1);
-        }
-        else if (PAL_T('b') == e.data.namespaceId &&
-            Tcscmp(e.data.data, PAL_T("ResultClassName")) == 0)
-        {
-            filter->resultClassName = _ExpectCharsAndEnd(
-                xml,
-                PAL_T('b'),
-                PAL_T("ResultClassName"));
+                if (!filter->associationClassName)
+                    RETURN(-1);
+            }
+            break;
 
-            if (!filter->resultClassName)
-                RETURN(-1);
-        }
-        else if (PAL_T('b') == e.data.namespaceId &&
-            Tcscmp(e.data.data, PAL_T("ResultRole")) == 0)
-        {
-            filter->resultRole = _ExpectCharsAndEnd(
-                xml,
-                PAL_T('b'),
-                PAL_T("ResultRole"));
+            case WSMANTAG_ASSOCIATION_ROLE:
+            {
+                filter->role = _ExpectCharsAndEnd(xml, PAL_T('b'), PAL_T("Role"));
 
-            if (!filter->resultRole)
-                RETURN(-1);
-        }
-        else
-        {
-            if (XML_Skip(xml) != 0)
-                RETURN(-1);
+                if (!filter->role)
+                    RETURN(-1);
+            }
+            break;
+
+            case WSMANTAG_ASSOCIATION_RESULT_CLASS_NAME:
+            {
+                filter->resultClassName = _ExpectCharsAndEnd(
+                    xml,
+                    PAL_T('b'),
+                    PAL_T("ResultClassName"));
+
+                if (!filter->resultClassName)
+                    RETURN(-1);
+            }
+            break;
+
+            case WSMANTAG_ASSOCIATION_RESULT_ROLE:
+            {
+                filter->resultRole = _ExpectCharsAndEnd(
+                    xml,
+                    PAL_T('b'),
+                    PAL_T("ResultRole"));
+
+                if (!filter->resultRole)
+                    RETURN(-1);
+            }
+            break;
+
+            default:
+            {
+                if (XML_Skip(xml) != 0)
+                    RETURN(-1);
+            }
+            break;
         }
     }
 
@@ -1893,9 +1920,7 @@ int WS_ParseEnumerateBody(
 
         if (e.type == XML_END)
         {
-            int tag = HashStr(e.data.namespaceId, e.data.data, e.data.size);
-
-            if (WSMANTAG_ENUM_ENUMERATE != tag)
+            if (_Tag(xml, &e) != WSMANTAG_ENUM_ENUMERATE)
             {
                 trace_Wsman_UnexpectedCloseTag(tcs(e.data.data));
                 RETURN(-1);
@@ -1907,7 +1932,7 @@ int WS_ParseEnumerateBody(
         if (e.type != XML_START)
             continue;
 
-        switch (HashStr(e.data.namespaceId, e.data.data, e.data.size))
+        switch (_Tag(xml, &e))
         {
         case WSMANTAG_ENUM_MAX_ELEMENTS:
             {
@@ -2615,9 +2640,7 @@ int WS_ParsePullBody(
 
         if (e.type == XML_END)
         {
-            int tag = HashStr(e.data.namespaceId, e.data.data, e.data.size);
-
-            if (WSMANTAG_ENUM_PULL != tag)
+            if (_Tag(xml, &e) != WSMANTAG_ENUM_PULL)
             {
                 trace_Wsman_UnexpectedCloseTag(tcs(e.data.data));
                 RETURN(-1);
@@ -2629,7 +2652,7 @@ int WS_ParsePullBody(
         if (e.type != XML_START)
             continue;
 
-        switch (HashStr(e.data.namespaceId, e.data.data, e.data.size))
+        switch (_Tag(xml, &e))
         {
         case WSMANTAG_PULL_MAX_ELEMENTS:
             {
@@ -2733,9 +2756,7 @@ int WS_ParseReleaseBody(
 
         if (e.type == XML_END)
         {
-            int tag = HashStr(e.data.namespaceId, e.data.data, e.data.size);
-
-            if (WSMANTAG_ENUM_RELEASE != tag)
+            if (_Tag(xml, &e) != WSMANTAG_ENUM_RELEASE)
             {
                 trace_Wsman_UnexpectedCloseTag(tcs(e.data.data));
                 RETURN(-1);
@@ -2747,7 +2768,7 @@ int WS_ParseReleaseBody(
         if (e.type != XML_START)
             continue;
 
-        switch (HashStr(e.data.namespaceId, e.data.data, e.data.size))
+        switch (_Tag(xml, &e))
         {
         case WSMANTAG_PULL_ENUMERATION_CONTEXT:
             {
@@ -2916,6 +2937,13 @@ int WS_ParseCreateResponseBody(
             RETURN(-1);
     }
 
+    /* Neither the reference parameters nor the optional instance */
+    if (!*dynamicInstanceParams)
+    {
+        XML_Raise(xml, WSMAN_ERROR_NO_RESOURCE_URI);
+        RETURN(-1);
+    }
+
     /* Expect </s:Body> */
     if ((e.type != XML_END) &&  (e.data.namespaceId != PAL_T('s')) && (Tcscmp(e.data.data, PAL_T("Body")) != 0))
         RETURN(-1);
@@ -2951,13 +2979,13 @@ static int _FetchNextInstance(
     XML *xml,
     Batch *dynamicBatch,
     MI_Instance** dynamicInstanceParams,
-    MI_Char ns,
+    int itemsTag,
     XML_Elem *e,
     MI_Boolean *moreInstance)
 {
     *moreInstance = MI_FALSE;
 
-    if (e->type != XML_END || ns != e->data.namespaceId || (Tcscmp(e->data.data, ZT("Items")) != 0))
+    if (e->type != XML_END || _Tag(xml, e) != itemsTag)
     {
         if (0 != WS_GetInstance(xml, e, dynamicBatch, dynamicInstanceParams, 0))
             RETURN(-1);
@@ -2965,7 +2993,7 @@ static int _FetchNextInstance(
         if (GetNextSkipCharsAndComments(xml, e) != 0)
             RETURN(-1);
 
-        if (e->type != XML_END || ns != e->data.namespaceId || (Tcscmp(e->data.data, ZT("Items")) != 0))
+        if (e->type != XML_END || _Tag(xml, e) != itemsTag)
         {
             *moreInstance = MI_TRUE;
         }
@@ -2984,19 +3012,26 @@ int WS_ParseEnumerateResponse(
     XML_Elem *e)
 {
     MI_Char *responseTag;
-    MI_Char responseNS;
+    int responseTagID;
+    int itemsTag;
+    int endOfSequenceTag;
 
     *dynamicInstanceParams = 0;
 
+    /* Optimized enumeration returns the first items in the wsman namespace */
     if (firstResponse == MI_TRUE)
     {
         responseTag = ZT("EnumerateResponse");
-        responseNS = ZT('w');
+        responseTagID = WSMANTAG_ENUM_ENUMERATE_RESPONSE;
+        itemsTag = WSMANTAG_ITEMS;
+        endOfSequenceTag = WSMANTAG_END_OF_SEQUENCE;
     }
     else
     {
         responseTag = ZT("PullResponse");
-        responseNS = ZT('n');
+        responseTagID = WSMANTAG_ENUM_PULL_RESPONSE;
+        itemsTag = WSMANTAG_ENUM_ITEMS;
+        endOfSequenceTag = WSMANTAG_ENUM_END_OF_SEQUENCE;
     }
 
     if (MI_FALSE == *getNextInstance)
@@ -3014,7 +3049,7 @@ int WS_ParseEnumerateResponse(
     {
         if (MI_TRUE == *getNextInstance)
         {
-            if (0 != _FetchNextInstance(xml, dynamicBatch, dynamicInstanceParams, responseNS, e, getNextInstance))
+            if (0 != _FetchNextInstance(xml, dynamicBatch, dynamicInstanceParams, itemsTag, e, getNextInstance))
                 RETURN(-1);
 
             if (MI_TRUE == *getNextInstance)
@@ -3025,13 +3060,13 @@ int WS_ParseEnumerateResponse(
             if (GetNextSkipCharsAndComments(xml, e) != 0)
                 RETURN(-1);
 
-            if (e->type == XML_END && (Tcscmp(e->data.data, responseTag) == 0))
+            if (e->type == XML_END && _Tag(xml, e) == responseTagID)
                 break;
 
             if (e->type != XML_START)
                 continue;
 
-            if (ZT('n') == e->data.namespaceId && (Tcscmp(e->data.data, ZT("EnumerationContext")) == 0))
+            if (_Tag(xml, e) == WSMANTAG_PULL_ENUMERATION_CONTEXT)
             {
                 if (0 != XML_Next(xml, e))
                     RETURN(-1);
@@ -3043,23 +3078,23 @@ int WS_ParseEnumerateResponse(
                     if (XML_Expect(xml, e, XML_END, PAL_T('n'), PAL_T("EnumerationContext")) != 0)
                         RETURN(-1);
                 }
-                else if (e->type == XML_END && ZT('n') == e->data.namespaceId && (Tcscmp(e->data.data, ZT("EnumerationContext")) == 0))
+                else if (e->type == XML_END && _Tag(xml, e) == WSMANTAG_PULL_ENUMERATION_CONTEXT)
                     continue;
                 else
                     RETURN(-1);
             }
-            else if (responseNS == e->data.namespaceId && (Tcscmp(e->data.data, ZT("Items")) == 0))
+            else if (_Tag(xml, e) == itemsTag)
             {
                 if (GetNextSkipCharsAndComments(xml, e) != 0)
                     RETURN(-1);
 
-                if (0 != _FetchNextInstance(xml, dynamicBatch, dynamicInstanceParams, responseNS, e, getNextInstance))
+                if (0 != _FetchNextInstance(xml, dynamicBatch, dynamicInstanceParams, itemsTag, e, getNextInstance))
                     RETURN(-1);
 
                 if (MI_TRUE == *getNextInstance)
                     return 0;
             }
-            else if (responseNS == e->data.namespaceId && (Tcscmp(e->data.data, ZT("EndOfSequence")) == 0))
+            else if (_Tag(xml, e) == endOfSequenceTag)
             {
                 *endOfSequence = MI_TRUE;
             }
@@ -3388,7 +3423,9 @@ int WS_ParseSubscribeBody(
         if (mode)
         {
             int tag = HashStr( 0, mode, Tcslen(mode));
-            if (WSMAN_DELIVERY_MODE_PULL != tag)
+            if (WSMAN_DELIVERY_MODE_PULL != tag &&
+                WSMAN_DELIVERY_MODE_PUSH != tag &&
+                WSMAN_DELIVERY_MODE_PUSH_WITH_ACK != tag)
             {
                 trace_Wsman_UnsupportedDeliveryMode(mode);
                 RETURN(-1);
@@ -3396,6 +3433,7 @@ int WS_ParseSubscribeBody(
             else
             {
                 trace_Wsman_DeliveryMode(mode);
+                wssubbody->deliveryMode = (MI_Uint32)tag;
             }
         }
         else
@@ -3412,10 +3450,8 @@ int WS_ParseSubscribeBody(
 
         if (e.type == XML_END)
         {
-            int tag = HashStr(e.data.namespaceId, e.data.data, e.data.size);
-
             /* The end tag for Delivery was encountered, so jump out of the loop. */
-            if (WSMANTAG_SUBSCRIBE_DELIVER != tag)
+            if (_Tag(xml, &e) != WSMANTAG_SUBSCRIBE_DELIVER)
             {
                 trace_Wsman_UnexpectedCloseTagWithNamespace(e.data.namespaceId, e.data.data);
                 RETURN(-1);
@@ -3427,7 +3463,7 @@ int WS_ParseSubscribeBody(
         if (e.type != XML_START)
             continue;
 
-        switch (HashStr(e.data.namespaceId, e.data.data, e.data.size))
+        switch (_Tag(xml, &e))
         {
         case WSMANTAG_SUBSCRIBE_HEARTBEATS:
             {
@@ -3475,6 +3511,83 @@ int WS_ParseSubscribeBody(
            }
            break;
 
+        case WSMANTAG_SUBSCRIBE_NOTIFY_TO:
+            {
+                /* Endpoint reference; only the address is used */
+                if (XML_Expect(xml, &e, XML_START, ZT('a'), ZT("Address")) != 0)
+                    RETURN(-1);
+
+                if (XML_Expect(xml, &e, XML_CHARS, 0, NULL) != 0)
+                    RETURN(-1);
+
+                if (XML_StripWhitespace(&e) != 0)
+                    RETURN(-1);
+
+                wssubbody->notifyTo = e.data.data;
+
+                if (XML_Expect(xml, &e, XML_END, ZT('a'), ZT("Address")) != 0)
+                    RETURN(-1);
+
+                /* skip reference parameters/properties */
+                for (;;)
+                {
+                    if (XML_Next(xml, &e) != 0)
+                        RETURN(-1);
+
+                    if (e.type == XML_END)
+                        break;
+
+                    if (e.type == XML_START && XML_Skip(xml) != 0)
+                        RETURN(-1);
+                }
+
+                if (_Tag(xml, &e) != WSMANTAG_SUBSCRIBE_NOTIFY_TO)
+                    RETURN(-1);
+            }
+            break;
+
+        case WSMANTAG_ENUM_MAX_ELEMENTS:
+            {
+                if (XML_Expect(xml, &e, XML_CHARS, 0, NULL) != 0)
+                    RETURN(-1);
+
+                wssubbody->maxElements = (MI_Uint32)Tcstoull(e.data.data, NULL, 10);
+
+                if (XML_Expect(xml, &e, XML_END, ZT('w'), ZT("MaxElements")) != 0)
+                    RETURN(-1);
+            }
+            break;
+
+        case WSMANTAG_SUBSCRIBE_MAX_TIME:
+            {
+                if (XML_Expect(xml, &e, XML_CHARS, 0, NULL) != 0)
+                    RETURN(-1);
+
+                if (XML_StripWhitespace(&e) != 0)
+                    RETURN(-1);
+
+                if (-1 == ParseWSManDatetime( e.data.data, &wssubbody->maxTime.value ) )
+                    RETURN(-1);
+
+                wssubbody->maxTime.exists = MI_TRUE;
+
+                if (XML_Expect(xml, &e, XML_END, ZT('w'), ZT("MaxTime")) != 0)
+                    RETURN(-1);
+            }
+            break;
+
+        case WSMANTAG_MAX_ENVELOPE_SIZE:
+            {
+                if (XML_Expect(xml, &e, XML_CHARS, 0, NULL) != 0)
+                    RETURN(-1);
+
+                wssubbody->maxEnvelopeSize = (MI_Uint32)Tcstoull(e.data.data, NULL, 10);
+
+                if (XML_Expect(xml, &e, XML_END, ZT('w'), ZT("MaxEnvelopeSize")) != 0)
+                    RETURN(-1);
+            }
+            break;
+
         default:
             {
                 if (_MustUnderstandCanBeIgnored(&e) != 0)
@@ -3501,7 +3614,7 @@ int WS_ParseSubscribeBody(
 
         if (e.type == XML_START)
         {
-            switch (HashStr(e.data.namespaceId, e.data.data, e.data.size))
+            switch (_Tag(xml, &e))
             {
             case WSMANTAG_EXPIRES:
                 {
@@ -3593,8 +3706,7 @@ int WS_ParseSubscribeBody(
         else if (e.type == XML_END)
         {
             /* Expect </e:Subscribe> */
-            if (ZT('e') == e.data.namespaceId &&
-                Tcscmp(e.data.data, ZT("Subscribe")) == 0)
+            if (_Tag(xml, &e) == WSMANTAG_SUBSCRIBE)
             {
                 sequenceState = SubscribeSequence_END;
                 /* We reached the end of the subscribe body an the end of the
@@ -103,6 +103,9 @@ typedef struct _WSMAN_WSEnumeratePullBody
     const TChar* initialBookmark;   /* xs:any Initial bookmark to use for the subscription (Optional) */
 
     MI_DatetimeField connectionRetry; /* xs:duration (Optional) */
+    MI_Uint32   deliveryMode;       /* WSMAN_DELIVERY_MODE_xxx */
+    const TChar* notifyTo;          /* e:NotifyTo address (Push modes) */
+    MI_Uint32   maxEnvelopeSize;    /* per delivered message (Optional) */
 
     /* Pull-specific */
     MI_Uint32   enumerationContextID;
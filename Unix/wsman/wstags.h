@@ -56,61 +56,79 @@ enum
     WSMANTAG_SUBSCRIBE_IDENTIFIER = 43,
     WSMANTAG_SUBSCRIBE_CONTENTENCODING = 44,
     WSMANTAG_SUBSCRIBE_CONNECTION_RETRY = 45,
-    WSMANTAG_IDENTIFY = 46,
-    WSMANTAG_ENUM_PULL = 47,
-    WSMANTAG_ENUM_RELEASE = 48,
-    WSMANTAG_MAX_TIME = 49,
-    WSMANTAG_ENUM_ENUMERATE = 50,
-    WSMANTAG_PULL_MAX_ELEMENTS = 51,
-    WSMANTAG_MAX_CHARACTERS = 52,
-    WSMANTAG_PULL_ENUMERATION_CONTEXT = 53,
-    WSMANTAG_HEADER = 54,
-    WSMANTAG_ENUM_FILTER = 55,
-    WSMANTAG_OPTION = 56,
-    WSMANTAG_SELECTOR = 57,
-    WSMANTAG_OPTION_SET = 58,
-    WSMANTAG_ENUM_MAX_ELEMENTS = 59,
-    WSMANTAG_RESOURCE_URI = 60,
-    WSMANTAG_SELECTOR_SET = 61,
-    WSMANTAG_ENUM_MODE = 62,
-    WSMANTAG_MAX_ENVELOPE_SIZE = 63,
-    WSMANTAG_OPERATION_TIMEOUT = 64,
-    WSMANTAG_ENUM_OPTIMIZE_ENUMERATION = 65,
-    WSMANTAG_BOOKMARK = 66,
-    WSMANTAG_SEND_BOOKMARKS = 67,
-    WSMANTAG_CONNECTION_RETRY = 68,
-    WSMANTAG_LOCALE = 69,
-    WSMANTAG_DATA_LOCALE = 70,
-    WSMANTAG_COMPRESSION_TYPE = 71,
-    WSMANTAG_ACTION_SHELL_COMMAND = 72,
-    WSMANTAG_ACTION_SHELL_SIGNAL = 73,
-    WSMANTAG_ACTION_SHELL_RECEIVE = 74,
-    WSMANTAG_ACTION_SHELL_SEND = 75,
-    WSMANTAG_ACTION_SHELL_CONNECT = 76,
-    WSMANTAG_ACTION_SHELL_RECONNECT = 77,
-    WSMANTAG_ACTION_SHELL_DISCONNECT = 78,
-    WSMANTAG_SESSION_ID = 79,
-    WSMAN_RESOURCE_URI_SHELL = 80,
-    WSMANTAG_ACTION_GET_RESPONSE = 81,
-    WSMANTAG_ACTION_PUT_RESPONSE = 82,
-    WSMANTAG_ACTION_CREATE_RESPONSE = 83,
-    WSMANTAG_ACTION_DELETE_RESPONSE = 84,
-    WSMANTAG_RELATES_TO = 85,
-    WSMANTAG_ACTION_FAULT_ADDRESSING = 86,
-    WSMANTAG_ACTION_FAULT_ENUMERATION = 87,
-    WSMANTAG_ACTION_FAULT_EVENTING = 88,
-    WSMANTAG_ACTION_FAULT_TRANSFER = 89,
-    WSMANTAG_ACTION_FAULT_WSMAN = 90,
-    WSMANTAG_ACTION_EVENTING = 91,
-    WSMANTAG_ACTION_ENUMERATE_RESPONSE = 92,
-    WSMANTAG_ACTION_PULL_RESPONSE = 93,
-    WSMANTAG_ACTION_SHELL_COMMAND_RESPONSE = 94,
-    WSMANTAG_ACTION_SHELL_SIGNAL_RESPONSE = 95,
-    WSMANTAG_ACTION_SHELL_RECEIVE_RESPONSE = 96,
-    WSMANTAG_ACTION_SHELL_SEND_RESPONSE = 97,
-    WSMANTAG_ACTION_SHELL_CONNECT_RESPONSE = 98,
-    WSMANTAG_ACTION_SHELL_RECONNECT_RESPONSE = 99,
-    WSMANTAG_ACTION_SHELL_DISCONNECT_RESPONSE = 100
+    WSMANTAG_SUBSCRIBE_NOTIFY_TO = 46,
+    WSMANTAG_SUBSCRIBE_MAX_TIME = 47,
+    WSMANTAG_IDENTIFY = 48,
+    WSMANTAG_ENUM_PULL = 49,
+    WSMANTAG_ENUM_RELEASE = 50,
+    WSMANTAG_MAX_TIME = 51,
+    WSMANTAG_ENUM_ENUMERATE = 52,
+    WSMANTAG_PULL_MAX_ELEMENTS = 53,
+    WSMANTAG_MAX_CHARACTERS = 54,
+    WSMANTAG_PULL_ENUMERATION_CONTEXT = 55,
+    WSMANTAG_HEADER = 56,
+    WSMANTAG_ENUM_FILTER = 57,
+    WSMANTAG_OPTION = 58,
+    WSMANTAG_SELECTOR = 59,
+    WSMANTAG_OPTION_SET = 60,
+    WSMANTAG_ENUM_MAX_ELEMENTS = 61,
+    WSMANTAG_RESOURCE_URI = 62,
+    WSMANTAG_SELECTOR_SET = 63,
+    WSMANTAG_ENUM_MODE = 64,
+    WSMANTAG_MAX_ENVELOPE_SIZE = 65,
+    WSMANTAG_OPERATION_TIMEOUT = 66,
+    WSMANTAG_ENUM_OPTIMIZE_ENUMERATION = 67,
+    WSMANTAG_BOOKMARK = 68,
+    WSMANTAG_SEND_BOOKMARKS = 69,
+    WSMANTAG_CONNECTION_RETRY = 70,
+    WSMANTAG_LOCALE = 71,
+    WSMANTAG_DATA_LOCALE = 72,
+    WSMANTAG_COMPRESSION_TYPE = 73,
+    WSMANTAG_ACTION_SHELL_COMMAND = 74,
+    WSMANTAG_ACTION_SHELL_SIGNAL = 75,
+    WSMANTAG_ACTION_SHELL_RECEIVE = 76,
+    WSMANTAG_ACTION_SHELL_SEND = 77,
+    WSMANTAG_ACTION_SHELL_CONNECT = 78,
+    WSMANTAG_ACTION_SHELL_RECONNECT = 79,
+    WSMANTAG_ACTION_SHELL_DISCONNECT = 80,
+    WSMANTAG_SESSION_ID = 81,
+    WSMAN_RESOURCE_URI_SHELL = 82,
+    WSMANTAG_ACTION_GET_RESPONSE = 83,
+    WSMANTAG_ACTION_PUT_RESPONSE = 84,
+    WSMANTAG_ACTION_CREATE_RESPONSE = 85,
+    WSMANTAG_ACTION_DELETE_RESPONSE = 86,
+    WSMANTAG_RELATES_TO = 87,
+    WSMANTAG_ACTION_FAULT_ADDRESSING = 88,
+    WSMANTAG_ACTION_FAULT_ENUMERATION = 89,
+    WSMANTAG_ACTION_FAULT_EVENTING = 90,
+    WSMANTAG_ACTION_FAULT_TRANSFER = 91,
+    WSMANTAG_ACTION_FAULT_WSMAN = 92,
+    WSMANTAG_ACTION_EVENTING = 93,
+    WSMANTAG_ACTION_ENUMERATE_RESPONSE = 94,
+    WSMANTAG_ACTION_PULL_RESPONSE = 95,
+    WSMANTAG_ACTION_SHELL_COMMAND_RESPONSE = 96,
+    WSMANTAG_ACTION_SHELL_SIGNAL_RESPONSE = 97,
+    WSMANTAG_ACTION_SHELL_RECEIVE_RESPONSE = 98,
+    WSMANTAG_ACTION_SHELL_SEND_RESPONSE = 99,
+    WSMANTAG_ACTION_SHELL_CONNECT_RESPONSE = 100,
+    WSMANTAG_ACTION_SHELL_RECONNECT_RESPONSE = 101,
+    WSMANTAG_ACTION_SHELL_DISCONNECT_RESPONSE = 102,
+    WSMANTAG_ENDPOINT_REFERENCE = 103,
+    WSMANTAG_REFERENCE_PARAMETERS = 104,
+    WSMANTAG_ASSOCIATED_INSTANCES = 105,
+    WSMANTAG_ASSOCIATION_INSTANCES = 106,
+    WSMANTAG_ASSOCIATION_OBJECT = 107,
+    WSMANTAG_ASSOCIATION_CLASS_NAME = 108,
+    WSMANTAG_ASSOCIATION_ROLE = 109,
+    WSMANTAG_ASSOCIATION_RESULT_CLASS_NAME = 110,
+    WSMANTAG_ASSOCIATION_RESULT_ROLE = 111,
+    WSMANTAG_SUBSCRIBE = 112,
+    WSMANTAG_ENUM_ENUMERATE_RESPONSE = 113,
+    WSMANTAG_ENUM_PULL_RESPONSE = 114,
+    WSMANTAG_ENUM_ITEMS = 115,
+    WSMANTAG_ITEMS = 116,
+    WSMANTAG_ENUM_END_OF_SEQUENCE = 117,
+    WSMANTAG_END_OF_SEQUENCE = 118
 };
 
 #if !defined(HASHSTR_CHAR)
@@ -143,27 +143,294 @@ INLINE int _IsInner(XML_Char c)
     return 0;
 }
 
-INLINE XML_Char* _SkipInner(_In_z_ XML_Char* p)
+/*
+**==============================================================================
+**
+** Scanning
+**
+**     The tokenizer spends most of its time looking for the end of a run of
+**     characters it does not have to look at individually: character data,
+**     attribute values, whitespace and names. _Scan() finds the end of such
+**     a run. Narrow character builds on x86 check 16 characters at once with
+**     SSE2 and long runs 32 at once with AVX2 if the processor has it. The
+**     text is zero-terminated, so vector loads are aligned: an aligned load
+**     never crosses into the next page.
+**
+**==============================================================================
+*/
+
+/* Runs found by _Scan(); every run also ends at '\0' */
+typedef enum _XML_Scan
 {
-    while (*p && _IsInner(*p))
-        p++;
+    /* Character data: ends at '<' or '&' */
+    SCAN_CHARDATA,
 
-    return p;
+    /* Attribute value: ends at '"', '\'' or '&' */
+    SCAN_ATTRVALUE,
+
+    /* Whitespace: ends at anything but [\n\t\r ] */
+    SCAN_SPACES,
+
+    /* Name: ends at anything but [A-Za-z0-9_-.] (':' ends a prefix) */
+    SCAN_NAME
 }
+XML_Scan;
 
-static XML_Char* _SkipSpacesAux(_Inout_ XML* self, _In_z_ XML_Char* p)
+INLINE int _ScanEnd(XML_Char c, XML_Scan scan)
 {
-    XML_UChar x;
-    size_t n = 0;
+    switch (scan)
+    {
+        case SCAN_CHARDATA:
+            return c == '\0' || c == '<' || c == '&';
+        case SCAN_ATTRVALUE:
+            return c == '\0' || c == '"' || c == '\'' || c == '&';
+        case SCAN_SPACES:
+            return !_IsSpace(c);
+        default:
+            return !_IsInner(c);
+    }
+}
+
+#if defined(__GNUC__) && defined(__SSE2__) && !defined(CONFIG_ENABLE_WCHAR)
+# include <emmintrin.h>
+# define XML_SCAN_SSE2
+
+# if (defined(__x86_64__) || defined(__i386__)) && \
+    (defined(__clang__) || __GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+#  include <immintrin.h>
+#  define XML_SCAN_AVX2
+# endif
+#endif
+
+#if defined(XML_SCAN_SSE2)
+
+/* Returns a bit for each of 16 characters at p (16-byte aligned) that ends
+   the run; newlines are set to a bit for each '\n' */
+INLINE unsigned int _ScanMask16(
+    _In_reads_(16) const XML_Char* p,
+    XML_Scan scan,
+    _Out_ unsigned int* newlines)
+{
+    __m128i v = _mm_load_si128((const __m128i*)p);
+    __m128i nl = _mm_cmpeq_epi8(v, _mm_set1_epi8('\n'));
+    __m128i m;
+
+    *newlines = (unsigned int)_mm_movemask_epi8(nl);
+
+    switch (scan)
+    {
+        case SCAN_CHARDATA:
+            m = _mm_cmpeq_epi8(v, _mm_setzero_si128());
+            m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8('<')));
+            m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8('&')));
+            return (unsigned int)_mm_movemask_epi8(m);
+
+        case SCAN_ATTRVALUE:
+            /* '&' and '\'' (0x26/0x27) differ in the last bit only */
+            m = _mm_cmpeq_epi8(v, _mm_setzero_si128());
+            m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8('"')));
+            m = _mm_or_si128(m, _mm_cmpeq_epi8(
+                _mm_or_si128(v, _mm_set1_epi8(0x01)), _mm_set1_epi8('\'')));
+            return (unsigned int)_mm_movemask_epi8(m);
+
+        case SCAN_SPACES:
+            m = _mm_or_si128(nl, _mm_cmpeq_epi8(v, _mm_set1_epi8(' ')));
+            m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8('\t')));
+            m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8('\r')));
+            return ~(unsigned int)_mm_movemask_epi8(m) & 0xFFFF;
+
+        default:
+        {
+            /* Signed compares: characters above 0x7F are negative; lower
+               case letters also cover upper case ones with bit 0x20 set */
+            __m128i l = _mm_or_si128(v, _mm_set1_epi8(0x20));
+
+            m = _mm_and_si128(
+                _mm_cmpgt_epi8(l, _mm_set1_epi8('a' - 1)),
+                _mm_cmplt_epi8(l, _mm_set1_epi8('z' + 1)));
+            m = _mm_or_si128(m, _mm_andnot_si128(
+                _mm_cmpeq_epi8(v, _mm_set1_epi8('/')),
+                _mm_and_si128(
+                    _mm_cmpgt_epi8(v, _mm_set1_epi8('-' - 1)),
+                    _mm_cmplt_epi8(v, _mm_set1_epi8('9' + 1)))));
+            m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8('_')));
+            return ~(unsigned int)_mm_movemask_epi8(m) & 0xFFFF;
+        }
+    }
+}
+
+#endif /* defined(XML_SCAN_SSE2) */
+
+#if defined(XML_SCAN_AVX2)
+
+/* Same as _ScanMask16() for 32 characters (32-byte aligned) */
+__attribute__((target("avx2")))
+static unsigned int _ScanMask32(
+    _In_reads_(32) const XML_Char* p,
+    XML_Scan scan,
+    _Out_ unsigned int* newlines)
+{
+    __m256i v = _mm256_load_si256((const __m256i*)p);
+    __m256i nl = _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n'));
+    __m256i m;
+
+    *newlines = (unsigned int)_mm256_movemask_epi8(nl);
+
+    switch (scan)
+    {
+        case SCAN_CHARDATA:
+            m = _mm256_cmpeq_epi8(v, _mm256_setzero_si256());
+            m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('<')));
+            m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('&')));
+            return (unsigned int)_mm256_movemask_epi8(m);
+
+        case SCAN_ATTRVALUE:
+            m = _mm256_cmpeq_epi8(v, _mm256_setzero_si256());
+            m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('"')));
+            m = _mm256_or_si256(m, _mm256_cmpeq_epi8(
+                _mm256_or_si256(v, _mm256_set1_epi8(0x01)), _mm256_set1_epi8('\'')));
+            return (unsigned int)_mm256_movemask_epi8(m);
+
+        case SCAN_SPACES:
+            m = _mm256_or_si256(nl, _mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')));
+            m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\t')));
+            m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\r')));
+            return ~(unsigned int)_mm256_movemask_epi8(m);
+
+        default:
+        {
+            __m256i l = _mm256_or_si256(v, _mm256_set1_epi8(0x20));
+
+            m = _mm256_and_si256(
+                _mm256_cmpgt_epi8(l, _mm256_set1_epi8('a' - 1)),
+                _mm256_cmpgt_epi8(_mm256_set1_epi8('z' + 1), l));
+            m = _mm256_or_si256(m, _mm256_andnot_si256(
+                _mm256_cmpeq_epi8(v, _mm256_set1_epi8('/')),
+                _mm256_and_si256(
+                    _mm256_cmpgt_epi8(v, _mm256_set1_epi8('-' - 1)),
+                    _mm256_cmpgt_epi8(_mm256_set1_epi8('9' + 1), v))));
+            m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('_')));
+            return ~(unsigned int)_mm256_movemask_epi8(m);
+        }
+    }
+}
+
+/* Continues a run at p (16-byte aligned) 32 characters at a time */
+__attribute__((target("avx2")))
+static XML_Char* _ScanAVX2(
+    _In_z_ XML_Char* p,
+    XML_Scan scan,
+    _Inout_ size_t* lines)
+{
+    unsigned int mask;
+    unsigned int newlines;
+
+    if ((size_t)p & 31)
+    {
+        mask = _ScanMask16(p, scan, &newlines);
 
-    while (*p && (x = (XML_UChar)_IsSpace(*p)) != 0)
+        if (mask)
+        {
+            *lines += __builtin_popcount(newlines & (mask ^ (mask - 1)) >> 1);
+            return p + __builtin_ctz(mask);
+        }
+
+        *lines += __builtin_popcount(newlines);
+        p += 16;
+    }
+
+    for (;;)
+    {
+        mask = _ScanMask32(p, scan, &newlines);
+
+        if (mask)
+        {
+            *lines += __builtin_popcount(newlines & (mask ^ (mask - 1)) >> 1);
+            return p + __builtin_ctz(mask);
+        }
+
+        *lines += __builtin_popcount(newlines);
+        p += 32;
+    }
+}
+
+/* Checked once; a race only repeats the check */
+static int _HaveAVX2()
+{
+    static int s_haveAVX2 = -1;
+
+    if (s_haveAVX2 < 0)
+        s_haveAVX2 = __builtin_cpu_supports("avx2") ? 1 : 0;
+
+    return s_haveAVX2;
+}
+
+#endif /* defined(XML_SCAN_AVX2) */
+
+/* Returns the end of the run starting at p; newlines are added to lines */
+INLINE XML_Char* _Scan(
+    _In_z_ XML_Char* p,
+    XML_Scan scan,
+    _Inout_ size_t* lines)
+{
+#if defined(XML_SCAN_SSE2)
+    unsigned int mask;
+    unsigned int newlines;
+
+    /* Short runs usually end before the first aligned block */
+    while ((size_t)p & 15)
     {
-        n += 0x01 & x;
+        if (_ScanEnd(*p, scan))
+            return p;
+
+        if (*p == '\n')
+            (*lines)++;
+
+        p++;
+    }
+
+    for (;;)
+    {
+        mask = _ScanMask16(p, scan, &newlines);
+
+        if (mask)
+        {
+            /* newlines before the end of the run */
+            *lines += __builtin_popcount(newlines & (mask ^ (mask - 1)) >> 1);
+            return p + __builtin_ctz(mask);
+        }
+
+        *lines += __builtin_popcount(newlines);
+        p += 16;
+
+# if defined(XML_SCAN_AVX2)
+        /* The run is long: continue with wider blocks if possible */
+        if (_HaveAVX2())
+            return _ScanAVX2(p, scan, lines);
+# endif
+    }
+#else
+    while (!_ScanEnd(*p, scan))
+    {
+        if (*p == '\n')
+            (*lines)++;
+
         p++;
     }
 
-    self->line += n;
     return p;
+#endif
+}
+
+INLINE XML_Char* _SkipInner(_In_z_ XML_Char* p)
+{
+    size_t lines = 0;
+    return _Scan(p, SCAN_NAME, &lines);
+}
+
+static XML_Char* _SkipSpacesAux(_Inout_ XML* self, _In_z_ XML_Char* p)
+{
+    return _Scan(p, SCAN_SPACES, &self->line);
 }
 
 INLINE XML_Char* _SkipSpaces(_Inout_ XML* self, _In_z_ XML_Char* p)
@@ -281,29 +548,6 @@ INLINE XML_Char* _ToRef(_Inout_ XML* self, _In_z_ XML_Char* p, _Out_ XML_Char* c
         return _ToEntityRef(self, p, ch);
 }
 
-/* Matches all but '\0', '\'', '"', and '&'. All matching charcters
- * yeild 2, except for '\n', which yields 1 
- */
-static const unsigned char _ReduceAttrValueMatchChars[256] =
-{
-    0,1,1,1,1,1,1,1,1,1,0,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,
-    1,1,0,1,1,1,0,0,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,
-    1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,
-    1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,
-    1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,
-    1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,
-    1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,
-    1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,
-};
-
-INLINE int _ReduceAttrValueMatch(XML_Char c)
-{
-    int i = (int) c;
-    if (i >= 0 && i< 256)
-        return _ReduceAttrValueMatchChars[i];
-    return 0;
-}
-
 /* Reduce entity references and remove leading and trailing whitespace */
 static XML_Char* _ReduceAttrValue(_Inout_ XML* self, _Inout_ XMLCharPtr* pInOut, XML_Char eos)
 {
@@ -314,22 +558,8 @@ static XML_Char* _ReduceAttrValue(_Inout_ XML* self, _Inout_ XMLCharPtr* pInOut,
     if (!p)
         return NULL;
 
-    while (*p)
-    {
-        if (_ReduceAttrValueMatch(*p))
-        {
-            p++;
-        }
-        else
-        {
-            if (*p == '\0' || *p != '\n')
-                break;
-
-            self->line++;
-            p++;
-        }
-    }
-
+    /* Nothing has to be moved before the first reference */
+    p = _Scan(p, SCAN_ATTRVALUE, &n);
     end = p;
 
     while (*p && *p != eos)
@@ -353,10 +583,16 @@ static XML_Char* _ReduceAttrValue(_Inout_ XML* self, _Inout_ XMLCharPtr* pInOut,
         }
         else
         {
+            /* Move up to the next reference or quote */
+            XML_Char* q;
+
             if (*p == '\n')
                 n++;
 
-            *end++ = *p++;
+            q = _Scan(p + 1, SCAN_ATTRVALUE, &n);
+            memmove(end, p, (q - p) * sizeof(XML_Char));
+            end += q - p;
+            p = q;
         }
     }
 
@@ -366,27 +602,6 @@ static XML_Char* _ReduceAttrValue(_Inout_ XML* self, _Inout_ XMLCharPtr* pInOut,
     return end;
 }
 
-/* Match all but these: '\0', '<', '&', '\n' */
-static const unsigned char _ReduceCharDataMatchChars[256] =
-{
-    0,1,1,1,1,1,1,1,1,1,0,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,
-    1,1,1,1,1,1,0,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,0,1,1,1,
-    1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,
-    1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,
-    1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,
-    1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,
-    1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,
-    1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,
-};
-
-INLINE int _ReduceCharDataMatch(XML_Char c)
-{
-    int i = (int) c;
-    if (i >= 0 && i< 256)
-        return _ReduceCharDataMatchChars[i];
-    return 1;
-}
-
 /* Reduce character data, advance p, and return pointer to end */
 static XML_Char* _ReduceCharData(_Inout_ XML* self, _Inout_ XMLCharPtr* pInOut)
 {
@@ -397,22 +612,7 @@ static XML_Char* _ReduceCharData(_Inout_ XML* self, _Inout_ XMLCharPtr* pInOut)
     if (!p)
         return NULL;
 
-    while (*p)
-    {
-        if (_ReduceCharDataMatch(*p))
-        {
-            p++;
-        }
-        else
-        {
-            if (!*p || *p != '\n')
-                break;
-
-            self->line++;
-            p++;
-        }
-    }
-
+    p = _Scan(p, SCAN_CHARDATA, &self->line);
     end = p;
 
     /* Can we return now? */
@@ -450,17 +650,12 @@ static XML_Char* _ReduceCharData(_Inout_ XML* self, _Inout_ XMLCharPtr* pInOut)
         }
         else
         {
-            for (;;)
-            {
-                while ((_ReduceCharDataMatch(*p)))
-                    *end++ = *p++;
-
-                if (*p != '\n')
-                    break;
+            /* Move up to the next reference or tag */
+            XML_Char* q = _Scan(p, SCAN_CHARDATA, &self->line);
 
-                *end++ = *p++;
-                self->line++;
-            }
+            memmove(end, p, (q - p) * sizeof(XML_Char));
+            end += q - p;
+            p = q;
         }
     }
 
@@ -850,6 +1045,16 @@ static void _ParseProcessingInstruction(
         self->state = STATE_START;
 }
 
+/* Sets the tag ID of a start or end tag once its name is zero-terminated */
+INLINE void _SetTag(_In_ XML* self, _Inout_ XML_Elem* elem)
+{
+    if (self->tagHash)
+    {
+        elem->tag = self->tagHash(
+            elem->data.namespaceId, elem->data.data, elem->data.size);
+    }
+}
+
 static void _ParseStartTag(
     _Inout_ XML* self, 
     _Inout_ XML_Elem* elem, 
@@ -965,6 +1170,7 @@ static void _ParseStartTag(
 
         /* Null-terminate the tag */
         *nameEnd = '\0';
+        _SetTag(self, elem);
 
         /* Inject an empty tag onto element stack */
         {
@@ -1011,6 +1217,7 @@ static void _ParseStartTag(
 
     /* Zero-terminate the name tag */
     *nameEnd = '\0';
+    _SetTag(self, elem);
 
     /* Push opening tag */
     {
@@ -1123,6 +1330,7 @@ static void _ParseEndTag(
     elem->data.namespaceUri = ns->uri;
     elem->data.namespaceUriSize = ns->uriSize;
     elem->data.namespaceId = ns->id;
+    _SetTag(self, elem);
 
     /* Match opening name */
     {
@@ -1429,6 +1637,22 @@ void XML_SetText(
     self->ptr = text;
     self->line = 1;
     self->state = STATE_START;
+    self->end = NULL;
+    self->nextText = NULL;
+    self->nextTextData = NULL;
+}
+
+void XML_SetTextPieces(
+    _Inout_ XML* self,
+    _In_z_ XML_Char* text,
+    size_t size,
+    _In_ XML_NextText nextText,
+    _In_opt_ void* data)
+{
+    XML_SetText(self, text);
+    self->end = text + size;
+    self->nextText = nextText;
+    self->nextTextData = data;
 }
 
 int GetNextSkipCharsAndComments(XML *xml, XML_Elem *e)
@@ -1472,9 +1696,26 @@ int XML_Next(
     }
 
     elem->attrsSize = 0;
+    elem->tag = 0;
 
     for (;;)
     {
+        /* Pieces end right after a tag, so move on between states */
+        while (self->ptr == self->end && self->nextText)
+        {
+            size_t size = 0;
+            XML_Char* text = self->nextText(self->nextTextData, &size);
+
+            if (!text)
+            {
+                self->nextText = NULL;
+                break;
+            }
+
+            self->ptr = text;
+            self->end = text + size;
+        }
+
         switch (self->state)
         {
             case STATE_START:
@@ -1677,6 +1918,13 @@ int XML_PutBack(
     return 0;
 }
 
+void XML_SetTagHash(
+    _Inout_ XML* self,
+    _In_opt_ XML_TagHash tagHash)
+{
+    self->tagHash = tagHash;
+}
+
 #if defined(_MSC_VER)
 void XML_Raise(_Inout_ XML* self, unsigned formatStringId, ...)
 {
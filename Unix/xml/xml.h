@@ -129,6 +129,19 @@ typedef enum _XML_Type
 }
 XML_Type;
 
+/* Maps the zero-terminated name of a tag in the given namespace to a tag
+   ID (for example a generated perfect hash); returns 0 for unknown names */
+typedef int (*XML_TagHash)(
+    XML_Char nsId,
+    _In_reads_z_(size) const XML_Char* name,
+    size_t size);
+
+/* Returns the zero-terminated piece of a document that follows the one
+   being parsed (and its size), or NULL after the last piece */
+typedef XML_Char* (*XML_NextText)(
+    void* data,
+    _Out_ size_t* size);
+
 /* Represents one XML element */
 typedef struct _XML_Elem
 {
@@ -138,6 +151,9 @@ typedef struct _XML_Elem
     /* Tag or character data */
     XML_Name data;
 
+    /* Tag ID of start and end tags (see XML_SetTagHash); 0 otherwise */
+    int tag;
+
     /* Attributes */
     XML_Attr attrs[XML_MAX_ATTRIBUTES];
     size_t attrsSize;
@@ -196,6 +212,16 @@ typedef struct _XML
 
     /* Whether XML root element has been encountered */
     int foundRoot;
+
+    /* Computes XML_Elem.tag; optional */
+    XML_TagHash tagHash;
+
+    /* End of the current piece of a document given in pieces */
+    XML_Char* end;
+
+    /* Gets the next piece; optional */
+    XML_NextText nextText;
+    void* nextTextData;
 }
 XML;
 
@@ -206,6 +232,18 @@ void XML_SetText(
     _Inout_ XML* self,
     _In_z_ XML_Char* text);
 
+/* Same as XML_SetText() for a document given in pieces: 'text' is the
+   first one ('size' characters) and nextText() returns the others. Pieces
+   may only be split right after a start or end tag (see
+   XML_Reader_Offset()); pointers into every piece parsed so far stay in
+   use until parsing is done */
+void XML_SetTextPieces(
+    _Inout_ XML* self,
+    _In_z_ XML_Char* text,
+    size_t size,
+    _In_ XML_NextText nextText,
+    _In_opt_ void* data);
+
 int XML_Next(
     _Inout_ XML* self,
     _Out_ XML_Elem* elem);
@@ -233,6 +271,13 @@ int XML_PutBack(
     _Inout_ XML* self,
     _In_ const XML_Elem* elem);
 
+/* Start and end tags returned from now on carry the tag ID computed by
+   tagHash, so callers can switch on XML_Elem.tag instead of comparing
+   names */
+void XML_SetTagHash(
+    _Inout_ XML* self,
+    _In_opt_ XML_TagHash tagHash);
+
 int XML_StripWhitespace(
     _Inout_ XML_Elem* elem);
 
@@ -284,6 +329,7 @@ void XML_Raise(_Inout_ XML* self, unsigned formatStringId, ...);
 #define XML_ERROR_SPECIFIC_ELEMENT_EXPECTED ZT("Failed to parse XML. The element name %T was expected but %T was found instead.")
 #define XML_ERROR_SPECIFIC_END_ELEMENT_EXPECTED ZT("Failed to parse XML. The element name %T end tag was expected but %T was found instead.")
 #define XML_ERROR_CHARACTER_DATA_EXPECTED ZT("Failed to parse XML. Character data was expected but not found.")
+#define XML_ERROR_OUT_OF_MEMORY ZT("Failed to parse XML. Out of memory.")
 
 #define WSMAN_ERROR_NO_CLASS_NAME_IN_SELECTOR ZT("Failed to process WS-Management packet. The class name was not found in the selector.")
 #define WSMAN_ERROR_NO_RESOURCE_URI ZT("Failed to process WS-Management packet. The resource URI was not found.")
@@ -0,0 +1,1155 @@
+/*
+**==============================================================================
+**
+** Copyright (c) Microsoft Corporation. All rights reserved. See file LICENSE
+** for license information.
+**
+**==============================================================================
+*/
+
+#include <common.h>
+#include "xmlreader.h"
+#include <string.h>
+#include <stdarg.h>
+#include <pal/format.h>
+
+#if defined(CONFIG_ENABLE_WCHAR)
+# define T(STR) L##STR
+# define XML_strcmp wcscmp
+# define XML_strlen wcslen
+#else
+# define T(STR) STR
+# define XML_strcmp strcmp
+# define XML_strlen strlen
+#endif
+
+/*
+**==============================================================================
+**
+** Local definitions
+**
+**==============================================================================
+*/
+
+typedef enum _XML_ReaderState
+{
+    /* Before the root element */
+    READER_PROLOG,
+
+    /* Inside the root element */
+    READER_CONTENT,
+
+    /* After a '<' (markup that is not complete yet) */
+    READER_PROLOG_TAG,
+    READER_CONTENT_TAG
+}
+XML_ReaderState;
+
+/* Open element */
+typedef struct _XML_ReaderScope
+{
+    /* Qualified name (offset in names) */
+    size_t name;
+    size_t nameSize;
+
+    /* Size of the prefix of the qualified name; 0 if none */
+    size_t prefixSize;
+
+    /* Sizes of names and nameSpaces when the element was opened */
+    size_t namesSize;
+    size_t nameSpacesSize;
+}
+XML_ReaderScope;
+
+/* Namespace declaration */
+typedef struct _XML_ReaderNameSpace
+{
+    /* Prefix and URI (offsets in names) */
+    size_t prefix;
+    size_t prefixSize;
+    size_t uri;
+    size_t uriSize;
+
+    /* Single character namespace name expected by client */
+    XML_Char id;
+}
+XML_ReaderNameSpace;
+
+#define XML_NS T("http://www.w3.org/XML/1998/namespace")
+#define XMLNS_NS T("http://www.w3.org/2000/xmlns/")
+
+/* Matches XML name characters of the form: [A-Za-z_][A-Za-z0-9_-.]* */
+INLINE int _IsFirst(XML_Char c)
+{
+    return (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || c == '_';
+}
+
+INLINE int _IsInner(XML_Char c)
+{
+    return _IsFirst(c) || (c >= '0' && c <= '9') || c == '-' || c == '.';
+}
+
+INLINE int _IsSpace(XML_Char c)
+{
+    return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+}
+
+INLINE XML_Char* _SkipSpaces(XML_Char* p, const XML_Char* end)
+{
+    while (p != end && _IsSpace(*p))
+        p++;
+
+    return p;
+}
+
+/* Skips prefix:name or name */
+INLINE XML_Char* _SkipName(XML_Char* p, const XML_Char* end, XML_Char** colon)
+{
+    *colon = NULL;
+
+    while (p != end && _IsInner(*p))
+        p++;
+
+    if (p != end && *p == ':')
+    {
+        *colon = p++;
+
+        while (p != end && _IsInner(*p))
+            p++;
+    }
+
+    return p;
+}
+
+static int _Raise(_Inout_ XML_Reader* self, _In_z_ const XML_Char* format, ...)
+{
+    va_list ap;
+
+    self->status = -1;
+    self->message[0] = '\0';
+
+    memset(&ap, 0, sizeof(ap));
+    va_start(ap, format);
+    Vstprintf(self->message, MI_COUNT(self->message), format, ap);
+    va_end(ap);
+
+    return -1;
+}
+
+/* Item is not complete: more data is needed unless this is all */
+static int _More(_Inout_ XML_Reader* self, _In_z_ const XML_Char* error)
+{
+    if (self->last)
+        return _Raise(self, error);
+
+    return XML_READER_MORE;
+}
+
+/* Grows an array to hold at least 'needed' items */
+static int _Reserve(
+    _Inout_ XML_Reader* self,
+    _Inout_ void** data,
+    _Inout_ size_t* capacity,
+    size_t needed,
+    size_t itemSize)
+{
+    size_t n = *capacity ? *capacity : 16;
+    void* p;
+
+    if (needed <= *capacity)
+        return 0;
+
+    while (n < needed && n <= (size_t)-1 / 2 / itemSize)
+        n *= 2;
+
+    if (n < needed)
+        return _Raise(self, XML_ERROR_OUT_OF_MEMORY);
+
+    p = PAL_Realloc(*data, n * itemSize);
+
+    if (!p)
+        return _Raise(self, XML_ERROR_OUT_OF_MEMORY);
+
+    *data = p;
+    *capacity = n;
+    return 0;
+}
+
+/* Copies a string to names; returns its offset there */
+static int _PushName(
+    _Inout_ XML_Reader* self,
+    _In_reads_(size) const XML_Char* s,
+    size_t size,
+    _Out_ size_t* offset)
+{
+    if (_Reserve(self, (void**)&self->names, &self->namesCapacity,
+        self->namesSize + size + 1, sizeof(XML_Char)) != 0)
+        return -1;
+
+    memcpy(self->names + self->namesSize, s, size * sizeof(XML_Char));
+    self->names[self->namesSize + size] = '\0';
+    *offset = self->namesSize;
+    self->namesSize += size + 1;
+    return 0;
+}
+
+static XML_Char _FindNameSpaceID(
+    _In_ XML_Reader* self,
+    _In_z_ const XML_Char* uri)
+{
+    size_t i;
+
+    for (i = 0; i < self->registeredNameSpacesSize; i++)
+    {
+        if (XML_strcmp(self->registeredNameSpaces[i].uri, uri) == 0)
+            return self->registeredNameSpaces[i].id;
+    }
+
+    return '\0';
+}
+
+/* Resolves a namespace prefix (empty for the default namespace) */
+static int _FindNameSpace(
+    _Inout_ XML_Reader* self,
+    _In_reads_(size) const XML_Char* prefix,
+    size_t size,
+    _Out_ XML_Name* name)
+{
+    size_t i;
+
+    name->namespaceUri = T("");
+    name->namespaceUriSize = 0;
+    name->namespaceId = '\0';
+
+    /* The 'xml' and 'xmlns' namespaces are fixed */
+    if (size == 3 && memcmp(prefix, T("xml"), 3 * sizeof(XML_Char)) == 0)
+    {
+        name->namespaceUri = XML_NS;
+        name->namespaceUriSize = XML_strlen(XML_NS);
+        return 0;
+    }
+
+    if (size == 5 && memcmp(prefix, T("xmlns"), 5 * sizeof(XML_Char)) == 0)
+    {
+        name->namespaceUri = XMLNS_NS;
+        name->namespaceUriSize = XML_strlen(XMLNS_NS);
+        return 0;
+    }
+
+    for (i = self->nameSpacesSize; i--; )
+    {
+        const XML_ReaderNameSpace* ns = &self->nameSpaces[i];
+
+        if (ns->prefixSize == size &&
+            memcmp(self->names + ns->prefix, prefix, size * sizeof(XML_Char)) == 0)
+        {
+            name->namespaceUri = self->names + ns->uri;
+            name->namespaceUriSize = ns->uriSize;
+            name->namespaceId = ns->id;
+            return 0;
+        }
+    }
+
+    /* An unmapped empty prefix means there is no namespace */
+    if (size)
+    {
+        XML_Char tmp[64];
+
+        if (size >= MI_COUNT(tmp))
+            size = MI_COUNT(tmp) - 1;
+
+        memcpy(tmp, prefix, size * sizeof(XML_Char));
+        tmp[size] = '\0';
+        return _Raise(self, XML_ERROR_UNDEFINED_NAMESPACE_PREFIX, tcs(tmp));
+    }
+
+    return 0;
+}
+
+/* Replaces a character or entity reference by the character */
+static int _ReduceRef(
+    _Inout_ XML_Reader* self,
+    _In_reads_(end - p) const XML_Char* p,
+    _In_ const XML_Char* end,
+    _Out_ XML_Char* ch)
+{
+    size_t n = end - p;
+
+    *ch = '\0';
+
+    if (n && *p == '#')
+    {
+        unsigned long x = 0;
+        unsigned int base = 10;
+
+        p++;
+
+        if (p != end && *p == 'x')
+        {
+            base = 16;
+            p++;
+        }
+
+        if (p == end)
+            return _Raise(self, XML_ERROR_BAD_CHARACTER_REFERENCE);
+
+        for (; p != end; p++)
+        {
+            unsigned int digit;
+
+            if (*p >= '0' && *p <= '9')
+                digit = *p - '0';
+            else if (base == 16 && *p >= 'a' && *p <= 'f')
+                digit = *p - 'a' + 10;
+            else if (base == 16 && *p >= 'A' && *p <= 'F')
+                digit = *p - 'A' + 10;
+            else
+                return _Raise(self, XML_ERROR_BAD_CHARACTER_REFERENCE);
+
+            x = x * base + digit;
+
+            if (x > 255)
+                return _Raise(self, XML_ERROR_BAD_CHARACTER_REFERENCE);
+        }
+
+        *ch = (XML_Char)x;
+        return 0;
+    }
+
+    if (n == 4 && memcmp(p, T("quot"), 4 * sizeof(XML_Char)) == 0)
+        *ch = '"';
+    else if (n == 4 && memcmp(p, T("apos"), 4 * sizeof(XML_Char)) == 0)
+        *ch = '\'';
+    else if (n == 2 && p[0] == 'l' && p[1] == 't')
+        *ch = '<';
+    else if (n == 2 && p[0] == 'g' && p[1] == 't')
+        *ch = '>';
+    else if (n == 3 && memcmp(p, T("amp"), 3 * sizeof(XML_Char)) == 0)
+        *ch = '&';
+    else
+        return _Raise(self, XML_ERROR_BAD_ENTITY_REFERENCE);
+
+    return 0;
+}
+
+/* Reduces references in [p, end) in place; returns the new end or NULL */
+static XML_Char* _ReduceRefs(
+    _Inout_ XML_Reader* self,
+    _Inout_updates_(end - p) XML_Char* p,
+    _In_ XML_Char* end)
+{
+    XML_Char* out;
+
+    while (p != end && *p != '&')
+        p++;
+
+    out = p;
+
+    while (p != end)
+    {
+        if (*p == '&')
+        {
+            XML_Char* semi = p + 1;
+
+            while (semi != end && *semi != ';')
+                semi++;
+
+            if (semi == end)
+            {
+                _Raise(self, XML_ERROR_BAD_ENTITY_REFERENCE);
+                return NULL;
+            }
+
+            if (_ReduceRef(self, p + 1, semi, out) != 0)
+                return NULL;
+
+            out++;
+            p = semi + 1;
+        }
+        else
+        {
+            *out++ = *p++;
+        }
+    }
+
+    return out;
+}
+
+static int _PushScope(
+    _Inout_ XML_Reader* self,
+    _In_reads_(size) const XML_Char* name,
+    size_t size,
+    size_t prefixSize)
+{
+    XML_ReaderScope* scope;
+    size_t namesSize = self->namesSize;
+    size_t offset;
+
+    if (_Reserve(self, (void**)&self->scopes, &self->scopesCapacity,
+        self->scopesSize + 1, sizeof(XML_ReaderScope)) != 0)
+        return -1;
+
+    if (_PushName(self, name, size, &offset) != 0)
+        return -1;
+
+    scope = &self->scopes[self->scopesSize++];
+    scope->name = offset;
+    scope->nameSize = size;
+    scope->prefixSize = prefixSize;
+    scope->namesSize = namesSize;
+    scope->nameSpacesSize = self->nameSpacesSize;
+    return 0;
+}
+
+static void _PopScope(
+    _Inout_ XML_Reader* self)
+{
+    XML_ReaderScope* scope = &self->scopes[--self->scopesSize];
+
+    self->namesSize = scope->namesSize;
+    self->nameSpacesSize = scope->nameSpacesSize;
+}
+
+/* Gets the name of the innermost open element */
+static int _ScopeName(
+    _Inout_ XML_Reader* self,
+    _Out_ XML_Name* name)
+{
+    const XML_ReaderScope* scope = &self->scopes[self->scopesSize - 1];
+    size_t skip = scope->prefixSize ? scope->prefixSize + 1 : 0;
+
+    if (_FindNameSpace(self, self->names + scope->name, scope->prefixSize,
+        name) != 0)
+        return -1;
+
+    name->data = self->names + scope->name + skip;
+    name->size = scope->nameSize - skip;
+    return 0;
+}
+
+/* Returns the end of the innermost open element */
+static int _EndElement(
+    _Inout_ XML_Reader* self,
+    _Out_ XML_ReaderElem* elem)
+{
+    if (_ScopeName(self, &elem->data) != 0)
+        return -1;
+
+    elem->type = XML_END;
+    elem->attrs = NULL;
+    elem->attrsSize = 0;
+
+    self->popScope = 1;
+    return 0;
+}
+
+/* Parses name="value"; p is at the name */
+static int _ParseAttr(
+    _Inout_ XML_Reader* self,
+    _Inout_ XML_Char** pInOut,
+    _In_ XML_Char* end)
+{
+    XML_Char* p = *pInOut;
+    XML_Char* name = p;
+    XML_Char* nameEnd;
+    XML_Char* colon;
+    XML_Char* value;
+    XML_Char* valueEnd;
+    XML_Char quote;
+    XML_Attr* attr;
+
+    if (!_IsFirst(*p))
+        return _Raise(self, XML_ERROR_EXPECTED_ATTRIBUTE_NAME);
+
+    nameEnd = p = _SkipName(p + 1, end, &colon);
+    p = _SkipSpaces(p, end);
+
+    if (p == end || *p != '=')
+    {
+        *nameEnd = '\0';
+        return _Raise(self, XML_ERROR_EXPECTED_ATTRIBUTE_EQUALS, tcs(name));
+    }
+
+    /* Null-terminate name now that we are beyond the '=' */
+    *nameEnd = '\0';
+    p = _SkipSpaces(p + 1, end);
+
+    if (p == end || (*p != '"' && *p != '\''))
+        return _Raise(self, XML_ERROR_EXPECTED_ATTRIBUTE_OPENING_QUOTES, tcs(name));
+
+    quote = *p++;
+    value = p;
+
+    while (p != end && *p != quote)
+        p++;
+
+    if (p == end)
+        return _Raise(self, XML_ERROR_EXPECTED_ATTRIBUTE_CLOSING_QUOTES, tcs(name));
+
+    valueEnd = _ReduceRefs(self, value, p);
+
+    if (!valueEnd)
+        return -1;
+
+    *valueEnd = '\0';
+    p++;
+
+    if (_Reserve(self, (void**)&self->attrs, &self->attrsCapacity,
+        self->attrsSize + 1, sizeof(XML_Attr)) != 0)
+        return -1;
+
+    attr = &self->attrs[self->attrsSize++];
+
+    /* Save the namespace prefix, which is translated by the caller */
+    if (colon)
+    {
+        *colon = '\0';
+        attr->name.data = colon + 1;
+        attr->name.namespaceUri = name;
+    }
+    else
+    {
+        attr->name.data = name;
+        attr->name.namespaceUri = T("");
+    }
+
+    attr->name.size = nameEnd - attr->name.data;
+    attr->value = value;
+    attr->valueSize = valueEnd - value;
+
+    *pInOut = p;
+    return 0;
+}
+
+/* Whether [p, end) starts with s: 1 if so, 0 if not, -1 if undecided */
+static int _StartsWith(
+    _In_reads_(end - p) const XML_Char* p,
+    _In_ const XML_Char* end,
+    _In_z_ const XML_Char* s)
+{
+    for (; *s; s++, p++)
+    {
+        if (p == end)
+            return -1;
+
+        if (*p != *s)
+            return 0;
+    }
+
+    return 1;
+}
+
+/* Finds the '>' that ends a tag; quoted values may contain '>' */
+static XML_Char* _FindTagEnd(
+    _Inout_ XML_Reader* self,
+    _In_ XML_Char* p,
+    _In_ const XML_Char* end)
+{
+    XML_Char* q = p + self->scan;
+    XML_Char quote = self->quote;
+
+    for (; q != end; q++)
+    {
+        if (quote)
+        {
+            if (*q == quote)
+                quote = '\0';
+        }
+        else if (*q == '"' || *q == '\'')
+        {
+            quote = *q;
+        }
+        else if (*q == '>')
+        {
+            self->scan = 0;
+            self->quote = '\0';
+            return q;
+        }
+    }
+
+    self->scan = end - p;
+    self->quote = quote;
+    return NULL;
+}
+
+/* Finds a terminator (such as "-->") starting at p + first */
+static XML_Char* _FindTerminator(
+    _Inout_ XML_Reader* self,
+    _In_ XML_Char* p,
+    _In_ const XML_Char* end,
+    size_t first,
+    _In_z_ const XML_Char* s)
+{
+    size_t n = XML_strlen(s);
+    XML_Char* q = p + (self->scan > first ? self->scan : first);
+
+    for (; end - q >= (ptrdiff_t)n; q++)
+    {
+        if (*q == s[0] && memcmp(q, s, n * sizeof(XML_Char)) == 0)
+        {
+            self->scan = 0;
+            return q;
+        }
+    }
+
+    /* a terminator may start in the last n - 1 characters */
+    self->scan = q - p;
+    return NULL;
+}
+
+static int _ParseStartTag(
+    _Inout_ XML_Reader* self,
+    _Out_ XML_ReaderElem* elem,
+    _In_ XML_Char* p,
+    _In_ XML_Char* end)
+{
+    XML_Char* name = p;
+    XML_Char* nameEnd;
+    XML_Char* colon;
+    int empty = 0;
+    size_t i;
+
+    nameEnd = p = _SkipName(p + 1, end, &colon);
+
+    if (p != end && *p != '/' && !_IsSpace(*p))
+    {
+        *nameEnd = '\0';
+        return _Raise(self, XML_ERROR_ELEMENT_NAME_NOT_CLOSED, tcs(name));
+    }
+
+    if (_PushScope(self, name, nameEnd - name, colon ? colon - name : 0) != 0)
+        return -1;
+
+    self->state = READER_CONTENT;
+
+    /* Process attributes */
+    self->attrsSize = 0;
+
+    for (;;)
+    {
+        p = _SkipSpaces(p, end);
+
+        if (p == end)
+            break;
+
+        if (*p == '/')
+        {
+            if (_SkipSpaces(p + 1, end) != end)
+            {
+                *nameEnd = '\0';
+                return _Raise(self, XML_ERROR_ELEMENT_NAME_NOT_CLOSED, tcs(name));
+            }
+
+            empty = 1;
+            break;
+        }
+
+        if (_ParseAttr(self, &p, end) != 0)
+            return -1;
+    }
+
+    /* Add namespace declarations: xmlns="uri" and xmlns:prefix="uri" */
+    for (i = 0; i < self->attrsSize; i++)
+    {
+        XML_Attr* attr = &self->attrs[i];
+        const XML_Char* prefix = T("");
+        XML_ReaderNameSpace* ns;
+        size_t prefixSize = 0;
+
+        if (attr->name.namespaceUri[0])
+        {
+            if (XML_strcmp(attr->name.namespaceUri, T("xmlns")) != 0)
+                continue;
+
+            prefix = attr->name.data;
+            prefixSize = attr->name.size;
+        }
+        else if (XML_strcmp(attr->name.data, T("xmlns")) == 0)
+        {
+            /* The namespace of the xmlns attribute is fixed */
+            attr->name.namespaceUri = T("xmlns");
+        }
+        else
+        {
+            continue;
+        }
+
+        if (_Reserve(self, (void**)&self->nameSpaces,
+            &self->nameSpacesCapacity, self->nameSpacesSize + 1,
+            sizeof(XML_ReaderNameSpace)) != 0)
+            return -1;
+
+        ns = &self->nameSpaces[self->nameSpacesSize];
+
+        if (_PushName(self, prefix, prefixSize, &ns->prefix) != 0 ||
+            _PushName(self, attr->value, attr->valueSize, &ns->uri) != 0)
+            return -1;
+
+        ns->prefixSize = prefixSize;
+        ns->uriSize = attr->valueSize;
+        ns->id = _FindNameSpaceID(self, self->names + ns->uri);
+        self->nameSpacesSize++;
+    }
+
+    /* Translate the namespaces now that all declarations are known;
+       unprefixed attributes get an empty namespace */
+    if (_ScopeName(self, &elem->data) != 0)
+        return -1;
+
+    for (i = 0; i < self->attrsSize; i++)
+    {
+        XML_Attr* attr = &self->attrs[i];
+        const XML_Char* prefix = attr->name.namespaceUri;
+
+        if (!*prefix)
+        {
+            attr->name.namespaceUriSize = 0;
+            attr->name.namespaceId = '\0';
+            continue;
+        }
+
+        if (_FindNameSpace(self, prefix, XML_strlen(prefix), &attr->name) != 0)
+            return -1;
+    }
+
+    elem->type = XML_START;
+    elem->attrs = self->attrs;
+    elem->attrsSize = self->attrsSize;
+
+    self->emptyEnd = empty;
+    return 0;
+}
+
+static int _ParseEndTag(
+    _Inout_ XML_Reader* self,
+    _Out_ XML_ReaderElem* elem,
+    _In_ XML_Char* p,
+    _In_ XML_Char* end)
+{
+    const XML_ReaderScope* scope;
+    XML_Char* name;
+    XML_Char* nameEnd;
+    XML_Char* colon;
+
+    name = p = _SkipSpaces(p + 1, end);
+
+    if (p == end || !_IsFirst(*p))
+        return _Raise(self, XML_ERROR_ELEMENT_NAME_EXPECTED_ELEM_END);
+
+    nameEnd = p = _SkipName(p + 1, end, &colon);
+    p = _SkipSpaces(p, end);
+    *nameEnd = '\0';
+
+    if (p != end)
+        return _Raise(self, XML_ERROR_ELEMENT_NAME_NOT_CLOSED_ELEM_END, tcs(name));
+
+    if (self->scopesSize == 0)
+        return _Raise(self, XML_ERROR_ELEMENT_TOO_MANY_ENDS, tcs(name));
+
+    /* The closing name has to match the opening name as written */
+    scope = &self->scopes[self->scopesSize - 1];
+
+    if (scope->nameSize != (size_t)(nameEnd - name) ||
+        memcmp(self->names + scope->name, name,
+            scope->nameSize * sizeof(XML_Char)) != 0)
+    {
+        return _Raise(self,
+            XML_ERROR_ELEMENT_END_ELEMENT_TAG_NOT_MATCH_START_TAG,
+            tcs(self->names + scope->name), tcs(name));
+    }
+
+    return _EndElement(self, elem);
+}
+
+static int _ParseInstruction(
+    _Inout_ XML_Reader* self,
+    _Out_ XML_ReaderElem* elem,
+    _In_ XML_Char* p,
+    _In_ XML_Char* end)
+{
+    /* <?xml version="1.0" encoding="UTF-8" standalone="yes"?> */
+    XML_Char* name = p + 1;
+    XML_Char* nameEnd;
+    XML_Char* colon;
+    size_t i;
+
+    nameEnd = p = _SkipName(name, end, &colon);
+    self->attrsSize = 0;
+
+    for (;;)
+    {
+        p = _SkipSpaces(p, end);
+
+        if (p == end)
+            break;
+
+        if (_ParseAttr(self, &p, end) != 0)
+            return -1;
+    }
+
+    /* Attributes of instructions have no namespace */
+    for (i = 0; i < self->attrsSize; i++)
+    {
+        self->attrs[i].name.namespaceUri = T("");
+        self->attrs[i].name.namespaceUriSize = 0;
+        self->attrs[i].name.namespaceId = '\0';
+    }
+
+    *nameEnd = '\0';
+
+    elem->type = XML_INSTRUCTION;
+    elem->data.data = name;
+    elem->data.size = nameEnd - name;
+    elem->data.namespaceUri = T("");
+    elem->data.namespaceUriSize = 0;
+    elem->data.namespaceId = '\0';
+    elem->attrs = self->attrs;
+    elem->attrsSize = self->attrsSize;
+    return 0;
+}
+
+static void _CharsElem(
+    _Out_ XML_ReaderElem* elem,
+    XML_Type type,
+    _In_ XML_Char* data,
+    _In_ XML_Char* end)
+{
+    *end = '\0';
+    elem->type = type;
+    elem->data.data = data;
+    elem->data.size = end - data;
+    elem->data.namespaceUri = T("");
+    elem->data.namespaceUriSize = 0;
+    elem->data.namespaceId = '\0';
+    elem->attrs = NULL;
+    elem->attrsSize = 0;
+}
+
+/* Parses markup that follows a '<'; returns 1 if nothing is returned */
+static int _ParseMarkup(
+    _Inout_ XML_Reader* self,
+    _Out_ XML_ReaderElem* elem,
+    _In_ XML_Char* p,
+    _In_ XML_Char* end)
+{
+    XML_Char* q;
+    int r;
+
+    if (p == end)
+        return _More(self, XML_ERROR_ELEMENT_EXPECTED);
+
+    if (*p == '/' || _IsFirst(*p))
+    {
+        q = _FindTagEnd(self, p, end);
+
+        if (!q)
+        {
+            return _More(self, *p == '/' ?
+                XML_ERROR_ELEMENT_NAME_PREMATURE_END_ELEM_END :
+                XML_ERROR_ELEMENT_NAME_PREMATURE_END);
+        }
+
+        self->pos = q + 1 - self->text;
+
+        if (*p == '/')
+            r = _ParseEndTag(self, elem, p, q);
+        else
+            r = _ParseStartTag(self, elem, p, q);
+
+        return r;
+    }
+
+    if (*p == '?')
+    {
+        q = _FindTerminator(self, p, end, 1, T("?>"));
+
+        if (!q)
+            return _More(self, XML_ERROR_END_OF_XML_INSTRUCTION);
+
+        self->pos = q + 2 - self->text;
+        return _ParseInstruction(self, elem, p, q);
+    }
+
+    if (*p != '!')
+        return _Raise(self, XML_ERROR_ELEMENT_EXPECTED);
+
+    if ((r = _StartsWith(p, end, T("!--"))) != 0)
+    {
+        if (r < 0)
+            return _More(self, XML_ERROR_COMMENT_PREMATURE_END);
+
+        q = _FindTerminator(self, p, end, 3, T("--"));
+
+        if (!q || q + 2 == end)
+        {
+            if (q)
+                self->scan = q - p;
+
+            return _More(self, XML_ERROR_COMMENT_PREMATURE_END);
+        }
+
+        if (q[2] != '>')
+            return _Raise(self, XML_ERROR_COMMENT_END_EXPECTED);
+
+        self->pos = q + 3 - self->text;
+        _CharsElem(elem, XML_COMMENT, p + 3, q);
+        return 0;
+    }
+
+    if ((r = _StartsWith(p, end, T("![CDATA["))) != 0)
+    {
+        if (r < 0)
+            return _More(self, XML_ERROR_CDATA_PREMATURE_END);
+
+        q = _FindTerminator(self, p, end, 8, T("]]>"));
+
+        if (!q)
+            return _More(self, XML_ERROR_CDATA_PREMATURE_END);
+
+        self->pos = q + 3 - self->text;
+        _CharsElem(elem, XML_CHARS, p + 8, q);
+        return 0;
+    }
+
+    if ((r = _StartsWith(p, end, T("!DOCTYPE"))) != 0)
+    {
+        if (r < 0)
+            return _More(self, XML_ERROR_DOCTYPE_PREMATURE_END);
+
+        q = _FindTerminator(self, p, end, 8, T(">"));
+
+        if (!q)
+            return _More(self, XML_ERROR_DOCTYPE_PREMATURE_END);
+
+        /* Skipped */
+        self->pos = q + 1 - self->text;
+        return 1;
+    }
+
+    if (end - p < 8)
+        return _More(self, XML_ERROR_COMMENT_CDATA_DOCTYPE_EXPECTED);
+
+    return _Raise(self, XML_ERROR_COMMENT_CDATA_DOCTYPE_EXPECTED);
+}
+
+/*
+**==============================================================================
+**
+** Public definitions
+**
+**==============================================================================
+*/
+
+void XML_Reader_Init(
+    _Out_ XML_Reader* self)
+{
+    memset(self, 0, sizeof(XML_Reader));
+    self->state = READER_PROLOG;
+}
+
+void XML_Reader_Destroy(
+    _Inout_ XML_Reader* self)
+{
+    PAL_Free(self->text);
+    PAL_Free(self->scopes);
+    PAL_Free(self->names);
+    PAL_Free(self->nameSpaces);
+    PAL_Free(self->attrs);
+    memset(self, 0, sizeof(XML_Reader));
+}
+
+int XML_Reader_RegisterNameSpace(
+    _Inout_ XML_Reader* self,
+    XML_Char id,
+    _In_z_ const XML_Char* uri)
+{
+    XML_RegisteredNameSpace* rns;
+
+    /* Reject out of range ids */
+    if (id < 'a' || id > 'z')
+        return -1;
+
+    if (self->registeredNameSpacesSize == XML_MAX_REGISTERED_NAMESPACES)
+        return -1;
+
+    rns = &self->registeredNameSpaces[self->registeredNameSpacesSize++];
+    rns->id = id;
+    rns->uri = uri;
+    rns->uriCode = 0;
+    return 0;
+}
+
+int XML_Reader_Feed(
+    _Inout_ XML_Reader* self,
+    _In_reads_(size) const XML_Char* data,
+    size_t size,
+    int last)
+{
+    size_t left = self->textSize - self->pos;
+
+    if (self->status == -1)
+        return -1;
+
+    if (self->last && size)
+        return _Raise(self, XML_ERROR_UNEXPECTED_STATE);
+
+    /* Move what is not consumed yet to the front */
+    if (self->pos)
+    {
+        memmove(self->text, self->text + self->pos, left * sizeof(XML_Char));
+        self->textSize = left;
+        self->offset += self->pos;
+        self->pos = 0;
+    }
+
+    if (_Reserve(self, (void**)&self->text, &self->textCapacity,
+        left + size + 1, sizeof(XML_Char)) != 0)
+        return -1;
+
+    if (size)
+        memcpy(self->text + left, data, size * sizeof(XML_Char));
+
+    self->textSize = left + size;
+    self->text[self->textSize] = '\0';
+
+    if (last)
+        self->last = 1;
+
+    return 0;
+}
+
+int XML_Reader_Next(
+    _Inout_ XML_Reader* self,
+    _Out_ XML_ReaderElem* elem)
+{
+    if (self->status)
+        return self->status;
+
+    if (self->popScope)
+    {
+        _PopScope(self);
+        self->popScope = 0;
+    }
+
+    if (self->emptyEnd)
+    {
+        self->emptyEnd = 0;
+        return _EndElement(self, elem);
+    }
+
+    if (!self->text)
+        return _More(self, XML_ERROR_OPEN_ANGLE_BRACKET_EXPECTED);
+
+    for (;;)
+    {
+        XML_Char* p = self->text + self->pos;
+        XML_Char* end = self->text + self->textSize;
+        int r;
+
+        switch (self->state)
+        {
+            case READER_PROLOG:
+            {
+                p = _SkipSpaces(p, end);
+                self->pos = p - self->text;
+
+                if (p == end)
+                    return _More(self, XML_ERROR_OPEN_ANGLE_BRACKET_EXPECTED);
+
+                if (*p != '<')
+                    return _Raise(self, XML_ERROR_OPEN_ANGLE_BRACKET_EXPECTED);
+
+                self->pos++;
+                self->state = READER_PROLOG_TAG;
+                break;
+            }
+            case READER_CONTENT:
+            {
+                XML_Char* lt;
+                XML_Char* dataEnd;
+
+                /* Finished parsing document once the root is closed */
+                if (self->scopesSize == 0)
+                {
+                    self->status = 1;
+                    return 1;
+                }
+
+                for (lt = p + self->scan; lt != end && *lt != '<'; lt++)
+                    ;
+
+                if (lt == end)
+                {
+                    self->scan = end - p;
+                    return _More(self,
+                        XML_ERROR_CHARDATA_EXPECTED_ELEMENT_END_TAG);
+                }
+
+                self->scan = 0;
+                self->pos = lt + 1 - self->text;
+                self->state = READER_CONTENT_TAG;
+
+                /* Return character data element if non-empty */
+                if (lt == p)
+                    break;
+
+                dataEnd = _ReduceRefs(self, p, lt);
+
+                if (!dataEnd)
+                    return -1;
+
+                _CharsElem(elem, XML_CHARS, p, dataEnd);
+                return 0;
+            }
+            case READER_PROLOG_TAG:
+            case READER_CONTENT_TAG:
+            {
+                int tagState = self->state;
+
+                r = _ParseMarkup(self, elem, p, end);
+
+                if (r == XML_READER_MORE || r == -1)
+                    return r;
+
+                /* a start tag moves on to the content */
+                if (self->state == tagState)
+                {
+                    self->state = tagState == READER_PROLOG_TAG ?
+                        READER_PROLOG : READER_CONTENT;
+                }
+
+                if (r == 0)
+                    return 0;
+
+                break;
+            }
+            default:
+            {
+                return _Raise(self, XML_ERROR_UNEXPECTED_STATE);
+            }
+        }
+    }
+}
+
+size_t XML_Reader_Offset(
+    _In_ const XML_Reader* self)
+{
+    return self->offset + self->pos;
+}
+
+const XML_Char* XML_ReaderElem_GetAttr(
+    _In_ const XML_ReaderElem* self,
+    XML_Char nsId,
+    _In_z_ const XML_Char* name)
+{
+    size_t i;
+
+    for (i = 0; i < self->attrsSize; i++)
+    {
+        if (nsId == self->attrs[i].name.namespaceId &&
+            XML_strcmp(name, self->attrs[i].name.data) == 0)
+            return self->attrs[i].value;
+    }
+
+    return NULL;
+}
@@ -0,0 +1,154 @@
+/*
+**==============================================================================
+**
+** Copyright (c) Microsoft Corporation. All rights reserved. See file LICENSE
+** for license information.
+**
+**==============================================================================
+*/
+
+#ifndef _omiar_xmlreader_h
+#define _omiar_xmlreader_h
+
+#include "xml.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+/*
+    Resumable XML pull parser.
+
+    Unlike XML_Next(), which needs the whole document as one zero-terminated
+    buffer, the reader is fed the document piece by piece (for example page
+    by page as it is received) and returns XML_READER_MORE when the next
+    element is not complete in the data fed so far. Only the unconsumed tail
+    of the fed data is kept between feeds. Names of open elements and
+    in-scope namespace declarations are copied, so element nesting,
+    namespaces and attributes are not limited by fixed arrays.
+
+    Elements are reported the same way XML_Next() reports them. Data of an
+    element (names, values, attributes) is valid until the next call to
+    XML_Reader_Next() or XML_Reader_Feed().
+*/
+
+/* XML_Reader_Next() result: more data has to be fed */
+#define XML_READER_MORE 2
+
+/* Represents one XML element returned by the reader */
+typedef struct _XML_ReaderElem
+{
+    /* Type of this XML object */
+    XML_Type type;
+
+    /* Tag or character data */
+    XML_Name data;
+
+    /* Attributes */
+    XML_Attr* attrs;
+    size_t attrsSize;
+}
+XML_ReaderElem;
+
+typedef struct _XML_Reader
+{
+    /* Fed data; text[pos, textSize) is not consumed yet; zero-terminated */
+    XML_Char* text;
+    size_t textSize;
+    size_t textCapacity;
+    size_t pos;
+
+    /* Offset of text[0] in the document */
+    size_t offset;
+
+    /* Where the search for the end of an incomplete item resumes (relative
+       to pos) and the open quote of an incomplete tag */
+    size_t scan;
+    XML_Char quote;
+
+    /* Whether the end of the document has been fed */
+    int last;
+
+    /* Internal parser state */
+    int state;
+
+    /* Status: 0=Okay, 1=Done, -1=Failed */
+    int status;
+
+    /* Error message */
+    XML_Char message[256];
+
+    /* Open elements */
+    struct _XML_ReaderScope* scopes;
+    size_t scopesSize;
+    size_t scopesCapacity;
+
+    /* Copies of the names of open elements and in-scope namespaces */
+    XML_Char* names;
+    size_t namesSize;
+    size_t namesCapacity;
+
+    /* In-scope namespace declarations */
+    struct _XML_ReaderNameSpace* nameSpaces;
+    size_t nameSpacesSize;
+    size_t nameSpacesCapacity;
+
+    /* Attributes of the last start tag */
+    XML_Attr* attrs;
+    size_t attrsSize;
+    size_t attrsCapacity;
+
+    /* Set when the innermost element was closed by the last element */
+    int popScope;
+
+    /* Set when the last element was an empty tag (its end is next) */
+    int emptyEnd;
+
+    /* Predefined namespaces */
+    XML_RegisteredNameSpace registeredNameSpaces[XML_MAX_REGISTERED_NAMESPACES];
+    size_t registeredNameSpacesSize;
+}
+XML_Reader;
+
+void XML_Reader_Init(
+    _Out_ XML_Reader* self);
+
+void XML_Reader_Destroy(
+    _Inout_ XML_Reader* self);
+
+int XML_Reader_RegisterNameSpace(
+    _Inout_ XML_Reader* self,
+    XML_Char id,
+    _In_z_ const XML_Char* uri);
+
+/* Appends data to the document; 'last' is set with (or after) the final
+   piece. Returns 0 or -1 if out of memory (status is set to failed). */
+int XML_Reader_Feed(
+    _Inout_ XML_Reader* self,
+    _In_reads_(size) const XML_Char* data,
+    size_t size,
+    int last);
+
+/* Returns 0 if an element was returned, XML_READER_MORE if more data has
+   to be fed, 1 at the end of the document and -1 on failure (the message
+   is in self->message) */
+int XML_Reader_Next(
+    _Inout_ XML_Reader* self,
+    _Out_ XML_ReaderElem* elem);
+
+/* Returns the offset in the document of the first character not consumed
+   yet. Right after a start or end tag is returned this is just past its
+   '>', where the document can be split for XML_SetTextPieces() */
+size_t XML_Reader_Offset(
+    _In_ const XML_Reader* self);
+
+const XML_Char* XML_ReaderElem_GetAttr(
+    _In_ const XML_ReaderElem* self,
+    XML_Char nsId,
+    _In_z_ const XML_Char* name);
+
+#if defined(__cplusplus)
+} /* extern "C" */
+#endif
+
+#endif /* _omiar_xmlreader_h */